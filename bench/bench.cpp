@@ -0,0 +1,52 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.hpp"
+
+// CPU-only benchmarks, no window or GL context is created.
+// Usage: bench [name] [options]   (no name runs everything)
+
+struct BenchEntry {
+    const char * name;
+    int (*run)(int argc, char ** argv);
+};
+
+static const BenchEntry benches[] = {
+    { "cull", benchCulling },
+    { "bvh", benchBVH },
+    { "occlusion", benchOcclusion },
+    { "lights", benchLights },
+    { "scenegraph", benchSceneGraph },
+    { "transforms", benchTransforms },
+    { "picking", benchPicking },
+    { "softraster", benchSoftRaster },
+    { "assets", benchAssets },
+    { "suballoc", benchSuballoc },
+    { "residency", benchResidency },
+};
+
+int main(int argc, char ** argv)
+{
+    const int numBenches = sizeof(benches) / sizeof(benches[0]);
+    const char * only = argc > 1 ? argv[1] : NULL;
+
+    int failures = 0;
+    bool ran = false;
+    for (int i = 0; i < numBenches; i++) {
+        if (only && strcmp(only, benches[i].name) != 0)
+            continue;
+        printf("== %s ==\n", benches[i].name);
+        failures += benches[i].run(only ? argc - 2 : 0, only ? argv + 2 : NULL) != 0;
+        ran = true;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "Unknown benchmark %s. Available:", only);
+        for (int i = 0; i < numBenches; i++)
+            fprintf(stderr, " %s", benches[i].name);
+        fprintf(stderr, "\n");
+        return 1;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <stddef.h>
+#include <chrono>
+
+// Wall clock helper shared by the benchmarks
+class BenchTimer {
+public:
+    BenchTimer() { reset(); }
+    void reset() { start = std::chrono::high_resolution_clock::now(); }
+    double milliseconds() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+private:
+    std::chrono::high_resolution_clock::time_point start;
+};
+
+// Heap use through operator new and delete since the bench started (bench_alloc.cpp)
+struct AllocationStats {
+    size_t count;   // calls to operator new
+    size_t bytes;   // bytes requested by them
+    size_t live;    // bytes not deleted yet
+    size_t peak;    // highest live since the last resetAllocationPeak()
+};
+AllocationStats allocationStats();
+void resetAllocationPeak();
+
+// Each benchmark returns 0 on success, non zero if a result check failed
+int benchCulling(int argc, char ** argv);
+int benchBVH(int argc, char ** argv);
+int benchOcclusion(int argc, char ** argv);
+int benchLights(int argc, char ** argv);
+int benchSceneGraph(int argc, char ** argv);
+int benchTransforms(int argc, char ** argv);
+int benchPicking(int argc, char ** argv);
+int benchSoftRaster(int argc, char ** argv);
+int benchAssets(int argc, char ** argv);
+int benchSuballoc(int argc, char ** argv);
+int benchResidency(int argc, char ** argv);
+
+#endif
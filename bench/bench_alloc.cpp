@@ -0,0 +1,78 @@
+// Include standard headers
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+#include "bench.hpp"
+
+// Global operator new and delete of the bench process, counting what goes through them.
+// Every block gets a header holding its size, so delete knows how much to take off the
+// live bytes; 16 bytes keep the alignment malloc gives.
+
+static std::atomic<size_t> allocationCount(0);
+static std::atomic<size_t> allocatedBytes(0);
+static std::atomic<size_t> liveBytes(0);
+static std::atomic<size_t> peakBytes(0);
+
+static const size_t HeaderBytes = 16;
+
+static void * countedAllocate(size_t size) {
+    void * block = malloc(size + HeaderBytes);
+    if (!block)
+        return NULL;
+    *(size_t *)block = size;
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        ;
+    return (char *)block + HeaderBytes;
+}
+
+static void countedFree(void * pointer) {
+    if (!pointer)
+        return;
+    void * block = (char *)pointer - HeaderBytes;
+    liveBytes.fetch_sub(*(size_t *)block, std::memory_order_relaxed);
+    free(block);
+}
+
+void * operator new(size_t size) {
+    void * pointer = countedAllocate(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return countedAllocate(size);
+}
+
+void operator delete(void * pointer) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, size_t) noexcept { countedFree(pointer); }
+void operator delete(void * pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+void operator delete[](void * pointer, const std::nothrow_t &) noexcept { countedFree(pointer); }
+
+AllocationStats allocationStats() {
+    AllocationStats stats;
+    stats.count = allocationCount.load(std::memory_order_relaxed);
+    stats.bytes = allocatedBytes.load(std::memory_order_relaxed);
+    stats.live = liveBytes.load(std::memory_order_relaxed);
+    stats.peak = peakBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void resetAllocationPeak() {
+    peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
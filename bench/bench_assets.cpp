@@ -0,0 +1,710 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#define dup _dup
+#define dup2 _dup2
+#define close _close
+#define open _open
+#define fileno _fileno
+#define NULL_DEVICE "NUL"
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/lineararena.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/bundle.hpp>
+#include <common/frustum.hpp>
+
+#include "bench.hpp"
+
+// Defined in common/texture.cpp; texture.hpp itself needs the GL headers
+bool loadBMP_pixels(const char * imagepath, std::vector<unsigned char> & data, unsigned int & width, unsigned int & height);
+
+struct AssetSettings {
+    double minMilliseconds;     // keep repeating a case until it ran this long...
+    int minIterations;          // ...and at least this often
+    size_t slowLimit;           // indexVBO_slow is O(n^2), skipped above this many vertices
+};
+
+struct AssetResult {
+    std::string name;           // function
+    std::string input;          // file below the asset directory, or a synthetic input
+    bool skipped;
+    int iterations;
+    double milliseconds;        // median of the iterations
+    double bytes;               // read or processed per call
+    double items;               // vertices, faces, models or pixels per call
+    size_t allocations;         // per call
+    size_t allocatedBytes;
+    size_t peakBytes;           // above what was live before the call
+};
+
+// The loaders print a line per call; they go to the null device while a case runs
+class QuietStdout {
+public:
+    QuietStdout() {
+        fflush(stdout);
+        saved = dup(fileno(stdout));
+        int null = open(NULL_DEVICE, O_WRONLY);
+        if (null >= 0) {
+            dup2(null, fileno(stdout));
+            close(null);
+        }
+    }
+    ~QuietStdout() {
+        fflush(stdout);
+        if (saved >= 0) {
+            dup2(saved, fileno(stdout));
+            close(saved);
+        }
+    }
+private:
+    int saved;
+};
+
+// Runs one case until the settings are satisfied; allocations are those of the first call
+template <typename Run>
+static AssetResult measure(const char * name, const std::string & input, double bytes, double items,
+                           const AssetSettings & settings, Run run) {
+    AssetResult result = AssetResult();
+    result.name = name;
+    result.input = input;
+    result.bytes = bytes;
+    result.items = items;
+
+    std::vector<double> times;
+    double total = 0.0;
+    {
+        QuietStdout quiet;
+        while ((total < settings.minMilliseconds || (int)times.size() < settings.minIterations) && times.size() < 1000) {
+            AllocationStats before = allocationStats();
+            resetAllocationPeak();
+            BenchTimer timer;
+            run();
+            double ms = timer.milliseconds();
+            if (times.empty()) {
+                AllocationStats after = allocationStats();
+                result.allocations = after.count - before.count;
+                result.allocatedBytes = after.bytes - before.bytes;
+                result.peakBytes = after.peak - before.live;
+            }
+            times.push_back(ms);
+            total += ms;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    result.iterations = (int)times.size();
+    result.milliseconds = times[times.size() / 2];
+    return result;
+}
+
+static AssetResult skipped(const char * name, const std::string & input) {
+    AssetResult result = AssetResult();
+    result.name = name;
+    result.input = input;
+    result.skipped = true;
+    return result;
+}
+
+// Sorted names of the files in directory ending in extension
+static std::vector<std::string> listFiles(const std::string & directory, const char * extension) {
+    std::vector<std::string> names;
+    size_t extensionLength = strlen(extension);
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE find = FindFirstFileA((directory + "\\*" + extension).c_str(), &found);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                names.push_back(found.cFileName);
+        } while (FindNextFileA(find, &found));
+        FindClose(find);
+    }
+#else
+    DIR * dir = opendir(directory.c_str());
+    if (dir) {
+        while (struct dirent * entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > extensionLength && name.compare(name.size() - extensionLength, extensionLength, extension) == 0)
+                names.push_back(name);
+        }
+        closedir(dir);
+    }
+#endif
+    (void)extensionLength;
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static long fileSize(const std::string & path) {
+    FILE * file = fopen(path.c_str(), "rb");
+    if (!file)
+        return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static bool writeFile(const std::string & path, const std::string & contents) {
+    FILE * file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+    return fclose(file) == 0 && written;
+}
+
+static bool readFile(const std::string & path, std::string & contents) {
+    long size = fileSize(path);
+    FILE * file = size >= 0 ? fopen(path.c_str(), "rb") : NULL;
+    if (!file)
+        return false;
+    contents.resize((size_t)size);
+    bool read = size == 0 || fread(&contents[0], 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    return read;
+}
+
+// 24 bit BMP with a gradient, rows padded to 4 bytes, in the layout loadBMP_pixels reads
+static std::string makeBMP(unsigned int width, unsigned int height) {
+    unsigned int rowBytes = (width * 3 + 3) & ~3u;
+    unsigned int imageSize = rowBytes * height;
+    std::string bmp(54 + (size_t)imageSize, '\0');
+    unsigned char * header = (unsigned char *)&bmp[0];
+    auto put32 = [&](int offset, unsigned int value) {
+        for (int i = 0; i < 4; i++)
+            header[offset + i] = (unsigned char)(value >> (8 * i));
+    };
+    header[0] = 'B';
+    header[1] = 'M';
+    put32(0x02, 54 + imageSize);
+    put32(0x0A, 54);
+    put32(0x0E, 40);
+    put32(0x12, width);
+    put32(0x16, height);
+    header[0x1A] = 1;
+    header[0x1C] = 24;
+    put32(0x22, imageSize);
+    for (unsigned int y = 0; y < height; y++) {
+        unsigned char * row = header + 54 + (size_t)y * rowBytes;
+        for (unsigned int x = 0; x < width; x++) {
+            row[x * 3 + 0] = (unsigned char)x;
+            row[x * 3 + 1] = (unsigned char)y;
+            row[x * 3 + 2] = (unsigned char)(x ^ y);
+        }
+    }
+    return bmp;
+}
+
+// loadOBJ leaves uvs or normals empty when the file has none; the indexers want one per vertex
+static void fillAttributes(const std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals) {
+    uvs.resize(vertices.size(), glm::vec2(0.0f));
+    normals.resize(vertices.size(), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Cases on the unrolled triangle list of one mesh
+static void benchArrays(const std::string & input, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs,
+                        std::vector<glm::vec3> & normals, const AssetSettings & settings, std::vector<AssetResult> & results) {
+    double bytes = (double)vertices.size() * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2));
+    double items = (double)vertices.size();
+    results.push_back(measure("indexVBO", input, bytes, items, settings, [&]() {
+        std::vector<unsigned short> indices;
+        std::vector<glm::vec3> outVertices, outNormals;
+        std::vector<glm::vec2> outUVs;
+        indexVBO(vertices, uvs, normals, indices, outVertices, outUVs, outNormals);
+    }));
+    if (vertices.size() <= settings.slowLimit) {
+        results.push_back(measure("indexVBO_slow", input, bytes, items, settings, [&]() {
+            std::vector<unsigned short> indices;
+            std::vector<glm::vec3> outVertices, outNormals;
+            std::vector<glm::vec2> outUVs;
+            indexVBO_slow(vertices, uvs, normals, indices, outVertices, outUVs, outNormals);
+        }));
+    } else {
+        results.push_back(skipped("indexVBO_slow", input));
+    }
+    results.push_back(measure("computeTangentBasis", input, bytes, items, settings, [&]() {
+        std::vector<glm::vec3> tangents, bitangents;
+        computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+    }));
+}
+
+// Cases reading one OBJ file; returns false if the loader rejects it
+static bool benchMesh(const std::string & path, const std::string & input, const AssetSettings & settings,
+                      std::vector<AssetResult> & results, bool withArrays) {
+    double bytes = (double)fileSize(path);
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::ivec3> vertexIndices, uvIndices, normalIndices;
+    bool loaded;
+    {
+        QuietStdout quiet;
+        loaded = loadOBJ_indexed_modified(path.c_str(), vertices, uvs, normals, vertexIndices, uvIndices, normalIndices) &&
+                 !vertexIndices.empty();
+    }
+    if (!loaded) {
+        // Faces of more than 4 vertices are not supported, Handgun_Packed.obj has some
+        printf("%s does not load, skipped\n", path.c_str());
+        results.push_back(skipped("loadOBJ_indexed_modified", input));
+        results.push_back(skipped("loadOBJ", input));
+        return false;
+    }
+    results.push_back(measure("loadOBJ_indexed_modified", input, bytes, (double)vertexIndices.size(), settings, [&]() {
+        std::vector<glm::vec3> v, n;
+        std::vector<glm::vec2> t;
+        std::vector<glm::ivec3> vi, ti, ni;
+        loadOBJ_indexed_modified(path.c_str(), v, t, n, vi, ti, ni);
+    }));
+
+    vertices.clear();
+    uvs.clear();
+    normals.clear();
+    {
+        QuietStdout quiet;
+        loadOBJ(path.c_str(), vertices, uvs, normals);
+    }
+    results.push_back(measure("loadOBJ", input, bytes, (double)vertices.size(), settings, [&]() {
+        std::vector<glm::vec3> v, n;
+        std::vector<glm::vec2> t;
+        loadOBJ(path.c_str(), v, t, n);
+    }));
+
+    if (withArrays) {
+        fillAttributes(vertices, uvs, normals);
+        benchArrays(input, vertices, uvs, normals, settings, results);
+    }
+    return true;
+}
+
+// Bounds read without the geometry match computeBounds over the vertices loadOBJ returns
+static bool sameBounds(const MeshBounds & bounds, const std::vector<glm::vec3> & vertices) {
+    AABB box;
+    BoundingSphere sphere;
+    computeBounds(vertices, box, sphere);
+    return bounds.vertices == vertices.size() && bounds.min == box.min && bounds.max == box.max &&
+           bounds.radius == sphere.radius;
+}
+
+static std::string escapeJSON(const std::string & text) {
+    std::string escaped;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            escaped += '\\';
+        escaped += text[i];
+    }
+    return escaped;
+}
+
+static double megabytesPerSecond(const AssetResult & result) {
+    return result.milliseconds > 0.0 ? result.bytes / (result.milliseconds * 1000.0) : 0.0;
+}
+
+static double itemsPerSecond(const AssetResult & result) {
+    return result.milliseconds > 0.0 ? result.items * 1000.0 / result.milliseconds : 0.0;
+}
+
+// One result per line, so the baseline reader can go line by line
+static bool writeJSON(const char * path, int scale, const std::vector<AssetResult> & results) {
+    FILE * file = fopen(path, "w");
+    if (!file)
+        return false;
+    fprintf(file, "{\n  \"bench\": \"assets\",\n  \"scale\": %d,\n  \"results\": [\n", scale);
+    for (size_t i = 0; i < results.size(); i++) {
+        const AssetResult & r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"input\": \"%s\"", escapeJSON(r.name).c_str(), escapeJSON(r.input).c_str());
+        if (r.skipped)
+            fprintf(file, ", \"skipped\": true");
+        else
+            fprintf(file, ", \"iterations\": %d, \"ms\": %.6f, \"bytes\": %.0f, \"mb_per_s\": %.3f, \"items\": %.0f, \"items_per_s\": %.1f"
+                    ", \"allocations\": %lu, \"allocated_bytes\": %lu, \"peak_bytes\": %lu",
+                    r.iterations, r.milliseconds, r.bytes, megabytesPerSecond(r), r.items, itemsPerSecond(r),
+                    (unsigned long)r.allocations, (unsigned long)r.allocatedBytes, (unsigned long)r.peakBytes);
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+// Value of "key" in one line of writeJSON output
+static bool findString(const std::string & line, const char * key, std::string & value) {
+    std::string pattern = std::string("\"") + key + "\": \"";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos)
+        return false;
+    value.clear();
+    for (size_t i = start + pattern.size(); i < line.size() && line[i] != '"'; i++) {
+        if (line[i] == '\\' && i + 1 < line.size())
+            i++;
+        value += line[i];
+    }
+    return true;
+}
+
+static bool findNumber(const std::string & line, const char * key, double & value) {
+    std::string pattern = std::string("\"") + key + "\": ";
+    size_t start = line.find(pattern);
+    if (start == std::string::npos)
+        return false;
+    value = atof(line.c_str() + start + pattern.size());
+    return true;
+}
+
+// Compares with a file written by --json. Time may grow by tolerance (relative) plus 0.01 ms
+// of timer noise, allocations and peak memory not at all. Returns the number of regressions.
+static int compareBaseline(const char * path, double tolerance, const std::vector<AssetResult> & results) {
+    std::string contents;
+    if (!readFile(path, contents)) {
+        printf("could not read baseline %s\n", path);
+        return 1;
+    }
+    int regressions = 0, compared = 0;
+    size_t lineStart = 0;
+    while (lineStart < contents.size()) {
+        size_t lineEnd = contents.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = contents.size();
+        std::string line = contents.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        std::string name, input;
+        double ms, allocations, peak;
+        if (!findString(line, "name", name) || !findString(line, "input", input) || !findNumber(line, "ms", ms) ||
+            !findNumber(line, "allocations", allocations) || !findNumber(line, "peak_bytes", peak))
+            continue;
+        const AssetResult * current = NULL;
+        for (size_t i = 0; i < results.size() && !current; i++)
+            if (results[i].name == name && results[i].input == input && !results[i].skipped)
+                current = &results[i];
+        if (!current) {
+            printf("baseline %s %s was not run\n", name.c_str(), input.c_str());
+            continue;
+        }
+        compared++;
+        const char * what = NULL;
+        if (current->milliseconds > ms * (1.0 + tolerance) + 0.01)
+            what = "time";
+        else if ((double)current->allocations > allocations)
+            what = "allocations";
+        else if ((double)current->peakBytes > peak)
+            what = "peak memory";
+        if (what) {
+            printf("REGRESSION %s %s %s: %.3f -> %.3f ms, %.0f -> %lu allocations, %.1f -> %.1f KB peak\n",
+                   what, name.c_str(), input.c_str(), ms, current->milliseconds, allocations,
+                   (unsigned long)current->allocations, peak / 1024.0, current->peakBytes / 1024.0);
+            regressions++;
+        } else if (current->milliseconds < ms / (1.0 + tolerance) - 0.01) {
+            printf("faster     %s %s: %.3f -> %.3f ms\n", name.c_str(), input.c_str(), ms, current->milliseconds);
+        }
+    }
+    printf("%d cases compared with %s, %d regressions (tolerance %.0f%%)\n", compared, path, regressions, tolerance * 100.0);
+    return regressions;
+}
+
+// The asset loading code of part4 over every mesh, texture and models file below an asset
+// directory, then over synthetic inputs scale times the largest mesh that loads. Reports the median
+// time, throughput, heap allocations and peak heap use per call, optionally as JSON, and
+// can compare against such a JSON file: any slower case beyond the tolerance or more
+// allocations or peak memory counts as a failure.
+// Usage: bench assets [--dir src] [--scale 4] [--min-time ms] [--json out.json]
+//                     [--baseline base.json] [--tolerance 0.1] [--slow-limit vertices]
+int benchAssets(int argc, char ** argv)
+{
+    std::string directory = "src";
+    int scale = 4;
+    const char * jsonPath = NULL;
+    const char * baselinePath = NULL;
+    double tolerance = 0.1;
+    AssetSettings settings;
+    settings.minMilliseconds = 200.0;
+    settings.minIterations = 3;
+    settings.slowLimit = 12000;
+    for (int i = 0; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--dir") && hasValue)
+            directory = argv[++i];
+        else if (!strcmp(argv[i], "--scale") && hasValue)
+            scale = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--min-time") && hasValue)
+            settings.minMilliseconds = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--json") && hasValue)
+            jsonPath = argv[++i];
+        else if (!strcmp(argv[i], "--baseline") && hasValue)
+            baselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && hasValue)
+            tolerance = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--slow-limit") && hasValue)
+            settings.slowLimit = (size_t)atol(argv[++i]);
+        else {
+            printf("unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    // Without --dir, the repository root or a build directory next to src
+    bool directoryGiven = false;
+    for (int i = 0; i < argc; i++)
+        directoryGiven = directoryGiven || !strcmp(argv[i], "--dir");
+    std::vector<std::string> meshes = listFiles(directory + "/meshes", ".obj");
+    if (meshes.empty() && !directoryGiven) {
+        directory = "../src";
+        meshes = listFiles(directory + "/meshes", ".obj");
+    }
+    std::vector<std::string> textures = listFiles(directory + "/textures", ".bmp");
+    std::vector<std::string> modelFiles = listFiles(directory, ".models");
+    if (meshes.empty()) {
+        printf("no meshes in %s/meshes, pass --dir\n", directory.c_str());
+        return 1;
+    }
+    int failures = 0;
+    std::vector<AssetResult> results;
+
+    // Bundles and synthetic inputs, written next to the other temporary files and removed afterwards
+    const char * temporary = getenv("TMPDIR");
+    if (!temporary)
+        temporary = getenv("TEMP");
+    if (!temporary)
+        temporary = "/tmp";
+    std::string prefix = std::string(temporary) + "/bench_assets_";
+
+    std::string largestMesh, largestModels;
+    long largestMeshSize = -1;
+    size_t mostModels = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        std::string path = directory + "/meshes/" + meshes[i];
+        if (benchMesh(path, "meshes/" + meshes[i], settings, results, true) && fileSize(path) > largestMeshSize) {
+            largestMeshSize = fileSize(path);
+            largestMesh = meshes[i];
+        }
+    }
+    for (size_t i = 0; i < modelFiles.size(); i++) {
+        std::string path = directory + "/" + modelFiles[i];
+        std::vector<Model> models;
+        {
+            QuietStdout quiet;
+            loadModels(path.c_str(), models);
+        }
+        if (models.size() > mostModels) {
+            mostModels = models.size();
+            largestModels = modelFiles[i];
+        }
+        results.push_back(measure("loadModels", modelFiles[i], (double)fileSize(path), (double)models.size(), settings, [&]() {
+            std::vector<Model> loaded;
+            loadModels(path.c_str(), loaded);
+        }));
+
+        // Every mesh of the scene through one load arena, like part4 loads it
+        std::vector<std::string> objPaths;
+        double objBytes = 0.0;
+        for (size_t m = 0; m < models.size(); m++) {
+            objPaths.push_back(directory + "/" + models[m].objFilename);
+            objBytes += (double)std::max(0L, fileSize(objPaths.back()));
+        }
+        results.push_back(measure("loadOBJ scene", modelFiles[i], objBytes, (double)models.size(), settings, [&]() {
+            LinearArena arena;
+            for (size_t m = 0; m < objPaths.size(); m++) {
+                std::vector<glm::vec3> v, n;
+                std::vector<glm::vec2> t;
+                loadOBJ(objPaths[m].c_str(), v, t, n, &arena);
+            }
+        }));
+
+        // The scene packed into a bundle, stored and as LZ4 blocks: the models, meshes and
+        // textures read back must equal the ones loaded from the files
+        std::string bundlePath = prefix + "scene.bundle";
+        for (int compress = 0; compress < 2; compress++) {
+            SceneBundle bundle;
+            std::vector<Model> packed;
+            std::vector<int> meshChunks, textureChunks;
+            bool loaded;
+            {
+                QuietStdout quiet;
+                loaded = packScene(path.c_str(), directory, bundlePath.c_str(), compress != 0) &&
+                         bundle.open(bundlePath.c_str()) && bundle.readScene(packed, meshChunks, textureChunks);
+            }
+            if (!loaded || packed.size() != models.size()) {
+                printf("%s does not pack into a bundle\n", modelFiles[i].c_str());
+                failures++;
+                remove(bundlePath.c_str());
+                continue;
+            }
+            int mismatches = 0;
+            for (size_t m = 0; m < models.size(); m++) {
+                std::vector<glm::vec3> v, n, packedV, packedN;
+                std::vector<glm::vec2> t, packedT;
+                std::vector<unsigned char> pixels, scratch;
+                unsigned int width = 0, height = 0, packedWidth, packedHeight;
+                MeshBounds parsedBounds = MeshBounds(), packedBounds = MeshBounds();
+                {
+                    QuietStdout quiet;
+                    loadOBJ(objPaths[m].c_str(), v, t, n);
+                    loadOBJ_bounds(objPaths[m].c_str(), parsedBounds);
+                    if (t.size() == v.size() && !v.empty())
+                        loadBMP_pixels((directory + "/" + models[m].textureFilename).c_str(), pixels, width, height);
+                }
+                if (!bundle.readMesh(meshChunks[m], packedV, packedT, packedN, scratch) || packedV != v ||
+                    (n.size() == v.size() && packedN != n) || (t.size() == v.size() && packedT != t) ||
+                    memcmp(&packed[m].sx, &models[m].sx, 20 * sizeof(float)) != 0)
+                    mismatches++;
+                if (!sameBounds(parsedBounds, v) || !bundle.readMeshBounds(meshChunks[m], packedBounds) ||
+                    !sameBounds(packedBounds, v))
+                    mismatches++;
+                const unsigned char * packedPixels = textureChunks[m] >= 0 ?
+                    bundle.readTexture(textureChunks[m], packedWidth, packedHeight, scratch) : NULL;
+                if (!pixels.empty() && (!packedPixels || packedWidth != width || packedHeight != height ||
+                    memcmp(packedPixels, &pixels[0], pixels.size()) != 0))
+                    mismatches++;
+            }
+            if (mismatches) {
+                printf("%d models of %s differ in the bundle\n", mismatches, modelFiles[i].c_str());
+                failures++;
+            }
+            // The same meshes as loadOBJ scene, from the mapped file
+            results.push_back(measure(compress ? "SceneBundle scene lz4" : "SceneBundle scene", modelFiles[i],
+                                      (double)bundle.getFileSize(), (double)models.size(), settings, [&]() {
+                SceneBundle reader;
+                std::vector<Model> scene;
+                std::vector<int> meshes, textures;
+                std::vector<unsigned char> scratch;
+                reader.open(bundlePath.c_str());
+                reader.readScene(scene, meshes, textures);
+                for (size_t m = 0; m < meshes.size(); m++) {
+                    std::vector<glm::vec3> v, n;
+                    std::vector<glm::vec2> t;
+                    reader.readMesh(meshes[m], v, t, n, scratch);
+                }
+            }));
+            bundle.close();
+            remove(bundlePath.c_str());
+        }
+    }
+    for (size_t i = 0; i < textures.size(); i++) {
+        std::string path = directory + "/textures/" + textures[i];
+        std::vector<unsigned char> pixels;
+        unsigned int width = 0, height = 0;
+        bool loaded;
+        {
+            QuietStdout quiet;
+            loaded = loadBMP_pixels(path.c_str(), pixels, width, height);
+        }
+        if (!loaded) {
+            printf("%s did not load\n", path.c_str());
+            failures++;
+            continue;
+        }
+        results.push_back(measure("loadBMP_pixels", "textures/" + textures[i], (double)fileSize(path), (double)width * height, settings, [&]() {
+            std::vector<unsigned char> data;
+            unsigned int w, h;
+            loadBMP_pixels(path.c_str(), data, w, h);
+        }));
+    }
+
+    // Synthetic inputs
+    char label[64];
+    snprintf(label, sizeof(label), "synthetic %dx ", scale);
+
+    // The largest OBJ repeated: later copies add vertices, their faces index the first copy
+    std::string obj;
+    if (!largestMesh.empty() && readFile(directory + "/meshes/" + largestMesh, obj)) {
+        std::string path = prefix + "mesh.obj", scaled;
+        for (int s = 0; s < scale; s++)
+            scaled += obj + "\n";
+        if (writeFile(path, scaled)) {
+            benchMesh(path, label + ("meshes/" + largestMesh), settings, results, false);
+            remove(path.c_str());
+        }
+
+        // Its triangle list as scale displaced copies, so the indexers see distinct vertices
+        std::vector<glm::vec3> vertices, normals, scaledVertices, scaledNormals;
+        std::vector<glm::vec2> uvs, scaledUVs;
+        {
+            QuietStdout quiet;
+            loadOBJ((directory + "/meshes/" + largestMesh).c_str(), vertices, uvs, normals);
+        }
+        fillAttributes(vertices, uvs, normals);
+        for (int s = 0; s < scale; s++) {
+            for (size_t v = 0; v < vertices.size(); v++)
+                scaledVertices.push_back(vertices[v] + glm::vec3(1000.0f * s, 0.0f, 0.0f));
+            scaledUVs.insert(scaledUVs.end(), uvs.begin(), uvs.end());
+            scaledNormals.insert(scaledNormals.end(), normals.begin(), normals.end());
+        }
+        benchArrays(label + ("meshes/" + largestMesh), scaledVertices, scaledUVs, scaledNormals, settings, results);
+    }
+
+    // A scene of 1000 * scale models
+    {
+        std::string path = prefix + "scene.models", scene;
+        int numModels = 1000 * scale;
+        scene = std::to_string(numModels) + "\n";
+        for (int m = 0; m < numModels; m++) {
+            char entry[256];
+            snprintf(entry, sizeof(entry), "# model %d\nmeshes/%s\n1 1 1 0 1 0 %d %d 0 %d\n0.1 0.1 0.1 0.8 0.6 0.4 1 1 1 32\ntextures/silo.bmp\n",
+                     m, largestMesh.c_str(), m % 360, m % 100, m / 100);
+            scene += entry;
+        }
+        if (writeFile(path, scene)) {
+            std::string input = label + std::string("scene.models");
+            results.push_back(measure("loadModels", input, (double)scene.size(), (double)numModels, settings, [&]() {
+                std::vector<Model> loaded;
+                loadModels(path.c_str(), loaded);
+            }));
+            remove(path.c_str());
+        }
+    }
+
+    // A 2048 x (512 * scale) texture
+    {
+        std::string path = prefix + "texture.bmp";
+        std::string bmp = makeBMP(2048, 512 * scale);
+        if (writeFile(path, bmp)) {
+            char input[64];
+            snprintf(input, sizeof(input), "synthetic 2048x%d.bmp", 512 * scale);
+            results.push_back(measure("loadBMP_pixels", input, (double)bmp.size(), 2048.0 * 512.0 * scale, settings, [&]() {
+                std::vector<unsigned char> data;
+                unsigned int w, h;
+                loadBMP_pixels(path.c_str(), data, w, h);
+            }));
+            remove(path.c_str());
+        }
+    }
+
+    printf("%-25s %-38s %10s %9s %10s %9s %10s\n", "function", "input", "ms", "MB/s", "Mitems/s", "allocs", "peak KB");
+    for (size_t i = 0; i < results.size(); i++) {
+        const AssetResult & r = results[i];
+        if (r.skipped)
+            printf("%-25s %-38s %10s\n", r.name.c_str(), r.input.c_str(), "skipped");
+        else
+            printf("%-25s %-38s %10.3f %9.1f %10.2f %9lu %10.1f\n", r.name.c_str(), r.input.c_str(), r.milliseconds,
+                   megabytesPerSecond(r), itemsPerSecond(r) / 1e6, (unsigned long)r.allocations, r.peakBytes / 1024.0);
+    }
+
+    if (jsonPath) {
+        if (writeJSON(jsonPath, scale, results))
+            printf("wrote %s\n", jsonPath);
+        else {
+            printf("could not write %s\n", jsonPath);
+            failures++;
+        }
+    }
+    if (baselinePath)
+        failures += compareBaseline(baselinePath, tolerance, results);
+    return failures;
+}
@@ -0,0 +1,156 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cfloat>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/frustum.hpp>
+#include <common/bvh.hpp>
+
+#include "bench.hpp"
+
+static bool sameObjects(std::vector<unsigned int> a, std::vector<unsigned int> b) {
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+static bool boxesOverlap(const AABB & a, const AABB & b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Scene BVH build, refit and query costs against linear scans.
+// Usage: bench bvh [numObjects] [numQueries]
+int benchBVH(int argc, char ** argv)
+{
+    size_t numObjects = argc > 0 ? (size_t)atol(argv[0]) : 1000000;
+    int numQueries = argc > 1 ? atoi(argv[1]) : 1000;
+    int failures = 0;
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<AABB> bounds(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        glm::vec3 e(extent(rng), extent(rng), extent(rng));
+        bounds[i].min = c - e;
+        bounds[i].max = c + e;
+    }
+
+    // Build
+    SceneBVH bvh;
+    BenchTimer timer;
+    bvh.build(bounds, 1);
+    double buildSingle = timer.milliseconds();
+    timer.reset();
+    bvh.build(bounds);
+    double buildParallel = timer.milliseconds();
+    printf("objects: %zu, nodes: %zu\n", numObjects, bvh.nodeCount());
+    printf("build  1 thread : %9.3f ms\n", buildSingle);
+    printf("build  parallel : %9.3f ms\n", buildParallel);
+
+    // Incremental refit after moving a small fraction of the objects
+    size_t numMoved = std::max<size_t>(1, numObjects / 1000);
+    timer.reset();
+    for (size_t m = 0; m < numMoved; m++) {
+        size_t i = rng() % numObjects;
+        glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+        bounds[i].min += offset;
+        bounds[i].max += offset;
+        bvh.update((unsigned int)i, bounds[i]);
+    }
+    size_t touched = bvh.refit();
+    double refitTime = timer.milliseconds();
+    printf("refit  %6zu moved: %9.3f ms (%zu nodes touched)\n", numMoved, refitTime, touched);
+
+    // Box queries
+    std::vector<unsigned int> result, reference;
+    std::vector<AABB> queryBoxes(numQueries);
+    for (int q = 0; q < numQueries; q++) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        queryBoxes[q].min = c - glm::vec3(10.0f);
+        queryBoxes[q].max = c + glm::vec3(10.0f);
+    }
+    size_t hits = 0;
+    timer.reset();
+    for (int q = 0; q < numQueries; q++) {
+        bvh.queryBox(queryBoxes[q], result);
+        hits += result.size();
+    }
+    double boxTime = timer.milliseconds() * 1000.0 / numQueries;
+    int checks = std::min(numQueries, 10);
+    timer.reset();
+    for (int q = 0; q < checks; q++) {
+        reference.clear();
+        for (size_t i = 0; i < numObjects; i++) {
+            if (boxesOverlap(bounds[i], queryBoxes[q]))
+                reference.push_back((unsigned int)i);
+        }
+        bvh.queryBox(queryBoxes[q], result);
+        if (!sameObjects(result, reference)) {
+            printf("FAILED: box query %d differs from linear scan\n", q);
+            failures++;
+        }
+    }
+    double boxLinear = timer.milliseconds() * 1000.0 / checks;
+    printf("box query      : %9.3f us/query (%.1f hits), linear %9.3f us\n", boxTime, (double)hits / numQueries, boxLinear);
+
+    // Ray queries, closest hit against the object boxes
+    std::vector<glm::vec3> origins(numQueries), directions(numQueries);
+    for (int q = 0; q < numQueries; q++) {
+        origins[q] = glm::vec3(position(rng), position(rng), position(rng));
+        directions[q] = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)));
+    }
+    size_t rayHits = 0;
+    timer.reset();
+    for (int q = 0; q < numQueries; q++) {
+        const glm::vec3 & o = origins[q];
+        glm::vec3 inv = 1.0f / directions[q];
+        int hit = bvh.raycast(o, directions[q], FLT_MAX, [&](unsigned int object, float tmax) {
+            const AABB & b = bvh.getObjectBounds(object);
+            glm::vec3 t0 = (b.min - o) * inv, t1 = (b.max - o) * inv;
+            glm::vec3 tn = glm::min(t0, t1), tf = glm::max(t0, t1);
+            float tnear = std::max(std::max(tn.x, tn.y), std::max(tn.z, 0.0f));
+            float tfar = std::min(std::min(tf.x, tf.y), tf.z);
+            return tnear <= tfar ? tnear : tmax;
+        });
+        rayHits += hit >= 0;
+    }
+    double rayTime = timer.milliseconds() * 1000.0 / numQueries;
+    printf("ray closest hit: %9.3f us/query (%zu of %d hit)\n", rayTime, rayHits, numQueries);
+
+    // Frustum query against the flat SIMD culling pass
+    glm::mat4 VP = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f) *
+                   glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    Frustum frustum = extractFrustumPlanes(VP);
+    timer.reset();
+    bvh.queryFrustum(frustum, result);
+    double frustumTime = timer.milliseconds();
+
+    CullingBounds soa;
+    soa.reserve(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        BoundingSphere s = { 0.5f * (bounds[i].min + bounds[i].max), FLT_MAX };
+        soa.push_back(bounds[i], s);
+    }
+    CullStats stats;
+    cullBounds(frustum, soa, reference, &stats);
+    printf("frustum query  : %9.3f ms (%zu visible), flat SIMD cull %9.3f ms\n", frustumTime, result.size(), stats.milliseconds);
+    if (!sameObjects(result, reference)) {
+        printf("FAILED: frustum query differs from flat culling\n");
+        failures++;
+    }
+
+    return failures;
+}
@@ -0,0 +1,69 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/frustum.hpp>
+
+#include "bench.hpp"
+
+// Frustum culling throughput, scalar reference against the SIMD path.
+// Usage: bench cull [numObjects] [repetitions]
+int benchCulling(int argc, char ** argv)
+{
+    size_t numObjects = argc > 0 ? (size_t)atol(argv[0]) : 1000000;
+    int repetitions = argc > 1 ? atoi(argv[1]) : 20;
+
+    // Random boxes scattered around the camera, under a tenth of them end up visible
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> extent(0.1f, 2.0f);
+
+    CullingBounds bounds;
+    bounds.reserve(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        glm::vec3 c(position(rng), position(rng), position(rng));
+        glm::vec3 e(extent(rng), extent(rng), extent(rng));
+        AABB box = { c - e, c + e };
+        BoundingSphere sphere = { c, glm::length(e) };
+        bounds.push_back(box, sphere);
+    }
+
+    glm::mat4 ProjectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 ViewMatrix = glm::lookAt(glm::vec3(0, 0, 5), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    Frustum frustum = extractFrustumPlanes(ProjectionMatrix * ViewMatrix);
+
+    std::vector<unsigned int> visibleScalar, visibleSimd;
+    CullStats stats;
+    double bestScalar = 1e30, bestSimd = 1e30;
+    for (int r = 0; r < repetitions; r++) {
+        cullBoundsScalar(frustum, bounds, visibleScalar, &stats);
+        if (stats.milliseconds < bestScalar) bestScalar = stats.milliseconds;
+        cullBounds(frustum, bounds, visibleSimd, &stats);
+        if (stats.milliseconds < bestSimd) bestSimd = stats.milliseconds;
+    }
+
+    const char * path =
+#if defined(__AVX__)
+        "avx";
+#elif defined(__SSE2__) || defined(_M_X64)
+        "sse";
+#else
+        "scalar";
+#endif
+
+    printf("objects: %zu, visible: %u, culled: %u\n", numObjects, stats.visible, stats.culled);
+    printf("scalar: %8.3f ms  %6.2f ns/object\n", bestScalar, bestScalar * 1e6 / numObjects);
+    printf("%-6s: %8.3f ms  %6.2f ns/object  (%.2fx)\n", path, bestSimd, bestSimd * 1e6 / numObjects, bestScalar / bestSimd);
+
+    if (visibleScalar != visibleSimd) {
+        printf("FAILED: SIMD visible list differs from scalar reference\n");
+        return 1;
+    }
+    return 0;
+}
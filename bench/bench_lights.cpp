@@ -0,0 +1,94 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/threadpool.hpp>
+#include <common/clusteredlights.hpp>
+
+#include "bench.hpp"
+
+// Point lights scattered through a 200 x 20 x 200 box around the camera.
+// Checks that the SIMD/threaded assignment matches the scalar one and that every light
+// reaching a random visible point is in that point's cluster list.
+// Usage: bench lights [numLights] [frames]
+int benchLights(int argc, char ** argv)
+{
+    int numLights = argc > 0 ? atoi(argv[0]) : 1000;
+    int frames = argc > 1 ? atoi(argv[1]) : 50;
+    int failures = 0;
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> px(-100.0f, 100.0f), py(-2.0f, 18.0f), pz(-100.0f, 100.0f), pr(2.0f, 8.0f);
+    std::vector<PointLight> lights(numLights);
+    for (int i = 0; i < numLights; i++) {
+        lights[i].position = glm::vec3(px(rng), py(rng), pz(rng));
+        lights[i].radius = pr(rng);
+        lights[i].color = glm::vec3(1.0f);
+    }
+
+    ClusterGrid grid = { 16, 9, 24, 0.1f, 100.0f };
+    ClusteredLights clusters;
+    clusters.setGrid(grid);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, grid.near, grid.far);
+    ThreadPool & pool = defaultThreadPool();
+
+    ClusterData simd, scalar;
+    double simdMs = 0.0, scalarMs = 0.0;
+    for (int f = 0; f < frames; f++) {
+        float angle = 6.2831853f * f / frames;
+        glm::mat4 view = glm::lookAt(glm::vec3(0, 5, 0), glm::vec3(std::sin(angle), 5, -std::cos(angle)), glm::vec3(0, 1, 0));
+        clusters.assign(lights, view, projection, simd, &pool);
+        clusters.assignScalar(lights, view, projection, scalar);
+        simdMs += simd.stats.milliseconds;
+        scalarMs += scalar.stats.milliseconds;
+        if (simd.clusters != scalar.clusters || simd.indices != scalar.indices) {
+            printf("frame %d: SIMD and scalar light lists differ\n", f);
+            failures++;
+        }
+    }
+
+    // Points on random view rays: every light containing one must be listed in its cluster
+    float scale, bias;
+    clusters.sliceParameters(scale, bias);
+    glm::mat4 inverse = glm::inverse(projection);
+    std::uniform_real_distribution<float> ndc(-0.999f, 0.999f), depth(0.0f, 1.0f);
+    int missing = 0;
+    for (int s = 0; s < 100000; s++) {
+        float nx = ndc(rng), ny = ndc(rng);
+        glm::vec4 p = inverse * glm::vec4(nx, ny, -1.0f, 1.0f);
+        glm::vec3 dir = glm::vec3(p) / p.w;
+        float d = grid.near * std::pow(grid.far / grid.near, depth(rng));
+        glm::vec3 point = dir / -dir.z * d;
+        int tx = std::min((int)((nx * 0.5f + 0.5f) * grid.tilesX), grid.tilesX - 1);
+        int ty = std::min((int)((ny * 0.5f + 0.5f) * grid.tilesY), grid.tilesY - 1);
+        int slice = std::min(std::max((int)(std::log(d) * scale + bias), 0), grid.slices - 1);
+        int c = tx + grid.tilesX * (ty + grid.tilesY * slice);
+        unsigned int first = simd.clusters[2 * c], count = simd.clusters[2 * c + 1];
+        for (size_t l = 0; l < simd.lights.size() / 2; l++) {
+            glm::vec4 light = simd.lights[2 * l];
+            if (glm::length(glm::vec3(light) - point) >= light.w * 0.999f)
+                continue;
+            if (std::find(simd.indices.begin() + first, simd.indices.begin() + first + count, (unsigned int)l) ==
+                simd.indices.begin() + first + count)
+                missing++;
+        }
+    }
+    if (missing) {
+        printf("%d lights missing from the clusters of points they reach\n", missing);
+        failures++;
+    }
+
+    printf("%d lights, %dx%dx%d clusters, %u in range, %u references, max %u per cluster\n", numLights,
+           grid.tilesX, grid.tilesY, grid.slices, simd.stats.lights, simd.stats.references, simd.stats.maxPerCluster);
+    printf("scalar      %8.3f ms/frame\n", scalarMs / frames);
+    printf("SIMD x%-2u    %8.3f ms/frame  (%.1fx)\n", pool.size(), simdMs / frames, scalarMs / std::max(simdMs, 1e-9));
+    return failures;
+}
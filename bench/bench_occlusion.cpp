@@ -0,0 +1,104 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/frustum.hpp>
+#include <common/threadpool.hpp>
+#include <common/occlusion.hpp>
+
+#include "bench.hpp"
+
+// Appends the 12 triangles of a box to a non-indexed triangle list
+static void appendBox(std::vector<glm::vec3> & out, const glm::vec3 & lo, const glm::vec3 & hi) {
+    glm::vec3 c[8];
+    for (int i = 0; i < 8; i++)
+        c[i] = glm::vec3((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+    static const int faces[6][4] = {
+        {0, 1, 3, 2}, {4, 6, 7, 5}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 5, 7, 3}
+    };
+    for (int f = 0; f < 6; f++) {
+        out.push_back(c[faces[f][0]]); out.push_back(c[faces[f][1]]); out.push_back(c[faces[f][2]]);
+        out.push_back(c[faces[f][0]]); out.push_back(c[faces[f][2]]); out.push_back(c[faces[f][3]]);
+    }
+}
+
+// City block: a street of building occluders with many small objects behind and between them.
+// Usage: bench occlusion [numObjects] [frames]
+int benchOcclusion(int argc, char ** argv)
+{
+    size_t numObjects = argc > 0 ? (size_t)atol(argv[0]) : 100000;
+    int frames = argc > 1 ? atoi(argv[1]) : 20;
+    int failures = 0;
+
+    // Two rows of buildings along the view direction plus one across the end of the street
+    std::vector<glm::vec3> buildings;
+    for (int i = 0; i < 10; i++) {
+        float z = -10.0f - i * 12.0f;
+        appendBox(buildings, glm::vec3(-30.0f, -2.0f, z - 10.0f), glm::vec3(-4.0f, 20.0f, z));
+        appendBox(buildings, glm::vec3(4.0f, -2.0f, z - 10.0f), glm::vec3(30.0f, 20.0f, z));
+    }
+    appendBox(buildings, glm::vec3(-40.0f, -2.0f, -140.0f), glm::vec3(40.0f, 30.0f, -130.0f));
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> px(-60.0f, 60.0f), py(-1.0f, 10.0f), pz(-200.0f, -5.0f);
+    std::vector<AABB> boxes(numObjects);
+    CullingBounds soa;
+    soa.reserve(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        glm::vec3 c(px(rng), py(rng), pz(rng));
+        boxes[i].min = c - glm::vec3(0.5f);
+        boxes[i].max = c + glm::vec3(0.5f);
+        BoundingSphere s = { c, 0.9f };
+        soa.push_back(boxes[i], s);
+    }
+
+    glm::mat4 VP = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 300.0f) *
+                   glm::lookAt(glm::vec3(0, 2, 0), glm::vec3(0, 2, -1), glm::vec3(0, 1, 0));
+    Frustum frustum = extractFrustumPlanes(VP);
+
+    OcclusionCuller culler;
+    ThreadPool & pool = defaultThreadPool();
+    std::vector<unsigned int> visible;
+    std::vector<unsigned char> skip;
+    CullStats frustumStats;
+    double raster = 0.0, test = 0.0;
+    for (int f = 0; f < frames; f++) {
+        cullBounds(frustum, soa, visible, &frustumStats);
+        culler.beginFrame(VP);
+        culler.addOccluder(buildings, glm::mat4(1.0f));
+        culler.rasterize(pool);
+        culler.cullVisible(boxes, skip, visible);
+        raster += culler.getStats().rasterMilliseconds;
+        test += culler.getStats().testMilliseconds;
+    }
+    const OcclusionStats & stats = culler.getStats();
+    printf("objects: %zu, in frustum: %u, occluded: %u (%.1f%%), drawn: %zu\n",
+           numObjects, frustumStats.visible, stats.occluded,
+           stats.tested ? 100.0 * stats.occluded / stats.tested : 0.0, visible.size());
+    printf("occluder triangles: %u, buffer %dx%d, threads: %u\n",
+           stats.occluderTriangles, culler.getWidth(), culler.getHeight(), pool.size());
+    printf("raster: %.3f ms/frame, test: %.3f ms/frame (%.1f ns/box)\n",
+           raster / frames, test / frames, stats.tested ? test / frames * 1e6 / stats.tested : 0.0);
+
+    // Anything in the open street in front of the end wall has to survive
+    for (size_t i = 0; i < numObjects; i++) {
+        glm::vec3 c = 0.5f * (boxes[i].min + boxes[i].max);
+        bool inStreet = c.x > -2.0f && c.x < 2.0f && c.z > -120.0f && c.y > 0.0f && c.y < 4.0f;
+        if (inStreet && !culler.testBox(boxes[i])) {
+            printf("FAILED: object %zu in plain view was culled\n", i);
+            failures++;
+            break;
+        }
+    }
+    if (stats.occluded == 0) {
+        printf("FAILED: nothing was occluded\n");
+        failures++;
+    }
+    return failures;
+}
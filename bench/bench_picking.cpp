@@ -0,0 +1,145 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/frustum.hpp>
+#include <common/bvh.hpp>
+#include <common/meshbvh.hpp>
+#include <common/picking.hpp>
+
+#include "bench.hpp"
+
+// Bumpy sphere as a non-indexed triangle list of about numTriangles triangles
+static void makeBumpySphere(size_t numTriangles, std::vector<glm::vec3> & vertices) {
+    int rings = std::max(2, (int)std::sqrt(numTriangles / 2.0));
+    int segments = std::max(3, (int)(numTriangles / (2 * rings)));
+    auto point = [&](int r, int s) {
+        float theta = 3.14159265f * r / rings, phi = 6.2831853f * s / segments;
+        float radius = 1.0f + 0.05f * std::sin(7.0f * theta) * std::cos(5.0f * phi);
+        return radius * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+    };
+    vertices.clear();
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            glm::vec3 a = point(r, s), b = point(r + 1, s), c = point(r + 1, s + 1), d = point(r, s + 1);
+            vertices.push_back(a); vertices.push_back(b); vertices.push_back(c);
+            vertices.push_back(a); vertices.push_back(c); vertices.push_back(d);
+        }
+    }
+}
+
+// Rays from a camera at random points on and around a mesh, first against one mesh, then
+// picking among many instances of it. Both are checked against testing every triangle.
+// Usage: bench picking [numTriangles] [numRays] [numInstances]
+int benchPicking(int argc, char ** argv)
+{
+    size_t numTriangles = argc > 0 ? (size_t)atol(argv[0]) : 200000;
+    int numRays = argc > 1 ? atoi(argv[1]) : 20000;
+    int numInstances = argc > 2 ? atoi(argv[2]) : 100;
+    int failures = 0;
+
+    std::vector<glm::vec3> vertices;
+    makeBumpySphere(numTriangles, vertices);
+    BenchTimer timer;
+    MeshBVH mesh;
+    mesh.build(vertices);
+    double buildMs = timer.milliseconds();
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::vec3> origins(numRays), directions(numRays);
+    for (int r = 0; r < numRays; r++) {
+        origins[r] = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng))) * 4.0f;
+        directions[r] = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.8f - origins[r];
+    }
+
+    // One mesh: every ray through the BVH, a subset brute force for reference
+    std::vector<MeshHit> hits(numRays);
+    std::vector<unsigned char> hit(numRays);
+    timer.reset();
+    for (int r = 0; r < numRays; r++)
+        hit[r] = mesh.intersect(origins[r], directions[r], 10.0f, hits[r]);
+    double bvhMs = timer.milliseconds();
+
+    int checked = std::min(numRays, 200);
+    int mismatches = 0, hitCount = 0;
+    timer.reset();
+    for (int r = 0; r < checked; r++) {
+        MeshHit reference;
+        bool referenceHit = intersectTriangles(vertices, origins[r], directions[r], 10.0f, reference);
+        hitCount += referenceHit;
+        if (referenceHit != (hit[r] != 0) ||
+            (referenceHit && reference.triangle != hits[r].triangle && std::fabs(reference.t - hits[r].t) > 1e-5f * reference.t))
+            mismatches++;
+    }
+    double bruteMs = timer.milliseconds();
+    if (mismatches) {
+        printf("%d of %d mesh rays differ from testing every triangle\n", mismatches, checked);
+        failures++;
+    }
+
+    // Instances on a grid with random rotation and scale, picked through the scene BVH
+    std::vector<const MeshBVH *> meshes(numInstances, &mesh);
+    std::vector<glm::mat4> models(numInstances);
+    std::vector<AABB> boxes(numInstances);
+    int side = std::max(1, (int)std::ceil(std::sqrt((double)numInstances)));
+    for (int i = 0; i < numInstances; i++) {
+        glm::vec3 position(3.0f * (i % side - side / 2), 0.0f, 3.0f * (i / side - side / 2));
+        models[i] = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), position), 3.0f * unit(rng),
+                                           glm::normalize(glm::vec3(unit(rng), 1.0f, unit(rng)))),
+                               glm::vec3(1.0f + 0.2f * unit(rng)));
+        boxes[i] = transformAABB(mesh.getBounds(), models[i]);
+    }
+    SceneBVH scene;
+    scene.build(boxes);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f * side, 2.0f * side), glm::vec3(0.0f), glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+
+    std::uniform_real_distribution<double> cursorX(0.0, 1024.0), cursorY(0.0, 768.0);
+    std::vector<PickResult> picks(numRays);
+    std::vector<glm::vec3> pickOrigins(numRays), pickDirections(numRays);
+    for (int r = 0; r < numRays; r++)
+        cursorRay(cursorX(rng), cursorY(rng), 1024, 768, view, projection, pickOrigins[r], pickDirections[r]);
+    int picked = 0;
+    timer.reset();
+    for (int r = 0; r < numRays; r++)
+        picked += pickRay(scene, meshes, models, pickOrigins[r], pickDirections[r], 1.0f, picks[r]);
+    double pickMs = timer.milliseconds();
+
+    int pickMismatches = 0;
+    int pickChecked = std::min(numRays, 20);
+    for (int r = 0; r < pickChecked; r++) {
+        int object = -1;
+        float best = 1.0f;
+        for (int i = 0; i < numInstances; i++) {
+            glm::mat4 toModel = glm::inverse(models[i]);
+            MeshHit reference;
+            if (intersectTriangles(vertices, glm::vec3(toModel * glm::vec4(pickOrigins[r], 1.0f)),
+                                   glm::vec3(toModel * glm::vec4(pickDirections[r], 0.0f)), best, reference)) {
+                best = reference.t;
+                object = i;
+            }
+        }
+        if (object != picks[r].object && (object < 0 || picks[r].object < 0 || std::fabs(best - picks[r].t) > 1e-5f))
+            pickMismatches++;
+    }
+    if (pickMismatches) {
+        printf("%d of %d picks differ from testing every triangle of every instance\n", pickMismatches, pickChecked);
+        failures++;
+    }
+
+    printf("%u triangles, %u nodes, %.1f KB, built in %.2f ms\n", (unsigned int)mesh.triangleCount(),
+           (unsigned int)mesh.nodeCount(), mesh.memoryBytes() / 1024.0, buildMs);
+    printf("mesh BVH      %8.3f us/ray  (%d rays)\n", bvhMs * 1000.0 / numRays, numRays);
+    printf("every triangle%8.1f us/ray  (%d rays, %d hits)\n", bruteMs * 1000.0 / checked, checked, hitCount);
+    printf("pick %3d instances %6.3f us/pick  (%d of %d hit)\n", numInstances, pickMs * 1000.0 / numRays, picked, numRays);
+    return failures;
+}
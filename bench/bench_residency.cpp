@@ -0,0 +1,127 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <common/residency.hpp>
+
+#include "bench.hpp"
+
+struct PendingLoad {
+    unsigned int item;
+    int readyFrame;
+};
+
+// A city of meshes of 16 KB to 1 MB on a square grid, walked through in a straight line
+// and back. Meshes within viewRadius of the camera are visible; loads take loadFrames
+// frames. Checks that the resident bytes never exceed the budget, that no visible mesh
+// is evicted, and that every visible mesh is resident once the camera stops.
+// Usage: bench residency [gridSide] [budgetMB] [frames]
+int benchResidency(int argc, char ** argv)
+{
+    int side = argc > 0 ? atoi(argv[0]) : 100;
+    size_t budget = (size_t)((argc > 1 ? atof(argv[1]) : 64.0) * 1048576.0);
+    int frames = argc > 2 ? atoi(argv[2]) : 2000;
+    const unsigned int keepFrames = 30, maxLoads = 4;
+    const int loadFrames = 3;
+    const float spacing = 10.0f, viewRadius = 60.0f;
+    int failures = 0;
+
+    std::mt19937 rng(49);
+    std::uniform_real_distribution<double> logSize(std::log(16384.0), std::log(1048576.0));
+    int count = side * side;
+    std::vector<size_t> sizes(count);
+    for (int i = 0; i < count; i++)
+        sizes[i] = (size_t)std::exp(logSize(rng));
+
+    // Loaded in order until the budget is full, like part4 does
+    ResidencyManager residency(budget);
+    size_t loaded = 0;
+    for (int i = 0; i < count; i++) {
+        bool fits = loaded + sizes[i] <= budget;
+        residency.add(sizes[i], fits ? ResidencyManager::Resident : ResidencyManager::Evicted);
+        if (fits)
+            loaded += sizes[i];
+    }
+
+    std::vector<int> lastVisible(count, -1000000);
+    std::vector<unsigned int> visible, loads, evictions;
+    std::deque<PendingLoad> pending;
+    size_t peak = 0;
+    int overBudget = 0, visibleEvicted = 0;
+    BenchTimer timer;
+    double updateMs = 0.0, worstMs = 0.0;
+    float extent = spacing * (side - 1);
+    int walkFrames = frames - 100;
+    for (int frame = 1; frame <= frames; frame++) {
+        // Along the diagonal and back, then standing still for the last 100 frames
+        float t = frame < walkFrames ? (float)frame / walkFrames : 1.0f;
+        float along = extent * (t < 0.5f ? 2.0f * t : 2.0f - 2.0f * t);
+        float cx = along, cz = along * 0.5f;
+        visible.clear();
+        int x0 = std::max(0, (int)std::floor((cx - viewRadius) / spacing)), x1 = std::min(side - 1, (int)std::ceil((cx + viewRadius) / spacing));
+        int z0 = std::max(0, (int)std::floor((cz - viewRadius) / spacing)), z1 = std::min(side - 1, (int)std::ceil((cz + viewRadius) / spacing));
+        for (int x = x0; x <= x1; x++)
+            for (int z = z0; z <= z1; z++) {
+                float dx = x * spacing - cx, dz = z * spacing - cz;
+                if (dx * dx + dz * dz <= viewRadius * viewRadius)
+                    visible.push_back((unsigned int)(x * side + z));
+            }
+
+        timer.reset();
+        for (size_t v = 0; v < visible.size(); v++)
+            residency.touch(visible[v], (unsigned int)frame);
+        while (!pending.empty() && pending.front().readyFrame <= frame) {
+            residency.finishLoad(pending.front().item, true);
+            pending.pop_front();
+        }
+        loads.clear();
+        evictions.clear();
+        residency.update((unsigned int)frame, keepFrames, maxLoads, loads, evictions);
+        double ms = timer.milliseconds();
+        updateMs += ms;
+        worstMs = std::max(worstMs, ms);
+
+        for (size_t l = 0; l < loads.size(); l++) {
+            PendingLoad load = { loads[l], frame + loadFrames };
+            pending.push_back(load);
+        }
+        for (size_t v = 0; v < visible.size(); v++)
+            lastVisible[visible[v]] = frame;
+        for (size_t e = 0; e < evictions.size(); e++)
+            if (lastVisible[evictions[e]] + (int)keepFrames >= frame)
+                visibleEvicted++;
+        size_t resident = residency.getResidentBytes();
+        peak = std::max(peak, resident);
+        if (resident > budget)
+            overBudget++;
+    }
+
+    if (overBudget) {
+        printf("over the budget in %d frames\n", overBudget);
+        failures++;
+    }
+    if (visibleEvicted) {
+        printf("%d meshes evicted while visible\n", visibleEvicted);
+        failures++;
+    }
+    int missing = 0;
+    for (size_t v = 0; v < visible.size(); v++)
+        if (residency.getState(visible[v]) != ResidencyManager::Resident)
+            missing++;
+    if (missing) {
+        printf("%d of %u visible meshes not resident after standing still\n", missing, (unsigned int)visible.size());
+        failures++;
+    }
+
+    ResidencyStats stats = residency.getStats();
+    printf("%d meshes, budget %.1f MB, peak %.1f MB, %u visible at the end\n", count, budget / 1048576.0,
+           peak / 1048576.0, (unsigned int)visible.size());
+    printf("%d frames: %u loads, %u evictions, %u deferred, update %.3f us/frame (worst %.3f us)\n", frames,
+           stats.loads, stats.evictions, stats.deferred, updateMs * 1000.0 / frames, worstMs * 1000.0);
+    return failures;
+}
@@ -0,0 +1,94 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <cmath>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/frustum.hpp>
+#include <common/scenegraph.hpp>
+
+#include "bench.hpp"
+
+static bool sameMatrix(const glm::mat4 & a, const glm::mat4 & b) {
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            if (std::fabs(a[c][r] - b[c][r]) > 1e-4f * (1.0f + std::fabs(b[c][r])))
+                return false;
+    return true;
+}
+
+// Static city: districts of buildings, each with a few meshes below it.
+// Times a full update against moving one leaf and one building with dirty flags, and
+// checks the incremental result against updating every node.
+// Usage: bench scenegraph [numNodes] [moves]
+int benchSceneGraph(int argc, char ** argv)
+{
+    size_t numNodes = argc > 0 ? (size_t)atol(argv[0]) : 1000000;
+    int moves = argc > 1 ? atoi(argv[1]) : 1000;
+    int failures = 0;
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    AABB unit = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+    // Roots of 1000 districts, then buildings, then 4 meshes per building
+    SceneGraph graph;
+    graph.reserve(numNodes);
+    std::vector<unsigned int> buildings, leaves;
+    for (size_t i = 0; i < 1000 && graph.size() < numNodes; i++)
+        graph.addNode(SceneGraph::NoParent, glm::translate(glm::mat4(1.0f), glm::vec3(offset(rng) * 100.0f, 0, offset(rng) * 100.0f)));
+    size_t districts = graph.size();
+    while (graph.size() < numNodes) {
+        unsigned int district = (unsigned int)(rng() % districts);
+        unsigned int building = graph.addNode(district, glm::translate(glm::mat4(1.0f), glm::vec3(offset(rng), 0, offset(rng))), &unit);
+        buildings.push_back(building);
+        for (int m = 0; m < 4 && graph.size() < numNodes; m++)
+            leaves.push_back(graph.addNode(building, glm::translate(glm::mat4(1.0f), glm::vec3(0, m + 1.0f, 0)), &unit));
+    }
+
+    BenchTimer timer;
+    graph.updateAll();
+    double fullMs = timer.milliseconds();
+
+    // One leaf, then one building with its meshes, per update
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    double leafMs = 0.0, buildingMs = 0.0;
+    size_t leafNodes = 0, buildingNodes = 0;
+    for (int m = 0; m < moves; m++) {
+        unsigned int leaf = leaves[rng() % leaves.size()];
+        graph.setLocal(leaf, glm::rotate(graph.getLocal(leaf), angle(rng), glm::vec3(0, 1, 0)));
+        timer.reset();
+        leafNodes += graph.update();
+        leafMs += timer.milliseconds();
+
+        unsigned int building = buildings[rng() % buildings.size()];
+        graph.setLocal(building, glm::translate(graph.getLocal(building), glm::vec3(0.1f, 0, 0)));
+        timer.reset();
+        buildingNodes += graph.update();
+        buildingMs += timer.milliseconds();
+    }
+
+    // The incremental updates must match recomputing everything
+    std::vector<glm::mat4> incremental(graph.size());
+    for (unsigned int i = 0; i < graph.size(); i++)
+        incremental[i] = graph.getWorld(i);
+    graph.updateAll();
+    size_t mismatches = 0;
+    for (unsigned int i = 0; i < graph.size(); i++)
+        mismatches += !sameMatrix(incremental[i], graph.getWorld(i));
+    if (mismatches) {
+        printf("%u world matrices differ from a full update\n", (unsigned int)mismatches);
+        failures++;
+    }
+
+    printf("%u nodes (%u buildings, %u meshes)\n", (unsigned int)graph.size(), (unsigned int)buildings.size(), (unsigned int)leaves.size());
+    printf("full update       %10.3f ms\n", fullMs);
+    printf("move one mesh     %10.3f us  (%.1f nodes)\n", leafMs * 1000.0 / moves, (double)leafNodes / moves);
+    printf("move one building %10.3f us  (%.1f nodes)\n", buildingMs * 1000.0 / moves, (double)buildingNodes / moves);
+    return failures;
+}
@@ -0,0 +1,167 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/threadpool.hpp>
+#include <common/softrasterizer.hpp>
+
+#include "bench.hpp"
+
+// UV sphere as a non-indexed triangle list with texture coordinates and normals
+static void makeSphere(int rings, int segments, std::vector<glm::vec3> & vertices,
+                       std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals) {
+    auto point = [&](int r, int s) {
+        float theta = 3.14159265f * r / rings, phi = 6.2831853f * s / segments;
+        return glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+    };
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            const int corners[6][2] = { { r, s }, { r + 1, s }, { r + 1, s + 1 }, { r, s }, { r + 1, s + 1 }, { r, s + 1 } };
+            for (int k = 0; k < 6; k++) {
+                glm::vec3 p = point(corners[k][0], corners[k][1]);
+                vertices.push_back(p);
+                normals.push_back(p);
+                uvs.push_back(glm::vec2(4.0f * corners[k][1] / segments, 2.0f * corners[k][0] / rings));
+            }
+        }
+    }
+}
+
+// Small distant spheres, each straight behind a larger one and hidden by it, near the
+// corners of the screen where window coordinates are large. The image has to be the
+// one the front spheres give alone; returns the pixels that differ.
+static int hiddenSpheres(const std::vector<glm::vec3> & vertices, int width, int height, ThreadPool & pool) {
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+    std::vector<SoftDraw> front, back;
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 5; x++) {
+            glm::vec3 direction = glm::normalize(glm::vec3(0.72f * (x - 2) / 2.0f, 0.38f * (y - 1.5f) / 1.5f, -1.0f));
+            float distance = 60.0f + 8.0f * ((x + y) % 4);
+            SoftDraw draw = SoftDraw();
+            draw.positions = &vertices;
+            draw.M = glm::scale(glm::translate(glm::mat4(1.0f), direction * distance), glm::vec3(1.5f));
+            draw.ambient = glm::vec3(0.1f, 0.2f, 0.9f);
+            front.push_back(draw);
+            draw.M = glm::translate(glm::mat4(1.0f), direction * (distance + 2.0f));
+            draw.ambient = glm::vec3(1.0f, 0.0f, 0.0f);
+            back.push_back(draw);
+        }
+    }
+    SoftRasterizer rasterizer;
+    rasterizer.resize(width, height);
+    rasterizer.beginFrame(projection, glm::vec3(0.8f));
+    for (size_t i = 0; i < front.size(); i++)
+        rasterizer.addDraw(front[i]);
+    rasterizer.render(pool);
+    std::vector<unsigned char> reference = rasterizer.getColor();
+    // Behind first, so every hidden pixel is drawn and then has to lose the depth test
+    rasterizer.beginFrame(projection, glm::vec3(0.8f));
+    for (size_t i = 0; i < back.size(); i++)
+        rasterizer.addDraw(back[i]);
+    for (size_t i = 0; i < front.size(); i++)
+        rasterizer.addDraw(front[i]);
+    rasterizer.render(pool);
+    const std::vector<unsigned char> & image = rasterizer.getColor();
+    int differ = 0;
+    for (size_t i = 0; i < image.size(); i += 3)
+        differ += image[i] != reference[i] || image[i + 1] != reference[i + 1] || image[i + 2] != reference[i + 2];
+    return differ;
+}
+
+// Frames of a grid of textured and untextured spheres, first on one thread and then on
+// the whole pool. Both images have to be identical, and spheres hidden behind others
+// must not show through.
+// Usage: bench softraster [numInstances] [numFrames] [width] [height]
+int benchSoftRaster(int argc, char ** argv)
+{
+    int numInstances = argc > 0 ? atoi(argv[0]) : 400;
+    int numFrames = argc > 1 ? atoi(argv[1]) : 10;
+    int width = argc > 2 ? atoi(argv[2]) : 1024;
+    int height = argc > 3 ? atoi(argv[3]) : 768;
+    int failures = 0;
+
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<glm::vec2> uvs;
+    makeSphere(24, 48, vertices, uvs, normals);
+
+    // Checkerboard with a gradient, BGR rows padded like a BMP
+    const int textureSize = 256;
+    std::vector<unsigned char> pixels(textureSize * textureSize * 3);
+    for (int y = 0; y < textureSize; y++) {
+        for (int x = 0; x < textureSize; x++) {
+            bool dark = ((x / 32) ^ (y / 32)) & 1;
+            unsigned char * p = &pixels[(y * textureSize + x) * 3];
+            p[0] = (unsigned char)(dark ? 40 : 220);
+            p[1] = (unsigned char)x;
+            p[2] = (unsigned char)(dark ? y : 255 - y);
+        }
+    }
+    SoftTexture texture;
+    texture.create(&pixels[0], textureSize, textureSize);
+
+    // Grid of instances in front of the camera, rows further back overlap the front ones
+    int side = std::max(1, (int)std::ceil(std::sqrt((double)numInstances)));
+    std::vector<SoftDraw> draws(numInstances);
+    for (int i = 0; i < numInstances; i++) {
+        SoftDraw & draw = draws[i];
+        bool textured = i % 2 == 0;
+        draw.positions = &vertices;
+        draw.uvs = textured ? &uvs : NULL;
+        draw.normals = &normals;
+        draw.texture = textured ? &texture : NULL;
+        draw.M = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f * (i % side - side / 2), 0.0f, -1.5f * (i / side)));
+        draw.ambient = glm::vec3(0.1f);
+        draw.diffuse = glm::vec3(0.2f + 0.6f * (i % 3) / 2.0f, 0.5f, 0.8f - 0.6f * (i % 3) / 2.0f);
+    }
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.4f * side, 2.0f), glm::vec3(0.0f, 0.0f, -0.75f * side), glm::vec3(0, 1, 0));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+
+    ThreadPool single(1);
+    ThreadPool & pool = defaultThreadPool();
+    ThreadPool * pools[2] = { &single, &pool };
+    std::vector<unsigned char> images[2];
+    double frameMs[2], geometryMs[2], rasterMs[2];
+    SoftRasterStats stats = SoftRasterStats();
+    for (int p = 0; p < 2; p++) {
+        SoftRasterizer rasterizer;
+        rasterizer.resize(width, height);
+        geometryMs[p] = rasterMs[p] = 0.0;
+        BenchTimer timer;
+        for (int f = 0; f < numFrames; f++) {
+            rasterizer.beginFrame(projection * view, glm::vec3(0.8f));
+            for (int i = 0; i < numInstances; i++)
+                rasterizer.addDraw(draws[i]);
+            rasterizer.render(*pools[p]);
+            geometryMs[p] += rasterizer.getStats().geometryMilliseconds;
+            rasterMs[p] += rasterizer.getStats().rasterMilliseconds;
+        }
+        frameMs[p] = timer.milliseconds() / numFrames;
+        images[p] = rasterizer.getColor();
+        stats = rasterizer.getStats();
+    }
+    if (images[0] != images[1]) {
+        printf("image on %u threads differs from the single threaded one\n", pool.size());
+        failures++;
+    }
+    int showThrough = hiddenSpheres(vertices, width, height, pool);
+    if (showThrough) {
+        printf("%d pixels of hidden spheres show through the ones in front\n", showThrough);
+        failures++;
+    }
+
+    printf("%d instances, %u triangles, %u set up, %u binned, %u pixels shaded, %dx%d\n", numInstances, stats.triangles,
+           stats.rasterized, stats.binned, stats.shaded, width, height);
+    for (int p = 0; p < 2; p++) {
+        printf("%2u thread%s %8.2f ms/frame (geometry %.2f, raster %.2f)  %6.1f M triangles/s\n", pools[p]->size(),
+               pools[p]->size() == 1 ? " " : "s", frameMs[p], geometryMs[p] / numFrames, rasterMs[p] / numFrames,
+               stats.triangles / (frameMs[p] * 1000.0));
+    }
+    return failures;
+}
@@ -0,0 +1,184 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <common/suballocator.hpp>
+
+#include "bench.hpp"
+
+struct LiveRange {
+    unsigned int page;
+    size_t offset, size;
+    unsigned int handle;
+};
+
+// Every live allocation inside its page, aligned, and overlapping no other; the first
+// granule of each holds its handle in the shadow pages, which follow every move
+static int checkAllocations(const BufferSuballocator & pool, const std::vector<unsigned int> & handles,
+                            const std::vector<size_t> & alignments, const std::vector<std::vector<unsigned int> > & shadow)
+{
+    std::vector<LiveRange> ranges;
+    int errors = 0;
+    for (size_t i = 0; i < handles.size(); i++) {
+        if (handles[i] == BufferSuballocator::NoAllocation)
+            continue;
+        LiveRange range = { pool.getPage(handles[i]), pool.getOffset(handles[i]), pool.getSize(handles[i]), handles[i] };
+        if (!pool.isPageLive(range.page) || range.offset + range.size > pool.pageCapacity(range.page) ||
+            range.offset % alignments[i] || shadow[range.page][range.offset / RangeAllocator::Granularity] != handles[i])
+            errors++;
+        ranges.push_back(range);
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const LiveRange & a, const LiveRange & b) {
+        return a.page != b.page ? a.page < b.page : a.offset < b.offset;
+    });
+    for (size_t i = 1; i < ranges.size(); i++)
+        if (ranges[i].page == ranges[i - 1].page && ranges[i - 1].offset + ranges[i - 1].size > ranges[i].offset)
+            errors++;
+    return errors;
+}
+
+static void growShadow(const BufferSuballocator & pool, std::vector<std::vector<unsigned int> > & shadow)
+{
+    shadow.resize(pool.pageSlots());
+    for (size_t p = 0; p < shadow.size(); p++) {
+        size_t granules = pool.isPageLive((unsigned int)p) ? pool.pageCapacity((unsigned int)p) / RangeAllocator::Granularity : 0;
+        if (shadow[p].size() != granules)
+            shadow[p].assign(granules, BufferSuballocator::NoAllocation);
+    }
+}
+
+static void printStats(const char * label, const SuballocatorStats & stats)
+{
+    printf("%-12s %6u allocations %3u pages %8.1f MB, %5.1f%% used, %6u holes, largest %7.1f KB\n", label,
+           stats.allocations, stats.pages, stats.capacity / 1048576.0,
+           stats.capacity ? 100.0 * stats.used / stats.capacity : 0.0, stats.freeBlocks, stats.largestFree / 1024.0);
+}
+
+// Meshes of 256 B to 64 KB, log uniform, some at 256 byte alignment, loaded into one
+// pool, then unloaded and replaced at random for a number of rounds, then compacted a
+// budget of bytes per frame. The result is checked after each phase.
+// Usage: bench suballoc [numMeshes] [rounds] [frameBudgetKB]
+int benchSuballoc(int argc, char ** argv)
+{
+    int numMeshes = argc > 0 ? atoi(argv[0]) : 20000;
+    int rounds = argc > 1 ? atoi(argv[1]) : 20;
+    size_t frameBudget = (argc > 2 ? (size_t)atol(argv[2]) : 1024) * 1024;
+    int failures = 0;
+
+    std::mt19937 rng(48);
+    std::uniform_real_distribution<double> logSize(std::log(256.0), std::log(65536.0));
+    std::uniform_int_distribution<int> pick(0, numMeshes - 1);
+    auto meshSize = [&]() { return (size_t)std::exp(logSize(rng)) & ~(size_t)3; };
+    auto meshAlignment = [&]() { return (rng() & 7) == 0 ? (size_t)256 : (size_t)16; };
+
+    BufferSuballocator pool;
+    std::vector<unsigned int> handles(numMeshes, BufferSuballocator::NoAllocation);
+    std::vector<size_t> alignments(numMeshes);
+    std::vector<std::vector<unsigned int> > shadow;
+    auto load = [&](int i) {
+        alignments[i] = meshAlignment();
+        handles[i] = pool.allocate(meshSize(), alignments[i]);
+        growShadow(pool, shadow);
+        shadow[pool.getPage(handles[i])][pool.getOffset(handles[i]) / RangeAllocator::Granularity] = handles[i];
+    };
+
+    // A mesh larger than the first pages gets a page of its own
+    unsigned int large = pool.allocate(3 << 20, 256);
+    if (large == BufferSuballocator::NoAllocation || pool.getOffset(large) % 256) {
+        printf("a 3 MB allocation failed\n");
+        failures++;
+    } else {
+        pool.free(large);
+    }
+
+    BenchTimer timer;
+    for (int i = 0; i < numMeshes; i++)
+        load(i);
+    double loadMs = timer.milliseconds();
+    SuballocatorStats loaded = pool.getStats();
+    printStats("loaded", loaded);
+
+    // A tenth of the meshes replaced per round, by meshes of other sizes
+    int churn = std::max(1, numMeshes / 10);
+    double churnMs = 0.0;
+    for (int round = 0; round < rounds; round++) {
+        std::vector<int> victims(churn);
+        for (int c = 0; c < churn; c++)
+            victims[c] = pick(rng);
+        timer.reset();
+        for (int c = 0; c < churn; c++) {
+            int i = victims[c];
+            if (handles[i] != BufferSuballocator::NoAllocation) {
+                pool.free(handles[i]);
+                handles[i] = BufferSuballocator::NoAllocation;
+            }
+        }
+        for (int c = 0; c < churn; c++)
+            if (handles[victims[c]] == BufferSuballocator::NoAllocation)
+                load(victims[c]);
+        churnMs += timer.milliseconds();
+    }
+    if (int errors = checkAllocations(pool, handles, alignments, shadow)) {
+        printf("%d allocations overlap or lost their place after churn\n", errors);
+        failures++;
+    }
+    SuballocatorStats churned = pool.getStats();
+    printStats("after churn", churned);
+
+    // Half the meshes unloaded, like leaving a region, then compaction frame by frame
+    for (int i = 0; i < numMeshes; i += 2) {
+        pool.free(handles[i]);
+        handles[i] = BufferSuballocator::NoAllocation;
+    }
+    printStats("half unloaded", pool.getStats());
+    std::vector<BufferMove> moves;
+    int frames = 0;
+    double defragMs = 0.0, worstFrameMs = 0.0;
+    while (!pool.isCompacted()) {
+        moves.clear();
+        timer.reset();
+        pool.defragment(frameBudget, moves);
+        double ms = timer.milliseconds();
+        defragMs += ms;
+        worstFrameMs = std::max(worstFrameMs, ms);
+        frames++;
+        for (size_t m = 0; m < moves.size(); m++)
+            shadow[moves[m].toPage][moves[m].toOffset / RangeAllocator::Granularity] =
+                shadow[moves[m].fromPage][moves[m].fromOffset / RangeAllocator::Granularity];
+        growShadow(pool, shadow);
+    }
+    if (int errors = checkAllocations(pool, handles, alignments, shadow)) {
+        printf("%d allocations overlap or lost their data in compaction\n", errors);
+        failures++;
+    }
+    SuballocatorStats compacted = pool.getStats();
+    printStats("compacted", compacted);
+    if (compacted.pages >= churned.pages && churned.pages > 1) {
+        printf("compaction released no page\n");
+        failures++;
+    }
+
+    // Everything unloaded: one empty page is left
+    for (int i = 0; i < numMeshes; i++)
+        if (handles[i] != BufferSuballocator::NoAllocation)
+            pool.free(handles[i]);
+    moves.clear();
+    while (!pool.isCompacted())
+        pool.defragment(frameBudget, moves);
+    SuballocatorStats empty = pool.getStats();
+    if (empty.pages != 1 || empty.allocations || empty.freeBlocks != 1) {
+        printf("%u pages, %u allocations, %u holes left after unloading everything\n", empty.pages, empty.allocations, empty.freeBlocks);
+        failures++;
+    }
+
+    printf("%d meshes in %u buffers instead of %d, load %.3f us/mesh, churn %.3f us/mesh\n", numMeshes, loaded.pages,
+           numMeshes, loadMs * 1000.0 / numMeshes, churnMs * 1000.0 / (2.0 * churn * std::max(rounds, 1)));
+    printf("compaction: %.1f MB moved in %d frames of %u KB, %.3f ms/frame (worst %.3f ms)\n",
+           compacted.movedBytes / 1048576.0, frames, (unsigned int)(frameBudget / 1024),
+           frames ? defragMs / frames : 0.0, worstFrameMs);
+    return failures;
+}
@@ -0,0 +1,113 @@
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <random>
+#include <cmath>
+
+// Include GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#if defined(__SSE2__)
+#include <glm/gtx/simd_mat4.hpp>
+#endif
+
+#include <common/transformbatch.hpp>
+
+#include "bench.hpp"
+
+static bool sameMatrix(const glm::mat4 & a, const glm::mat4 & b) {
+    for (int c = 0; c < 4; c++)
+        for (int r = 0; r < 4; r++)
+            if (std::fabs(a[c][r] - b[c][r]) > 1e-5f * (1.0f + std::fabs(b[c][r])))
+                return false;
+    return true;
+}
+
+// Random TRS objects, composed to model matrices and multiplied by a view projection.
+// Times the per-object glm::mat4 path against the SoA batch kernels, and checks that
+// both give the same matrices.
+// Usage: bench transforms [numObjects] [frames]
+int benchTransforms(int argc, char ** argv)
+{
+    size_t numObjects = argc > 0 ? (size_t)atol(argv[0]) : 100000;
+    int frames = argc > 1 ? atoi(argv[1]) : 20;
+    int failures = 0;
+
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> pos(-100.0f, 100.0f), unit(-1.0f, 1.0f), size(0.5f, 2.0f);
+    TransformSoA transforms;
+    transforms.reserve(numObjects);
+    for (size_t i = 0; i < numObjects; i++) {
+        glm::quat r = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        transforms.push_back(glm::vec3(pos(rng), pos(rng), pos(rng)), r, glm::vec3(size(rng), size(rng), size(rng)));
+    }
+    glm::mat4 VP = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                   glm::lookAt(glm::vec3(0, 5, 20), glm::vec3(0), glm::vec3(0, 1, 0));
+
+    std::vector<glm::mat4> scalarM(numObjects), scalarMVP(numObjects), batchM(numObjects), batchMVP(numObjects);
+    double scalarComposeMs = 0.0, batchComposeMs = 0.0, scalarMultiplyMs = 0.0, batchMultiplyMs = 0.0, simdMultiplyMs = 0.0;
+    BenchTimer timer;
+    for (int f = 0; f < frames; f++) {
+        // What the renderer did per object: glm::translate * mat4_cast * glm::scale, then VP * M
+        timer.reset();
+        for (size_t i = 0; i < numObjects; i++) {
+            glm::mat4 T = glm::translate(glm::mat4(1.0f), transforms.translation(i));
+            glm::mat4 S = glm::scale(glm::mat4(1.0f), transforms.scale(i));
+            scalarM[i] = T * glm::mat4_cast(transforms.rotation(i)) * S;
+        }
+        scalarComposeMs += timer.milliseconds();
+        timer.reset();
+        for (size_t i = 0; i < numObjects; i++)
+            scalarMVP[i] = VP * scalarM[i];
+        scalarMultiplyMs += timer.milliseconds();
+
+        timer.reset();
+        composeTransforms(transforms, 0, numObjects, &batchM[0]);
+        batchComposeMs += timer.milliseconds();
+        timer.reset();
+        multiplyMatrices(VP, &batchM[0], &batchMVP[0], numObjects);
+        batchMultiplyMs += timer.milliseconds();
+
+#if defined(__SSE2__)
+        // glm's own SIMD matrix type, converting in and out as a caller holding glm::mat4 would
+        timer.reset();
+        glm::simdMat4 simdVP(VP);
+        for (size_t i = 0; i < numObjects; i++)
+            batchMVP[i] = glm::mat4_cast(simdVP * glm::simdMat4(batchM[i]));
+        simdMultiplyMs += timer.milliseconds();
+        multiplyMatrices(VP, &batchM[0], &batchMVP[0], numObjects);
+#endif
+    }
+
+    size_t composeMismatches = 0, multiplyMismatches = 0;
+    std::vector<glm::mat4> reference(numObjects);
+    composeTransformsScalar(transforms, 0, numObjects, &reference[0]);
+    for (size_t i = 0; i < numObjects; i++) {
+        composeMismatches += memcmp(&reference[i], &batchM[i], sizeof(glm::mat4)) != 0 || !sameMatrix(batchM[i], scalarM[i]);
+    }
+    multiplyMatricesScalar(VP, &batchM[0], &reference[0], numObjects);
+    for (size_t i = 0; i < numObjects; i++)
+        multiplyMismatches += memcmp(&reference[i], &batchMVP[i], sizeof(glm::mat4)) != 0;
+    if (composeMismatches) {
+        printf("%u composed matrices differ from the scalar path\n", (unsigned int)composeMismatches);
+        failures++;
+    }
+    if (multiplyMismatches) {
+        printf("%u VP * M products differ from glm\n", (unsigned int)multiplyMismatches);
+        failures++;
+    }
+
+    double objects = (double)numObjects * frames;
+    printf("%u objects, %d frames\n", (unsigned int)numObjects, frames);
+    printf("compose glm::mat4   %8.3f ms/frame  %7.1f M/s\n", scalarComposeMs / frames, objects / scalarComposeMs / 1000.0);
+    printf("compose SoA batch   %8.3f ms/frame  %7.1f M/s  (%.1fx)\n", batchComposeMs / frames, objects / batchComposeMs / 1000.0, scalarComposeMs / batchComposeMs);
+    printf("VP * M glm::mat4    %8.3f ms/frame  %7.1f M/s\n", scalarMultiplyMs / frames, objects / scalarMultiplyMs / 1000.0);
+#if defined(__SSE2__)
+    printf("VP * M glm simdMat4 %8.3f ms/frame  %7.1f M/s  (%.1fx)\n", simdMultiplyMs / frames, objects / simdMultiplyMs / 1000.0, scalarMultiplyMs / simdMultiplyMs);
+#endif
+    printf("VP * M batch        %8.3f ms/frame  %7.1f M/s  (%.1fx)\n", batchMultiplyMs / frames, objects / batchMultiplyMs / 1000.0, scalarMultiplyMs / batchMultiplyMs);
+    return failures;
+}
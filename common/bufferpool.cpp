@@ -0,0 +1,76 @@
+// Include standard headers
+#include <stddef.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "bufferpool.hpp"
+
+GpuBufferPool::GpuBufferPool(size_t minPageBytes, size_t maxPageBytes) : ranges(minPageBytes, maxPageBytes) {
+}
+
+GpuBufferPool::~GpuBufferPool() {
+    // GL objects belong to the context, destroy() must run while it is still current
+}
+
+void GpuBufferPool::syncBuffers() {
+    buffers.resize(ranges.pageSlots(), 0);
+    for (unsigned int page = 0; page < buffers.size(); page++) {
+        if (ranges.isPageLive(page) && !buffers[page]) {
+            glGenBuffers(1, &buffers[page]);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[page]);
+            glBufferData(GL_COPY_WRITE_BUFFER, ranges.pageCapacity(page), NULL, GL_STATIC_DRAW);
+        } else if (!ranges.isPageLive(page) && buffers[page]) {
+            glDeleteBuffers(1, &buffers[page]);
+            buffers[page] = 0;
+        }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+unsigned int GpuBufferPool::allocate(size_t size, size_t alignment, const void * data) {
+    size_t pages = ranges.pageSlots();
+    unsigned int handle = ranges.allocate(size, alignment);
+    if (handle == BufferSuballocator::NoAllocation)
+        return handle;
+    if (ranges.pageSlots() != pages || !buffers[ranges.getPage(handle)])
+        syncBuffers();
+    if (data)
+        upload(handle, 0, size, data);
+    return handle;
+}
+
+void GpuBufferPool::upload(unsigned int handle, size_t offset, size_t size, const void * data) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, getBuffer(handle));
+    glBufferSubData(GL_COPY_WRITE_BUFFER, getOffset(handle) + offset, size, data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GpuBufferPool::free(unsigned int handle) {
+    ranges.free(handle);
+}
+
+size_t GpuBufferPool::defragment(size_t maxBytes, std::vector<unsigned int> & moved) {
+    moves.clear();
+    size_t bytes = ranges.defragment(maxBytes, moves);
+    // Draws issued before read the old ranges, GL orders the copies after them. Pages the
+    // moves emptied are deleted only now that their copies are issued.
+    for (size_t i = 0; i < moves.size(); i++) {
+        const BufferMove & move = moves[i];
+        glBindBuffer(GL_COPY_READ_BUFFER, buffers[move.fromPage]);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[move.toPage]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, move.fromOffset, move.toOffset, move.size);
+        moved.push_back(move.handle);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    syncBuffers();
+    return bytes;
+}
+
+void GpuBufferPool::destroy() {
+    for (size_t page = 0; page < buffers.size(); page++)
+        if (buffers[page])
+            glDeleteBuffers(1, &buffers[page]);
+    buffers.clear();
+}
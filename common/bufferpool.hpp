@@ -0,0 +1,48 @@
+#ifndef BUFFERPOOL_HPP
+#define BUFFERPOOL_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#include "suballocator.hpp"
+
+// Vertex or index data of many meshes in a few large GL buffers, one per page of a
+// BufferSuballocator, instead of buffers of their own. Meshes are uploaded into their
+// range with glBufferSubData and drawn at its offset; defragment() compacts the pages
+// with glCopyBufferSubData a budget at a time and deletes the buffers it empties.
+// Buffers are bound to GL_COPY_WRITE_BUFFER and GL_COPY_READ_BUFFER only, so vertex
+// array and element bindings are left alone.
+class GpuBufferPool {
+public:
+    GpuBufferPool(size_t minPageBytes = 1 << 20, size_t maxPageBytes = 64 << 20);
+    ~GpuBufferPool();
+
+    // size bytes at alignment, filled from data unless it is NULL
+    unsigned int allocate(size_t size, size_t alignment, const void * data);
+    void upload(unsigned int handle, size_t offset, size_t size, const void * data);
+    void free(unsigned int handle);
+
+    GLuint getBuffer(unsigned int handle) const { return buffers[ranges.getPage(handle)]; }
+    size_t getOffset(unsigned int handle) const { return ranges.getOffset(handle); }
+    size_t getSize(unsigned int handle) const { return ranges.getSize(handle); }
+
+    // Copies up to maxBytes of allocations to their new place; moved gets the handles
+    // whose buffer or offset changed, their vertex arrays must be pointed there
+    size_t defragment(size_t maxBytes, std::vector<unsigned int> & moved);
+    bool isCompacted() const { return ranges.isCompacted(); }
+
+    SuballocatorStats getStats() const { return ranges.getStats(); }
+    // Deletes every buffer, the handles are invalid after; must run while the context
+    // is current
+    void destroy();
+
+private:
+    // Creates the buffers of new pages and deletes those of released ones
+    void syncBuffers();
+
+    BufferSuballocator ranges;
+    std::vector<GLuint> buffers;   // by page, 0 for released pages
+    std::vector<BufferMove> moves;
+};
+
+#endif
@@ -0,0 +1,429 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+#include "bundle.hpp"
+#include "lz4block.hpp"
+
+// Defined in texture.cpp; texture.hpp itself needs the GL headers
+bool loadBMP_pixels(const char * imagepath, std::vector<unsigned char> & data, unsigned int & width, unsigned int & height);
+
+static const char BundleMagic[8] = { 'P', '4', 'B', 'U', 'N', 'D', 'L', 'E' };
+static const uint32_t BundleVersion = 2;
+// An LZ4 block expands at most about 255 times, a chunk claiming more is corrupt
+static const uint64_t MaxLZ4Ratio = 256;
+
+// Mesh chunk layout, the same part4's vertexLayout gives a mesh with a texture
+static size_t align16(size_t bytes) {
+    return (bytes + 15) & ~(size_t)15;
+}
+
+SceneBundle::SceneBundle() : data(NULL), size(0), header(NULL), toc(NULL), names(NULL) {
+}
+
+SceneBundle::~SceneBundle() {
+    close();
+}
+
+bool SceneBundle::open(const char * path) {
+    close();
+#ifdef _WIN32
+    FILE * file = fopen(path, "rb");
+    if (!file) {
+        printf("%s could not be opened\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    contents.resize(length > 0 ? (size_t)length : 0);
+    bool read = length > 0 && fread(&contents[0], 1, contents.size(), file) == contents.size();
+    fclose(file);
+    if (!read) {
+        printf("%s could not be read\n", path);
+        contents.clear();
+        return false;
+    }
+    data = &contents[0];
+    size = contents.size();
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("%s could not be opened\n", path);
+        return false;
+    }
+    struct stat status;
+    void * mapping = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+        mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file open
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("%s could not be mapped\n", path);
+        return false;
+    }
+    data = (const unsigned char *)mapping;
+    size = (size_t)status.st_size;
+#endif
+
+    // Everything the accessors rely on is checked here once
+    const BundleHeader * h = (const BundleHeader *)data;
+    bool valid = size >= sizeof(BundleHeader) && memcmp(h->magic, BundleMagic, sizeof(BundleMagic)) == 0 &&
+                 h->version == BundleVersion && h->namesOffset <= size && h->namesSize <= size - h->namesOffset &&
+                 h->tocOffset <= size && h->tocOffset % 8 == 0 &&
+                 h->chunkCount <= (size - h->tocOffset) / sizeof(BundleChunk);
+    for (uint32_t i = 0; valid && i < h->chunkCount; i++) {
+        const BundleChunk & chunk = ((const BundleChunk *)(data + h->tocOffset))[i];
+        valid = chunk.offset <= size && chunk.storedSize <= size - chunk.offset &&
+                chunk.nameOffset <= h->namesSize && chunk.nameSize <= h->namesSize - chunk.nameOffset &&
+                (chunk.flags & BundleLZ4 ? chunk.size <= chunk.storedSize * MaxLZ4Ratio : chunk.storedSize == chunk.size);
+    }
+    if (!valid) {
+        printf("%s is not a scene bundle of version %u\n", path, BundleVersion);
+        close();
+        return false;
+    }
+    header = h;
+    toc = (const BundleChunk *)(data + h->tocOffset);
+    names = (const char *)(data + h->namesOffset);
+    return true;
+}
+
+void SceneBundle::close() {
+#ifndef _WIN32
+    if (data)
+        munmap((void *)data, size);
+#endif
+    contents.clear();
+    data = NULL;
+    size = 0;
+    header = NULL;
+    toc = NULL;
+    names = NULL;
+}
+
+std::string SceneBundle::getName(unsigned int chunk) const {
+    return std::string(names + toc[chunk].nameOffset, toc[chunk].nameSize);
+}
+
+const unsigned char * SceneBundle::readChunk(unsigned int chunk, std::vector<unsigned char> & scratch) const {
+    const BundleChunk & entry = toc[chunk];
+    if (!(entry.flags & BundleLZ4))
+        return data + entry.offset;
+    scratch.resize((size_t)entry.size + 1);
+    if (!lz4Decompress(data + entry.offset, (size_t)entry.storedSize, &scratch[0], (size_t)entry.size)) {
+        printf("chunk %s of the bundle is corrupt\n", getName(chunk).c_str());
+        return NULL;
+    }
+    return &scratch[0];
+}
+
+bool SceneBundle::readScene(std::vector<Model> & models, std::vector<int> & meshes, std::vector<int> & textures) const {
+    models.clear();
+    meshes.clear();
+    textures.clear();
+    unsigned int scene = 0;
+    while (scene < chunkCount() && toc[scene].type != BundleScene)
+        scene++;
+    std::vector<unsigned char> scratch;
+    const unsigned char * bytes = scene < chunkCount() ? readChunk(scene, scratch) : NULL;
+    if (!bytes || toc[scene].size % sizeof(BundleModel))
+        return false;
+    size_t count = (size_t)toc[scene].size / sizeof(BundleModel);
+    for (size_t i = 0; i < count; i++) {
+        BundleModel entry;
+        memcpy(&entry, bytes + i * sizeof(BundleModel), sizeof(entry));
+        if (entry.mesh < 0 || (uint32_t)entry.mesh >= chunkCount() || toc[entry.mesh].type != BundleMesh ||
+            (entry.texture >= 0 && ((uint32_t)entry.texture >= chunkCount() || toc[entry.texture].type != BundleTexture)))
+            return false;
+        Model model;
+        model.objFilename = getName(entry.mesh);
+        model.textureFilename = entry.texture >= 0 ? getName(entry.texture) : std::string();
+        float * transform[10] = { &model.sx, &model.sy, &model.sz, &model.rx, &model.ry, &model.rz, &model.ra,
+                                  &model.tx, &model.ty, &model.tz };
+        float * material[10] = { &model.ar, &model.ag, &model.ab, &model.dr, &model.dg, &model.db,
+                                 &model.sr, &model.sg, &model.sb, &model.ss };
+        for (int f = 0; f < 10; f++) {
+            *transform[f] = entry.transform[f];
+            *material[f] = entry.material[f];
+        }
+        models.push_back(model);
+        meshes.push_back(entry.mesh);
+        textures.push_back(entry.texture);
+    }
+    return true;
+}
+
+// Whether the layout a mesh chunk claims fits in its bytes
+static bool validMeshLayout(const BundleChunk & entry) {
+    size_t count = entry.info[0], normalOffset = entry.info[1], uvOffset = entry.info[2];
+    size_t positionBytes = count * sizeof(glm::vec3);
+    return entry.type == BundleMesh && positionBytes <= entry.size &&
+           (!normalOffset || (normalOffset >= positionBytes && normalOffset + positionBytes <= entry.size)) &&
+           (!uvOffset || (uvOffset >= positionBytes && uvOffset + count * sizeof(glm::vec2) <= entry.size));
+}
+
+bool SceneBundle::readMeshBounds(int chunk, MeshBounds & bounds) const {
+    const BundleChunk & entry = toc[chunk];
+    if (!validMeshLayout(entry))
+        return false;
+    bounds.vertices = entry.info[0];
+    bounds.normals = entry.info[1] != 0;
+    bounds.uvs = entry.info[2] != 0;
+    bounds.min = glm::vec3(entry.bounds[0], entry.bounds[1], entry.bounds[2]);
+    bounds.max = glm::vec3(entry.bounds[3], entry.bounds[4], entry.bounds[5]);
+    bounds.radius = entry.bounds[6];
+    return true;
+}
+
+const unsigned char * SceneBundle::readMesh(int chunk, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs,
+                                            std::vector<glm::vec3> & normals, std::vector<unsigned char> & scratch) const {
+    const BundleChunk & entry = toc[chunk];
+    size_t count = entry.info[0], normalOffset = entry.info[1], uvOffset = entry.info[2];
+    size_t positionBytes = count * sizeof(glm::vec3);
+    if (!validMeshLayout(entry))
+        return NULL;
+    const unsigned char * bytes = readChunk(chunk, scratch);
+    if (!bytes)
+        return NULL;
+    vertices.resize(count);
+    normals.resize(normalOffset ? count : 0);
+    uvs.resize(uvOffset ? count : 0);
+    if (count)
+        memcpy(&vertices[0], bytes, positionBytes);
+    if (count && normalOffset)
+        memcpy(&normals[0], bytes + normalOffset, positionBytes);
+    if (count && uvOffset)
+        memcpy(&uvs[0], bytes + uvOffset, count * sizeof(glm::vec2));
+    return bytes;
+}
+
+const unsigned char * SceneBundle::readTexture(int chunk, unsigned int & width, unsigned int & height,
+                                               std::vector<unsigned char> & scratch) const {
+    const BundleChunk & entry = toc[chunk];
+    width = entry.info[0];
+    height = entry.info[1];
+    // Rows of 3 byte pixels padded to 4 bytes, like the .bmp had them; computed in 64 bits
+    // and divided rather than multiplied, so no width or height of the TOC can wrap it
+    uint64_t rowBytes = ((uint64_t)width * 3 + 3) & ~(uint64_t)3;
+    if (entry.type != BundleTexture || !width || !height || rowBytes > entry.size / height)
+        return NULL;
+    return readChunk(chunk, scratch);
+}
+
+BundleWriter::BundleWriter() : file(NULL), pageSize(4096), position(0), rawBytes(0), storedBytes(0) {
+}
+
+BundleWriter::~BundleWriter() {
+    if (file)
+        fclose(file);
+}
+
+bool BundleWriter::open(const char * path, uint32_t pageBytes) {
+    file = fopen(path, "wb");
+    if (!file) {
+        printf("%s could not be created\n", path);
+        return false;
+    }
+    pageSize = pageBytes;
+    position = 0;
+    rawBytes = storedBytes = 0;
+    chunks.clear();
+    names.clear();
+    // The header goes in last, over this
+    BundleHeader header = BundleHeader();
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        return false;
+    position = sizeof(header);
+    return true;
+}
+
+// Zeros up to the next page boundary
+bool BundleWriter::pad() {
+    static const char zeros[4096] = { 0 };
+    while (position % pageSize) {
+        size_t bytes = (size_t)(pageSize - position % pageSize);
+        bytes = bytes < sizeof(zeros) ? bytes : sizeof(zeros);
+        if (fwrite(zeros, 1, bytes, file) != bytes)
+            return false;
+        position += bytes;
+    }
+    return true;
+}
+
+int BundleWriter::addChunk(BundleChunkType type, const std::string & name, const void * bytes, size_t size,
+                           const uint32_t info[4], bool compress, const MeshBounds * bounds) {
+    BundleChunk chunk = BundleChunk();
+    chunk.type = type;
+    chunk.size = size;
+    chunk.storedSize = size;
+    chunk.nameOffset = (uint32_t)names.size();
+    chunk.nameSize = (uint32_t)name.size();
+    for (int i = 0; i < 4; i++)
+        chunk.info[i] = info ? info[i] : 0;
+    if (bounds) {
+        const float values[8] = { bounds->min.x, bounds->min.y, bounds->min.z,
+                                  bounds->max.x, bounds->max.y, bounds->max.z, bounds->radius, 0.0f };
+        memcpy(chunk.bounds, values, sizeof(values));
+    }
+    names += name;
+
+    const void * stored = bytes;
+    if (compress && size) {
+        compressed.resize(lz4CompressBound(size));
+        size_t compressedSize = lz4Compress((const unsigned char *)bytes, size, &compressed[0]);
+        if (compressedSize < size) {
+            chunk.flags |= BundleLZ4;
+            chunk.storedSize = compressedSize;
+            stored = &compressed[0];
+        }
+    }
+    if (!pad())
+        return -1;
+    chunk.offset = position;
+    if (chunk.storedSize && fwrite(stored, 1, (size_t)chunk.storedSize, file) != chunk.storedSize)
+        return -1;
+    position += chunk.storedSize;
+    rawBytes += chunk.size;
+    storedBytes += chunk.storedSize;
+    chunks.push_back(chunk);
+    return (int)chunks.size() - 1;
+}
+
+bool BundleWriter::finish() {
+    BundleHeader header = BundleHeader();
+    memcpy(header.magic, BundleMagic, sizeof(BundleMagic));
+    header.version = BundleVersion;
+    header.pageSize = pageSize;
+    header.chunkCount = (uint32_t)chunks.size();
+    header.namesSize = (uint32_t)names.size();
+    header.namesOffset = position;
+    bool written = fwrite(names.data(), 1, names.size(), file) == names.size();
+    position += names.size();
+    static const char zeros[8] = { 0 };
+    size_t padding = (size_t)((8 - position % 8) % 8);
+    written = written && fwrite(zeros, 1, padding, file) == padding;
+    position += padding;
+    header.tocOffset = position;
+    written = written && (chunks.empty() || fwrite(&chunks[0], sizeof(BundleChunk), chunks.size(), file) == chunks.size());
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+    file = NULL;
+    return written;
+}
+
+bool packScene(const char * modelsPath, const std::string & directory, const char * bundlePath, bool compress) {
+    std::vector<Model> models;
+    if (!loadModels(modelsPath, models))
+        return false;
+    std::string prefix = directory.empty() ? std::string() : directory + "/";
+
+    BundleWriter writer;
+    if (!writer.open(bundlePath))
+        return false;
+    std::map<std::string, int> meshChunks, textureChunks;
+    std::vector<int> texturedMeshes;
+    std::vector<BundleModel> entries(models.size());
+    for (size_t i = 0; i < models.size(); i++) {
+        const Model & model = models[i];
+        BundleModel & entry = entries[i];
+        const float transform[10] = { model.sx, model.sy, model.sz, model.rx, model.ry, model.rz, model.ra,
+                                      model.tx, model.ty, model.tz };
+        const float material[10] = { model.ar, model.ag, model.ab, model.dr, model.dg, model.db,
+                                     model.sr, model.sg, model.sb, model.ss };
+        memcpy(entry.transform, transform, sizeof(transform));
+        memcpy(entry.material, material, sizeof(material));
+        entry.texture = -1;
+
+        std::map<std::string, int>::iterator mesh = meshChunks.find(model.objFilename);
+        if (mesh == meshChunks.end()) {
+            std::vector<glm::vec3> vertices, normals;
+            std::vector<glm::vec2> uvs;
+            if (!loadOBJ((prefix + model.objFilename).c_str(), vertices, uvs, normals))
+                return false;
+            size_t count = vertices.size();
+            uint32_t info[4] = { (uint32_t)count, 0, 0, 0 };
+            std::vector<unsigned char> layout(align16(count * sizeof(glm::vec3)));
+            if (count && normals.size() == count) {
+                info[1] = (uint32_t)layout.size();
+                layout.resize(layout.size() + align16(count * sizeof(glm::vec3)));
+                memcpy(&layout[info[1]], &normals[0], count * sizeof(glm::vec3));
+            }
+            if (count && uvs.size() == count) {
+                info[2] = (uint32_t)layout.size();
+                layout.resize(layout.size() + count * sizeof(glm::vec2));
+                memcpy(&layout[info[2]], &uvs[0], count * sizeof(glm::vec2));
+            }
+            if (count)
+                memcpy(&layout[0], &vertices[0], count * sizeof(glm::vec3));
+            AABB box;
+            BoundingSphere sphere;
+            computeBounds(vertices, box, sphere);
+            MeshBounds bounds = MeshBounds();
+            bounds.min = box.min;
+            bounds.max = box.max;
+            bounds.radius = sphere.radius;
+            int chunk = writer.addChunk(BundleMesh, model.objFilename, layout.empty() ? NULL : &layout[0], layout.size(),
+                                        info, compress, &bounds);
+            if (chunk < 0)
+                return false;
+            mesh = meshChunks.insert(std::make_pair(model.objFilename, chunk)).first;
+            if (info[2])
+                texturedMeshes.push_back(chunk);
+        }
+        entry.mesh = mesh->second;
+
+        // part4 only textures meshes with uvs; a texture that does not load is left out
+        if (std::find(texturedMeshes.begin(), texturedMeshes.end(), entry.mesh) == texturedMeshes.end())
+            continue;
+        std::map<std::string, int>::iterator texture = textureChunks.find(model.textureFilename);
+        if (texture == textureChunks.end()) {
+            std::string path = prefix + model.textureFilename;
+            // loadBMP_pixels waits for a key when the file is missing
+            FILE * file = fopen(path.c_str(), "rb");
+            std::vector<unsigned char> pixels;
+            uint32_t info[4] = { 0, 0, 0, 0 };
+            int chunk = -1;
+            if (file) {
+                fclose(file);
+                if (loadBMP_pixels(path.c_str(), pixels, info[0], info[1]) && !pixels.empty()) {
+                    chunk = writer.addChunk(BundleTexture, model.textureFilename, &pixels[0], pixels.size(), info, compress);
+                    if (chunk < 0)
+                        return false;
+                }
+            }
+            if (chunk < 0)
+                printf("%s left out of the bundle\n", path.c_str());
+            texture = textureChunks.insert(std::make_pair(model.textureFilename, chunk)).first;
+        }
+        entry.texture = texture->second;
+    }
+
+    if (writer.addChunk(BundleScene, modelsPath, entries.empty() ? NULL : &entries[0],
+                        entries.size() * sizeof(BundleModel), NULL, compress) < 0 || !writer.finish()) {
+        printf("%s could not be written\n", bundlePath);
+        return false;
+    }
+    printf("%s: %u models, %u meshes, %u textures, %.1f MB packed into %.1f MB\n", bundlePath,
+           (unsigned int)models.size(), (unsigned int)meshChunks.size(), (unsigned int)textureChunks.size(),
+           writer.getRawBytes() / 1048576.0, writer.getStoredBytes() / 1048576.0);
+    return true;
+}
@@ -0,0 +1,138 @@
+#ifndef BUNDLE_HPP
+#define BUNDLE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+
+// A scene packed into one file by packbundle, read by part4 --bundle with one mmap:
+//   BundleHeader | chunks, each at a page boundary | chunk names | BundleChunk[chunkCount]
+// The scene chunk holds the models of the .models file. A mesh chunk holds the unrolled
+// vertex data in the layout part4 uploads to the vertex pool: positions, normals and uvs,
+// the first two padded to 16 bytes. A texture chunk holds the BGR rows loadBMP_pixels
+// returns. Uncompressed chunks are uploaded straight from the mapping, compressed ones
+// are LZ4 blocks. Numbers are in the byte order of the machine that packed the file.
+
+enum BundleChunkType {
+    BundleScene = 1,
+    BundleMesh = 2,
+    BundleTexture = 3
+};
+
+// BundleChunk::flags
+const uint32_t BundleLZ4 = 1;
+
+struct BundleHeader {
+    char magic[8];          // "P4BUNDLE"
+    uint32_t version;
+    uint32_t pageSize;
+    uint32_t chunkCount;
+    uint32_t namesSize;
+    uint64_t namesOffset;
+    uint64_t tocOffset;
+};
+
+struct BundleChunk {
+    uint32_t type;
+    uint32_t flags;
+    uint64_t offset;        // in the file
+    uint64_t storedSize;    // in the file
+    uint64_t size;          // decompressed
+    uint32_t nameOffset, nameSize;  // the file it came from, in the names
+    uint32_t info[4];       // mesh: vertices, normal offset, uv offset (0 without);
+                            // texture: width, height
+    float bounds[8];        // mesh: box min and max, radius of the sphere around its
+                            // center, so a mesh left unloaded needs only the table
+};
+
+// Element of the scene chunk
+struct BundleModel {
+    float transform[10];    // sx sy sz rx ry rz ra tx ty tz, as in .models files
+    float material[10];     // ar ag ab dr dg db sr sg sb ss
+    int32_t mesh, texture;  // chunk indices, -1 for none
+};
+
+// Read only view of a bundle; safe to read from several threads once open
+class SceneBundle {
+public:
+    SceneBundle();
+    ~SceneBundle();
+
+    // Maps the file and checks the table of contents
+    bool open(const char * path);
+    void close();
+    bool isOpen() const { return data != NULL; }
+
+    unsigned int chunkCount() const { return header ? header->chunkCount : 0; }
+    const BundleChunk & getChunk(unsigned int chunk) const { return toc[chunk]; }
+    std::string getName(unsigned int chunk) const;
+    size_t getFileSize() const { return size; }
+
+    // The bytes of a chunk: in the mapping when stored uncompressed, otherwise
+    // decompressed into scratch. NULL if it does not decompress.
+    const unsigned char * readChunk(unsigned int chunk, std::vector<unsigned char> & scratch) const;
+
+    // The models of the scene chunk, named after the files they were packed from, and
+    // the mesh and texture chunk of each, -1 for none
+    bool readScene(std::vector<Model> & models, std::vector<int> & meshes, std::vector<int> & textures) const;
+    // A mesh as loadOBJ returns it; returns its vertex data for a direct upload, NULL on failure
+    const unsigned char * readMesh(int chunk, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs,
+                                   std::vector<glm::vec3> & normals, std::vector<unsigned char> & scratch) const;
+    // What readMesh would return about a mesh, from the table of contents alone
+    bool readMeshBounds(int chunk, MeshBounds & bounds) const;
+    // Pixels as loadBMP_pixels returns them, NULL on failure
+    const unsigned char * readTexture(int chunk, unsigned int & width, unsigned int & height,
+                                      std::vector<unsigned char> & scratch) const;
+
+private:
+    SceneBundle(const SceneBundle &);
+    SceneBundle & operator=(const SceneBundle &);
+
+    const unsigned char * data;
+    size_t size;
+    const BundleHeader * header;
+    const BundleChunk * toc;
+    const char * names;
+    std::vector<unsigned char> contents;   // the file, where it is read instead of mapped
+};
+
+// Writes a bundle front to back: chunks as they are added, the names and the table of
+// contents on finish(), then the header
+class BundleWriter {
+public:
+    BundleWriter();
+    ~BundleWriter();
+
+    bool open(const char * path, uint32_t pageSize = 4096);
+    // Returns the chunk index, -1 on a write error. With compress, the chunk is stored
+    // as an LZ4 block if that is smaller. Mesh chunks take their bounds.
+    int addChunk(BundleChunkType type, const std::string & name, const void * bytes, size_t size,
+                 const uint32_t info[4], bool compress, const MeshBounds * bounds = NULL);
+    bool finish();
+
+    uint64_t getRawBytes() const { return rawBytes; }
+    uint64_t getStoredBytes() const { return storedBytes; }
+
+private:
+    bool pad();
+
+    FILE * file;
+    uint32_t pageSize;
+    uint64_t position;
+    uint64_t rawBytes, storedBytes;
+    std::vector<BundleChunk> chunks;
+    std::string names;
+    std::vector<unsigned char> compressed;
+};
+
+// Packs modelsPath and the meshes and textures it names, read relative to directory
+// (the working directory if empty), into bundlePath. Models sharing a file share its chunk.
+bool packScene(const char * modelsPath, const std::string & directory, const char * bundlePath, bool compress);
+
+#endif
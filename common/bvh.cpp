@@ -0,0 +1,405 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cmath>
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+#include "bvh.hpp"
+
+static const int NumBins = 16;
+static const int MaxLeafSize = 8;
+// Subtrees smaller than this are not worth a thread
+static const int ParallelThreshold = 4096;
+// Past this depth only median splits are made, which bounds the traversal stacks
+static const int MaxSAHDepth = 64;
+static const int StackSize = 128;
+
+struct SceneBVH::BuildContext {
+    std::atomic<int> nextNode;
+};
+
+static inline AABB emptyBox() {
+    AABB b;
+    b.min = glm::vec3(FLT_MAX);
+    b.max = glm::vec3(-FLT_MAX);
+    return b;
+}
+
+static inline void grow(AABB & b, const AABB & o) {
+    b.min = glm::min(b.min, o.min);
+    b.max = glm::max(b.max, o.max);
+}
+
+static inline float surfaceArea(const AABB & b) {
+    glm::vec3 d = glm::max(b.max - b.min, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static inline bool overlaps(const AABB & a, const AABB & b) {
+    return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+           a.min.y <= b.max.y && a.max.y >= b.min.y &&
+           a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+static inline float intersectRayBox(const AABB & b, const glm::vec3 & origin, const glm::vec3 & invDir, float tmax) {
+    glm::vec3 t0 = (b.min - origin) * invDir;
+    glm::vec3 t1 = (b.max - origin) * invDir;
+    glm::vec3 tsmall = glm::min(t0, t1);
+    glm::vec3 tbig = glm::max(t0, t1);
+    float tnear = std::max(std::max(tsmall.x, tsmall.y), std::max(tsmall.z, 0.0f));
+    float tfar = std::min(std::min(tbig.x, tbig.y), std::min(tbig.z, tmax));
+    return tnear <= tfar ? tnear : FLT_MAX;
+}
+
+static inline glm::vec3 safeInverse(const glm::vec3 & d) {
+    // Avoid NaNs from 0 * inf in the slab test for axis aligned rays
+    glm::vec3 inv;
+    for (int i = 0; i < 3; i++)
+        inv[i] = 1.0f / (std::fabs(d[i]) > 1e-20f ? d[i] : (d[i] < 0.0f ? -1e-20f : 1e-20f));
+    return inv;
+}
+
+SceneBVH::SceneBVH() {
+}
+
+void SceneBVH::build(const std::vector<AABB> & bounds, unsigned int numThreads) {
+    int n = (int)bounds.size();
+    objectBounds = bounds;
+    centroids.resize(n);
+    primitives.resize(n);
+    for (int i = 0; i < n; i++) {
+        centroids[i] = 0.5f * (bounds[i].min + bounds[i].max);
+        primitives[i] = i;
+    }
+    dirtyLeaves.clear();
+
+    if (n == 0) {
+        nodes.clear();
+        objectLeaf.clear();
+        leafDirty.clear();
+        return;
+    }
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    int threadDepth = 0;
+    while ((1u << threadDepth) < numThreads)
+        threadDepth++;
+
+    // A binary tree with n leaves at most has 2n-1 nodes; reserving them up front
+    // lets threads write disjoint node pairs without locking
+    nodes.resize(2 * n - 1);
+    nodes[0].parent = -1;
+    BuildContext ctx;
+    ctx.nextNode = 1;
+    buildRange(ctx, 0, 0, n, 0, threadDepth);
+    nodes.resize(ctx.nextNode);
+
+    objectLeaf.resize(n);
+    leafDirty.assign(nodes.size(), 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].count == 0)
+            continue;
+        for (int p = nodes[i].first; p < nodes[i].first + nodes[i].count; p++)
+            objectLeaf[primitives[p]] = (int)i;
+    }
+}
+
+void SceneBVH::buildRange(BuildContext & ctx, int node, int begin, int end, int depth, int threadDepth) {
+    int count = end - begin;
+
+    AABB box = emptyBox();
+    AABB centroidBox = emptyBox();
+    for (int i = begin; i < end; i++) {
+        unsigned int p = primitives[i];
+        grow(box, objectBounds[p]);
+        centroidBox.min = glm::min(centroidBox.min, centroids[p]);
+        centroidBox.max = glm::max(centroidBox.max, centroids[p]);
+    }
+    nodes[node].bounds = box;
+    nodes[node].first = begin;
+    nodes[node].count = count;
+
+    if (count <= 2)
+        return;
+
+    // Split along the axis with the largest centroid spread
+    glm::vec3 extent = centroidBox.max - centroidBox.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int mid = begin;
+    if (extent[axis] > 0.0f && depth < MaxSAHDepth) {
+        // Binned SAH
+        int binCount[NumBins] = {0};
+        AABB binBox[NumBins];
+        for (int b = 0; b < NumBins; b++)
+            binBox[b] = emptyBox();
+
+        float lo = centroidBox.min[axis];
+        float scale = NumBins * (1.0f - 1e-5f) / extent[axis];
+        for (int i = begin; i < end; i++) {
+            unsigned int p = primitives[i];
+            int b = (int)((centroids[p][axis] - lo) * scale);
+            binCount[b]++;
+            grow(binBox[b], objectBounds[p]);
+        }
+
+        // Sweep from the right to get suffix areas, then from the left for the costs
+        float rightArea[NumBins];
+        int rightCount[NumBins];
+        AABB acc = emptyBox();
+        int accCount = 0;
+        for (int b = NumBins - 1; b > 0; b--) {
+            grow(acc, binBox[b]);
+            accCount += binCount[b];
+            rightArea[b] = surfaceArea(acc);
+            rightCount[b] = accCount;
+        }
+
+        float bestCost = FLT_MAX;
+        int bestSplit = -1;
+        acc = emptyBox();
+        accCount = 0;
+        for (int b = 1; b < NumBins; b++) {
+            grow(acc, binBox[b - 1]);
+            accCount += binCount[b - 1];
+            if (accCount == 0 || rightCount[b] == 0)
+                continue;
+            float cost = surfaceArea(acc) * accCount + rightArea[b] * rightCount[b];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        // Keep small ranges as leaves when splitting does not pay off
+        float leafCost = surfaceArea(box) * count;
+        if (count <= MaxLeafSize && (bestSplit < 0 || bestCost >= leafCost))
+            return;
+
+        if (bestSplit > 0) {
+            unsigned int * first = &primitives[0] + begin;
+            unsigned int * last = &primitives[0] + end;
+            const std::vector<glm::vec3> & c = centroids;
+            mid = (int)(std::partition(first, last, [&](unsigned int p) {
+                return (int)((c[p][axis] - lo) * scale) < bestSplit;
+            }) - &primitives[0]);
+        }
+    } else if (count <= MaxLeafSize && depth < MaxSAHDepth) {
+        return;
+    }
+
+    // All centroids coincide or the partition degenerated: fall back to a median split
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        const std::vector<glm::vec3> & c = centroids;
+        std::nth_element(&primitives[0] + begin, &primitives[0] + mid, &primitives[0] + end,
+                         [&](unsigned int a, unsigned int b) { return c[a][axis] < c[b][axis]; });
+    }
+
+    int children = ctx.nextNode.fetch_add(2);
+    nodes[node].first = children;
+    nodes[node].count = 0;
+    nodes[children].parent = node;
+    nodes[children + 1].parent = node;
+
+    if (threadDepth > 0 && count > ParallelThreshold) {
+        std::thread worker(&SceneBVH::buildRange, this, std::ref(ctx), children, begin, mid, depth + 1, threadDepth - 1);
+        buildRange(ctx, children + 1, mid, end, depth + 1, threadDepth - 1);
+        worker.join();
+    } else {
+        buildRange(ctx, children, begin, mid, depth + 1, 0);
+        buildRange(ctx, children + 1, mid, end, depth + 1, 0);
+    }
+}
+
+void SceneBVH::update(unsigned int object, const AABB & box) {
+    objectBounds[object] = box;
+    int leaf = objectLeaf[object];
+    if (!leafDirty[leaf]) {
+        leafDirty[leaf] = 1;
+        dirtyLeaves.push_back(leaf);
+    }
+}
+
+size_t SceneBVH::refit() {
+    size_t touched = 0;
+    for (size_t d = 0; d < dirtyLeaves.size(); d++) {
+        int node = dirtyLeaves[d];
+        leafDirty[node] = 0;
+
+        AABB box = emptyBox();
+        for (int p = nodes[node].first; p < nodes[node].first + nodes[node].count; p++)
+            grow(box, objectBounds[primitives[p]]);
+        nodes[node].bounds = box;
+        touched++;
+
+        // Walk up until an ancestor's bounds stop changing
+        for (node = nodes[node].parent; node != -1; node = nodes[node].parent) {
+            AABB merged = nodes[nodes[node].first].bounds;
+            grow(merged, nodes[nodes[node].first + 1].bounds);
+            if (merged.min == nodes[node].bounds.min && merged.max == nodes[node].bounds.max)
+                break;
+            nodes[node].bounds = merged;
+            touched++;
+        }
+    }
+    dirtyLeaves.clear();
+    return touched;
+}
+
+// 0 outside, 1 intersecting, 2 fully inside
+static inline int classifyBox(const Frustum & frustum, const AABB & b) {
+    glm::vec3 c = 0.5f * (b.min + b.max);
+    glm::vec3 e = 0.5f * (b.max - b.min);
+    int result = 2;
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4 & pl = frustum.planes[p];
+        float d = pl.x * c.x + pl.y * c.y + pl.z * c.z + pl.w;
+        float r = std::fabs(pl.x) * e.x + std::fabs(pl.y) * e.y + std::fabs(pl.z) * e.z;
+        if (d + r < 0.0f)
+            return 0;
+        if (d - r < 0.0f)
+            result = 1;
+    }
+    return result;
+}
+
+void SceneBVH::queryFrustum(const Frustum & frustum, std::vector<unsigned int> & out_objects) const {
+    out_objects.clear();
+    if (nodes.empty())
+        return;
+
+    // Second stack entry flags subtrees already known to be fully inside
+    int stack[StackSize];
+    bool inside[StackSize];
+    int top = 0;
+    stack[top] = 0; inside[top] = false; top++;
+    while (top > 0) {
+        top--;
+        const BVHNode & node = nodes[stack[top]];
+        bool contained = inside[top];
+        if (!contained) {
+            int c = classifyBox(frustum, node.bounds);
+            if (c == 0)
+                continue;
+            contained = (c == 2);
+        }
+        if (node.count > 0) {
+            for (int p = node.first; p < node.first + node.count; p++) {
+                unsigned int object = primitives[p];
+                if (contained || classifyBox(frustum, objectBounds[object]) != 0)
+                    out_objects.push_back(object);
+            }
+        } else {
+            stack[top] = node.first;     inside[top] = contained; top++;
+            stack[top] = node.first + 1; inside[top] = contained; top++;
+        }
+    }
+}
+
+void SceneBVH::queryBox(const AABB & box, std::vector<unsigned int> & out_objects) const {
+    out_objects.clear();
+    if (nodes.empty())
+        return;
+
+    int stack[StackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode & node = nodes[stack[--top]];
+        if (!overlaps(node.bounds, box))
+            continue;
+        if (node.count > 0) {
+            for (int p = node.first; p < node.first + node.count; p++) {
+                if (overlaps(objectBounds[primitives[p]], box))
+                    out_objects.push_back(primitives[p]);
+            }
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+    }
+}
+
+void SceneBVH::queryRay(const glm::vec3 & origin, const glm::vec3 & direction, float tmax,
+                        std::vector<unsigned int> & out_objects) const {
+    out_objects.clear();
+    if (nodes.empty())
+        return;
+
+    glm::vec3 invDir = safeInverse(direction);
+    int stack[StackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BVHNode & node = nodes[stack[--top]];
+        if (intersectRayBox(node.bounds, origin, invDir, tmax) == FLT_MAX)
+            continue;
+        if (node.count > 0) {
+            for (int p = node.first; p < node.first + node.count; p++) {
+                if (intersectRayBox(objectBounds[primitives[p]], origin, invDir, tmax) != FLT_MAX)
+                    out_objects.push_back(primitives[p]);
+            }
+        } else {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+    }
+}
+
+int SceneBVH::raycast(const glm::vec3 & origin, const glm::vec3 & direction, float tmax,
+                      const std::function<float(unsigned int, float)> & intersect, float * out_t) const {
+    int hit = -1;
+    if (nodes.empty())
+        return hit;
+
+    glm::vec3 invDir = safeInverse(direction);
+    float best = tmax;
+    int stack[StackSize];
+    float stackT[StackSize];
+    int top = 0;
+    float t = intersectRayBox(nodes[0].bounds, origin, invDir, best);
+    if (t != FLT_MAX) {
+        stack[top] = 0; stackT[top] = t; top++;
+    }
+    while (top > 0) {
+        top--;
+        if (stackT[top] >= best)
+            continue;
+        const BVHNode & node = nodes[stack[top]];
+        if (node.count > 0) {
+            for (int p = node.first; p < node.first + node.count; p++) {
+                unsigned int object = primitives[p];
+                if (intersectRayBox(objectBounds[object], origin, invDir, best) == FLT_MAX)
+                    continue;
+                float th = intersect(object, best);
+                if (th < best) {
+                    best = th;
+                    hit = (int)object;
+                }
+            }
+        } else {
+            // Push the far child first so the near one is visited next
+            int a = node.first, b = node.first + 1;
+            float ta = intersectRayBox(nodes[a].bounds, origin, invDir, best);
+            float tb = intersectRayBox(nodes[b].bounds, origin, invDir, best);
+            if (ta > tb) {
+                std::swap(a, b);
+                std::swap(ta, tb);
+            }
+            if (tb != FLT_MAX) { stack[top] = b; stackT[top] = tb; top++; }
+            if (ta != FLT_MAX) { stack[top] = a; stackT[top] = ta; top++; }
+        }
+    }
+    if (out_t && hit >= 0)
+        *out_t = best;
+    return hit;
+}
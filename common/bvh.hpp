@@ -0,0 +1,62 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+struct BVHNode {
+    AABB bounds;
+    int first;   // first child (children are stored as a pair) or first primitive for leaves
+    int count;   // number of primitives, 0 for inner nodes
+    int parent;  // -1 for the root
+};
+
+// Bounding volume hierarchy over object world bounds.
+// Built top down with binned SAH; large subtrees are built on worker threads.
+// Moving an object only refits the path from its leaf to the root.
+class SceneBVH {
+public:
+    SceneBVH();
+
+    // numThreads = 0 uses std::thread::hardware_concurrency()
+    void build(const std::vector<AABB> & objectBounds, unsigned int numThreads = 0);
+
+    // Record new bounds for an object; applied on the next refit()
+    void update(unsigned int object, const AABB & box);
+    // Propagate pending updates towards the root, returns number of nodes touched
+    size_t refit();
+
+    void queryFrustum(const Frustum & frustum, std::vector<unsigned int> & out_objects) const;
+    void queryBox(const AABB & box, std::vector<unsigned int> & out_objects) const;
+    // All objects whose bounds the ray hits within [0, tmax]
+    void queryRay(const glm::vec3 & origin, const glm::vec3 & direction, float tmax,
+                  std::vector<unsigned int> & out_objects) const;
+
+    // Closest hit: visits candidate objects front to back and calls intersect(object, tmax),
+    // which returns the hit distance or a value >= tmax on a miss.
+    // Returns the closest object or -1 and writes its distance to out_t.
+    int raycast(const glm::vec3 & origin, const glm::vec3 & direction, float tmax,
+                const std::function<float(unsigned int, float)> & intersect, float * out_t = NULL) const;
+
+    size_t objectCount() const { return objectBounds.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    const AABB & getObjectBounds(unsigned int object) const { return objectBounds[object]; }
+    const std::vector<BVHNode> & getNodes() const { return nodes; }
+
+private:
+    struct BuildContext;
+    void buildRange(BuildContext & ctx, int node, int begin, int end, int depth, int threadDepth);
+
+    std::vector<BVHNode> nodes;
+    std::vector<unsigned int> primitives;   // object indices referenced by the leaves
+    std::vector<AABB> objectBounds;
+    std::vector<glm::vec3> centroids;
+    std::vector<int> objectLeaf;            // leaf node holding each object
+    std::vector<unsigned int> dirtyLeaves;
+    std::vector<unsigned char> leafDirty;
+};
+
+#endif
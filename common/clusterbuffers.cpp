@@ -0,0 +1,78 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "clusteredlights.hpp"
+#include "clusterbuffers.hpp"
+
+static const GLenum Formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+
+ClusterBuffers::ClusterBuffers() : maxTexels(0) {
+    memset(buffers, 0, sizeof(buffers));
+    memset(textures, 0, sizeof(textures));
+}
+
+bool ClusterBuffers::create() {
+    GLint texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &texels);
+    maxTexels = texels > 0 ? (size_t)texels : 65536;
+
+    glGenBuffers(3, buffers);
+    glGenTextures(3, textures);
+    for (int i = 0; i < 3; i++) {
+        // Never empty, a buffer texture without storage reads as incomplete
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, Formats[i], buffers[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR) {
+        printf("Creating the light cluster buffers failed\n");
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void ClusterBuffers::destroy() {
+    if (textures[0])
+        glDeleteTextures(3, textures);
+    if (buffers[0])
+        glDeleteBuffers(3, buffers);
+    memset(buffers, 0, sizeof(buffers));
+    memset(textures, 0, sizeof(textures));
+}
+
+void ClusterBuffers::upload(const ClusterData & data) {
+    const void * sources[3] = {
+        data.lights.empty() ? NULL : &data.lights[0],
+        data.clusters.empty() ? NULL : &data.clusters[0],
+        data.indices.empty() ? NULL : &data.indices[0],
+    };
+    size_t sizes[3] = {
+        data.lights.size() * sizeof(glm::vec4),
+        data.clusters.size() * sizeof(unsigned int),
+        data.indices.size() * sizeof(unsigned int),
+    };
+    for (int i = 0; i < 3; i++) {
+        // Orphan the old storage, then fill the new one
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, sizes[i] > 16 ? sizes[i] : 16, NULL, GL_STREAM_DRAW);
+        if (sizes[i])
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, sizes[i], sources[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusterBuffers::bind(GLuint firstUnit) const {
+    for (int i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
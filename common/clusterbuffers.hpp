@@ -0,0 +1,32 @@
+#ifndef CLUSTERBUFFERS_HPP
+#define CLUSTERBUFFERS_HPP
+
+#include <stddef.h>
+
+struct ClusterData;
+
+// GL side of clustered lighting: the light, cluster and index lists of a frame in
+// three buffer textures (samplerBuffer / usamplerBuffer, core since GL 3.1).
+// upload() replaces the storage every frame so the driver never waits for draws of
+// an earlier frame still reading the old lists.
+class ClusterBuffers {
+public:
+    ClusterBuffers();
+
+    bool create();
+    void destroy();
+
+    void upload(const ClusterData & data);
+    // Binds the lights, clusters and indices to three consecutive texture units from firstUnit
+    void bind(GLuint firstUnit) const;
+
+    // GL_MAX_TEXTURE_BUFFER_SIZE, the longest list a buffer texture can hold
+    size_t getMaxTexels() const { return maxTexels; }
+
+private:
+    GLuint buffers[3];
+    GLuint textures[3];
+    size_t maxTexels;
+};
+
+#endif
@@ -0,0 +1,209 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LIGHTS_SSE 1
+#endif
+
+#include "threadpool.hpp"
+#include "clusteredlights.hpp"
+
+// Padding lights: far away with no radius, they never touch a cluster
+static const float PadPosition = 1e18f;
+
+ClusteredLights::ClusteredLights() : maxReferences((size_t)-1), boundsValid(false) {
+    grid.tilesX = 16;
+    grid.tilesY = 9;
+    grid.slices = 24;
+    grid.near = 0.1f;
+    grid.far = 100.0f;
+}
+
+void ClusteredLights::setGrid(const ClusterGrid & newGrid) {
+    grid = newGrid;
+    grid.tilesX = std::max(grid.tilesX, 1);
+    grid.tilesY = std::max(grid.tilesY, 1);
+    grid.slices = std::max(grid.slices, 1);
+    boundsValid = false;
+}
+
+void ClusteredLights::sliceParameters(float & out_scale, float & out_bias) const {
+    float range = std::log(grid.far / grid.near);
+    out_scale = grid.slices / range;
+    out_bias = -grid.slices * std::log(grid.near) / range;
+}
+
+void ClusteredLights::buildBounds(const glm::mat4 & projection) {
+    int tiles = grid.tilesX * grid.tilesY;
+    int count = tiles * grid.slices;
+    minX.resize(count); minY.resize(count); minZ.resize(count);
+    maxX.resize(count); maxY.resize(count); maxZ.resize(count);
+    sliceNear.resize(grid.slices);
+    sliceFar.resize(grid.slices);
+    slices.resize(grid.slices);
+
+    for (int s = 0; s < grid.slices; s++) {
+        sliceNear[s] = grid.near * std::pow(grid.far / grid.near, (float)s / grid.slices);
+        sliceFar[s] = grid.near * std::pow(grid.far / grid.near, (float)(s + 1) / grid.slices);
+    }
+
+    // Direction through each tile corner with a view space depth of 1
+    glm::mat4 inverse = glm::inverse(projection);
+    std::vector<glm::vec3> corners((grid.tilesX + 1) * (grid.tilesY + 1));
+    for (int y = 0; y <= grid.tilesY; y++) {
+        for (int x = 0; x <= grid.tilesX; x++) {
+            glm::vec4 p = inverse * glm::vec4(-1.0f + 2.0f * x / grid.tilesX, -1.0f + 2.0f * y / grid.tilesY, -1.0f, 1.0f);
+            glm::vec3 v = glm::vec3(p) / p.w;
+            corners[y * (grid.tilesX + 1) + x] = v / -v.z;
+        }
+    }
+
+    for (int s = 0; s < grid.slices; s++) {
+        for (int y = 0; y < grid.tilesY; y++) {
+            for (int x = 0; x < grid.tilesX; x++) {
+                int c = s * tiles + y * grid.tilesX + x;
+                glm::vec3 lo(1e30f), hi(-1e30f);
+                for (int k = 0; k < 4; k++) {
+                    const glm::vec3 & d = corners[(y + (k >> 1)) * (grid.tilesX + 1) + x + (k & 1)];
+                    lo = glm::min(lo, glm::min(d * sliceNear[s], d * sliceFar[s]));
+                    hi = glm::max(hi, glm::max(d * sliceNear[s], d * sliceFar[s]));
+                }
+                minX[c] = lo.x; minY[c] = lo.y; minZ[c] = lo.z;
+                maxX[c] = hi.x; maxY[c] = hi.y; maxZ[c] = hi.z;
+            }
+        }
+    }
+    boundsProjection = projection;
+    boundsValid = true;
+}
+
+void ClusteredLights::prepareLights(const std::vector<PointLight> & lights, const glm::mat4 & view, ClusterData & out) {
+    // Keep the lights that reach into the depth range, in view space
+    out.lights.clear();
+    lightX.clear(); lightY.clear(); lightZ.clear(); lightR.clear();
+    for (size_t i = 0; i < lights.size(); i++) {
+        glm::vec3 p = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        float r = lights[i].radius;
+        if (-p.z + r < grid.near || -p.z - r > grid.far)
+            continue;
+        lightX.push_back(p.x); lightY.push_back(p.y); lightZ.push_back(p.z); lightR.push_back(r);
+        out.lights.push_back(glm::vec4(p, r));
+        out.lights.push_back(glm::vec4(lights[i].color, 1.0f));
+    }
+}
+
+void ClusteredLights::assignSlice(int s, bool simd) {
+    SliceLists & lists = slices[s];
+    int tiles = grid.tilesX * grid.tilesY;
+    lists.counts.assign(tiles, 0);
+    lists.indices.clear();
+
+    // Lights overlapping the depth range of the slice
+    lists.x.clear(); lists.y.clear(); lists.z.clear(); lists.r.clear(); lists.light.clear();
+    for (size_t i = 0; i < lightR.size(); i++) {
+        float depth = -lightZ[i];
+        if (depth + lightR[i] < sliceNear[s] || depth - lightR[i] > sliceFar[s])
+            continue;
+        lists.x.push_back(lightX[i]); lists.y.push_back(lightY[i]); lists.z.push_back(lightZ[i]); lists.r.push_back(lightR[i]);
+        lists.light.push_back((unsigned int)i);
+    }
+    size_t n = lists.light.size();
+    while (lists.r.size() % 4) {
+        lists.x.push_back(PadPosition); lists.y.push_back(PadPosition); lists.z.push_back(PadPosition); lists.r.push_back(0.0f);
+    }
+
+    for (int t = 0; t < tiles; t++) {
+        int c = s * tiles + t;
+        size_t before = lists.indices.size();
+        size_t i = 0;
+#if defined(LIGHTS_SSE)
+        if (simd) {
+            const __m128 zero = _mm_setzero_ps();
+            __m128 bx0 = _mm_set1_ps(minX[c]), by0 = _mm_set1_ps(minY[c]), bz0 = _mm_set1_ps(minZ[c]);
+            __m128 bx1 = _mm_set1_ps(maxX[c]), by1 = _mm_set1_ps(maxY[c]), bz1 = _mm_set1_ps(maxZ[c]);
+            for (; i < n; i += 4) {
+                __m128 px = _mm_loadu_ps(&lists.x[i]);
+                __m128 py = _mm_loadu_ps(&lists.y[i]);
+                __m128 pz = _mm_loadu_ps(&lists.z[i]);
+                __m128 r = _mm_loadu_ps(&lists.r[i]);
+                // Distance from the center to the box, per axis
+                __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(bx0, px), zero), _mm_max_ps(_mm_sub_ps(px, bx1), zero));
+                __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(by0, py), zero), _mm_max_ps(_mm_sub_ps(py, by1), zero));
+                __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(bz0, pz), zero), _mm_max_ps(_mm_sub_ps(pz, bz1), zero));
+                __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(r, r)));
+                for (int k = 0; mask; k++, mask >>= 1) {
+                    if (mask & 1)
+                        lists.indices.push_back(lists.light[i + k]);
+                }
+            }
+        }
+#endif
+        for (; i < n; i++) {
+            float dx = std::max(minX[c] - lists.x[i], 0.0f) + std::max(lists.x[i] - maxX[c], 0.0f);
+            float dy = std::max(minY[c] - lists.y[i], 0.0f) + std::max(lists.y[i] - maxY[c], 0.0f);
+            float dz = std::max(minZ[c] - lists.z[i], 0.0f) + std::max(lists.z[i] - maxZ[c], 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= lists.r[i] * lists.r[i])
+                lists.indices.push_back(lists.light[i]);
+        }
+        lists.counts[t] = (unsigned int)(lists.indices.size() - before);
+    }
+}
+
+void ClusteredLights::gather(ClusterData & out) {
+    int tiles = grid.tilesX * grid.tilesY;
+    out.clusters.resize(2 * tiles * grid.slices);
+    out.indices.clear();
+    out.stats.lights = (unsigned int)lightR.size();
+    out.stats.maxPerCluster = 0;
+    out.stats.overflows = 0;
+    for (int s = 0; s < grid.slices; s++) {
+        const SliceLists & lists = slices[s];
+        size_t read = 0;
+        for (int t = 0; t < tiles; t++) {
+            unsigned int count = lists.counts[t];
+            unsigned int kept = (unsigned int)std::min<size_t>(count, maxReferences - std::min(maxReferences, out.indices.size()));
+            int c = s * tiles + t;
+            out.clusters[2 * c] = (unsigned int)out.indices.size();
+            out.clusters[2 * c + 1] = kept;
+            out.indices.insert(out.indices.end(), lists.indices.begin() + read, lists.indices.begin() + read + kept);
+            out.stats.maxPerCluster = std::max(out.stats.maxPerCluster, count);
+            out.stats.overflows += count - kept;
+            read += count;
+        }
+    }
+    out.stats.references = (unsigned int)out.indices.size();
+}
+
+void ClusteredLights::assign(const std::vector<PointLight> & lights, const glm::mat4 & view, const glm::mat4 & projection,
+                             ClusterData & out, ThreadPool * pool) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    if (!boundsValid || projection != boundsProjection)
+        buildBounds(projection);
+    prepareLights(lights, view, out);
+    if (pool && !lightR.empty())
+        pool->parallelFor(grid.slices, [&](int s) { assignSlice(s, true); });
+    else
+        for (int s = 0; s < grid.slices; s++)
+            assignSlice(s, true);
+    gather(out);
+    out.stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void ClusteredLights::assignScalar(const std::vector<PointLight> & lights, const glm::mat4 & view, const glm::mat4 & projection,
+                                   ClusterData & out) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    if (!boundsValid || projection != boundsProjection)
+        buildBounds(projection);
+    prepareLights(lights, view, out);
+    for (int s = 0; s < grid.slices; s++)
+        assignSlice(s, false);
+    gather(out);
+    out.stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,86 @@
+#ifndef CLUSTEREDLIGHTS_HPP
+#define CLUSTEREDLIGHTS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+class ThreadPool;
+
+struct PointLight {
+    glm::vec3 position;     // world space
+    float radius;           // the light fades to nothing at this distance
+    glm::vec3 color;        // intensity included
+};
+
+// Screen tiles times exponential depth slices between near and far
+struct ClusterGrid {
+    int tilesX, tilesY, slices;
+    float near, far;
+};
+
+struct ClusterStats {
+    unsigned int lights;        // lights within the depth range of the grid
+    unsigned int references;    // light indices stored over all clusters
+    unsigned int maxPerCluster;
+    unsigned int overflows;     // references dropped because the index list was full
+    double milliseconds;
+};
+
+// Light lists of one frame in the layout the shaders read them
+struct ClusterData {
+    std::vector<glm::vec4> lights;      // per light: view space position and radius, colour
+    std::vector<unsigned int> clusters; // per cluster: offset and count in indices; x, then y, then slice
+    std::vector<unsigned int> indices;  // the light lists of all clusters back to back
+    ClusterStats stats;
+};
+
+// Assigns point lights to the clusters of a view frustum for clustered forward shading.
+// The view space bounds of every cluster are computed once per projection. Each frame
+// the lights are moved to view space, and every depth slice (one thread pool job each)
+// gathers the lights overlapping its depth range and tests them 4 at a time (SSE)
+// against the box of each of its clusters.
+class ClusteredLights {
+public:
+    ClusteredLights();
+
+    void setGrid(const ClusterGrid & grid);
+    const ClusterGrid & getGrid() const { return grid; }
+    // Longest index list the buffers can hold, later references are dropped
+    void setMaxReferences(size_t count) { maxReferences = count; }
+
+    // Slice of a view space depth d: log(d) * scale + bias
+    void sliceParameters(float & out_scale, float & out_bias) const;
+
+    void assign(const std::vector<PointLight> & lights, const glm::mat4 & view, const glm::mat4 & projection,
+                ClusterData & out, ThreadPool * pool = NULL);
+    // Reference implementation, one light and cluster at a time on the calling thread
+    void assignScalar(const std::vector<PointLight> & lights, const glm::mat4 & view, const glm::mat4 & projection,
+                      ClusterData & out);
+
+private:
+    void buildBounds(const glm::mat4 & projection);
+    void prepareLights(const std::vector<PointLight> & lights, const glm::mat4 & view, ClusterData & out);
+    void assignSlice(int slice, bool simd);
+    void gather(ClusterData & out);
+
+    // Lights of one slice and the lists of its clusters, reused every frame
+    struct SliceLists {
+        std::vector<float> x, y, z, r;          // candidate lights, padded to a multiple of 4
+        std::vector<unsigned int> light;        // their index in ClusterData::lights
+        std::vector<unsigned int> counts;       // per cluster of the slice
+        std::vector<unsigned int> indices;
+    };
+
+    ClusterGrid grid;
+    size_t maxReferences;
+    glm::mat4 boundsProjection;
+    bool boundsValid;
+    // View space box of every cluster
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    std::vector<float> sliceNear, sliceFar;     // depth range of each slice
+    // Lights of the frame in view space
+    std::vector<float> lightX, lightY, lightZ, lightR;
+    std::vector<SliceLists> slices;
+};
+
+#endif
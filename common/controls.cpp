@@ -14,6 +14,9 @@ using namespace glm;
 
 glm::mat4 ViewMatrix;
 glm::mat4 ProjectionMatrix;
+bool redrawRequested = true;
+bool pickRequested = false;
+double pickX, pickY;
 
 glm::mat4 getViewMatrix(){
 	return ViewMatrix;
@@ -21,6 +24,18 @@ glm::mat4 getViewMatrix(){
 glm::mat4 getProjectionMatrix(){
 	return ProjectionMatrix;
 }
+bool consumeRedraw(){
+	bool requested = redrawRequested;
+	redrawRequested = false;
+	return requested;
+}
+bool consumePick(double & x, double & y){
+	bool requested = pickRequested;
+	pickRequested = false;
+	x = pickX;
+	y = pickY;
+	return requested;
+}
 
 // Initial distance between eye and center :
 static float radius = 5;
@@ -44,11 +59,15 @@ float zoomSpeed = 0.01f;
 float zoomSpeedScrollWheel = 0.05f;
 
 void updateView() {
+    glm::mat4 previous = ViewMatrix;
     ViewMatrix = glm::lookAt(
                              glm::vec3(center-radius*direction), // camera is located here
                              glm::vec3(center), // camera looks at center point
                              glm::vec3(up)  // head is up
                              );
+    // Cursor moves without a button held leave the view as it was
+    if (ViewMatrix != previous)
+        redrawRequested = true;
 }
 
 void MouseDraggedCallback(GLFWwindow*, double x, double y)
@@ -104,6 +123,12 @@ void MouseScrollCallback(GLFWwindow*, double dx, double dy)
     updateView();
 }
 
+void WindowRefreshCallback(GLFWwindow*)
+{
+    // Exposed or resized, the contents have to be drawn again
+    redrawRequested = true;
+}
+
 void MousePressCallback(GLFWwindow*, int button, int action, int mods)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT  && action == GLFW_PRESS)
@@ -119,21 +144,35 @@ void MousePressCallback(GLFWwindow*, int button, int action, int mods)
         }
     }
     
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS)
+    {
+        glfwGetCursorPos(window, &pickX, &pickY);
+        pickRequested = true;
+        redrawRequested = true;
+    }
+    
     if (action == GLFW_RELEASE)
     {
         mode = None;
     }
 }
 
-void initializeMouseCallbacks() {
+void initializeView(int width, int height) {
+    
+    // Initialize View and Project matrices
+    ProjectionMatrix = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 100.0f);
+    updateView();
+    
+}
+
+void initializeMouseCallbacks(int width, int height) {
     
     // Setup callback functions
     glfwSetScrollCallback(window, MouseScrollCallback);
     glfwSetMouseButtonCallback(window, MousePressCallback);
     glfwSetCursorPosCallback(window, MouseDraggedCallback);
+    glfwSetWindowRefreshCallback(window, WindowRefreshCallback);
     
-    // Initialize View and Project matrices
-    ProjectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.1f, 100.0f);
-    updateView();
+    initializeView(width, height);
     
 }
@@ -2,8 +2,15 @@
 #define CONTROLS_HPP
 
 void computeMatricesFromInputs();
-void initializeMouseCallbacks();
+// Input callbacks on the window, and the view and projection for its size
+void initializeMouseCallbacks(int width, int height);
+// View and projection setup without input, e.g. for offscreen rendering
+void initializeView(int width, int height);
 glm::mat4 getViewMatrix();
 glm::mat4 getProjectionMatrix();
+// True once after the view moved or the window asked to be repainted, for on-demand rendering
+bool consumeRedraw();
+// True once after a right click, with the cursor position in window coordinates
+bool consumePick(double & x, double & y);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Include standard headers
+#include <cmath>
+#include <algorithm>
+
+#include "dynamicresolution.hpp"
+
+DynamicResolutionSettings defaultDynamicResolutionSettings() {
+    DynamicResolutionSettings s;
+    s.targetMilliseconds = 1000.0 / 60.0;
+    s.headroom = 0.9f;
+    s.minScale = 0.5f;
+    s.maxScale = 1.0f;
+    s.smoothing = 0.1f;
+    s.maxStep = 0.1f;
+    return s;
+}
+
+DynamicResolution::DynamicResolution(const DynamicResolutionSettings & settings)
+    : settings(settings), scale(settings.maxScale), average(0.0), first(true) {
+}
+
+float DynamicResolution::update(double frameMilliseconds) {
+    if (first) {
+        average = frameMilliseconds;
+        first = false;
+    } else if (frameMilliseconds > average && frameMilliseconds > settings.targetMilliseconds) {
+        average = frameMilliseconds;
+    } else {
+        average += settings.smoothing * (frameMilliseconds - average);
+    }
+
+    double goal = settings.targetMilliseconds * settings.headroom;
+    if (average <= 0.0)
+        return scale;
+    // Dead band around the goal, so a steady load doesn't make the scale oscillate
+    double ratio = goal / average;
+    if (ratio > 0.95 && ratio < 1.05)
+        return scale;
+
+    float step = (float)std::sqrt(ratio);
+    step = std::min(std::max(step, 1.0f - settings.maxStep), 1.0f + settings.maxStep);
+    scale = std::min(std::max(scale * step, settings.minScale), settings.maxScale);
+    return scale;
+}
+
+void DynamicResolution::renderSize(int width, int height, int & out_width, int & out_height) const {
+    out_width = std::min(width, std::max(8, ((int)(width * scale) + 7) / 8 * 8));
+    out_height = std::min(height, std::max(8, ((int)(height * scale) + 7) / 8 * 8));
+}
@@ -0,0 +1,41 @@
+#ifndef DYNAMICRESOLUTION_HPP
+#define DYNAMICRESOLUTION_HPP
+
+struct DynamicResolutionSettings {
+    double targetMilliseconds;  // frame budget, 1000 / 60 for 60 Hz
+    float headroom;             // fraction of the budget aimed for, leaves room for spikes
+    float minScale, maxScale;   // limits of the per axis render scale
+    float smoothing;            // weight of a new frame time in the moving average, 0..1
+    float maxStep;              // largest relative scale change per frame
+};
+
+DynamicResolutionSettings defaultDynamicResolutionSettings();
+
+// Picks the render resolution from measured frame times.
+// Frame times are averaged exponentially, except that frames over budget are taken
+// in at once so a load spike lowers the resolution on the next frame. Since fill cost
+// grows with the pixel count, the scale moves by the square root of budget / average.
+// Render sizes are rounded to multiples of 8 pixels so small corrections don't make
+// the image flicker between neighbouring sizes.
+class DynamicResolution {
+public:
+    DynamicResolution(const DynamicResolutionSettings & settings = defaultDynamicResolutionSettings());
+
+    // Feed the time of the last frame, returns the scale for the next one
+    float update(double frameMilliseconds);
+
+    float getScale() const { return scale; }
+    double getAverageMilliseconds() const { return average; }
+    const DynamicResolutionSettings & getSettings() const { return settings; }
+
+    // Render size for an output of width x height at the current scale
+    void renderSize(int width, int height, int & out_width, int & out_height) const;
+
+private:
+    DynamicResolutionSettings settings;
+    float scale;
+    double average;
+    bool first;
+};
+
+#endif
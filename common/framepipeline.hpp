@@ -0,0 +1,138 @@
+#ifndef FRAMEPIPELINE_HPP
+#define FRAMEPIPELINE_HPP
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Single producer / single consumer triple buffer.
+// The producer fills writeBuffer() and publish()es it, the consumer calls update() and
+// reads readBuffer(). Neither side ever waits for the other: the slots are exchanged
+// through one atomic index, and a publish that is never read is simply overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), front(0), back(2) {}
+
+    T & writeBuffer() { return slots[back]; }
+    void publish() {
+        back = middle.exchange(back | FreshBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // True if a newer buffer was published since the last update
+    bool update() {
+        if (!(middle.load(std::memory_order_acquire) & FreshBit))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+    T & readBuffer() { return slots[front]; }
+    const T & readBuffer() const { return slots[front]; }
+
+private:
+    static const unsigned int FreshBit = 4;
+    static const unsigned int IndexMask = 3;
+
+    T slots[3];
+    std::atomic<unsigned int> middle;   // slot index, FreshBit while unread
+    unsigned int front;                 // owned by the consumer
+    unsigned int back;                  // owned by the producer
+};
+
+// Builds frame packets on a worker thread, one frame ahead of the render thread.
+// The render thread submit()s the input of frame N+1 (camera state) and then acquire()s
+// the packet the worker built from the previous input, so building N+1 overlaps with
+// submitting N to GL. Input and packets travel through triple buffers; the mutex and
+// condition variable are only used to put an idle thread to sleep.
+template <typename Input, typename Packet>
+class FramePipeline {
+public:
+    typedef std::function<void(const Input &, Packet &)> BuildFunction;
+
+    FramePipeline() : running(false), quit(false), inputSerial(0), packetSerial(0) {}
+    ~FramePipeline() { stop(); }
+
+    void start(const BuildFunction & buildFrame) {
+        build = buildFrame;
+        quit = false;
+        running = true;
+        worker = std::thread(&FramePipeline::workerLoop, this);
+    }
+
+    void stop() {
+        if (!running)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        worker.join();
+        running = false;
+    }
+
+    bool isRunning() const { return running; }
+
+    // Render thread: hand the input for the next packet to the worker
+    void submit(const Input & input) {
+        inputs.writeBuffer() = input;
+        inputs.publish();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inputSerial++;
+        }
+        wake.notify_all();
+    }
+
+    // Render thread: newest packet that has not been acquired yet, waits if the worker
+    // is still building it
+    Packet & acquire() {
+        for (;;) {
+            unsigned int seen = packetSerial.load(std::memory_order_acquire);
+            if (packets.update())
+                return packets.readBuffer();
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&]() { return packetSerial.load(std::memory_order_acquire) != seen; });
+        }
+    }
+
+private:
+    void workerLoop() {
+        unsigned int builtSerial = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return quit || inputSerial != builtSerial; });
+                if (quit)
+                    return;
+                builtSerial = inputSerial;
+            }
+            inputs.update();
+            build(inputs.readBuffer(), packets.writeBuffer());
+            packets.publish();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                packetSerial.fetch_add(1, std::memory_order_release);
+            }
+            ready.notify_all();
+        }
+    }
+
+    BuildFunction build;
+    std::thread worker;
+    bool running;
+    bool quit;
+
+    TripleBuffer<Input> inputs;
+    TripleBuffer<Packet> packets;
+
+    std::mutex mutex;
+    std::condition_variable wake;    // new input for the worker
+    std::condition_variable ready;   // new packet for the render thread
+    unsigned int inputSerial;
+    std::atomic<unsigned int> packetSerial;
+};
+
+#endif
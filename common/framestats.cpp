@@ -0,0 +1,35 @@
+// Include standard headers
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include "framestats.hpp"
+
+FrameTimeSummary summarizeFrameTimes(const std::vector<double> & frameMilliseconds) {
+    FrameTimeSummary s = FrameTimeSummary();
+    s.frames = frameMilliseconds.size();
+    if (s.frames == 0)
+        return s;
+
+    std::vector<double> sorted(frameMilliseconds);
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for (size_t i = 0; i < sorted.size(); i++)
+        total += sorted[i];
+
+    // Nearest rank percentiles
+    s.minMs = sorted.front();
+    s.maxMs = sorted.back();
+    s.medianMs = sorted[(sorted.size() - 1) / 2];
+    s.p99Ms = sorted[std::min(sorted.size() - 1, (size_t)(0.99 * sorted.size()))];
+    s.meanMs = total / sorted.size();
+    s.framesPerSecond = total > 0.0 ? 1000.0 * sorted.size() / total : 0.0;
+    return s;
+}
+
+void printFrameTimeSummary(const FrameTimeSummary & s) {
+    printf("frames: %zu\n", s.frames);
+    printf("frame time ms: min %.3f  median %.3f  p99 %.3f  max %.3f  mean %.3f\n",
+           s.minMs, s.medianMs, s.p99Ms, s.maxMs, s.meanMs);
+    printf("throughput: %.1f frames/s\n", s.framesPerSecond);
+}
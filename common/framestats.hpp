@@ -0,0 +1,15 @@
+#ifndef FRAMESTATS_HPP
+#define FRAMESTATS_HPP
+
+#include <vector>
+
+struct FrameTimeSummary {
+    size_t frames;
+    double minMs, medianMs, p99Ms, maxMs, meanMs;
+    double framesPerSecond;   // frames / total time
+};
+
+FrameTimeSummary summarizeFrameTimes(const std::vector<double> & frameMilliseconds);
+void printFrameTimeSummary(const FrameTimeSummary & summary);
+
+#endif
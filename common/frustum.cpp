@@ -0,0 +1,283 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRUSTUM_SSE 1
+#endif
+
+#include "frustum.hpp"
+
+void CullingBounds::clear() {
+    sx.clear(); sy.clear(); sz.clear(); sr.clear();
+    cx.clear(); cy.clear(); cz.clear();
+    ex.clear(); ey.clear(); ez.clear();
+}
+
+void CullingBounds::reserve(size_t n) {
+    sx.reserve(n); sy.reserve(n); sz.reserve(n); sr.reserve(n);
+    cx.reserve(n); cy.reserve(n); cz.reserve(n);
+    ex.reserve(n); ey.reserve(n); ez.reserve(n);
+}
+
+void CullingBounds::push_back(const AABB & box, const BoundingSphere & sphere) {
+    sx.push_back(0); sy.push_back(0); sz.push_back(0); sr.push_back(0);
+    cx.push_back(0); cy.push_back(0); cz.push_back(0);
+    ex.push_back(0); ey.push_back(0); ez.push_back(0);
+    set(size() - 1, box, sphere);
+}
+
+void CullingBounds::set(size_t i, const AABB & box, const BoundingSphere & sphere) {
+    glm::vec3 c = 0.5f * (box.min + box.max);
+    glm::vec3 e = 0.5f * (box.max - box.min);
+    sx[i] = sphere.center.x; sy[i] = sphere.center.y; sz[i] = sphere.center.z; sr[i] = sphere.radius;
+    cx[i] = c.x; cy[i] = c.y; cz[i] = c.z;
+    ex[i] = e.x; ey[i] = e.y; ez[i] = e.z;
+}
+
+void computeBounds(
+    const std::vector<glm::vec3> & vertices,
+    AABB & out_box,
+    BoundingSphere & out_sphere
+){
+    if (vertices.empty()) {
+        out_box.min = out_box.max = glm::vec3(0.0f);
+        out_sphere.center = glm::vec3(0.0f);
+        out_sphere.radius = 0.0f;
+        return;
+    }
+
+    glm::vec3 lo = vertices[0];
+    glm::vec3 hi = vertices[0];
+    for (size_t i = 1; i < vertices.size(); i++) {
+        lo = glm::min(lo, vertices[i]);
+        hi = glm::max(hi, vertices[i]);
+    }
+    out_box.min = lo;
+    out_box.max = hi;
+
+    // Sphere around the box center; tighter than the box diagonal for most meshes
+    glm::vec3 c = 0.5f * (lo + hi);
+    float r2 = 0.0f;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        glm::vec3 d = vertices[i] - c;
+        r2 = std::max(r2, glm::dot(d, d));
+    }
+    out_sphere.center = c;
+    out_sphere.radius = std::sqrt(r2);
+}
+
+AABB transformAABB(const AABB & box, const glm::mat4 & M) {
+    // Arvo's method: transform center, then project extents on the absolute matrix
+    glm::vec3 c = 0.5f * (box.min + box.max);
+    glm::vec3 e = 0.5f * (box.max - box.min);
+    glm::vec3 wc = glm::vec3(M * glm::vec4(c, 1.0f));
+    glm::vec3 we;
+    for (int row = 0; row < 3; row++) {
+        we[row] = std::fabs(M[0][row]) * e.x + std::fabs(M[1][row]) * e.y + std::fabs(M[2][row]) * e.z;
+    }
+    AABB out;
+    out.min = wc - we;
+    out.max = wc + we;
+    return out;
+}
+
+BoundingSphere transformSphere(const BoundingSphere & sphere, const glm::mat4 & M) {
+    float s = std::max(glm::length(glm::vec3(M[0])), std::max(glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2]))));
+    BoundingSphere out;
+    out.center = glm::vec3(M * glm::vec4(sphere.center, 1.0f));
+    out.radius = sphere.radius * s;
+    return out;
+}
+
+Frustum extractFrustumPlanes(const glm::mat4 & VP) {
+    // glm is column major: VP[col][row]
+    glm::vec4 row0(VP[0][0], VP[1][0], VP[2][0], VP[3][0]);
+    glm::vec4 row1(VP[0][1], VP[1][1], VP[2][1], VP[3][1]);
+    glm::vec4 row2(VP[0][2], VP[1][2], VP[2][2], VP[3][2]);
+    glm::vec4 row3(VP[0][3], VP[1][3], VP[2][3], VP[3][3]);
+
+    Frustum f;
+    f.planes[0] = row3 + row0; // left
+    f.planes[1] = row3 - row0; // right
+    f.planes[2] = row3 + row1; // bottom
+    f.planes[3] = row3 - row1; // top
+    f.planes[4] = row3 + row2; // near
+    f.planes[5] = row3 - row2; // far
+
+    // Normalize so the sphere test can compare distances directly
+    for (int i = 0; i < 6; i++) {
+        float len = glm::length(glm::vec3(f.planes[i]));
+        if (len > 0.0f)
+            f.planes[i] /= len;
+    }
+    return f;
+}
+
+static inline bool objectVisible(const Frustum & frustum, const CullingBounds & b, size_t i) {
+    // Same operation order as the SIMD paths so all of them agree bit for bit
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4 & pl = frustum.planes[p];
+        float ds = (pl.x * b.sx[i] + pl.y * b.sy[i]) + (pl.z * b.sz[i] + (pl.w + b.sr[i]));
+        if (!(ds >= 0.0f))
+            return false;
+        float dc = (pl.x * b.cx[i] + pl.y * b.cy[i]) + (pl.z * b.cz[i] + pl.w);
+        float rc = (std::fabs(pl.x) * b.ex[i] + std::fabs(pl.y) * b.ey[i]) + std::fabs(pl.z) * b.ez[i];
+        if (!(dc + rc >= 0.0f))
+            return false;
+    }
+    return true;
+}
+
+static double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static void finishStats(CullStats * stats, size_t tested, size_t visible, std::chrono::high_resolution_clock::time_point start) {
+    if (!stats)
+        return;
+    stats->tested = (unsigned int)tested;
+    stats->visible = (unsigned int)visible;
+    stats->culled = (unsigned int)(tested - visible);
+    stats->milliseconds = elapsedMilliseconds(start);
+}
+
+void cullBoundsScalar(
+    const Frustum & frustum,
+    const CullingBounds & bounds,
+    std::vector<unsigned int> & out_visible,
+    CullStats * stats
+){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t n = bounds.size();
+    out_visible.resize(n);
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (objectVisible(frustum, bounds, i))
+            out_visible[count++] = (unsigned int)i;
+    }
+    out_visible.resize(count);
+    finishStats(stats, n, count, start);
+}
+
+void cullBounds(
+    const Frustum & frustum,
+    const CullingBounds & bounds,
+    std::vector<unsigned int> & out_visible,
+    CullStats * stats
+){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t n = bounds.size();
+    out_visible.resize(n);
+    unsigned int * out = n ? &out_visible[0] : NULL;
+    size_t count = 0;
+    size_t i = 0;
+
+#if defined(FRUSTUM_AVX)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+        for (int p = 0; p < 6; p++) {
+            px[p] = _mm256_set1_ps(frustum.planes[p].x);
+            py[p] = _mm256_set1_ps(frustum.planes[p].y);
+            pz[p] = _mm256_set1_ps(frustum.planes[p].z);
+            pw[p] = _mm256_set1_ps(frustum.planes[p].w);
+            ax[p] = _mm256_andnot_ps(signMask, px[p]);
+            ay[p] = _mm256_andnot_ps(signMask, py[p]);
+            az[p] = _mm256_andnot_ps(signMask, pz[p]);
+        }
+        for (; i + 8 <= n; i += 8) {
+            __m256 sx = _mm256_loadu_ps(&bounds.sx[i]);
+            __m256 sy = _mm256_loadu_ps(&bounds.sy[i]);
+            __m256 sz = _mm256_loadu_ps(&bounds.sz[i]);
+            __m256 sr = _mm256_loadu_ps(&bounds.sr[i]);
+            __m256 cx = _mm256_loadu_ps(&bounds.cx[i]);
+            __m256 cy = _mm256_loadu_ps(&bounds.cy[i]);
+            __m256 cz = _mm256_loadu_ps(&bounds.cz[i]);
+            __m256 ex = _mm256_loadu_ps(&bounds.ex[i]);
+            __m256 ey = _mm256_loadu_ps(&bounds.ey[i]);
+            __m256 ez = _mm256_loadu_ps(&bounds.ez[i]);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                // sphere: dot(n, s) + d + r >= 0
+                __m256 ds = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], sx), _mm256_mul_ps(py[p], sy)),
+                                          _mm256_add_ps(_mm256_mul_ps(pz[p], sz), _mm256_add_ps(pw[p], sr)));
+                // box: dot(n, c) + d + dot(|n|, e) >= 0
+                __m256 dc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px[p], cx), _mm256_mul_ps(py[p], cy)),
+                                          _mm256_add_ps(_mm256_mul_ps(pz[p], cz), pw[p]));
+                __m256 rc = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[p], ex), _mm256_mul_ps(ay[p], ey)),
+                                          _mm256_mul_ps(az[p], ez));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(ds, _mm256_setzero_ps(), _CMP_GE_OQ));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(dc, rc), _mm256_setzero_ps(), _CMP_GE_OQ));
+            }
+            int mask = _mm256_movemask_ps(inside);
+            for (int k = 0; k < 8; k++) {
+                out[count] = (unsigned int)(i + k);
+                count += (mask >> k) & 1;
+            }
+        }
+    }
+#endif
+
+#if defined(FRUSTUM_SSE)
+    {
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 px[6], py[6], pz[6], pw[6], ax[6], ay[6], az[6];
+        for (int p = 0; p < 6; p++) {
+            px[p] = _mm_set1_ps(frustum.planes[p].x);
+            py[p] = _mm_set1_ps(frustum.planes[p].y);
+            pz[p] = _mm_set1_ps(frustum.planes[p].z);
+            pw[p] = _mm_set1_ps(frustum.planes[p].w);
+            ax[p] = _mm_andnot_ps(signMask, px[p]);
+            ay[p] = _mm_andnot_ps(signMask, py[p]);
+            az[p] = _mm_andnot_ps(signMask, pz[p]);
+        }
+        for (; i + 4 <= n; i += 4) {
+            __m128 sx = _mm_loadu_ps(&bounds.sx[i]);
+            __m128 sy = _mm_loadu_ps(&bounds.sy[i]);
+            __m128 sz = _mm_loadu_ps(&bounds.sz[i]);
+            __m128 sr = _mm_loadu_ps(&bounds.sr[i]);
+            __m128 cx = _mm_loadu_ps(&bounds.cx[i]);
+            __m128 cy = _mm_loadu_ps(&bounds.cy[i]);
+            __m128 cz = _mm_loadu_ps(&bounds.cz[i]);
+            __m128 ex = _mm_loadu_ps(&bounds.ex[i]);
+            __m128 ey = _mm_loadu_ps(&bounds.ey[i]);
+            __m128 ez = _mm_loadu_ps(&bounds.ez[i]);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m128 ds = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], sx), _mm_mul_ps(py[p], sy)),
+                                       _mm_add_ps(_mm_mul_ps(pz[p], sz), _mm_add_ps(pw[p], sr)));
+                __m128 dc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[p], cx), _mm_mul_ps(py[p], cy)),
+                                       _mm_add_ps(_mm_mul_ps(pz[p], cz), pw[p]));
+                __m128 rc = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+                                       _mm_mul_ps(az[p], ez));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(ds, _mm_setzero_ps()));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dc, rc), _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; k++) {
+                out[count] = (unsigned int)(i + k);
+                count += (mask >> k) & 1;
+            }
+        }
+    }
+#endif
+
+    // Remaining objects (or everything on targets without SIMD)
+    for (; i < n; i++) {
+        if (objectVisible(frustum, bounds, i))
+            out[count++] = (unsigned int)i;
+    }
+
+    out_visible.resize(count);
+    finishStats(stats, n, count, start);
+}
@@ -0,0 +1,76 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// Six clip planes (left, right, bottom, top, near, far) as (n.x, n.y, n.z, d),
+// normals pointing into the frustum
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// World space bounds of every object in structure-of-arrays layout so the
+// culling pass can test 4 (SSE) or 8 (AVX) objects per iteration.
+// Each object has a sphere (sx,sy,sz,sr) and a box (cx,cy,cz center, ex,ey,ez half extents).
+struct CullingBounds {
+    std::vector<float> sx, sy, sz, sr;
+    std::vector<float> cx, cy, cz;
+    std::vector<float> ex, ey, ez;
+
+    size_t size() const { return sr.size(); }
+    void clear();
+    void reserve(size_t n);
+    void push_back(const AABB & box, const BoundingSphere & sphere);
+    void set(size_t i, const AABB & box, const BoundingSphere & sphere);
+};
+
+struct CullStats {
+    unsigned int tested;
+    unsigned int visible;
+    unsigned int culled;
+    double milliseconds;
+};
+
+// Bounds of a vertex list, computed once at load time
+void computeBounds(
+    const std::vector<glm::vec3> & vertices,
+    AABB & out_box,
+    BoundingSphere & out_sphere
+);
+
+AABB transformAABB(const AABB & box, const glm::mat4 & M);
+BoundingSphere transformSphere(const BoundingSphere & sphere, const glm::mat4 & M);
+
+// Gribb/Hartmann plane extraction from ProjectionMatrix * ViewMatrix
+Frustum extractFrustumPlanes(const glm::mat4 & VP);
+
+// Fills out_visible with the indices of all objects intersecting the frustum.
+// Uses AVX or SSE when the compiler enables them, scalar code otherwise.
+void cullBounds(
+    const Frustum & frustum,
+    const CullingBounds & bounds,
+    std::vector<unsigned int> & out_visible,
+    CullStats * stats = NULL
+);
+
+// Reference implementation, one object at a time
+void cullBoundsScalar(
+    const Frustum & frustum,
+    const CullingBounds & bounds,
+    std::vector<unsigned int> & out_visible,
+    CullStats * stats = NULL
+);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+// Offscreen OpenGL core context that needs no window or display server.
+// Uses EGL (surfaceless Mesa, or any EGL driver with configless contexts);
+// rendering has to go to a framebuffer object.
+// Returns false when EGL support was not compiled in or no context could be made.
+bool createHeadlessContext(int major, int minor);
+void destroyHeadlessContext();
+
+#endif
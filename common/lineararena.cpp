@@ -0,0 +1,91 @@
+// Include standard headers
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include "lineararena.hpp"
+
+LinearArena::LinearArena(size_t chunkBytes) :
+    chunkBytes(chunkBytes), current(0), offset(0), used(0), allocations(0), peak(0) {
+}
+
+LinearArena::~LinearArena() {
+    release();
+}
+
+void * LinearArena::allocate(size_t bytes, size_t alignment) {
+    allocations++;
+    for (;;) {
+        if (current < chunks.size()) {
+            // Chunks come from operator new, aligned to at least 16
+            size_t start = (offset + alignment - 1) & ~(alignment - 1);
+            if (start + bytes <= chunks[current].size) {
+                used += start - offset + bytes;
+                peak = std::max(peak, used);
+                offset = start + bytes;
+                return chunks[current].data + start;
+            }
+            // The rest of this chunk stays unused until the next rewind
+            if (current + 1 < chunks.size() && chunks[current + 1].size >= bytes) {
+                used += chunks[current].size - offset;
+                current++;
+                offset = 0;
+                continue;
+            }
+        }
+        // A new chunk after the current one; smaller ones further on are kept for later
+        Chunk chunk;
+        chunk.size = std::max(chunkBytes, bytes);
+        chunk.data = (char *)::operator new(chunk.size);
+        if (chunks.empty()) {
+            chunks.push_back(chunk);
+            current = 0;
+        } else {
+            used += chunks[current].size - offset;
+            chunks.insert(chunks.begin() + current + 1, chunk);
+            current++;
+        }
+        offset = 0;
+    }
+}
+
+LinearArena::Mark LinearArena::mark() const {
+    Mark mark = { current, offset, used };
+    return mark;
+}
+
+void LinearArena::rewind(const Mark & mark) {
+    current = mark.chunk;
+    offset = mark.offset;
+    used = mark.used;
+}
+
+void LinearArena::reset() {
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+void LinearArena::release() {
+    for (size_t i = 0; i < chunks.size(); i++)
+        ::operator delete(chunks[i].data);
+    chunks.clear();
+    reset();
+}
+
+ArenaStats LinearArena::getStats() const {
+    ArenaStats stats;
+    stats.allocations = allocations;
+    stats.chunks = chunks.size();
+    stats.capacity = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+        stats.capacity += chunks[i].size;
+    stats.peak = peak;
+    return stats;
+}
+
+LinearArena & threadArena() {
+    static thread_local LinearArena arena;
+    return arena;
+}
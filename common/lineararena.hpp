@@ -0,0 +1,93 @@
+#ifndef LINEARARENA_HPP
+#define LINEARARENA_HPP
+
+#include <stddef.h>
+#include <vector>
+
+struct ArenaStats {
+    size_t allocations;     // allocate() calls
+    size_t chunks;          // chunks held, each one heap allocation
+    size_t capacity;        // bytes in them
+    size_t peak;            // most bytes in use at once
+};
+
+// Bump allocator for temporaries with a common lifetime, like the arrays of one file
+// being parsed. Memory comes from chunks of at least chunkBytes; nothing is freed one
+// by one, rewind() drops everything allocated after a mark at once and keeps the
+// chunks, so the next load reuses them without touching the heap.
+// One arena belongs to one thread.
+class LinearArena {
+public:
+    struct Mark {
+        size_t chunk, offset, used;
+    };
+
+    explicit LinearArena(size_t chunkBytes = 256 * 1024);
+    ~LinearArena();
+
+    // alignment is a power of two up to 16
+    void * allocate(size_t bytes, size_t alignment);
+
+    Mark mark() const;
+    void rewind(const Mark & mark);
+    // Rewinds to empty; release() also frees the chunks
+    void reset();
+    void release();
+
+    ArenaStats getStats() const;
+
+private:
+    LinearArena(const LinearArena &);
+    LinearArena & operator=(const LinearArena &);
+
+    struct Chunk {
+        char * data;
+        size_t size;
+    };
+    std::vector<Chunk> chunks;
+    size_t chunkBytes;
+    size_t current;         // chunk being filled
+    size_t offset;          // into it
+    size_t used;            // bytes in use, including alignment padding
+    size_t allocations;
+    size_t peak;
+};
+
+// Arena of the calling thread, for loaders called without one
+LinearArena & threadArena();
+
+// Rewinds an arena to where it was when the scope started
+class ArenaScope {
+public:
+    explicit ArenaScope(LinearArena & arena) : arena(arena), start(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(start); }
+private:
+    LinearArena & arena;
+    LinearArena::Mark start;
+};
+
+// Standard allocator on top of an arena. deallocate() does nothing, the memory comes
+// back when the arena is rewound, so containers using it must not outlive that.
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearArena * arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena) {}
+
+    T * allocate(size_t count) { return (T *)arena->allocate(count * sizeof(T), alignof(T)); }
+    void deallocate(T *, size_t) {}
+
+    LinearArena * arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena == b.arena; }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b) { return a.arena != b.arena; }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif
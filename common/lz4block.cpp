@@ -0,0 +1,153 @@
+// Include standard headers
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "lz4block.hpp"
+
+// Block rules: the last 5 bytes are literals and the last match starts at least 12
+// bytes before the end, so decoders may copy in 8 byte steps
+static const size_t MinMatch = 4;
+static const size_t LastLiterals = 5;
+static const size_t MatchLimit = 12;
+static const size_t MaxOffset = 65535;
+static const int HashBits = 16;
+
+static uint32_t read32(const unsigned char * p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static unsigned int hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+static unsigned char * writeLength(unsigned char * out, size_t length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// Literals from..to, then a match of length at offset unless length is 0
+static unsigned char * writeSequence(unsigned char * out, const unsigned char * from, const unsigned char * to,
+                                     size_t offset, size_t length) {
+    size_t literals = to - from;
+    unsigned char * token = out++;
+    *token = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+        out = writeLength(out, literals - 15);
+    memcpy(out, from, literals);
+    out += literals;
+    if (length) {
+        *out++ = (unsigned char)(offset & 0xff);
+        *out++ = (unsigned char)(offset >> 8);
+        length -= MinMatch;
+        *token |= (unsigned char)(length < 15 ? length : 15);
+        if (length >= 15)
+            out = writeLength(out, length - 15);
+    }
+    return out;
+}
+
+size_t lz4CompressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t lz4Compress(const unsigned char * src, size_t size, unsigned char * dst) {
+    unsigned char * out = dst;
+    size_t anchor = 0;
+    if (size > MatchLimit) {
+        // Positions + 1 by hash of the 4 bytes there, 0 for none
+        std::vector<uint32_t> table(1 << HashBits, 0);
+        size_t lastStart = size - MatchLimit, lastEnd = size - LastLiterals;
+        size_t pos = 0;
+        unsigned int misses = 0;
+        while (pos <= lastStart) {
+            uint32_t sequence = read32(src + pos);
+            unsigned int h = hash(sequence);
+            size_t candidate = table[h];
+            table[h] = (uint32_t)(pos + 1);
+            if (!candidate || pos - (candidate - 1) > MaxOffset || read32(src + candidate - 1) != sequence) {
+                // Incompressible runs are skipped faster the longer they get
+                pos += 1 + (misses++ >> 6);
+                continue;
+            }
+            size_t match = candidate - 1, length = MinMatch;
+            while (pos + length < lastEnd && src[match + length] == src[pos + length])
+                length++;
+            while (pos > anchor && match > 0 && src[pos - 1] == src[match - 1]) {
+                pos--;
+                match--;
+                length++;
+            }
+            out = writeSequence(out, src + anchor, src + pos, pos - match, length);
+            pos += length;
+            anchor = pos;
+            misses = 0;
+            if (pos - 2 <= lastStart)
+                table[hash(read32(src + pos - 2))] = (uint32_t)(pos - 1);
+        }
+    }
+    out = writeSequence(out, src + anchor, src + size, 0, 0);
+    return out - dst;
+}
+
+bool lz4Decompress(const unsigned char * src, size_t size, unsigned char * dst, size_t dstSize) {
+    size_t in = 0, out = 0;
+    while (in < size) {
+        unsigned int token = src[in++];
+        size_t literals = token >> 4;
+        if (literals == 15) {
+            unsigned char byte;
+            do {
+                if (in >= size)
+                    return false;
+                byte = src[in++];
+                literals += byte;
+            } while (byte == 255);
+        }
+        if (literals > size - in || literals > dstSize - out)
+            return false;
+        memcpy(dst + out, src + in, literals);
+        in += literals;
+        out += literals;
+        // The last sequence has no match
+        if (in == size)
+            break;
+
+        if (size - in < 2)
+            return false;
+        size_t offset = src[in] | (src[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+        size_t length = token & 15;
+        if (length == 15) {
+            unsigned char byte;
+            do {
+                if (in >= size)
+                    return false;
+                byte = src[in++];
+                length += byte;
+            } while (byte == 255);
+        }
+        length += MinMatch;
+        if (length > dstSize - out)
+            return false;
+        const unsigned char * from = dst + out - offset;
+        if (offset >= length) {
+            memcpy(dst + out, from, length);
+        } else {
+            // Overlapping: a run repeating the last offset bytes
+            for (size_t i = 0; i < length; i++)
+                dst[out + i] = from[i];
+        }
+        out += length;
+    }
+    return out == dstSize;
+}
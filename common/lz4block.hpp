@@ -0,0 +1,19 @@
+#ifndef LZ4BLOCK_HPP
+#define LZ4BLOCK_HPP
+
+#include <stddef.h>
+
+// The LZ4 block format, compatible with LZ4_compress_default and LZ4_decompress_safe:
+// sequences of literals and a back reference of at least 4 bytes up to 64 KB back.
+// One hash table probe per position, so it compresses a little worse than the
+// reference library but decodes the same and just as fast.
+
+// dst must hold this many bytes for any input of size bytes
+size_t lz4CompressBound(size_t size);
+// Returns the size of the block written to dst
+size_t lz4Compress(const unsigned char * src, size_t size, unsigned char * dst);
+// False unless src is a valid block that decodes to exactly dstSize bytes; never
+// reads or writes outside the two buffers
+bool lz4Decompress(const unsigned char * src, size_t size, unsigned char * dst, size_t dstSize);
+
+#endif
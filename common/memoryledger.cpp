@@ -0,0 +1,113 @@
+// Include standard headers
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+#include "memoryledger.hpp"
+
+const int MemoryLedger::Shared;
+
+MemoryLedger::MemoryLedger() {
+}
+
+unsigned int MemoryLedger::record(const char * kind, const std::string & name, int owner) {
+    std::string key = std::string(kind) + '\n' + name + '\n' + std::to_string(owner);
+    std::map<std::string, unsigned int>::iterator found = index.find(key);
+    if (found != index.end()) {
+        assets[found->second].instances++;
+        return found->second;
+    }
+    MemoryAsset asset = MemoryAsset();
+    asset.kind = kind;
+    asset.name = name;
+    asset.owner = owner;
+    asset.instances = 1;
+    assets.push_back(asset);
+    index[key] = (unsigned int)(assets.size() - 1);
+    return (unsigned int)(assets.size() - 1);
+}
+
+void MemoryLedger::allocateCPU(unsigned int asset, size_t bytes) {
+    MemoryAsset & a = assets[asset];
+    a.cpuBytes += bytes;
+    a.peakCpuBytes = std::max(a.peakCpuBytes, a.cpuBytes);
+}
+
+void MemoryLedger::releaseCPU(unsigned int asset, size_t bytes) {
+    MemoryAsset & a = assets[asset];
+    if (bytes > a.cpuBytes) {
+        a.overReleases++;
+        bytes = a.cpuBytes;
+    }
+    a.cpuBytes -= bytes;
+    a.releasedCpuBytes += bytes;
+}
+
+void MemoryLedger::allocateGPU(unsigned int asset, size_t bytes) {
+    MemoryAsset & a = assets[asset];
+    a.gpuBytes += bytes;
+    a.peakGpuBytes = std::max(a.peakGpuBytes, a.gpuBytes);
+}
+
+void MemoryLedger::releaseGPU(unsigned int asset, size_t bytes) {
+    MemoryAsset & a = assets[asset];
+    if (bytes > a.gpuBytes) {
+        a.overReleases++;
+        bytes = a.gpuBytes;
+    }
+    a.gpuBytes -= bytes;
+}
+
+size_t MemoryLedger::cpuBytes(const char * kind) const {
+    size_t total = 0;
+    for (size_t i = 0; i < assets.size(); i++)
+        if (!kind || assets[i].kind == kind)
+            total += assets[i].cpuBytes;
+    return total;
+}
+
+size_t MemoryLedger::gpuBytes(const char * kind) const {
+    size_t total = 0;
+    for (size_t i = 0; i < assets.size(); i++)
+        if (!kind || assets[i].kind == kind)
+            total += assets[i].gpuBytes;
+    return total;
+}
+
+size_t MemoryLedger::releasedCpuBytes(const char * kind) const {
+    size_t total = 0;
+    for (size_t i = 0; i < assets.size(); i++)
+        if (!kind || assets[i].kind == kind)
+            total += assets[i].releasedCpuBytes;
+    return total;
+}
+
+unsigned int MemoryLedger::overReleases() const {
+    unsigned int total = 0;
+    for (size_t i = 0; i < assets.size(); i++)
+        total += assets[i].overReleases;
+    return total;
+}
+
+void MemoryLedger::report(FILE * out) const {
+    std::vector<const MemoryAsset *> listed;
+    for (size_t i = 0; i < assets.size(); i++)
+        if (assets[i].cpuBytes || assets[i].gpuBytes || assets[i].overReleases)
+            listed.push_back(&assets[i]);
+    std::sort(listed.begin(), listed.end(), [](const MemoryAsset * a, const MemoryAsset * b) {
+        return a->cpuBytes + a->gpuBytes > b->cpuBytes + b->gpuBytes;
+    });
+    fprintf(out, "%-9s %-32s %6s %5s %10s %10s %10s\n", "kind", "asset", "model", "loads", "CPU KB", "GPU KB", "peak KB");
+    for (size_t i = 0; i < listed.size(); i++) {
+        const MemoryAsset & a = *listed[i];
+        std::string owner = a.owner == Shared ? "shared" : std::to_string(a.owner);
+        fprintf(out, "%-9s %-32s %6s %5u %10.1f %10.1f %10.1f", a.kind.c_str(), a.name.c_str(), owner.c_str(),
+                a.instances, a.cpuBytes / 1024.0, a.gpuBytes / 1024.0, (a.peakCpuBytes + a.peakGpuBytes) / 1024.0);
+        if (a.overReleases)
+            fprintf(out, "  released %u times more than held", a.overReleases);
+        fprintf(out, "\n");
+    }
+    fprintf(out, "%-9s %-32s %6s %5s %10.1f %10.1f\n", "total", "", "", "", cpuBytes() / 1024.0, gpuBytes() / 1024.0);
+}
@@ -0,0 +1,65 @@
+#ifndef MEMORYLEDGER_HPP
+#define MEMORYLEDGER_HPP
+
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <map>
+
+// Memory of one asset, by the file it came from and the model holding it
+struct MemoryAsset {
+    std::string kind;       // "mesh", "texture", "pick BVH", ...
+    std::string name;
+    int owner;              // model index, MemoryLedger::Shared for assets models share
+    unsigned int instances; // loads recorded for this owner, 1 unless it loaded twice
+    size_t cpuBytes;        // resident now
+    size_t gpuBytes;
+    size_t peakCpuBytes;    // highest since the first load
+    size_t peakGpuBytes;
+    size_t releasedCpuBytes;
+    unsigned int overReleases;  // releases of more than was held, e.g. double frees
+};
+
+// Bytes each mesh and texture holds on the CPU and on the GPU. Loaders record what they
+// allocate and release under the asset's kind, name and owning model, and the report
+// lists what is resident, so hosts can be sized from a scene and a model whose assets
+// outlive their cleanup, or are released twice, shows up.
+// Not thread safe; assets are loaded and released on the main thread.
+class MemoryLedger {
+public:
+    static const int Shared = -1;
+
+    MemoryLedger();
+
+    // Entry for kind, name and owner, created on first use; every call counts one instance
+    unsigned int record(const char * kind, const std::string & name, int owner = Shared);
+
+    void allocateCPU(unsigned int asset, size_t bytes);
+    void releaseCPU(unsigned int asset, size_t bytes);
+    void allocateGPU(unsigned int asset, size_t bytes);
+    void releaseGPU(unsigned int asset, size_t bytes);
+
+    // Of the assets of one kind, or of all with NULL
+    size_t cpuBytes(const char * kind = NULL) const;
+    size_t gpuBytes(const char * kind = NULL) const;
+    // CPU bytes released so far, e.g. geometry dropped after its upload
+    size_t releasedCpuBytes(const char * kind = NULL) const;
+    unsigned int overReleases() const;
+    const std::vector<MemoryAsset> & getAssets() const { return assets; }
+
+    // One line per asset with resident memory or an over-release, largest first, then
+    // the totals. The peak column adds the CPU and GPU peaks.
+    void report(FILE * out) const;
+
+private:
+    std::vector<MemoryAsset> assets;
+    std::map<std::string, unsigned int> index;  // by kind, name and owner
+};
+
+// Bytes of a vector's storage
+template <typename T>
+size_t vectorBytes(const std::vector<T> & v) {
+    return v.capacity() * sizeof(T);
+}
+
+#endif
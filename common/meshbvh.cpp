@@ -0,0 +1,387 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <string.h>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define MESHBVH_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHBVH_SSE 1
+#endif
+
+#include "meshbvh.hpp"
+
+static const int NumBins = 16;
+static const int LeafSize = 8;
+// Past this depth only median splits are made, which bounds the traversal stack
+static const int MaxSAHDepth = 48;
+static const int StackSize = 128;
+static const float DetEpsilon = 1e-12f;
+
+struct MeshBVH::BuildContext {
+    const std::vector<glm::vec3> * vertices;
+    std::vector<AABB> boxes;
+    std::vector<glm::vec3> centroids;
+    std::vector<unsigned int> order;
+};
+
+static inline AABB emptyBox() {
+    AABB b;
+    b.min = glm::vec3(FLT_MAX);
+    b.max = glm::vec3(-FLT_MAX);
+    return b;
+}
+
+static inline void grow(AABB & b, const AABB & o) {
+    b.min = glm::min(b.min, o.min);
+    b.max = glm::max(b.max, o.max);
+}
+
+static inline float surfaceArea(const AABB & b) {
+    glm::vec3 d = glm::max(b.max - b.min, glm::vec3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// Slab test, returns the entry distance or FLT_MAX on a miss
+static inline float intersectRayBox(const AABB & b, const glm::vec3 & origin, const glm::vec3 & invDir, float tmax) {
+    glm::vec3 t0 = (b.min - origin) * invDir;
+    glm::vec3 t1 = (b.max - origin) * invDir;
+    glm::vec3 tsmall = glm::min(t0, t1);
+    glm::vec3 tbig = glm::max(t0, t1);
+    float tnear = std::max(std::max(tsmall.x, tsmall.y), std::max(tsmall.z, 0.0f));
+    float tfar = std::min(std::min(tbig.x, tbig.y), std::min(tbig.z, tmax));
+    return tnear <= tfar ? tnear : FLT_MAX;
+}
+
+static inline glm::vec3 safeInverse(const glm::vec3 & d) {
+    // Avoid NaNs from 0 * inf in the slab test for axis aligned rays
+    glm::vec3 inv;
+    for (int i = 0; i < 3; i++)
+        inv[i] = 1.0f / (std::fabs(d[i]) > 1e-20f ? d[i] : (d[i] < 0.0f ? -1e-20f : 1e-20f));
+    return inv;
+}
+
+// Moller-Trumbore for one triangle, the reference for the SIMD block tests
+static inline bool intersectTriangle(const glm::vec3 & v0, const glm::vec3 & e1, const glm::vec3 & e2,
+                                     const glm::vec3 & origin, const glm::vec3 & direction,
+                                     float & t, float & u, float & v) {
+    glm::vec3 p = glm::cross(direction, e2);
+    float det = glm::dot(e1, p);
+    if (std::fabs(det) <= DetEpsilon)
+        return false;
+    float invDet = 1.0f / det;
+    glm::vec3 s = origin - v0;
+    u = glm::dot(s, p) * invDet;
+    glm::vec3 q = glm::cross(s, e1);
+    v = glm::dot(direction, q) * invDet;
+    t = glm::dot(e2, q) * invDet;
+    return u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= 0.0f;
+}
+
+bool intersectTriangles(const std::vector<glm::vec3> & vertices, const glm::vec3 & origin, const glm::vec3 & direction,
+                        float tmax, MeshHit & hit) {
+    bool found = false;
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        float t, u, v;
+        if (intersectTriangle(vertices[i], vertices[i + 1] - vertices[i], vertices[i + 2] - vertices[i], origin, direction, t, u, v) &&
+            t < tmax) {
+            tmax = t;
+            hit.t = t;
+            hit.triangle = (unsigned int)(i / 3);
+            hit.u = u;
+            hit.v = v;
+            found = true;
+        }
+    }
+    return found;
+}
+
+MeshBVH::MeshBVH() : triangles(0) {
+}
+
+void MeshBVH::build(const std::vector<glm::vec3> & vertices) {
+    int n = (int)(vertices.size() / 3);
+    triangles = n;
+    nodes.clear();
+    blocks.clear();
+    if (n == 0)
+        return;
+
+    BuildContext ctx;
+    ctx.vertices = &vertices;
+    ctx.boxes.resize(n);
+    ctx.centroids.resize(n);
+    ctx.order.resize(n);
+    for (int i = 0; i < n; i++) {
+        const glm::vec3 & a = vertices[3 * i], & b = vertices[3 * i + 1], & c = vertices[3 * i + 2];
+        ctx.boxes[i].min = glm::min(a, glm::min(b, c));
+        ctx.boxes[i].max = glm::max(a, glm::max(b, c));
+        ctx.centroids[i] = 0.5f * (ctx.boxes[i].min + ctx.boxes[i].max);
+        ctx.order[i] = i;
+    }
+
+    nodes.reserve(2 * ((n + LeafSize - 1) / LeafSize));
+    blocks.reserve((n + LeafSize - 1) / LeafSize * 2);
+    nodes.push_back(Node());
+    buildRange(ctx, 0, 0, n, 0);
+}
+
+void MeshBVH::buildRange(BuildContext & ctx, int node, int begin, int end, int depth) {
+    int count = end - begin;
+
+    AABB box = emptyBox();
+    AABB centroidBox = emptyBox();
+    for (int i = begin; i < end; i++) {
+        unsigned int p = ctx.order[i];
+        grow(box, ctx.boxes[p]);
+        centroidBox.min = glm::min(centroidBox.min, ctx.centroids[p]);
+        centroidBox.max = glm::max(centroidBox.max, ctx.centroids[p]);
+    }
+    nodes[node].bounds = box;
+
+    // A full block costs the same to test as a partly filled one, so never split below it
+    if (count <= LeafSize) {
+        TriangleBlock block;
+        memset(&block, 0, sizeof(block));
+        for (int k = 0; k < count; k++) {
+            unsigned int p = ctx.order[begin + k];
+            const glm::vec3 & v0 = (*ctx.vertices)[3 * p];
+            glm::vec3 e1 = (*ctx.vertices)[3 * p + 1] - v0;
+            glm::vec3 e2 = (*ctx.vertices)[3 * p + 2] - v0;
+            block.v0x[k] = v0.x; block.v0y[k] = v0.y; block.v0z[k] = v0.z;
+            block.e1x[k] = e1.x; block.e1y[k] = e1.y; block.e1z[k] = e1.z;
+            block.e2x[k] = e2.x; block.e2y[k] = e2.y; block.e2z[k] = e2.z;
+            block.triangle[k] = p;
+        }
+        nodes[node].first = (int)blocks.size();
+        nodes[node].leaf = 1;
+        blocks.push_back(block);
+        return;
+    }
+
+    // Split along the axis with the largest centroid spread
+    glm::vec3 extent = centroidBox.max - centroidBox.min;
+    int axis = 0;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int mid = begin;
+    if (extent[axis] > 0.0f && depth < MaxSAHDepth) {
+        // Binned SAH
+        int binCount[NumBins] = {0};
+        AABB binBox[NumBins];
+        for (int b = 0; b < NumBins; b++)
+            binBox[b] = emptyBox();
+
+        float lo = centroidBox.min[axis];
+        float scale = NumBins * (1.0f - 1e-5f) / extent[axis];
+        for (int i = begin; i < end; i++) {
+            unsigned int p = ctx.order[i];
+            int b = (int)((ctx.centroids[p][axis] - lo) * scale);
+            binCount[b]++;
+            grow(binBox[b], ctx.boxes[p]);
+        }
+
+        // Sweep from the right to get suffix areas, then from the left for the costs.
+        // Leaves are tested a block at a time, so counts are rounded up to whole blocks.
+        float rightArea[NumBins];
+        int rightCount[NumBins];
+        AABB acc = emptyBox();
+        int accCount = 0;
+        for (int b = NumBins - 1; b > 0; b--) {
+            grow(acc, binBox[b]);
+            accCount += binCount[b];
+            rightArea[b] = surfaceArea(acc);
+            rightCount[b] = accCount;
+        }
+
+        float bestCost = FLT_MAX;
+        int bestSplit = -1;
+        acc = emptyBox();
+        accCount = 0;
+        for (int b = 1; b < NumBins; b++) {
+            grow(acc, binBox[b - 1]);
+            accCount += binCount[b - 1];
+            if (accCount == 0 || rightCount[b] == 0)
+                continue;
+            float cost = surfaceArea(acc) * ((accCount + LeafSize - 1) / LeafSize) +
+                         rightArea[b] * ((rightCount[b] + LeafSize - 1) / LeafSize);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        if (bestSplit > 0) {
+            unsigned int * first = &ctx.order[0] + begin;
+            unsigned int * last = &ctx.order[0] + end;
+            const std::vector<glm::vec3> & c = ctx.centroids;
+            mid = (int)(std::partition(first, last, [&](unsigned int p) {
+                return (int)((c[p][axis] - lo) * scale) < bestSplit;
+            }) - &ctx.order[0]);
+        }
+    }
+
+    // All centroids coincide or the partition degenerated: fall back to a median split
+    if (mid == begin || mid == end) {
+        mid = begin + count / 2;
+        const std::vector<glm::vec3> & c = ctx.centroids;
+        std::nth_element(&ctx.order[0] + begin, &ctx.order[0] + mid, &ctx.order[0] + end,
+                         [&](unsigned int a, unsigned int b) { return c[a][axis] < c[b][axis]; });
+    }
+
+    int children = (int)nodes.size();
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    nodes[node].first = children;
+    nodes[node].leaf = 0;
+    buildRange(ctx, children, begin, mid, depth + 1);
+    buildRange(ctx, children + 1, mid, end, depth + 1);
+}
+
+bool MeshBVH::intersectBlock(const TriangleBlock & block, const glm::vec3 & origin, const glm::vec3 & direction,
+                             float tmax, MeshHit & hit) const {
+    float t[8], u[8], v[8];
+    int mask = 0;
+
+#if defined(MESHBVH_AVX)
+    {
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        __m256 dx = _mm256_set1_ps(direction.x), dy = _mm256_set1_ps(direction.y), dz = _mm256_set1_ps(direction.z);
+        __m256 e1x = _mm256_loadu_ps(block.e1x), e1y = _mm256_loadu_ps(block.e1y), e1z = _mm256_loadu_ps(block.e1z);
+        __m256 e2x = _mm256_loadu_ps(block.e2x), e2y = _mm256_loadu_ps(block.e2y), e2z = _mm256_loadu_ps(block.e2z);
+        // p = d x e2, det = e1 . p
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+        __m256 valid = _mm256_cmp_ps(_mm256_andnot_ps(signMask, det), _mm256_set1_ps(DetEpsilon), _CMP_GT_OQ);
+        __m256 invDet = _mm256_div_ps(one, det);
+        // s = o - v0, u = (s . p) / det
+        __m256 sx = _mm256_sub_ps(_mm256_set1_ps(origin.x), _mm256_loadu_ps(block.v0x));
+        __m256 sy = _mm256_sub_ps(_mm256_set1_ps(origin.y), _mm256_loadu_ps(block.v0y));
+        __m256 sz = _mm256_sub_ps(_mm256_set1_ps(origin.z), _mm256_loadu_ps(block.v0z));
+        __m256 uu = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), invDet);
+        // q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        __m256 vv = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), invDet);
+        __m256 tt = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), invDet);
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(uu, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(vv, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(uu, vv), one, _CMP_LE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, zero, _CMP_GE_OQ));
+        valid = _mm256_and_ps(valid, _mm256_cmp_ps(tt, _mm256_set1_ps(tmax), _CMP_LT_OQ));
+        mask = _mm256_movemask_ps(valid);
+        _mm256_storeu_ps(t, tt);
+        _mm256_storeu_ps(u, uu);
+        _mm256_storeu_ps(v, vv);
+    }
+#elif defined(MESHBVH_SSE)
+    {
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+        __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+        __m128 limit = _mm_set1_ps(tmax), epsilon = _mm_set1_ps(DetEpsilon);
+        for (int half = 0; half < 8; half += 4) {
+            __m128 e1x = _mm_loadu_ps(block.e1x + half), e1y = _mm_loadu_ps(block.e1y + half), e1z = _mm_loadu_ps(block.e1z + half);
+            __m128 e2x = _mm_loadu_ps(block.e2x + half), e2y = _mm_loadu_ps(block.e2y + half), e2z = _mm_loadu_ps(block.e2z + half);
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+            __m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(signMask, det), epsilon);
+            __m128 invDet = _mm_div_ps(one, det);
+            __m128 sx = _mm_sub_ps(ox, _mm_loadu_ps(block.v0x + half));
+            __m128 sy = _mm_sub_ps(oy, _mm_loadu_ps(block.v0y + half));
+            __m128 sz = _mm_sub_ps(oz, _mm_loadu_ps(block.v0z + half));
+            __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invDet);
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), invDet);
+            __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), invDet);
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(uu, zero));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(vv, zero));
+            valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(uu, vv), one));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(tt, zero));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(tt, limit));
+            mask |= _mm_movemask_ps(valid) << half;
+            _mm_storeu_ps(t + half, tt);
+            _mm_storeu_ps(u + half, uu);
+            _mm_storeu_ps(v + half, vv);
+        }
+    }
+#else
+    for (int k = 0; k < 8; k++) {
+        glm::vec3 v0(block.v0x[k], block.v0y[k], block.v0z[k]);
+        glm::vec3 e1(block.e1x[k], block.e1y[k], block.e1z[k]);
+        glm::vec3 e2(block.e2x[k], block.e2y[k], block.e2z[k]);
+        if (intersectTriangle(v0, e1, e2, origin, direction, t[k], u[k], v[k]) && t[k] < tmax)
+            mask |= 1 << k;
+    }
+#endif
+
+    if (!mask)
+        return false;
+    int best = -1;
+    for (int k = 0; k < 8; k++) {
+        if ((mask >> k) & 1 && (best < 0 || t[k] < t[best]))
+            best = k;
+    }
+    hit.t = t[best];
+    hit.triangle = block.triangle[best];
+    hit.u = u[best];
+    hit.v = v[best];
+    return true;
+}
+
+bool MeshBVH::intersect(const glm::vec3 & origin, const glm::vec3 & direction, float tmax, MeshHit & hit) const {
+    if (nodes.empty())
+        return false;
+
+    glm::vec3 invDir = safeInverse(direction);
+    bool found = false;
+    float best = tmax;
+    int stack[StackSize];
+    float stackT[StackSize];
+    int top = 0;
+    float t = intersectRayBox(nodes[0].bounds, origin, invDir, best);
+    if (t != FLT_MAX) {
+        stack[top] = 0; stackT[top] = t; top++;
+    }
+    while (top > 0) {
+        top--;
+        if (stackT[top] >= best)
+            continue;
+        const Node & node = nodes[stack[top]];
+        if (node.leaf) {
+            if (intersectBlock(blocks[node.first], origin, direction, best, hit)) {
+                best = hit.t;
+                found = true;
+            }
+        } else {
+            // Push the far child first so the near one is visited next
+            int a = node.first, b = node.first + 1;
+            float ta = intersectRayBox(nodes[a].bounds, origin, invDir, best);
+            float tb = intersectRayBox(nodes[b].bounds, origin, invDir, best);
+            if (ta > tb) {
+                std::swap(a, b);
+                std::swap(ta, tb);
+            }
+            if (tb != FLT_MAX) { stack[top] = b; stackT[top] = tb; top++; }
+            if (ta != FLT_MAX) { stack[top] = a; stackT[top] = ta; top++; }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,63 @@
+#ifndef MESHBVH_HPP
+#define MESHBVH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+struct MeshHit {
+    float t;                // along the query direction, in its units
+    unsigned int triangle;  // index into the triangle list the BVH was built from
+    float u, v;             // barycentrics of vertices 1 and 2, vertex 0 has 1 - u - v
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, for ray queries.
+// Built once with binned SAH. Every leaf holds up to 8 triangles in one SoA block
+// (vertex 0 and both edges), so a leaf is a single 8-wide (AVX) or two 4-wide (SSE)
+// Moller-Trumbore tests.
+class MeshBVH {
+public:
+    MeshBVH();
+
+    // Non-indexed triangle list, as returned by loadOBJ
+    void build(const std::vector<glm::vec3> & vertices);
+
+    // Closest triangle hit with t in [0, tmax). The direction does not have to be
+    // normalized, so a ray transformed into model space keeps its world space t.
+    bool intersect(const glm::vec3 & origin, const glm::vec3 & direction, float tmax, MeshHit & hit) const;
+
+    size_t triangleCount() const { return triangles; }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t memoryBytes() const { return nodes.size() * sizeof(Node) + blocks.size() * sizeof(TriangleBlock); }
+    const AABB & getBounds() const { return nodes[0].bounds; }
+
+private:
+    struct Node {
+        AABB bounds;
+        int first;  // first child (children are stored as a pair) or block for leaves
+        int leaf;   // 1 for leaves
+    };
+    // Unused lanes have zero edges, which never hit
+    struct TriangleBlock {
+        float v0x[8], v0y[8], v0z[8];
+        float e1x[8], e1y[8], e1z[8];
+        float e2x[8], e2y[8], e2z[8];
+        unsigned int triangle[8];
+    };
+    struct BuildContext;
+
+    void buildRange(BuildContext & ctx, int node, int begin, int end, int depth);
+    bool intersectBlock(const TriangleBlock & block, const glm::vec3 & origin, const glm::vec3 & direction,
+                        float tmax, MeshHit & hit) const;
+
+    std::vector<Node> nodes;
+    std::vector<TriangleBlock> blocks;
+    size_t triangles;
+};
+
+// Reference: tests every triangle of the list, one at a time
+bool intersectTriangles(const std::vector<glm::vec3> & vertices, const glm::vec3 & origin, const glm::vec3 & direction,
+                        float tmax, MeshHit & hit);
+
+#endif
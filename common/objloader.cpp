@@ -3,9 +3,11 @@
 #include <string>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
 #include <glm/glm.hpp>
 
 #include "objloader.hpp"
+#include "lineararena.hpp"
 
 
 // Very, VERY simple OBJ loader.
@@ -19,6 +21,16 @@
 // - Loading from memory, stream, etc
 
 
+// Body of loadOBJ_indexed_modified for any vector type, loadOBJ parses into arena vectors
+template <typename Vec3Array, typename Vec2Array, typename IVec3Array>
+static bool parseOBJ_modified(const char * path,
+                              Vec3Array & vertices,
+                              Vec2Array & uvs,
+                              Vec3Array & normals,
+                              IVec3Array & vertexIndices,
+                              IVec3Array & uvIndices,
+                              IVec3Array & normalIndices);
+
 bool getNextLine(FILE* file, char* line) {
     char word[128];
     while( 1 ) {
@@ -94,23 +106,36 @@ bool loadModels(const char* path, std::vector<Model>& out_models) {
 // load an .obj file:
 // - first read raw data from the file with loadOBJ_indexed
 // - then unroll the indices and return full lists of vertices, uvs, and normals
+// The raw data lives in the arena (the calling thread's one without) only during the call
 //
 bool loadOBJ(
              const char * path,
              std::vector<glm::vec3> & out_vertices,
              std::vector<glm::vec2> & out_uvs,
-             std::vector<glm::vec3> & out_normals
+             std::vector<glm::vec3> & out_normals,
+             LinearArena * arena
              ){
 	printf("Loading OBJ file %s...\n", path);
     
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
-    std::vector<glm::ivec3> temp_vertexIndices;
-    std::vector<glm::ivec3> temp_uvIndices;
-    std::vector<glm::ivec3> temp_normalIndices;
+    LinearArena & temporaries = arena ? *arena : threadArena();
+    ArenaScope scope(temporaries);
+	ArenaVector<glm::vec3> temp_vertices((ArenaAllocator<glm::vec3>(&temporaries)));
+	ArenaVector<glm::vec2> temp_uvs((ArenaAllocator<glm::vec2>(&temporaries)));
+	ArenaVector<glm::vec3> temp_normals((ArenaAllocator<glm::vec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_vertexIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_uvIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_normalIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+    
+    if (!parseOBJ_modified(path, temp_vertices, temp_uvs, temp_normals, temp_vertexIndices, temp_uvIndices, temp_normalIndices))
+        return false;
     
-    loadOBJ_indexed_modified(path, temp_vertices, temp_uvs, temp_normals, temp_vertexIndices, temp_uvIndices, temp_normalIndices);
+    // Every output gets three entries per triangle, allocated once
+    size_t count = temp_vertexIndices.size() * 3;
+    out_vertices.reserve(out_vertices.size() + count);
+    if (temp_uvs.size() > 0)
+        out_uvs.reserve(out_uvs.size() + count);
+    if (temp_normals.size() > 0)
+        out_normals.reserve(out_normals.size() + count);
     
     // Unroll indices and return expanded buffers of vertex positions, uvs, and normals
 	// For each vertex of each triangle
@@ -143,6 +168,59 @@ bool loadOBJ(
 	return true;
 }
 
+//
+// read only what loadOBJ would return about an .obj file: the number of vertices, which
+// attributes it has and the bounds of its triangles, without unrolling anything
+//
+bool loadOBJ_bounds(
+                    const char * path,
+                    MeshBounds & out_bounds,
+                    LinearArena * arena
+                    ){
+	printf("Loading OBJ bounds %s...\n", path);
+
+    LinearArena & temporaries = arena ? *arena : threadArena();
+    ArenaScope scope(temporaries);
+	ArenaVector<glm::vec3> temp_vertices((ArenaAllocator<glm::vec3>(&temporaries)));
+	ArenaVector<glm::vec2> temp_uvs((ArenaAllocator<glm::vec2>(&temporaries)));
+	ArenaVector<glm::vec3> temp_normals((ArenaAllocator<glm::vec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_vertexIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_uvIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+    ArenaVector<glm::ivec3> temp_normalIndices((ArenaAllocator<glm::ivec3>(&temporaries)));
+
+    if (!parseOBJ_modified(path, temp_vertices, temp_uvs, temp_normals, temp_vertexIndices, temp_uvIndices, temp_normalIndices))
+        return false;
+
+    out_bounds.vertices = temp_vertexIndices.size() * 3;
+    out_bounds.uvs = temp_uvs.size() > 0;
+    out_bounds.normals = temp_normals.size() > 0;
+
+    // Only positions used by a triangle count, as in the unrolled vertices; the sphere is
+    // centered on the box like computeBounds makes it
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (!temp_vertexIndices.empty())
+        lo = hi = temp_vertices[ temp_vertexIndices[0][0] ];
+    for (size_t vi = 0; vi < temp_vertexIndices.size(); vi++){
+        for (unsigned int i = 0; i < 3; i++){
+            glm::vec3 vertex = temp_vertices[ temp_vertexIndices[vi][i] ];
+            lo = glm::min(lo, vertex);
+            hi = glm::max(hi, vertex);
+        }
+    }
+    glm::vec3 center = 0.5f * (lo + hi);
+    float r2 = 0.0f;
+    for (size_t vi = 0; vi < temp_vertexIndices.size(); vi++){
+        for (unsigned int i = 0; i < 3; i++){
+            glm::vec3 d = temp_vertices[ temp_vertexIndices[vi][i] ] - center;
+            r2 = std::max(r2, glm::dot(d, d));
+        }
+    }
+    out_bounds.min = lo;
+    out_bounds.max = hi;
+    out_bounds.radius = std::sqrt(r2);
+	return true;
+}
+
 //
 // load an .obj file with indices:
 // - read vertices, uvs, normals, and associated indices from a .obj file
@@ -264,15 +342,74 @@ bool loadOBJ_indexed_modified(const char * path,
                      std::vector<glm::ivec3> & uvIndices,
                      std::vector<glm::ivec3> & normalIndices
                      ){
+    return parseOBJ_modified(path, vertices, uvs, normals, vertexIndices, uvIndices, normalIndices);
+}
+
+// Elements of an .obj file, from a quick pass over its lines
+struct OBJCounts {
+    size_t vertices, uvs, normals;
+    size_t triangles;   // quads count twice
+};
+
+static OBJCounts countOBJ(FILE * file){
+    OBJCounts counts = OBJCounts();
+    char line[1024];
+    while (fgets(line, sizeof(line), file)){
+        const char * c = line;
+        while (*c == ' ' || *c == '\t')
+            c++;
+        if (c[0] == 'v' && c[1] == ' ')
+            counts.vertices++;
+        else if (c[0] == 'v' && c[1] == 't')
+            counts.uvs++;
+        else if (c[0] == 'v' && c[1] == 'n')
+            counts.normals++;
+        else if (c[0] == 'f' && c[1] == ' '){
+            int corners = 0;
+            for (c++; *c; ){
+                while (*c == ' ' || *c == '\t')
+                    c++;
+                if (!*c || *c == '\n' || *c == '\r')
+                    break;
+                corners++;
+                while (*c && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r')
+                    c++;
+            }
+            counts.triangles += corners == 4 ? 2 : 1;
+        }
+    }
+    return counts;
+}
+
+template <typename Vec3Array, typename Vec2Array, typename IVec3Array>
+static bool parseOBJ_modified(const char * path,
+                              Vec3Array & vertices,
+                              Vec2Array & uvs,
+                              Vec3Array & normals,
+                              IVec3Array & vertexIndices,
+                              IVec3Array & uvIndices,
+                              IVec3Array & normalIndices
+                              ){
     printf("Loading OBJ file indexed %s...\n", path);
 
     FILE * file = fopen(path, "r");
     if( file == NULL ){
         printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-        getchar();
         return false;
     }   
 
+    // Count first, so every array is allocated once at its final size
+    OBJCounts counts = countOBJ(file);
+    vertices.reserve(vertices.size() + counts.vertices);
+    uvs.reserve(uvs.size() + counts.uvs);
+    normals.reserve(normals.size() + counts.normals);
+    vertexIndices.reserve(vertexIndices.size() + counts.triangles);
+    if (counts.uvs > 0)
+        uvIndices.reserve(uvIndices.size() + counts.triangles);
+    if (counts.normals > 0)
+        normalIndices.reserve(normalIndices.size() + counts.triangles);
+    rewind(file);
+
     int vCnt = 0;
     int uvCnt = 0;
     int nrmlCnt = 0;
@@ -327,6 +464,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 12){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }else{
@@ -334,6 +472,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 9){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }
@@ -344,6 +483,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 8){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }else{
@@ -351,6 +491,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 6){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
 
                     }
@@ -362,6 +503,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 8){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                     }else{
@@ -369,6 +511,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 6){
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }
@@ -379,6 +522,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 4) {
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }else{
@@ -386,6 +530,7 @@ bool loadOBJ_indexed_modified(const char * path,
                     if (matches != 3) {
                         printf("LoadOBJ parser failed.\n");
                         printf("%s",faceLine);
+                        fclose(file);
                         return false;
                     }
                 }
@@ -417,6 +562,7 @@ bool loadOBJ_indexed_modified(const char * path,
             fgets(stupidBuffer, 1000, file);
         }
     }
+    fclose(file);
     return true;
 }
                                              
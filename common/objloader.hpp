@@ -2,6 +2,8 @@
 #define OBJLOADER_H
 #include <string>
 
+class LinearArena;
+
 struct Model {
     // model files
     std::string objFilename;
@@ -28,11 +30,29 @@ bool loadModels(
 );
 
 
+// The parser's temporaries come from arena, or the calling thread's arena when NULL,
+// and are gone when it returns
 bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
 	std::vector<glm::vec2> & out_uvs, 
-	std::vector<glm::vec3> & out_normals
+	std::vector<glm::vec3> & out_normals,
+	LinearArena * arena = NULL
+);
+
+// What loadOBJ would return about a mesh, without its geometry
+struct MeshBounds {
+    size_t vertices;            // three per triangle
+    bool uvs, normals;          // one per vertex when set
+    glm::vec3 min, max;         // box of the vertices
+    float radius;               // of the sphere around the box center
+};
+
+// Parses path like loadOBJ but keeps only its bounds, for meshes not loaded yet
+bool loadOBJ_bounds(
+	const char * path,
+	MeshBounds & out_bounds,
+	LinearArena * arena = NULL
 );
 
 bool loadOBJ_indexed(
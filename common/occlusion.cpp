@@ -0,0 +1,261 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE 1
+#endif
+
+#include "occlusion.hpp"
+
+static const int TileSize = 8;
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+OcclusionCuller::OcclusionCuller(int w, int h) {
+    // Rows are processed 4 pixels at a time and in whole tiles
+    width = (w + TileSize - 1) / TileSize * TileSize;
+    height = (h + TileSize - 1) / TileSize * TileSize;
+    tilesX = width / TileSize;
+    tilesY = height / TileSize;
+    depth.assign(width * height, 0.0f);
+    tileMin.assign(tilesX * tilesY, 0.0f);
+    viewProjection = glm::mat4(1.0f);
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 & VP) {
+    viewProjection = VP;
+    triangles.clear();
+    std::fill(depth.begin(), depth.end(), 0.0f);
+    std::fill(tileMin.begin(), tileMin.end(), 0.0f);
+    stats = OcclusionStats();
+}
+
+void OcclusionCuller::addClipTriangle(const glm::vec4 & c0, const glm::vec4 & c1, const glm::vec4 & c2) {
+    ScreenTriangle t;
+    const glm::vec4 * c[3] = { &c0, &c1, &c2 };
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / c[i]->w;
+        t.v[i] = glm::vec2((c[i]->x * invW * 0.5f + 0.5f) * width,
+                           (c[i]->y * invW * 0.5f + 0.5f) * height);
+        t.iz[i] = invW;
+    }
+
+    // Orient counter clockwise so inside means all edge functions positive
+    float area = (t.v[1].x - t.v[0].x) * (t.v[2].y - t.v[0].y) - (t.v[2].x - t.v[0].x) * (t.v[1].y - t.v[0].y);
+    if (area == 0.0f || area != area)
+        return;
+    if (area < 0.0f) {
+        std::swap(t.v[1], t.v[2]);
+        std::swap(t.iz[1], t.iz[2]);
+    }
+
+    glm::vec2 lo = glm::min(t.v[0], glm::min(t.v[1], t.v[2]));
+    glm::vec2 hi = glm::max(t.v[0], glm::max(t.v[1], t.v[2]));
+    t.minX = std::max(0, (int)std::floor(lo.x));
+    t.minY = std::max(0, (int)std::floor(lo.y));
+    t.maxX = std::min(width - 1, (int)std::ceil(hi.x));
+    t.maxY = std::min(height - 1, (int)std::ceil(hi.y));
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+    triangles.push_back(t);
+}
+
+void OcclusionCuller::addOccluder(const std::vector<glm::vec3> & vertices, const glm::mat4 & M) {
+    addOccluderMVP(vertices, viewProjection * M);
+}
+
+void OcclusionCuller::addOccluderMVP(const std::vector<glm::vec3> & vertices, const glm::mat4 & MVP) {
+    stats.occluders++;
+    for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        glm::vec4 c[3];
+        for (int k = 0; k < 3; k++)
+            c[k] = MVP * glm::vec4(vertices[i + k], 1.0f);
+        stats.occluderTriangles++;
+
+        // Clip against the near plane (z = -w); at most one extra triangle comes out
+        float d[3];
+        int inside = 0;
+        for (int k = 0; k < 3; k++) {
+            d[k] = c[k].z + c[k].w;
+            inside += d[k] >= 0.0f;
+        }
+        if (inside == 3) {
+            addClipTriangle(c[0], c[1], c[2]);
+        } else if (inside > 0) {
+            glm::vec4 poly[4];
+            int n = 0;
+            for (int k = 0; k < 3; k++) {
+                int next = (k + 1) % 3;
+                if (d[k] >= 0.0f)
+                    poly[n++] = c[k];
+                if ((d[k] >= 0.0f) != (d[next] >= 0.0f)) {
+                    float s = d[k] / (d[k] - d[next]);
+                    poly[n++] = c[k] + s * (c[next] - c[k]);
+                }
+            }
+            for (int k = 1; k + 1 < n; k++)
+                addClipTriangle(poly[0], poly[k], poly[k + 1]);
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTileRow(int tileRow) {
+    int rowMin = tileRow * TileSize;
+    int rowMax = rowMin + TileSize - 1;
+
+    for (size_t ti = 0; ti < triangles.size(); ti++) {
+        const ScreenTriangle & t = triangles[ti];
+        if (t.maxY < rowMin || t.minY > rowMax)
+            continue;
+
+        // Edge functions E(p) = A*x + B*y + C, positive inside
+        float A[3], B[3], C[3];
+        for (int e = 0; e < 3; e++) {
+            const glm::vec2 & a = t.v[e];
+            const glm::vec2 & b = t.v[(e + 1) % 3];
+            A[e] = -(b.y - a.y);
+            B[e] = b.x - a.x;
+            C[e] = -(A[e] * a.x + B[e] * a.y);
+        }
+        // 1/w is affine in screen space; edge e is opposite vertex (e + 2) % 3
+        float area = C[0] + C[1] + C[2];
+        float za = (t.iz[2] * A[0] + t.iz[0] * A[1] + t.iz[1] * A[2]) / area;
+        float zb = (t.iz[2] * B[0] + t.iz[0] * B[1] + t.iz[1] * B[2]) / area;
+        float zc = (t.iz[2] * C[0] + t.iz[0] * C[1] + t.iz[1] * C[2]) / area;
+
+        int y0 = std::max(rowMin, t.minY);
+        int y1 = std::min(rowMax, t.maxY);
+        int x0 = t.minX & ~3;
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float * row = &depth[y * width];
+#if defined(OCCLUSION_SSE)
+            __m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            __m128 e0y = _mm_set1_ps(B[0] * py + C[0]);
+            __m128 e1y = _mm_set1_ps(B[1] * py + C[1]);
+            __m128 e2y = _mm_set1_ps(B[2] * py + C[2]);
+            __m128 zy = _mm_set1_ps(zb * py + zc);
+            __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]), az = _mm_set1_ps(za);
+            for (int x = x0; x <= t.maxX; x += 4) {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), stepX);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0y);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1y);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2y);
+                __m128 inside = _mm_and_ps(_mm_cmpgt_ps(e0, _mm_setzero_ps()),
+                                _mm_and_ps(_mm_cmpgt_ps(e1, _mm_setzero_ps()), _mm_cmpgt_ps(e2, _mm_setzero_ps())));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(az, px), zy);
+                __m128 old = _mm_loadu_ps(row + x);
+                __m128 nearest = _mm_max_ps(old, z);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+#else
+            for (int x = x0; x <= t.maxX; x++) {
+                float px = x + 0.5f;
+                if (A[0] * px + B[0] * py + C[0] > 0.0f &&
+                    A[1] * px + B[1] * py + C[1] > 0.0f &&
+                    A[2] * px + B[2] * py + C[2] > 0.0f) {
+                    float z = za * px + zb * py + zc;
+                    if (z > row[x])
+                        row[x] = z;
+                }
+            }
+#endif
+        }
+    }
+
+    // Farthest depth of each tile in this row, for the hierarchical test
+    for (int tx = 0; tx < tilesX; tx++) {
+        float m = depth[rowMin * width + tx * TileSize];
+        for (int y = rowMin; y <= rowMax; y++) {
+            const float * row = &depth[y * width + tx * TileSize];
+            for (int x = 0; x < TileSize; x++)
+                m = std::min(m, row[x]);
+        }
+        tileMin[tileRow * tilesX + tx] = m;
+    }
+}
+
+void OcclusionCuller::rasterize(ThreadPool & pool) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    pool.parallelFor(tilesY, [this](int tileRow) { rasterizeTileRow(tileRow); });
+    stats.rasterMilliseconds = millisecondsSince(start);
+}
+
+bool OcclusionCuller::testBox(const AABB & box) const {
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    float nearest = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 c = viewProjection * glm::vec4(corner, 1.0f);
+        // Boxes crossing the near plane are always visible
+        if (c.z + c.w < 0.0f || c.w <= 0.0f)
+            return true;
+        float invW = 1.0f / c.w;
+        glm::vec2 s((c.x * invW * 0.5f + 0.5f) * width, (c.y * invW * 0.5f + 0.5f) * height);
+        lo = glm::min(lo, s);
+        hi = glm::max(hi, s);
+        nearest = std::max(nearest, invW);
+    }
+
+    // One pixel of slack keeps the test conservative at occluder silhouettes
+    int x0 = std::max(0, (int)std::floor(lo.x) - 1);
+    int y0 = std::max(0, (int)std::floor(lo.y) - 1);
+    int x1 = std::min(width - 1, (int)std::ceil(hi.x) + 1);
+    int y1 = std::min(height - 1, (int)std::ceil(hi.y) + 1);
+    if (x0 > x1 || y0 > y1)
+        return true;
+
+    for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++) {
+        for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++) {
+            // Whole tile covered by occluders closer than the box
+            if (tileMin[ty * tilesX + tx] > nearest)
+                continue;
+            int px0 = std::max(x0, tx * TileSize), px1 = std::min(x1, tx * TileSize + TileSize - 1);
+            int py0 = std::max(y0, ty * TileSize), py1 = std::min(y1, ty * TileSize + TileSize - 1);
+            for (int y = py0; y <= py1; y++) {
+                const float * row = &depth[y * width];
+                for (int x = px0; x <= px1; x++) {
+                    if (row[x] <= nearest)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionCuller::cullVisible(
+    const std::vector<AABB> & worldBoxes,
+    const std::vector<unsigned char> & skip,
+    std::vector<unsigned int> & visible
+){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    size_t count = 0;
+    for (size_t i = 0; i < visible.size(); i++) {
+        unsigned int object = visible[i];
+        if (!skip.empty() && skip[object]) {
+            visible[count++] = object;
+            continue;
+        }
+        stats.tested++;
+        if (testBox(worldBoxes[object]))
+            visible[count++] = object;
+        else
+            stats.occluded++;
+    }
+    visible.resize(count);
+    stats.testMilliseconds = millisecondsSince(start);
+}
@@ -0,0 +1,70 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+#include "threadpool.hpp"
+
+struct OcclusionStats {
+    unsigned int occluders;
+    unsigned int occluderTriangles;
+    unsigned int tested;
+    unsigned int occluded;
+    double rasterMilliseconds;
+    double testMilliseconds;
+};
+
+// CPU software occlusion culling.
+// Selected occluder meshes are rasterized into a small depth buffer holding 1/w
+// (larger is closer), split into rows of 8x8 tiles that are filled in parallel.
+// Each tile also keeps its farthest depth, so most occludee boxes are rejected
+// or accepted per tile before touching individual pixels.
+class OcclusionCuller {
+public:
+    OcclusionCuller(int width = 320, int height = 240);
+
+    // Clears the depth buffer and statistics
+    void beginFrame(const glm::mat4 & VP);
+    // Non-indexed triangle list in model space, as returned by loadOBJ
+    void addOccluder(const std::vector<glm::vec3> & triangles, const glm::mat4 & M);
+    // Same with the full model view projection, for callers that batch the VP * M products
+    void addOccluderMVP(const std::vector<glm::vec3> & triangles, const glm::mat4 & MVP);
+    void rasterize(ThreadPool & pool);
+
+    // True if any part of the box may be visible
+    bool testBox(const AABB & worldBox) const;
+    // Removes occluded entries from visible. Objects flagged in skip (e.g. the occluders
+    // themselves) are kept without testing; skip may be empty.
+    void cullVisible(
+        const std::vector<AABB> & worldBoxes,
+        const std::vector<unsigned char> & skip,
+        std::vector<unsigned int> & visible
+    );
+
+    const OcclusionStats & getStats() const { return stats; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const std::vector<float> & getDepth() const { return depth; }
+
+private:
+    struct ScreenTriangle {
+        glm::vec2 v[3];
+        float iz[3];
+        int minX, minY, maxX, maxY;
+    };
+
+    void addClipTriangle(const glm::vec4 & c0, const glm::vec4 & c1, const glm::vec4 & c2);
+    void rasterizeTileRow(int tileRow);
+
+    int width, height;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    std::vector<float> depth;      // width * height, 1/w of the nearest occluder, 0 when empty
+    std::vector<float> tileMin;    // farthest (smallest) 1/w inside each tile
+    std::vector<ScreenTriangle> triangles;
+    OcclusionStats stats;
+};
+
+#endif
@@ -0,0 +1,52 @@
+// Include standard headers
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "picking.hpp"
+
+void cursorRay(double x, double y, int width, int height, const glm::mat4 & view, const glm::mat4 & projection,
+               glm::vec3 & origin, glm::vec3 & direction) {
+    float ndcX = (float)(2.0 * x / width - 1.0);
+    float ndcY = (float)(1.0 - 2.0 * y / height);
+    glm::mat4 inverse = glm::inverse(projection * view);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    origin = glm::vec3(nearPoint) / nearPoint.w;
+    direction = glm::vec3(farPoint) / farPoint.w - origin;
+}
+
+bool pickRay(const SceneBVH & scene, const std::vector<const MeshBVH *> & meshes, const std::vector<glm::mat4> & modelMatrices,
+             const glm::vec3 & origin, const glm::vec3 & direction, float tmax, PickResult & out) {
+    // The callback only reports hits closer than the best so far, so the last one recorded
+    // belongs to the object raycast returns
+    MeshHit best;
+    float t;
+    int object = scene.raycast(origin, direction, tmax, [&](unsigned int candidate, float limit) {
+        glm::mat4 toModel = glm::inverse(modelMatrices[candidate]);
+        glm::vec3 modelOrigin = glm::vec3(toModel * glm::vec4(origin, 1.0f));
+        glm::vec3 modelDirection = glm::vec3(toModel * glm::vec4(direction, 0.0f));
+        MeshHit hit;
+        if (!meshes[candidate]->intersect(modelOrigin, modelDirection, limit, hit))
+            return limit;
+        best = hit;
+        return hit.t;
+    }, &t);
+
+    out.object = object;
+    if (object < 0)
+        return false;
+    out.triangle = best.triangle;
+    out.barycentric = glm::vec3(1.0f - best.u - best.v, best.u, best.v);
+    out.position = origin + t * direction;
+    out.t = t;
+    return true;
+}
+
+bool pickCursor(double x, double y, int width, int height, const glm::mat4 & view, const glm::mat4 & projection,
+                const SceneBVH & scene, const std::vector<const MeshBVH *> & meshes, const std::vector<glm::mat4> & modelMatrices,
+                PickResult & out) {
+    glm::vec3 origin, direction;
+    cursorRay(x, y, width, height, view, projection, origin, direction);
+    return pickRay(scene, meshes, modelMatrices, origin, direction, 1.0f, out);
+}
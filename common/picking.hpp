@@ -0,0 +1,34 @@
+#ifndef PICKING_HPP
+#define PICKING_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "bvh.hpp"
+#include "meshbvh.hpp"
+
+struct PickResult {
+    int object;             // -1 when nothing was hit
+    unsigned int triangle;
+    glm::vec3 barycentric;  // weights of the triangle's three vertices
+    glm::vec3 position;     // world space
+    float t;                // 0 on the near plane, 1 on the far plane for cursor rays
+};
+
+// World space ray through a cursor position in window coordinates (origin top left),
+// from the near plane (t = 0) to the far plane (t = 1)
+void cursorRay(double x, double y, int width, int height, const glm::mat4 & view, const glm::mat4 & projection,
+               glm::vec3 & origin, glm::vec3 & direction);
+
+// Closest triangle along the ray. The scene BVH visits objects front to back; each
+// candidate is tested in its own model space against its mesh BVH.
+// meshes and modelMatrices are indexed by the objects of scene; instances may share a mesh.
+bool pickRay(const SceneBVH & scene, const std::vector<const MeshBVH *> & meshes, const std::vector<glm::mat4> & modelMatrices,
+             const glm::vec3 & origin, const glm::vec3 & direction, float tmax, PickResult & out);
+
+// Model, triangle and barycentrics under the cursor
+bool pickCursor(double x, double y, int width, int height, const glm::mat4 & view, const glm::mat4 & projection,
+                const SceneBVH & scene, const std::vector<const MeshBVH *> & meshes, const std::vector<glm::mat4> & modelMatrices,
+                PickResult & out);
+
+#endif
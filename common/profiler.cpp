@@ -0,0 +1,248 @@
+// Include standard headers
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "profiler.hpp"
+
+static double millisecondsBetween(std::chrono::high_resolution_clock::time_point a,
+                                  std::chrono::high_resolution_clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+FrameProfiler::FrameProfiler(unsigned int history)
+    : gpuTimers(false), recording(false), history(std::max(1u, history)), frameIndex(0), dropped(0),
+      hasPending(false), recentNext(0) {
+}
+
+FrameProfiler::~FrameProfiler() {
+    // Queries belong to the context, cleanup() must run while it is still current
+}
+
+int FrameProfiler::addPhase(const char * name, bool gpu) {
+    Phase p;
+    p.name = name;
+    p.gpu = gpu;
+    p.queries[0] = p.queries[1] = 0;
+    p.issued[0] = p.issued[1] = false;
+    phases.push_back(p);
+    return (int)phases.size() - 1;
+}
+
+bool FrameProfiler::initialize() {
+    gpuTimers = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if (!gpuTimers) {
+        printf("Timer queries not supported, GPU phase times are disabled\n");
+        return false;
+    }
+    for (size_t i = 0; i < phases.size(); i++) {
+        if (phases[i].gpu)
+            glGenQueries(2, phases[i].queries);
+    }
+    return true;
+}
+
+void FrameProfiler::cleanup() {
+    for (size_t i = 0; i < phases.size(); i++) {
+        if (phases[i].queries[0])
+            glDeleteQueries(2, phases[i].queries);
+        phases[i].queries[0] = phases[i].queries[1] = 0;
+    }
+    gpuTimers = false;
+}
+
+void FrameProfiler::beginFrame() {
+    // The previous frame's queries had a whole frame to finish
+    if (hasPending) {
+        resolveGPU(pending, (frameIndex - 1) & 1, false);
+        commit(pending);
+        hasPending = false;
+    }
+
+    current.frame = frameIndex;
+    current.frameMs = 0.0;
+    current.cpuMs.assign(phases.size(), -1.0);
+    current.gpuMs.assign(phases.size(), -1.0);
+    for (size_t i = 0; i < phases.size(); i++)
+        phases[i].issued[frameIndex & 1] = false;
+    frameStart = Clock::now();
+}
+
+void FrameProfiler::endFrame() {
+    current.frameMs = millisecondsBetween(frameStart, Clock::now());
+    pending.frame = current.frame;
+    pending.frameMs = current.frameMs;
+    pending.cpuMs.swap(current.cpuMs);
+    pending.gpuMs.swap(current.gpuMs);
+    hasPending = true;
+    frameIndex++;
+}
+
+void FrameProfiler::begin(int phase) {
+    Phase & p = phases[phase];
+    if (p.gpu && gpuTimers) {
+        glBeginQuery(GL_TIME_ELAPSED, p.queries[frameIndex & 1]);
+        p.issued[frameIndex & 1] = true;
+    }
+    p.start = Clock::now();
+}
+
+void FrameProfiler::end(int phase) {
+    Phase & p = phases[phase];
+    double ms = millisecondsBetween(p.start, Clock::now());
+    // A phase may run several times per frame
+    current.cpuMs[phase] = current.cpuMs[phase] < 0.0 ? ms : current.cpuMs[phase] + ms;
+    if (p.gpu && gpuTimers)
+        glEndQuery(GL_TIME_ELAPSED);
+}
+
+void FrameProfiler::record(int phase, double cpuMs) {
+    current.cpuMs[phase] = current.cpuMs[phase] < 0.0 ? cpuMs : current.cpuMs[phase] + cpuMs;
+}
+
+void FrameProfiler::flush() {
+    if (hasPending) {
+        resolveGPU(pending, (frameIndex - 1) & 1, true);
+        commit(pending);
+        hasPending = false;
+    }
+}
+
+void FrameProfiler::resolveGPU(FrameRecord & record, int buffer, bool wait) {
+    for (size_t i = 0; i < phases.size(); i++) {
+        Phase & p = phases[i];
+        if (!p.issued[buffer])
+            continue;
+        if (!wait) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(p.queries[buffer], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                // Reading now would stall; the GPU is more than a frame behind
+                dropped++;
+                continue;
+            }
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(p.queries[buffer], GL_QUERY_RESULT, &nanoseconds);
+        record.gpuMs[i] = nanoseconds / 1e6;
+    }
+}
+
+void FrameProfiler::commit(const FrameRecord & record) {
+    if (recent.size() < history) {
+        recent.push_back(record);
+    } else {
+        recent[recentNext] = record;
+        recentNext = (recentNext + 1) % history;
+    }
+    if (recording)
+        frames.push_back(record);
+}
+
+PhaseStats FrameProfiler::getStats(int phase) const {
+    PhaseStats s;
+    s.cpuAverageMs = s.cpuMaxMs = 0.0;
+    s.gpuAverageMs = s.gpuMaxMs = -1.0;
+    int cpuCount = 0, gpuCount = 0;
+    double cpuTotal = 0.0, gpuTotal = 0.0;
+    for (size_t i = 0; i < recent.size(); i++) {
+        double cpu = recent[i].cpuMs[phase], gpu = recent[i].gpuMs[phase];
+        if (cpu >= 0.0) {
+            cpuTotal += cpu;
+            s.cpuMaxMs = std::max(s.cpuMaxMs, cpu);
+            cpuCount++;
+        }
+        if (gpu >= 0.0) {
+            gpuTotal += gpu;
+            s.gpuMaxMs = std::max(s.gpuMaxMs, gpu);
+            gpuCount++;
+        }
+    }
+    if (cpuCount)
+        s.cpuAverageMs = cpuTotal / cpuCount;
+    if (gpuCount)
+        s.gpuAverageMs = gpuTotal / gpuCount;
+    return s;
+}
+
+double FrameProfiler::frameAverageMs() const {
+    if (recent.empty())
+        return 0.0;
+    double total = 0.0;
+    for (size_t i = 0; i < recent.size(); i++)
+        total += recent[i].frameMs;
+    return total / recent.size();
+}
+
+void FrameProfiler::formatOverlay(std::vector<std::string> & out_lines) const {
+    out_lines.clear();
+    char line[128];
+    double frameMs = frameAverageMs();
+    snprintf(line, sizeof(line), "frame %6.2f ms %5.0f fps", frameMs, frameMs > 0.0 ? 1000.0 / frameMs : 0.0);
+    out_lines.push_back(line);
+    for (size_t i = 0; i < phases.size(); i++) {
+        PhaseStats s = getStats((int)i);
+        if (s.gpuAverageMs >= 0.0)
+            snprintf(line, sizeof(line), "%-9s cpu %5.2f gpu %5.2f", phases[i].name.c_str(), s.cpuAverageMs, s.gpuAverageMs);
+        else
+            snprintf(line, sizeof(line), "%-9s cpu %5.2f", phases[i].name.c_str(), s.cpuAverageMs);
+        out_lines.push_back(line);
+    }
+}
+
+bool FrameProfiler::exportCSV(const char * path) const {
+    FILE * file = fopen(path, "w");
+    if (!file) {
+        printf("Cannot write profile %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame,frame_ms");
+    for (size_t i = 0; i < phases.size(); i++)
+        fprintf(file, ",%s_cpu_ms,%s_gpu_ms", phases[i].name.c_str(), phases[i].name.c_str());
+    fprintf(file, "\n");
+    for (size_t f = 0; f < frames.size(); f++) {
+        const FrameRecord & r = frames[f];
+        fprintf(file, "%u,%.4f", r.frame, r.frameMs);
+        // Phases that did not run are left empty
+        for (size_t i = 0; i < phases.size(); i++) {
+            if (r.cpuMs[i] >= 0.0) fprintf(file, ",%.4f", r.cpuMs[i]); else fprintf(file, ",");
+            if (r.gpuMs[i] >= 0.0) fprintf(file, ",%.4f", r.gpuMs[i]); else fprintf(file, ",");
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return true;
+}
+
+bool FrameProfiler::exportJSON(const char * path) const {
+    FILE * file = fopen(path, "w");
+    if (!file) {
+        printf("Cannot write profile %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"phases\": [");
+    for (size_t i = 0; i < phases.size(); i++)
+        fprintf(file, "%s\"%s\"", i ? ", " : "", phases[i].name.c_str());
+    fprintf(file, "],\n  \"frames\": [\n");
+    for (size_t f = 0; f < frames.size(); f++) {
+        const FrameRecord & r = frames[f];
+        fprintf(file, "    {\"frame\": %u, \"frame_ms\": %.4f, \"cpu_ms\": [", r.frame, r.frameMs);
+        for (size_t i = 0; i < phases.size(); i++) {
+            if (r.cpuMs[i] >= 0.0) fprintf(file, "%s%.4f", i ? ", " : "", r.cpuMs[i]);
+            else fprintf(file, "%snull", i ? ", " : "");
+        }
+        fprintf(file, "], \"gpu_ms\": [");
+        for (size_t i = 0; i < phases.size(); i++) {
+            if (r.gpuMs[i] >= 0.0) fprintf(file, "%s%.4f", i ? ", " : "", r.gpuMs[i]);
+            else fprintf(file, "%snull", i ? ", " : "");
+        }
+        fprintf(file, "]}%s\n", f + 1 < frames.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
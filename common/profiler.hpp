@@ -0,0 +1,103 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+
+// Average and worst case over the rolling window
+struct PhaseStats {
+    double cpuAverageMs, cpuMaxMs;
+    double gpuAverageMs, gpuMaxMs;    // negative when the phase has no GPU timer
+};
+
+// Per frame CPU and GPU timing of named phases.
+// CPU time comes from a high resolution clock. GPU phases are additionally wrapped in
+// GL_TIME_ELAPSED queries; there are two sets of queries and the results of a frame
+// are read back one frame later, so the CPU never waits on the GPU. GPU phases must
+// not nest since only one GL_TIME_ELAPSED query can be active.
+class FrameProfiler {
+public:
+    FrameProfiler(unsigned int history = 120);
+    ~FrameProfiler();
+
+    // Register phases before initialize(); returns the phase index
+    int addPhase(const char * name, bool gpu);
+    // Creates the queries, needs a current context. GPU timing is disabled when the
+    // context lacks ARB_timer_query.
+    bool initialize();
+    void cleanup();
+
+    // Keep every frame for exportCSV / exportJSON (otherwise only the rolling window)
+    void setRecording(bool record) { recording = record; }
+
+    void beginFrame();
+    void endFrame();
+    void begin(int phase);
+    void end(int phase);
+    // CPU time of a phase measured elsewhere, e.g. on another thread
+    void record(int phase, double cpuMs);
+    // Waits for the last frame's GPU results
+    void flush();
+
+    size_t phaseCount() const { return phases.size(); }
+    const char * phaseName(int phase) const { return phases[phase].name.c_str(); }
+    PhaseStats getStats(int phase) const;
+    // Rolling average of the whole frame, CPU side
+    double frameAverageMs() const;
+    unsigned int framesRecorded() const { return (unsigned int)frames.size(); }
+    unsigned int gpuResultsDropped() const { return dropped; }
+
+    // One line per phase, e.g. for the on-screen overlay
+    void formatOverlay(std::vector<std::string> & out_lines) const;
+
+    // Recorded frames, one row per frame, times in milliseconds
+    bool exportCSV(const char * path) const;
+    bool exportJSON(const char * path) const;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Phase {
+        std::string name;
+        bool gpu;
+        GLuint queries[2];
+        bool issued[2];
+        Clock::time_point start;
+    };
+    // Times of one frame, cpu and gpu per phase, -1 when not measured
+    struct FrameRecord {
+        unsigned int frame;
+        double frameMs;
+        std::vector<double> cpuMs, gpuMs;
+    };
+
+    void resolveGPU(FrameRecord & record, int buffer, bool wait);
+    void commit(const FrameRecord & record);
+
+    std::vector<Phase> phases;
+    bool gpuTimers;
+    bool recording;
+    unsigned int history;
+    unsigned int frameIndex;
+    unsigned int dropped;
+    Clock::time_point frameStart;
+    FrameRecord current, pending;
+    bool hasPending;
+
+    std::vector<FrameRecord> recent;   // ring buffer of the last history frames
+    size_t recentNext;
+    std::vector<FrameRecord> frames;   // everything, when recording
+};
+
+// Times the enclosing block as one phase
+class ScopedPhase {
+public:
+    ScopedPhase(FrameProfiler & profiler, int phase) : profiler(profiler), phase(phase) { profiler.begin(phase); }
+    ~ScopedPhase() { profiler.end(phase); }
+private:
+    FrameProfiler & profiler;
+    int phase;
+};
+
+#endif
@@ -0,0 +1,211 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "shader.hpp"
+#include "programcache.hpp"
+
+// Start of every cache file, followed by the binary itself
+struct ProgramBinaryHeader {
+    char magic[4];
+    unsigned int version;
+    unsigned long long key;     // repeated to catch renamed or truncated files
+    unsigned int format;        // GLenum from glGetProgramBinary
+    unsigned int length;
+};
+
+static const char BinaryMagic[4] = { 'P', 'R', 'G', 'B' };
+static const unsigned int BinaryVersion = 1;
+
+// FNV-1a, 64 bit
+static unsigned long long hashBytes(unsigned long long hash, const void * data, size_t size) {
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static unsigned long long hashString(unsigned long long hash, const std::string & text) {
+    // Length first, so moving text from one source to the other changes the key
+    unsigned long long length = text.size();
+    hash = hashBytes(hash, &length, sizeof(length));
+    return hashBytes(hash, text.data(), text.size());
+}
+
+static bool makeDirectory(const char * path) {
+#ifdef _WIN32
+    int result = _mkdir(path);
+#else
+    int result = mkdir(path, 0755);
+#endif
+    if (result == 0 || errno == EEXIST)
+        return true;
+    printf("Cannot create program cache directory %s\n", path);
+    return false;
+}
+
+static std::string glString(GLenum name) {
+    const GLubyte * value = glGetString(name);
+    return value ? std::string((const char *)value) : std::string();
+}
+
+ProgramCache::ProgramCache() : enabled(false) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool ProgramCache::initialize(const char * path) {
+    enabled = false;
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+        return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats <= 0 || !makeDirectory(path))
+        return false;
+
+    directory = path;
+    driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION) + "\n" +
+             glString(GL_SHADING_LANGUAGE_VERSION);
+    enabled = true;
+    return true;
+}
+
+GLuint ProgramCache::load(const char * vertex_file_path, const char * fragment_file_path) {
+    std::string vertex_code, fragment_code;
+    if (!ReadShaderFile(vertex_file_path, vertex_code)) {
+        printf("Impossible to open %s\n", vertex_file_path);
+        return 0;
+    }
+    if (!ReadShaderFile(fragment_file_path, fragment_code)) {
+        printf("Impossible to open %s\n", fragment_file_path);
+        return 0;
+    }
+    return loadSource(vertex_code, fragment_code, vertex_file_path, fragment_file_path);
+}
+
+GLuint ProgramCache::loadSource(const std::string & vertex_code, const std::string & fragment_code,
+                                const char * vertex_name, const char * fragment_name) {
+    unsigned long long key = makeKey(vertex_code, fragment_code);
+    GLuint program = fetch(key);
+    if (program)
+        return program;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    program = CompileProgram(vertex_code, fragment_code, vertex_name, fragment_name, enabled);
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    if (program)
+        store(program, key);
+    return program;
+}
+
+unsigned long long ProgramCache::makeKey(const std::string & vertex_code, const std::string & fragment_code) const {
+    if (!enabled)
+        return 0;
+    unsigned long long key = hashString(14695981039346656037ULL, driver);
+    key = hashString(key, vertex_code);
+    return hashString(key, fragment_code);
+}
+
+std::string ProgramCache::binaryPath(unsigned long long key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", key);
+    return directory + name;
+}
+
+GLuint ProgramCache::fetch(unsigned long long key) {
+    if (!enabled) {
+        stats.misses++;
+        return 0;
+    }
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    GLuint program = 0;
+    FILE * file = fopen(binaryPath(key).c_str(), "rb");
+    if (file) {
+        ProgramBinaryHeader header;
+        std::vector<char> binary;
+        bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                     memcmp(header.magic, BinaryMagic, sizeof(BinaryMagic)) == 0 &&
+                     header.version == BinaryVersion && header.key == key && header.length > 0;
+        if (valid) {
+            binary.resize(header.length);
+            valid = fread(&binary[0], 1, binary.size(), file) == binary.size();
+        }
+        fclose(file);
+
+        if (valid) {
+            program = glCreateProgram();
+            glProgramBinary(program, header.format, &binary[0], (GLsizei)binary.size());
+            GLint linked = GL_FALSE;
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+            if (linked != GL_TRUE) {
+                // Driver changed in a way its strings don't show, the caller compiles again
+                glDeleteProgram(program);
+                glGetError();
+                program = 0;
+            }
+        }
+        if (!program)
+            stats.rejected++;
+    }
+    if (program)
+        stats.hits++;
+    else
+        stats.misses++;
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return program;
+}
+
+void ProgramCache::store(GLuint program, unsigned long long key) {
+    if (!enabled)
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, &binary[0]);
+    if (written <= 0)
+        return;
+
+    ProgramBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BinaryMagic, sizeof(BinaryMagic));
+    header.version = BinaryVersion;
+    header.key = key;
+    header.format = format;
+    header.length = (unsigned int)written;
+
+    // Written under a temporary name first, so a crash never leaves half a binary
+    std::string path = binaryPath(key);
+    std::string temporary = path + ".tmp";
+    FILE * file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        printf("Cannot write %s\n", temporary.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(&binary[0], 1, written, file) == (size_t)written;
+    ok = fclose(file) == 0 && ok;
+    remove(path.c_str());
+    if (ok && rename(temporary.c_str(), path.c_str()) == 0)
+        stats.written++;
+    else
+        remove(temporary.c_str());
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
@@ -0,0 +1,53 @@
+#ifndef PROGRAMCACHE_HPP
+#define PROGRAMCACHE_HPP
+
+#include <string>
+
+struct ProgramCacheStats {
+    unsigned int hits;          // programs created from a stored binary
+    unsigned int misses;        // programs with no usable binary
+    unsigned int rejected;      // stored binaries the driver refused, compiled again
+    unsigned int written;       // binaries stored for the next start
+    double milliseconds;        // total time spent loading, compiling and storing programs
+};
+
+// Keeps linked programs on disk so later starts skip compiling and linking.
+// A program is stored under a 64 bit hash of its sources and of the GL vendor,
+// renderer and version strings, so a driver update or an edited shader simply
+// misses. Binaries come from glGetProgramBinary and go back in with glProgramBinary;
+// when the driver rejects one (its format or build changed) the program is compiled
+// from source and the file replaced.
+class ProgramCache {
+public:
+    ProgramCache();
+
+    // Stores binaries in directory, creating it if needed. False when the driver has
+    // no program binary formats or the directory is unusable; load() then compiles.
+    bool initialize(const char * directory);
+    bool isEnabled() const { return enabled; }
+
+    // LoadShaders() through the cache, 0 on failure
+    GLuint load(const char * vertex_file_path, const char * fragment_file_path);
+    // Same for sources already in memory, the names only label messages
+    GLuint loadSource(const std::string & vertex_code, const std::string & fragment_code,
+                      const char * vertex_name, const char * fragment_name);
+
+    // Building blocks of loadSource() for callers that compile on their own:
+    // the key of a pair of sources, the program stored under it (0 on a miss or when
+    // disabled), and storing a program linked with the retrievable hint
+    unsigned long long makeKey(const std::string & vertex_code, const std::string & fragment_code) const;
+    GLuint fetch(unsigned long long key);
+    void store(GLuint program, unsigned long long key);
+
+    const ProgramCacheStats & getStats() const { return stats; }
+
+private:
+    std::string binaryPath(unsigned long long key) const;
+
+    std::string directory;
+    std::string driver;         // vendor, renderer and version, part of every key
+    bool enabled;
+    ProgramCacheStats stats;
+};
+
+#endif
@@ -0,0 +1,160 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "renderqueue.hpp"
+
+RenderQueue::RenderQueue()
+    : nearPlane(0.1f), farPlane(100.0f), sortMode(SortByState), uniformBinding(0), uniformBuffer(0), uniformBase(0), uniformStride(0) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+void RenderQueue::clear() {
+    commands.clear();
+    keys.clear();
+    order.clear();
+}
+
+void RenderQueue::setDepthRange(float n, float f) {
+    nearPlane = n;
+    farPlane = f;
+}
+
+void RenderQueue::setObjectUniforms(GLuint binding, GLuint buffer, GLintptr baseOffset, GLsizeiptr stride) {
+    uniformBinding = binding;
+    uniformBuffer = buffer;
+    uniformBase = baseOffset;
+    uniformStride = stride;
+}
+
+uint64_t RenderQueue::makeKey(const DrawCommand & c, float nearPlane, float farPlane, SortMode mode) {
+    float d = (c.viewDepth - nearPlane) / (farPlane - nearPlane);
+    d = std::min(std::max(d, 0.0f), 1.0f);
+    uint64_t depth = (uint64_t)(d * 0xFFFFFF);
+
+    if (mode == SortFrontToBack) {
+        return (depth << 40) |
+               ((uint64_t)(c.program  & 0xFF)  << 32) |
+               ((uint64_t)(c.texture  & 0xFFF) << 20) |
+               ((uint64_t)(c.vao      & 0xFFF) << 8) |
+               (uint64_t)(c.material & 0xFF);
+    }
+    return ((uint64_t)(c.program  & 0xFF)  << 56) |
+           ((uint64_t)(c.texture  & 0xFFF) << 44) |
+           ((uint64_t)(c.vao      & 0xFFF) << 32) |
+           ((uint64_t)(c.material & 0xFF)  << 24) |
+           depth;
+}
+
+void RenderQueue::push(const DrawCommand & command) {
+    keys.push_back(makeKey(command, nearPlane, farPlane, sortMode));
+    order.push_back((uint32_t)commands.size());
+    commands.push_back(command);
+}
+
+void RenderQueue::sort() {
+    size_t n = keys.size();
+    if (n < 2)
+        return;
+    scratchKeys.resize(n);
+    scratchOrder.resize(n);
+
+    // Bytes that are identical in every key never need a pass
+    uint64_t andAll = keys[0], orAll = keys[0];
+    for (size_t i = 1; i < n; i++) {
+        andAll &= keys[i];
+        orAll |= keys[i];
+    }
+    uint64_t varying = andAll ^ orAll;
+
+    uint64_t * srcKeys = &keys[0];
+    uint32_t * srcOrder = &order[0];
+    uint64_t * dstKeys = &scratchKeys[0];
+    uint32_t * dstOrder = &scratchOrder[0];
+    for (int shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0)
+            continue;
+
+        size_t offsets[256] = {0};
+        for (size_t i = 0; i < n; i++)
+            offsets[(srcKeys[i] >> shift) & 0xFF]++;
+        size_t sum = 0;
+        for (int b = 0; b < 256; b++) {
+            size_t c = offsets[b];
+            offsets[b] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < n; i++) {
+            size_t dst = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+            dstKeys[dst] = srcKeys[i];
+            dstOrder[dst] = srcOrder[i];
+        }
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcOrder, dstOrder);
+    }
+
+    // An odd number of passes leaves the result in the scratch arrays
+    if (srcKeys != &keys[0]) {
+        keys.swap(scratchKeys);
+        order.swap(scratchOrder);
+    }
+}
+
+void RenderQueue::submit(GLint modelMatrixLocation) {
+    memset(&stats, 0, sizeof(stats));
+
+    GLuint currentProgram = 0, currentVao = 0, currentTexture = 0;
+    const glm::mat4 * currentMatrix = NULL;
+    bool first = true;
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const DrawCommand & c = commands[order[i]];
+
+        if (first || c.program != currentProgram) {
+            glUseProgram(c.program);
+            currentProgram = c.program;
+            currentMatrix = NULL; // uniforms are per program
+            stats.programBinds++;
+        } else {
+            stats.programBindsAvoided++;
+        }
+        if (first || c.vao != currentVao) {
+            glBindVertexArray(c.vao);
+            currentVao = c.vao;
+            stats.vaoBinds++;
+        } else {
+            stats.vaoBindsAvoided++;
+        }
+        if (first || c.texture != currentTexture) {
+            glBindTexture(GL_TEXTURE_2D, c.texture);
+            currentTexture = c.texture;
+            stats.textureBinds++;
+        } else {
+            stats.textureBindsAvoided++;
+        }
+        if (c.uniformSlot >= 0 && uniformBuffer) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, uniformBinding, uniformBuffer,
+                              uniformBase + c.uniformSlot * uniformStride, uniformStride);
+            stats.uniformRangeBinds++;
+        } else if (c.modelMatrix != currentMatrix) {
+            glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &(*c.modelMatrix)[0][0]);
+            currentMatrix = c.modelMatrix;
+            stats.uniformUploads++;
+        } else {
+            stats.uniformUploadsAvoided++;
+        }
+        first = false;
+
+        glDrawArrays(GL_TRIANGLES, c.first, c.count);
+        stats.draws++;
+    }
+
+    // Unbind once at the end instead of after every draw
+    if (!order.empty())
+        glBindVertexArray(0);
+}
@@ -0,0 +1,86 @@
+#ifndef RENDERQUEUE_HPP
+#define RENDERQUEUE_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+// One glDrawArrays call and the state it needs
+struct DrawCommand {
+    GLuint program;
+    GLuint vao;
+    GLuint texture;
+    unsigned int material;
+    GLint first;
+    GLsizei count;
+    const glm::mat4 * modelMatrix;
+    int uniformSlot;     // slice of the object uniform buffer, -1 to upload modelMatrix instead
+    float viewDepth;     // distance along the view direction, used as the last sort criterion
+};
+
+// State changes issued and skipped during the last submit
+struct RenderQueueStats {
+    unsigned int draws;
+    unsigned int programBinds, programBindsAvoided;
+    unsigned int vaoBinds, vaoBindsAvoided;
+    unsigned int textureBinds, textureBindsAvoided;
+    unsigned int uniformUploads, uniformUploadsAvoided;
+    unsigned int uniformRangeBinds;
+
+    unsigned int bindsAvoided() const {
+        return programBindsAvoided + vaoBindsAvoided + textureBindsAvoided + uniformUploadsAvoided;
+    }
+};
+
+// Collects the frame's draws, sorts them by a 64-bit state key and submits them
+// with redundant binds filtered out.
+//
+// Key layout, most significant first:
+//   program:8 | texture:12 | vao:12 | material:8 | depth:24
+// or, sorting front to back (depth pre-pass, overdraw reduction):
+//   depth:24 | program:8 | texture:12 | vao:12 | material:8
+// GL names are truncated into their fields, which only affects how well draws
+// group; submit() compares the real names before skipping a bind.
+class RenderQueue {
+public:
+    enum SortMode {
+        SortByState,
+        SortFrontToBack
+    };
+
+    RenderQueue();
+
+    void clear();
+    // nearPlane/farPlane map viewDepth into the depth bits, front to back
+    void setDepthRange(float nearPlane, float farPlane);
+    // Applies to commands pushed afterwards
+    void setSortMode(SortMode mode) { sortMode = mode; }
+    void push(const DrawCommand & command);
+    // LSD radix sort, 8 bits per pass; passes where every key has the same byte are skipped
+    void sort();
+    // Commands with a uniformSlot get [baseOffset + slot * stride, stride) of buffer bound
+    // to the uniform block binding point instead of a uniform upload
+    void setObjectUniforms(GLuint binding, GLuint buffer, GLintptr baseOffset, GLsizeiptr stride);
+    // Issues the draws; modelMatrixLocation is the "M" uniform of the bound programs
+    void submit(GLint modelMatrixLocation);
+
+    size_t size() const { return commands.size(); }
+    const RenderQueueStats & getStats() const { return stats; }
+
+    static uint64_t makeKey(const DrawCommand & command, float nearPlane, float farPlane, SortMode mode = SortByState);
+
+private:
+    std::vector<DrawCommand> commands;
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> scratchKeys;
+    std::vector<uint32_t> scratchOrder;
+    float nearPlane, farPlane;
+    SortMode sortMode;
+    GLuint uniformBinding, uniformBuffer;
+    GLintptr uniformBase;
+    GLsizeiptr uniformStride;
+    RenderQueueStats stats;
+};
+
+#endif
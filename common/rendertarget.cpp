@@ -0,0 +1,92 @@
+// Include standard headers
+#include <stdio.h>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "rendertarget.hpp"
+
+bool createRenderTarget(RenderTarget & target, int width, int height, int samples) {
+    target.width = width;
+    target.height = height;
+    target.samples = samples;
+    target.colorTexture = 0;
+    target.colorBuffer = 0;
+
+    glGenFramebuffers(1, &target.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+    if (samples > 0) {
+        glGenRenderbuffers(1, &target.colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.colorBuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBuffer);
+    } else {
+        glGenTextures(1, &target.colorTexture);
+        glBindTexture(GL_TEXTURE_2D, target.colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTexture, 0);
+    }
+
+    glGenRenderbuffers(1, &target.depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Framebuffer incomplete (0x%x)\n", status);
+        destroyRenderTarget(target);
+        return false;
+    }
+    return true;
+}
+
+void destroyRenderTarget(RenderTarget & target) {
+    if (target.colorTexture)
+        glDeleteTextures(1, &target.colorTexture);
+    if (target.colorBuffer)
+        glDeleteRenderbuffers(1, &target.colorBuffer);
+    if (target.depthBuffer)
+        glDeleteRenderbuffers(1, &target.depthBuffer);
+    if (target.fbo)
+        glDeleteFramebuffers(1, &target.fbo);
+    target.fbo = target.colorTexture = target.colorBuffer = target.depthBuffer = 0;
+}
+
+void resolveRenderTarget(const RenderTarget & src, const RenderTarget * dst) {
+    blitRenderTarget(src, src.width, src.height, dst, dst ? dst->width : src.width, dst ? dst->height : src.height);
+}
+
+void blitRenderTarget(const RenderTarget & src, int srcWidth, int srcHeight,
+                      const RenderTarget * dst, int dstWidth, int dstHeight) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, src.fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst ? dst->fbo : 0);
+    // Multisampled sources can only be resolved 1:1
+    glBlitFramebuffer(0, 0, srcWidth, srcHeight, 0, 0, dstWidth, dstHeight, GL_COLOR_BUFFER_BIT,
+                      (dstWidth == srcWidth && dstHeight == srcHeight) ? GL_NEAREST : GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool saveFramebufferPPM(const char * path, int width, int height) {
+    std::vector<unsigned char> pixels(width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        printf("Impossible to write %s\n", path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    // GL rows start at the bottom, PPM rows at the top
+    for (int y = height - 1; y >= 0; y--)
+        fwrite(&pixels[y * width * 3], 1, width * 3, file);
+    fclose(file);
+    return true;
+}
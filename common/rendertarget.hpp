@@ -0,0 +1,26 @@
+#ifndef RENDERTARGET_HPP
+#define RENDERTARGET_HPP
+
+// Offscreen framebuffer. Single sampled targets have a texture color
+// attachment; multisampled ones use renderbuffers and need a resolve.
+struct RenderTarget {
+    GLuint fbo;
+    GLuint colorTexture;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+    int width, height, samples;
+};
+
+bool createRenderTarget(RenderTarget & target, int width, int height, int samples);
+void destroyRenderTarget(RenderTarget & target);
+// Blits color from src into dst (or the default framebuffer when dst is NULL)
+void resolveRenderTarget(const RenderTarget & src, const RenderTarget * dst);
+// Blits the lower left srcWidth x srcHeight pixels of src over dstWidth x dstHeight
+// pixels of dst (or the default framebuffer), bilinear filtered when scaling
+void blitRenderTarget(const RenderTarget & src, int srcWidth, int srcHeight,
+                      const RenderTarget * dst, int dstWidth, int dstHeight);
+
+// Writes the color buffer of the bound read framebuffer as a binary PPM
+bool saveFramebufferPPM(const char * path, int width, int height);
+
+#endif
@@ -0,0 +1,259 @@
+// Include standard headers
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+#include "bundle.hpp"
+#include "meshbvh.hpp"
+#include "residency.hpp"
+
+const unsigned int ResidencyManager::NoItem;
+
+ResidencyManager::ResidencyManager(size_t budgetBytes) :
+    head(NoItem), tail(NoItem), budget(budgetBytes), residentBytes(0), peakBytes(0),
+    loads(0), evictionCount(0), deferred(0), failures(0) {
+}
+
+void ResidencyManager::link(unsigned int index) {
+    Item & item = items[index];
+    item.prev = NoItem;
+    item.next = head;
+    if (head != NoItem)
+        items[head].prev = index;
+    else
+        tail = index;
+    head = index;
+}
+
+void ResidencyManager::unlink(unsigned int index) {
+    Item & item = items[index];
+    if (item.prev != NoItem)
+        items[item.prev].next = item.next;
+    else
+        head = item.next;
+    if (item.next != NoItem)
+        items[item.next].prev = item.prev;
+    else
+        tail = item.prev;
+    item.prev = item.next = NoItem;
+}
+
+unsigned int ResidencyManager::add(size_t bytes, State state) {
+    unsigned int index = (unsigned int)items.size();
+    Item item;
+    item.bytes = bytes;
+    item.lastFrame = 0;
+    item.prev = item.next = NoItem;
+    item.state = state;
+    item.requested = false;
+    item.failed = false;
+    items.push_back(item);
+    if (state != Evicted) {
+        // Added last, so the first items loaded are the first evicted
+        if (tail != NoItem) {
+            items[tail].next = index;
+            items[index].prev = tail;
+            tail = index;
+        } else {
+            head = tail = index;
+        }
+        residentBytes += bytes;
+        peakBytes = std::max(peakBytes, residentBytes);
+    }
+    return index;
+}
+
+void ResidencyManager::touch(unsigned int index, unsigned int frame) {
+    Item & item = items[index];
+    item.lastFrame = frame;
+    if (item.state != Evicted) {
+        if (head != index) {
+            unlink(index);
+            link(index);
+        }
+    } else if (!item.requested && !item.failed) {
+        item.requested = true;
+        requests.push_back(index);
+    }
+}
+
+// Evicts the least recently visible resident item, unless it was seen too recently;
+// loading items are passed over, their loads are in flight
+bool ResidencyManager::evictOne(unsigned int frame, unsigned int keepFrames, std::vector<unsigned int> & evictions) {
+    for (unsigned int index = tail; index != NoItem; index = items[index].prev) {
+        Item & item = items[index];
+        if (item.lastFrame + keepFrames >= frame)
+            return false;
+        if (item.state != Resident)
+            continue;
+        unlink(index);
+        item.state = Evicted;
+        residentBytes -= item.bytes;
+        evictions.push_back(index);
+        evictionCount++;
+        return true;
+    }
+    return false;
+}
+
+void ResidencyManager::update(unsigned int frame, unsigned int keepFrames, unsigned int maxLoads,
+                              std::vector<unsigned int> & started, std::vector<unsigned int> & evictions) {
+    if (budget) {
+        while (residentBytes > budget && evictOne(frame, keepFrames, evictions))
+            ;
+    }
+
+    // Requests in the order they came, dropping those out of view again
+    size_t kept = 0;
+    unsigned int startedNow = 0;
+    bool waiting = false;
+    for (size_t r = 0; r < requests.size(); r++) {
+        unsigned int index = requests[r];
+        Item & item = items[index];
+        if (item.lastFrame + keepFrames < frame) {
+            item.requested = false;
+            continue;
+        }
+        if (!waiting && startedNow < maxLoads) {
+            while (budget && residentBytes + item.bytes > budget && evictOne(frame, keepFrames, evictions))
+                ;
+            if (!budget || residentBytes + item.bytes <= budget) {
+                item.state = Loading;
+                item.requested = false;
+                link(index);
+                residentBytes += item.bytes;
+                peakBytes = std::max(peakBytes, residentBytes);
+                started.push_back(index);
+                startedNow++;
+                loads++;
+                continue;
+            }
+            // No room until something leaves the view; later requests wait as well
+            waiting = true;
+            deferred++;
+        }
+        requests[kept++] = index;
+    }
+    requests.resize(kept);
+}
+
+void ResidencyManager::finishLoad(unsigned int index, bool loaded) {
+    Item & item = items[index];
+    if (item.state != Loading)
+        return;
+    if (loaded) {
+        item.state = Resident;
+    } else {
+        unlink(index);
+        item.state = Evicted;
+        item.failed = true;
+        residentBytes -= item.bytes;
+        failures++;
+    }
+}
+
+ResidencyStats ResidencyManager::getStats() const {
+    ResidencyStats stats;
+    stats.resident = stats.loading = stats.evicted = 0;
+    for (size_t i = 0; i < items.size(); i++) {
+        if (items[i].state == Resident)
+            stats.resident++;
+        else if (items[i].state == Loading)
+            stats.loading++;
+        else
+            stats.evicted++;
+    }
+    stats.residentBytes = residentBytes;
+    stats.peakBytes = peakBytes;
+    stats.budget = budget;
+    stats.loads = loads;
+    stats.evictions = evictionCount;
+    stats.deferred = deferred;
+    stats.failed = failures;
+    return stats;
+}
+
+MeshStreamer::MeshStreamer() : bundle(NULL), running(false), quit(false) {
+}
+
+MeshStreamer::~MeshStreamer() {
+    stop();
+}
+
+void MeshStreamer::start(const SceneBundle * source) {
+    if (running)
+        return;
+    bundle = source;
+    quit = false;
+    running = true;
+    worker = std::thread(&MeshStreamer::workerLoop, this);
+}
+
+void MeshStreamer::stop() {
+    if (!running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+        requests.clear();
+    }
+    wake.notify_all();
+    worker.join();
+    running = false;
+}
+
+void MeshStreamer::request(unsigned int item, const std::string & path, int chunk) {
+    Request request = { item, path, chunk };
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(request);
+    }
+    wake.notify_all();
+}
+
+size_t MeshStreamer::poll(std::vector<StreamedMesh> & done) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = finished.size();
+    for (size_t i = 0; i < count; i++) {
+        done.push_back(StreamedMesh());
+        std::swap(done.back(), finished[i]);
+    }
+    finished.clear();
+    return count;
+}
+
+void MeshStreamer::workerLoop() {
+    std::vector<unsigned char> scratch;
+    for (;;) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return quit || !requests.empty(); });
+            if (quit)
+                return;
+            request = requests.front();
+            requests.pop_front();
+        }
+        // Parsed outside the lock; the temporaries go to this thread's arena
+        StreamedMesh mesh;
+        mesh.item = request.item;
+        if (bundle && request.chunk >= 0) {
+            mesh.loaded = bundle->readMesh(request.chunk, mesh.vertices, mesh.uvs, mesh.normals, scratch) != NULL;
+        } else {
+            mesh.loaded = loadOBJ(request.path.c_str(), mesh.vertices, mesh.uvs, mesh.normals);
+        }
+        if (mesh.loaded)
+            mesh.bvh.build(mesh.vertices);
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.push_back(StreamedMesh());
+        std::swap(finished.back(), mesh);
+    }
+}
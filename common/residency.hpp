@@ -0,0 +1,127 @@
+#ifndef RESIDENCY_HPP
+#define RESIDENCY_HPP
+
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "meshbvh.hpp"
+
+class SceneBundle;
+
+struct ResidencyStats {
+    unsigned int resident, loading, evicted;
+    size_t residentBytes;   // resident and loading items, loads reserve their bytes
+    size_t peakBytes;
+    size_t budget;
+    unsigned int loads;     // started so far
+    unsigned int evictions;
+    unsigned int deferred;  // frames a requested load waited for room
+    unsigned int failed;    // loads that failed, those items stay evicted
+};
+
+// Which meshes of a scene have their geometry loaded, under a byte budget. Items are
+// touched with the frame they were visible in; visible items that are not resident are
+// requested, and update() starts their loads, making room by evicting the least
+// recently visible items. Items seen in the last keepFrames frames are never evicted,
+// so a visible set larger than the budget waits instead of thrashing.
+// Bookkeeping only: the host loads, uploads and frees the geometry.
+class ResidencyManager {
+public:
+    enum State { Evicted, Loading, Resident };
+    static const unsigned int NoItem = 0xffffffffu;
+
+    // budgetBytes 0 keeps everything resident
+    explicit ResidencyManager(size_t budgetBytes = 0);
+
+    unsigned int add(size_t bytes, State state);
+    void touch(unsigned int item, unsigned int frame);
+
+    // Starts up to maxLoads of the requested loads that fit, appending them to loads,
+    // and appends the items evicted for them or to get back under the budget
+    void update(unsigned int frame, unsigned int keepFrames, unsigned int maxLoads,
+                std::vector<unsigned int> & loads, std::vector<unsigned int> & evictions);
+    // Loading -> Resident, or Evicted when the load failed; a failed item is not
+    // requested again
+    void finishLoad(unsigned int item, bool loaded);
+
+    State getState(unsigned int item) const { return items[item].state; }
+    size_t getBudget() const { return budget; }
+    size_t getResidentBytes() const { return residentBytes; }
+    bool hasBudget() const { return budget != 0; }
+    ResidencyStats getStats() const;
+
+private:
+    struct Item {
+        size_t bytes;
+        unsigned int lastFrame;
+        unsigned int prev, next;    // LRU list of resident and loading items
+        State state;
+        bool requested;
+        bool failed;
+    };
+
+    void link(unsigned int item);
+    void unlink(unsigned int item);
+    bool evictOne(unsigned int frame, unsigned int keepFrames, std::vector<unsigned int> & evictions);
+
+    std::vector<Item> items;
+    std::vector<unsigned int> requests;
+    unsigned int head, tail;    // most and least recently visible
+    size_t budget;
+    size_t residentBytes, peakBytes;
+    unsigned int loads, evictionCount, deferred, failures;
+};
+
+// Geometry of one mesh read by MeshStreamer
+struct StreamedMesh {
+    unsigned int item;
+    bool loaded;
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    MeshBVH bvh;            // of the vertices, for picking
+};
+
+// Reads .obj files with loadOBJ, or mesh chunks of a bundle, on a thread of its own, so
+// evicted meshes come back without stalling frames, with their pick BVH built. The render
+// thread request()s meshes and poll()s the finished ones, then uploads them itself.
+class MeshStreamer {
+public:
+    MeshStreamer();
+    ~MeshStreamer();
+
+    // Meshes requested with a chunk are read from bundle, which must stay open until stop()
+    void start(const SceneBundle * bundle = NULL);
+    // Drops the requests not started yet and waits for the current one
+    void stop();
+
+    void request(unsigned int item, const std::string & path, int chunk = -1);
+    // Moves the finished meshes to the end of done, returns how many
+    size_t poll(std::vector<StreamedMesh> & done);
+
+private:
+    struct Request {
+        unsigned int item;
+        std::string path;
+        int chunk;
+    };
+
+    void workerLoop();
+
+    const SceneBundle * bundle;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Request> requests;
+    std::vector<StreamedMesh> finished;
+    bool running, quit;
+};
+
+#endif
@@ -0,0 +1,46 @@
+// Include standard headers
+#include <stdio.h>
+
+#include <GL/glew.h>
+
+#include "samplecounter.hpp"
+
+SampleCounter::SampleCounter() : current(0) {
+    queries[0] = queries[1] = 0;
+    issued[0] = issued[1] = false;
+}
+
+void SampleCounter::create() {
+    glGenQueries(2, queries);
+    issued[0] = issued[1] = false;
+    current = 0;
+}
+
+void SampleCounter::destroy() {
+    if (queries[0])
+        glDeleteQueries(2, queries);
+    queries[0] = queries[1] = 0;
+}
+
+void SampleCounter::begin() {
+    glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+}
+
+void SampleCounter::end() {
+    glEndQuery(GL_SAMPLES_PASSED);
+    issued[current] = true;
+    current ^= 1;
+}
+
+bool SampleCounter::previous(GLuint64 & out_samples) {
+    // After end() current is the query issued one frame earlier
+    if (!issued[current])
+        return false;
+    GLuint available = 0;
+    glGetQueryObjectuiv(queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+    glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &out_samples);
+    issued[current] = false;
+    return true;
+}
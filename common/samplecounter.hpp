@@ -0,0 +1,26 @@
+#ifndef SAMPLECOUNTER_HPP
+#define SAMPLECOUNTER_HPP
+
+// Counts the samples that pass the depth test between begin() and end(), i.e. the
+// fragments that get shaded. Like the profiler's timers it alternates between two
+// GL_SAMPLES_PASSED queries and reads each result a frame later.
+class SampleCounter {
+public:
+    SampleCounter();
+
+    void create();
+    void destroy();
+
+    void begin();
+    void end();
+    // Result of the query ended before the last one; false when there is none or it
+    // is not available yet
+    bool previous(GLuint64 & out_samples);
+
+private:
+    GLuint queries[2];
+    bool issued[2];
+    int current;
+};
+
+#endif
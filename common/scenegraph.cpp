@@ -0,0 +1,90 @@
+// Include standard headers
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "transformbatch.hpp"
+#include "scenegraph.hpp"
+
+const unsigned int SceneGraph::NoParent;
+
+SceneGraph::SceneGraph() {
+}
+
+void SceneGraph::reserve(size_t count) {
+    parents.reserve(count);
+    firstChild.reserve(count);
+    nextSibling.reserve(count);
+    locals.reserve(count);
+    worlds.reserve(count);
+    localBounds.reserve(count);
+    worldBounds.reserve(count);
+    flags.reserve(count);
+}
+
+unsigned int SceneGraph::addNode(unsigned int parent, const glm::mat4 & local, const AABB * bounds) {
+    unsigned int node = (unsigned int)parents.size();
+    parents.push_back(parent);
+    firstChild.push_back(NoParent);
+    nextSibling.push_back(NoParent);
+    if (parent != NoParent) {
+        nextSibling[node] = firstChild[parent];
+        firstChild[parent] = node;
+    }
+    locals.push_back(local);
+    worlds.push_back(parent != NoParent ? worlds[parent] * local : local);
+    AABB empty = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    localBounds.push_back(bounds ? *bounds : empty);
+    worldBounds.push_back(bounds ? transformAABB(*bounds, worlds[node]) : empty);
+    flags.push_back(bounds ? HasBounds : 0);
+    return node;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4 & local) {
+    locals[node] = local;
+    if (!(flags[node] & Dirty)) {
+        flags[node] |= Dirty;
+        dirty.push_back(node);
+    }
+}
+
+void SceneGraph::updateNode(unsigned int node) {
+    unsigned int parent = parents[node];
+    if (parent != NoParent)
+        multiplyMatrices(worlds[parent], &locals[node], &worlds[node], 1);
+    else
+        worlds[node] = locals[node];
+    if (flags[node] & HasBounds)
+        worldBounds[node] = transformAABB(localBounds[node], worlds[node]);
+    flags[node] &= ~Dirty;
+}
+
+size_t SceneGraph::update() {
+    changed.clear();
+    // Ancestors have lower indices, so they are handled first and clear the dirty
+    // flags of everything below them
+    std::sort(dirty.begin(), dirty.end());
+    for (size_t d = 0; d < dirty.size(); d++) {
+        if (!(flags[dirty[d]] & Dirty))
+            continue;
+        stack.push_back(dirty[d]);
+        while (!stack.empty()) {
+            unsigned int node = stack.back();
+            stack.pop_back();
+            updateNode(node);
+            changed.push_back(node);
+            for (unsigned int child = firstChild[node]; child != NoParent; child = nextSibling[child])
+                stack.push_back(child);
+        }
+    }
+    dirty.clear();
+    return changed.size();
+}
+
+void SceneGraph::updateAll() {
+    for (unsigned int node = 0; node < parents.size(); node++)
+        updateNode(node);
+    dirty.clear();
+    changed.clear();
+}
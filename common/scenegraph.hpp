@@ -0,0 +1,56 @@
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+// Parent/child transform hierarchy in flat arrays.
+// A node can only be added below an existing one, so parents always come before their
+// children and a single pass in array order computes every world matrix (updateAll).
+// setLocal() marks a node dirty; update() then only walks the subtrees below dirty
+// nodes, so moving one node costs the size of its subtree and not of the scene.
+// Bounds are per node (its own mesh, in local space) and are not merged over children.
+class SceneGraph {
+public:
+    static const unsigned int NoParent = 0xffffffffu;
+
+    SceneGraph();
+
+    void reserve(size_t count);
+    // New node below parent (NoParent for a root), bounds NULL for nodes without a mesh
+    unsigned int addNode(unsigned int parent, const glm::mat4 & local, const AABB * bounds = NULL);
+    void setLocal(unsigned int node, const glm::mat4 & local);
+
+    // World matrices and bounds of every dirty subtree, returns the number of nodes updated
+    size_t update();
+    // Reference: every node in array order
+    void updateAll();
+
+    // Nodes whose world matrix changed in the last update(), parents before children
+    const std::vector<unsigned int> & getChanged() const { return changed; }
+
+    size_t size() const { return parents.size(); }
+    unsigned int getParent(unsigned int node) const { return parents[node]; }
+    const glm::mat4 & getLocal(unsigned int node) const { return locals[node]; }
+    const glm::mat4 & getWorld(unsigned int node) const { return worlds[node]; }
+    bool hasBounds(unsigned int node) const { return (flags[node] & HasBounds) != 0; }
+    const AABB & getWorldBounds(unsigned int node) const { return worldBounds[node]; }
+
+private:
+    enum Flags { Dirty = 1, HasBounds = 2 };
+
+    void updateNode(unsigned int node);
+
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> firstChild, nextSibling;
+    std::vector<glm::mat4> locals, worlds;
+    std::vector<AABB> localBounds, worldBounds;
+    std::vector<unsigned char> flags;
+    std::vector<unsigned int> dirty;        // nodes given a new local matrix since the last update
+    std::vector<unsigned int> changed;
+    std::vector<unsigned int> stack;
+};
+
+#endif
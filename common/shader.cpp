@@ -3,6 +3,7 @@
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
 using namespace std;
 
@@ -13,97 +14,100 @@ using namespace std;
 
 #include "shader.hpp"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
-		return 0;
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
-	}
-
+bool ReadShaderFile(const char * file_path, std::string & code){
+	std::ifstream ShaderStream(file_path, std::ios::in | std::ios::binary);
+	if(!ShaderStream.is_open())
+		return false;
+	// One read of the whole file instead of growing the string line by line
+	std::stringstream Buffer;
+	Buffer << ShaderStream.rdbuf();
+	code = Buffer.str();
+	return true;
+}
 
+static GLuint CompileShader(GLenum type, const char * source, const char * name){
+	GLuint ShaderID = glCreateShader(type);
+	glShaderSource(ShaderID, 1, &source , NULL);
+	glCompileShader(ShaderID);
 
+	// Check the shader, warnings are printed too
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
-
-
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 1 ){
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s:\n%s\n", name, &ShaderErrorMessage[0]);
 	}
-
-
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+	if ( Result != GL_TRUE ){
+		printf("Compiling shader %s failed\n", name);
+		glDeleteShader(ShaderID);
+		return 0;
 	}
+	return ShaderID;
+}
 
+GLuint CompileProgram(const std::string & vertex_code, const std::string & fragment_code,
+                      const char * vertex_name, const char * fragment_name, bool retrievable){
 
+	printf("Compiling shader : %s\n", vertex_name);
+	GLuint VertexShaderID = CompileShader(GL_VERTEX_SHADER, vertex_code.c_str(), vertex_name);
+	printf("Compiling shader : %s\n", fragment_name);
+	GLuint FragmentShaderID = CompileShader(GL_FRAGMENT_SHADER, fragment_code.c_str(), fragment_name);
+	if ( !VertexShaderID || !FragmentShaderID ){
+		glDeleteShader(VertexShaderID);
+		glDeleteShader(FragmentShaderID);
+		return 0;
+	}
 
 	// Link the program
 	printf("Linking program\n");
 	GLuint ProgramID = glCreateProgram();
+	if ( retrievable )
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
 
 	// Check the program
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
 	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
 	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
+	if ( InfoLogLength > 1 ){
 		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
 		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
 		printf("%s\n", &ProgramErrorMessage[0]);
 	}
 
+	glDetachShader(ProgramID, VertexShaderID);
+	glDetachShader(ProgramID, FragmentShaderID);
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
 
+	if ( Result != GL_TRUE ){
+		printf("Linking %s + %s failed\n", vertex_name, fragment_name);
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
 	return ProgramID;
 }
 
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+
+	// Read the shader code from the files
+	std::string VertexShaderCode;
+	if(!ReadShaderFile(vertex_file_path, VertexShaderCode)){
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
+		getchar();
+		return 0;
+	}
+	std::string FragmentShaderCode;
+	if(!ReadShaderFile(fragment_file_path, FragmentShaderCode)){
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", fragment_file_path);
+		return 0;
+	}
 
+	return CompileProgram(VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path);
+}
@@ -1,6 +1,17 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <string>
+
+// Whole file into code, false if it can't be opened
+bool ReadShaderFile(const char * file_path, std::string & code);
+
+// Compiles and links a program from GLSL sources, 0 if either step fails.
+// The names only label the messages. retrievable asks the driver to keep the
+// program binary around for glGetProgramBinary.
+GLuint CompileProgram(const std::string & vertex_code, const std::string & fragment_code,
+                      const char * vertex_name, const char * fragment_name, bool retrievable = false);
+
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
 #endif
@@ -0,0 +1,212 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "shader.hpp"
+#include "programcache.hpp"
+#include "shadervariants.hpp"
+
+// GLEW predates the KHR version, its enums are the ARB ones
+static bool hasExtension(const char * name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const GLubyte * extension = glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp((const char *)extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Prints the log of a shader or program, true if its status is GL_TRUE
+static bool checkStatus(GLuint object, bool program, const char * name) {
+    GLint result = GL_FALSE, length = 0;
+    if (program) {
+        glGetProgramiv(object, GL_LINK_STATUS, &result);
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    } else {
+        glGetShaderiv(object, GL_COMPILE_STATUS, &result);
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    }
+    if (length > 1) {
+        std::vector<char> message(length + 1);
+        if (program)
+            glGetProgramInfoLog(object, length, NULL, &message[0]);
+        else
+            glGetShaderInfoLog(object, length, NULL, &message[0]);
+        printf("%s:\n%s\n", name, &message[0]);
+    }
+    return result == GL_TRUE;
+}
+
+ShaderVariants::ShaderVariants() : cache(NULL) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool ShaderVariants::initialize(const char * vertex_file_path, const char * fragment_file_path,
+                                const char * const * names, int featureCount, ProgramCache * programCache) {
+    if (!ReadShaderFile(vertex_file_path, vertexCode)) {
+        printf("Impossible to open %s\n", vertex_file_path);
+        return false;
+    }
+    if (!ReadShaderFile(fragment_file_path, fragmentCode)) {
+        printf("Impossible to open %s\n", fragment_file_path);
+        return false;
+    }
+    vertexName = vertex_file_path;
+    fragmentName = fragment_file_path;
+    featureNames.assign(names, names + featureCount);
+    cache = programCache;
+
+    stats.parallel = GLEW_ARB_parallel_shader_compile || hasExtension("GL_KHR_parallel_shader_compile");
+    if (GLEW_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);  // as many as the driver likes
+    return true;
+}
+
+void ShaderVariants::destroy() {
+    for (size_t i = 0; i < variants.size(); i++) {
+        glDeleteShader(variants[i].vertexShader);
+        glDeleteShader(variants[i].fragmentShader);
+        glDeleteProgram(variants[i].program);
+    }
+    variants.clear();
+}
+
+int ShaderVariants::request(unsigned int features) {
+    stats.requests++;
+    for (size_t i = 0; i < variants.size(); i++) {
+        if (variants[i].features == features)
+            return (int)i;
+    }
+    Variant variant;
+    memset(&variant, 0, sizeof(variant));
+    variant.features = features;
+    variants.push_back(variant);
+    stats.variants++;
+    return (int)variants.size() - 1;
+}
+
+std::string ShaderVariants::withDefines(const std::string & code, unsigned int features) const {
+    std::string defines;
+    for (size_t i = 0; i < featureNames.size(); i++) {
+        if (features & (1u << i))
+            defines += "#define " + featureNames[i] + " 1\n";
+    }
+    // #version has to stay first; #line keeps the line numbers of messages right
+    size_t insert = 0;
+    if (code.compare(0, 8, "#version") == 0) {
+        size_t end = code.find('\n');
+        insert = end == std::string::npos ? code.size() : end + 1;
+        return code.substr(0, insert) + defines + "#line 2\n" + code.substr(insert);
+    }
+    return defines + "#line 1\n" + code;
+}
+
+void ShaderVariants::compile() {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Variants stored by an earlier start need no compile at all
+    std::vector<size_t> pending;
+    std::vector<std::string> sources(2 * variants.size());
+    for (size_t i = 0; i < variants.size(); i++) {
+        Variant & v = variants[i];
+        if (v.program || v.compiling)
+            continue;
+        sources[2 * i] = withDefines(vertexCode, v.features);
+        sources[2 * i + 1] = withDefines(fragmentCode, v.features);
+        if (cache) {
+            v.key = cache->makeKey(sources[2 * i], sources[2 * i + 1]);
+            v.program = cache->fetch(v.key);
+            if (v.program) {
+                stats.cached++;
+                continue;
+            }
+        }
+        pending.push_back(i);
+    }
+
+    // Every compile first, then every link, so no status query waits in between
+    for (size_t p = 0; p < pending.size(); p++) {
+        Variant & v = variants[pending[p]];
+        const char * vertex = sources[2 * pending[p]].c_str();
+        const char * fragment = sources[2 * pending[p] + 1].c_str();
+        v.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(v.vertexShader, 1, &vertex, NULL);
+        glCompileShader(v.vertexShader);
+        v.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(v.fragmentShader, 1, &fragment, NULL);
+        glCompileShader(v.fragmentShader);
+    }
+    for (size_t p = 0; p < pending.size(); p++) {
+        Variant & v = variants[pending[p]];
+        v.program = glCreateProgram();
+        if (cache && cache->isEnabled())
+            glProgramParameteri(v.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(v.program, v.vertexShader);
+        glAttachShader(v.program, v.fragmentShader);
+        glLinkProgram(v.program);
+        v.compiling = true;
+    }
+
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+bool ShaderVariants::ready() const {
+    if (!stats.parallel)
+        return true;
+    for (size_t i = 0; i < variants.size(); i++) {
+        if (!variants[i].compiling)
+            continue;
+        GLint done = GL_TRUE;
+        glGetProgramiv(variants[i].program, GL_COMPLETION_STATUS_ARB, &done);
+        if (!done)
+            return false;
+    }
+    return true;
+}
+
+bool ShaderVariants::finish() {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    bool ok = true;
+    for (size_t i = 0; i < variants.size(); i++) {
+        Variant & v = variants[i];
+        if (!v.compiling)
+            continue;
+        char name[64];
+        snprintf(name, sizeof(name), "variant %#x", v.features);
+        std::string vertex = vertexName + " (" + name + ")";
+        std::string fragment = fragmentName + " (" + name + ")";
+        bool compiled = checkStatus(v.vertexShader, false, vertex.c_str());
+        compiled = checkStatus(v.fragmentShader, false, fragment.c_str()) && compiled;
+        bool linked = compiled && checkStatus(v.program, true, name);
+
+        glDetachShader(v.program, v.vertexShader);
+        glDetachShader(v.program, v.fragmentShader);
+        glDeleteShader(v.vertexShader);
+        glDeleteShader(v.fragmentShader);
+        v.vertexShader = v.fragmentShader = 0;
+        v.compiling = false;
+
+        if (!linked) {
+            printf("Building %s + %s, %s failed\n", vertexName.c_str(), fragmentName.c_str(), name);
+            glDeleteProgram(v.program);
+            v.program = 0;
+            stats.failed++;
+            ok = false;
+            continue;
+        }
+        stats.compiled++;
+        if (cache)
+            cache->store(v.program, v.key);
+    }
+
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return ok;
+}
@@ -0,0 +1,72 @@
+#ifndef SHADERVARIANTS_HPP
+#define SHADERVARIANTS_HPP
+
+#include <string>
+#include <vector>
+
+class ProgramCache;
+
+struct ShaderVariantStats {
+    unsigned int variants;      // distinct feature sets requested
+    unsigned int requests;      // request() calls, most of them share a variant
+    unsigned int compiled;      // variants compiled from source
+    unsigned int cached;        // variants loaded from program binaries
+    unsigned int failed;
+    bool parallel;              // the driver compiles in the background
+    double milliseconds;        // time spent in compile() and finish()
+};
+
+// Programs built from one pair of sources with a different set of features each.
+// Feature bit i #defines featureNames[i] right after the #version line, so a shader
+// keeps the code of a feature inside #ifdef NAME and a variant without the feature
+// doesn't pay for it. Variants are identified by their feature bits, asking twice for
+// the same set returns the same variant.
+//
+// compile() starts every new variant: all shaders are compiled, then all programs
+// linked, and nothing is checked until finish(). With ARB/KHR_parallel_shader_compile
+// the driver does this on its own threads and ready() tells when it is done, so the
+// caller can load other data in between; without it the driver at least gets the
+// whole batch before the first status query forces it to finish a program.
+class ShaderVariants {
+public:
+    ShaderVariants();
+
+    // Reads the sources, the cache is optional and must outlive this object
+    bool initialize(const char * vertex_file_path, const char * fragment_file_path,
+                    const char * const * featureNames, int featureCount, ProgramCache * cache = NULL);
+    void destroy();
+
+    // Index of the variant with these features, new ones are built by the next compile()
+    int request(unsigned int features);
+
+    void compile();
+    // False while a variant is still compiling in the background
+    bool ready() const;
+    // Waits for the variants compile() started and checks them, false if one failed
+    bool finish();
+
+    int count() const { return (int)variants.size(); }
+    GLuint getProgram(int variant) const { return variants[variant].program; }
+    unsigned int getFeatures(int variant) const { return variants[variant].features; }
+    const ShaderVariantStats & getStats() const { return stats; }
+
+private:
+    struct Variant {
+        unsigned int features;
+        GLuint program;
+        GLuint vertexShader, fragmentShader;    // while compiling
+        unsigned long long key;                 // program cache key
+        bool compiling;
+    };
+
+    std::string withDefines(const std::string & code, unsigned int features) const;
+
+    std::string vertexCode, fragmentCode;
+    std::string vertexName, fragmentName;
+    std::vector<std::string> featureNames;
+    ProgramCache * cache;
+    std::vector<Variant> variants;
+    ShaderVariantStats stats;
+};
+
+#endif
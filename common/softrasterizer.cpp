@@ -0,0 +1,524 @@
+// Include standard headers
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SOFTRASTER_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRASTER_SSE 1
+#endif
+
+#include "softrasterizer.hpp"
+
+static const int TileSize = 64;
+// Triangles of one geometry job. The visibility buffer stores the job in the upper
+// bits of a triangle id and its index in the job (near plane clipping makes at most
+// twice as many triangles) below TriangleBits.
+static const size_t JobTriangles = 4096;
+static const int TriangleBits = 20;
+static const size_t MaxJobs = 1 << (32 - TriangleBits);
+static const unsigned int NoTriangle = 0xffffffffu;
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+SoftTexture::SoftTexture() {
+}
+
+bool SoftTexture::create(const unsigned char * bgr, int w, int h) {
+    levels.clear();
+    if (!bgr || w <= 0 || h <= 0)
+        return false;
+
+    Level base;
+    base.width = w;
+    base.height = h;
+    base.powerOfTwo = (w & (w - 1)) == 0 && (h & (h - 1)) == 0;
+    base.texels.resize(w * h * 4);
+    int stride = (w * 3 + 3) & ~3;
+    for (int y = 0; y < h; y++) {
+        const unsigned char * row = bgr + y * stride;
+        unsigned char * out = &base.texels[y * w * 4];
+        for (int x = 0; x < w; x++, out += 4) {
+            out[0] = row[x * 3 + 2];
+            out[1] = row[x * 3 + 1];
+            out[2] = row[x * 3];
+            out[3] = 255;
+        }
+    }
+    levels.push_back(base);
+
+    // Box filtered chain down to 1x1, like glGenerateMipmap
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level & prev = levels.back();
+        Level next;
+        next.width = std::max(1, prev.width / 2);
+        next.height = std::max(1, prev.height / 2);
+        next.powerOfTwo = prev.powerOfTwo;
+        next.texels.resize(next.width * next.height * 4);
+        for (int y = 0; y < next.height; y++) {
+            int y0 = std::min(2 * y, prev.height - 1), y1 = std::min(2 * y + 1, prev.height - 1);
+            for (int x = 0; x < next.width; x++) {
+                int x0 = std::min(2 * x, prev.width - 1), x1 = std::min(2 * x + 1, prev.width - 1);
+                for (int c = 0; c < 4; c++)
+                    next.texels[(y * next.width + x) * 4 + c] = (unsigned char)((prev.texels[(y0 * prev.width + x0) * 4 + c] +
+                        prev.texels[(y0 * prev.width + x1) * 4 + c] + prev.texels[(y1 * prev.width + x0) * 4 + c] +
+                        prev.texels[(y1 * prev.width + x1) * 4 + c] + 2) / 4);
+            }
+        }
+        levels.push_back(next);
+    }
+    return true;
+}
+
+glm::vec3 SoftTexture::sampleLevel(const Level & level, const glm::vec2 & uv) const {
+    float fx = uv.x * level.width - 0.5f, fy = uv.y * level.height - 0.5f;
+    // floor without a libm call
+    int ix = (int)fx, iy = (int)fy;
+    ix -= (float)ix > fx;
+    iy -= (float)iy > fy;
+    float sx = fx - ix, sy = fy - iy;
+    // GL_REPEAT; power of two sizes wrap with a mask, negative coordinates included
+    int x0, y0;
+    if (level.powerOfTwo) {
+        x0 = ix & (level.width - 1);
+        y0 = iy & (level.height - 1);
+    } else {
+        x0 = ix % level.width;
+        y0 = iy % level.height;
+        if (x0 < 0) x0 += level.width;
+        if (y0 < 0) y0 += level.height;
+    }
+    int x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+    int y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+    const unsigned char * row0 = &level.texels[y0 * level.width * 4];
+    const unsigned char * row1 = &level.texels[y1 * level.width * 4];
+    glm::vec3 t00(row0[x0 * 4], row0[x0 * 4 + 1], row0[x0 * 4 + 2]), t01(row0[x1 * 4], row0[x1 * 4 + 1], row0[x1 * 4 + 2]);
+    glm::vec3 t10(row1[x0 * 4], row1[x0 * 4 + 1], row1[x0 * 4 + 2]), t11(row1[x1 * 4], row1[x1 * 4 + 1], row1[x1 * 4 + 2]);
+    glm::vec3 top = t00 + sx * (t01 - t00);
+    glm::vec3 bottom = t10 + sx * (t11 - t10);
+    return (top + sy * (bottom - top)) * (1.0f / 255.0f);
+}
+
+glm::vec3 SoftTexture::sample(const glm::vec2 & uv, float lod) const {
+    if (levels.empty())
+        return glm::vec3(1.0f);
+    // GL_LINEAR magnification, GL_LINEAR_MIPMAP_LINEAR minification
+    lod = std::min(std::max(lod, 0.0f), (float)(levels.size() - 1));
+    int level = (int)lod;
+    float blend = lod - level;
+    glm::vec3 c = sampleLevel(levels[level], uv);
+    if (blend > 0.0f && level + 1 < (int)levels.size())
+        c += blend * (sampleLevel(levels[level + 1], uv) - c);
+    return c;
+}
+
+SoftRasterizer::SoftRasterizer() {
+    width = height = 0;
+    tilesX = tilesY = 0;
+    viewProjection = glm::mat4(1.0f);
+    clear = glm::vec3(0.0f);
+    jobCount = 0;
+    stats = SoftRasterStats();
+}
+
+void SoftRasterizer::resize(int w, int h) {
+    width = w;
+    height = h;
+    tilesX = (w + TileSize - 1) / TileSize;
+    tilesY = (h + TileSize - 1) / TileSize;
+    color.assign(w * h * 3, 0);
+    tileShaded.assign(tilesX * tilesY, 0);
+}
+
+void SoftRasterizer::beginFrame(const glm::mat4 & VP, const glm::vec3 & clearColor) {
+    viewProjection = VP;
+    clear = clearColor;
+    draws.clear();
+    jobCount = 0;
+    stats = SoftRasterStats();
+}
+
+void SoftRasterizer::addDraw(const SoftDraw & draw) {
+    draws.push_back(draw);
+}
+
+void SoftRasterizer::setupTriangle(GeometryJob & job, const SoftDraw & draw,
+                                   const ClipVertex & c0, const ClipVertex & c1, const ClipVertex & c2) {
+    Triangle t;
+    const ClipVertex * c[3] = { &c0, &c1, &c2 };
+    glm::vec2 v[3];
+    float z[3];
+    for (int i = 0; i < 3; i++) {
+        float invW = 1.0f / c[i]->clip.w;
+        // Window coordinates with the first row at the top
+        v[i] = glm::vec2((c[i]->clip.x * invW * 0.5f + 0.5f) * width,
+                         (0.5f - c[i]->clip.y * invW * 0.5f) * height);
+        z[i] = c[i]->clip.z * invW * 0.5f + 0.5f;
+        t.invW[i] = invW;
+        t.uv[i] = c[i]->uv;
+        t.color[i] = c[i]->color;
+    }
+
+    // Orient counter clockwise so inside means all edge functions positive; nothing is
+    // culled by facing, like the GL path
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+    if (area == 0.0f || area != area)
+        return;
+    if (area < 0.0f) {
+        std::swap(v[1], v[2]);
+        std::swap(z[1], z[2]);
+        std::swap(t.invW[1], t.invW[2]);
+        std::swap(t.uv[1], t.uv[2]);
+        std::swap(t.color[1], t.color[2]);
+        area = -area;
+    }
+
+    // Pixels whose centres may be inside
+    glm::vec2 lo = glm::min(v[0], glm::min(v[1], v[2]));
+    glm::vec2 hi = glm::max(v[0], glm::max(v[1], v[2]));
+    lo = glm::clamp(lo, glm::vec2(-1.0f), glm::vec2((float)width, (float)height));
+    hi = glm::clamp(hi, glm::vec2(-1.0f), glm::vec2((float)width, (float)height));
+    t.minX = std::max(0, (int)std::ceil(lo.x - 0.5f));
+    t.minY = std::max(0, (int)std::ceil(lo.y - 0.5f));
+    t.maxX = std::min(width - 1, (int)std::floor(hi.x - 0.5f));
+    t.maxY = std::min(height - 1, (int)std::floor(hi.y - 0.5f));
+    if (t.minX > t.maxX || t.minY > t.maxY)
+        return;
+
+    for (int e = 0; e < 3; e++) {
+        const glm::vec2 & a = v[e];
+        const glm::vec2 & b = v[(e + 1) % 3];
+        t.v[e] = a;
+        t.A[e] = a.y - b.y;
+        t.B[e] = b.x - a.x;
+    }
+    // Depth from the differences to vertex 0; the depths themselves are all close to 1
+    // for distant triangles
+    t.invArea = 1.0f / area;
+    glm::vec2 e1 = v[1] - v[0], e2 = v[2] - v[0];
+    float dz1 = z[1] - z[0], dz2 = z[2] - z[0];
+    t.z0 = z[0];
+    t.zA = (dz1 * e2.y - dz2 * e1.y) * t.invArea;
+    t.zB = (dz2 * e1.x - dz1 * e2.x) * t.invArea;
+
+    // Texels per pixel from the areas; one level for the whole triangle
+    t.texture = draw.texture;
+    t.lod = 0.0f;
+    if (t.texture) {
+        glm::vec2 du = t.uv[1] - t.uv[0], dv = t.uv[2] - t.uv[0];
+        float texels = std::fabs(du.x * dv.y - du.y * dv.x) * t.texture->getWidth() * t.texture->getHeight();
+        if (texels > 0.0f)
+            t.lod = 0.5f * std::log2(texels / area);
+    }
+    job.triangles.push_back(t);
+}
+
+void SoftRasterizer::transformDraw(GeometryJob & job, const SoftDraw & draw, size_t first, size_t end) {
+    glm::mat4 MVP = viewProjection * draw.M;
+    glm::mat3 N = glm::mat3(glm::transpose(glm::inverse(draw.M)));
+    const std::vector<glm::vec3> & positions = *draw.positions;
+    bool textured = draw.texture && draw.uvs;
+    bool lit = !textured && draw.normals;
+
+    for (size_t i = first; i < end; i++) {
+        ClipVertex c[3];
+        for (int k = 0; k < 3; k++) {
+            size_t index = i * 3 + k;
+            c[k].clip = MVP * glm::vec4(positions[index], 1.0f);
+            c[k].uv = textured ? (*draw.uvs)[index] : glm::vec2(0.0f);
+            if (lit) {
+                glm::vec3 n = glm::normalize(N * (*draw.normals)[index]);
+                c[k].color = draw.ambient + draw.diffuse * std::max(0.0f, n.x);
+            } else {
+                c[k].color = draw.ambient + draw.diffuse;
+            }
+        }
+
+        // Entirely outside one side of the frustum
+        if ((c[0].clip.x > c[0].clip.w && c[1].clip.x > c[1].clip.w && c[2].clip.x > c[2].clip.w) ||
+            (c[0].clip.x < -c[0].clip.w && c[1].clip.x < -c[1].clip.w && c[2].clip.x < -c[2].clip.w) ||
+            (c[0].clip.y > c[0].clip.w && c[1].clip.y > c[1].clip.w && c[2].clip.y > c[2].clip.w) ||
+            (c[0].clip.y < -c[0].clip.w && c[1].clip.y < -c[1].clip.w && c[2].clip.y < -c[2].clip.w) ||
+            (c[0].clip.z > c[0].clip.w && c[1].clip.z > c[1].clip.w && c[2].clip.z > c[2].clip.w))
+            continue;
+
+        // Clip against the near plane (z = -w); at most one extra triangle comes out
+        float d[3];
+        int inside = 0;
+        for (int k = 0; k < 3; k++) {
+            d[k] = c[k].clip.z + c[k].clip.w;
+            inside += d[k] >= 0.0f;
+        }
+        if (inside == 3) {
+            setupTriangle(job, draw, c[0], c[1], c[2]);
+        } else if (inside > 0) {
+            ClipVertex poly[4];
+            int n = 0;
+            for (int k = 0; k < 3; k++) {
+                int next = (k + 1) % 3;
+                if (d[k] >= 0.0f)
+                    poly[n++] = c[k];
+                if ((d[k] >= 0.0f) != (d[next] >= 0.0f)) {
+                    float s = d[k] / (d[k] - d[next]);
+                    poly[n].clip = c[k].clip + s * (c[next].clip - c[k].clip);
+                    poly[n].uv = c[k].uv + s * (c[next].uv - c[k].uv);
+                    poly[n].color = c[k].color + s * (c[next].color - c[k].color);
+                    n++;
+                }
+            }
+            for (int k = 1; k + 1 < n; k++)
+                setupTriangle(job, draw, poly[0], poly[k], poly[k + 1]);
+        }
+    }
+}
+
+void SoftRasterizer::runGeometry(GeometryJob & job) {
+    job.triangles.clear();
+    size_t end = job.first + job.count;
+    size_t d = std::upper_bound(drawStart.begin(), drawStart.end(), job.first) - drawStart.begin() - 1;
+    for (size_t i = job.first; i < end; d++) {
+        size_t drawEnd = std::min(end, drawStart[d + 1]);
+        if (drawEnd > i)
+            transformDraw(job, draws[d], i - drawStart[d], drawEnd - drawStart[d]);
+        i = drawEnd;
+    }
+
+    // Bin by the tiles of each bounding box: count, prefix sum, then fill
+    int tiles = tilesX * tilesY;
+    job.tileStart.assign(tiles + 1, 0);
+    for (size_t i = 0; i < job.triangles.size(); i++) {
+        const Triangle & t = job.triangles[i];
+        for (int ty = t.minY / TileSize; ty <= t.maxY / TileSize; ty++)
+            for (int tx = t.minX / TileSize; tx <= t.maxX / TileSize; tx++)
+                job.tileStart[ty * tilesX + tx + 1]++;
+    }
+    for (int tile = 0; tile < tiles; tile++)
+        job.tileStart[tile + 1] += job.tileStart[tile];
+    job.binned.resize(job.tileStart[tiles]);
+    for (size_t i = 0; i < job.triangles.size(); i++) {
+        const Triangle & t = job.triangles[i];
+        for (int ty = t.minY / TileSize; ty <= t.maxY / TileSize; ty++)
+            for (int tx = t.minX / TileSize; tx <= t.maxX / TileSize; tx++)
+                job.binned[job.tileStart[ty * tilesX + tx]++] = (unsigned int)i;
+    }
+    // Every start moved to the next one's, shift them back
+    for (int tile = tiles; tile > 0; tile--)
+        job.tileStart[tile] = job.tileStart[tile - 1];
+    job.tileStart[0] = 0;
+}
+
+void SoftRasterizer::rasterizeTile(int tile) {
+    const int originX = (tile % tilesX) * TileSize, originY = (tile / tilesX) * TileSize;
+    const int lastX = std::min(originX + TileSize, width) - 1, lastY = std::min(originY + TileSize, height) - 1;
+    const glm::vec2 tileOrigin((float)originX, (float)originY);
+
+    // Nearest depth and triangle of every pixel of the tile
+    float depth[TileSize * TileSize];
+    unsigned int visible[TileSize * TileSize];
+    std::fill(depth, depth + TileSize * TileSize, 1.0f);
+    std::fill(visible, visible + TileSize * TileSize, NoTriangle);
+
+    for (size_t j = 0; j < jobCount; j++) {
+        const GeometryJob & job = jobs[j];
+        for (unsigned int b = job.tileStart[tile]; b < job.tileStart[tile + 1]; b++) {
+            const Triangle & t = job.triangles[job.binned[b]];
+            const unsigned int id = (unsigned int)(j << TriangleBits) | job.binned[b];
+            // Edge functions and depth in tile coordinates. Written as a.x * b.y - a.y * b.x
+            // from the same tile origin, so the shared edge of two triangles evaluates to
+            // exactly opposite values in both and no pixel on it is missed.
+            float C[3];
+            for (int e = 0; e < 3; e++) {
+                glm::vec2 a = t.v[e] - tileOrigin, b = t.v[(e + 1) % 3] - tileOrigin;
+                C[e] = a.x * b.y - a.y * b.x;
+            }
+            const float zC = t.z0 - t.zA * (t.v[0].x - originX) - t.zB * (t.v[0].y - originY);
+            int y0 = std::max(t.minY, originY) - originY, y1 = std::min(t.maxY, lastY) - originY;
+            int x1 = std::min(t.maxX, lastX) - originX;
+#if defined(SOFTRASTER_AVX)
+            // Lanes outside the bounding box but inside the triangle may be written too,
+            // they are still in the tile
+            int x0 = (std::max(t.minX, originX) - originX) & ~7;
+            const __m256 stepX = _mm256_set_ps(7.5f, 6.5f, 5.5f, 4.5f, 3.5f, 2.5f, 1.5f, 0.5f);
+            const __m256 a0 = _mm256_set1_ps(t.A[0]), a1 = _mm256_set1_ps(t.A[1]), a2 = _mm256_set1_ps(t.A[2]);
+            const __m256 az = _mm256_set1_ps(t.zA);
+            const __m256 zero = _mm256_setzero_ps();
+            const __m256 ids = _mm256_castsi256_ps(_mm256_set1_epi32((int)id));
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                __m256 e0y = _mm256_set1_ps(t.B[0] * py + C[0]);
+                __m256 e1y = _mm256_set1_ps(t.B[1] * py + C[1]);
+                __m256 e2y = _mm256_set1_ps(t.B[2] * py + C[2]);
+                __m256 zy = _mm256_set1_ps(t.zB * py + zC);
+                float * depthRow = depth + y * TileSize;
+                float * visibleRow = (float *)(visible + y * TileSize);
+                for (int x = x0; x <= x1; x += 8) {
+                    __m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), stepX);
+                    __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), e0y);
+                    __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), e1y);
+                    __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), e2y);
+                    __m256 inside = _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                                    _mm256_and_ps(_mm256_cmp_ps(e1, zero, _CMP_GE_OQ), _mm256_cmp_ps(e2, zero, _CMP_GE_OQ)));
+                    if (_mm256_movemask_ps(inside) == 0)
+                        continue;
+                    __m256 z = _mm256_add_ps(_mm256_mul_ps(az, px), zy);
+                    __m256 old = _mm256_loadu_ps(depthRow + x);
+                    __m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, old, _CMP_LT_OQ));
+                    _mm256_storeu_ps(depthRow + x, _mm256_blendv_ps(old, z, pass));
+                    _mm256_storeu_ps(visibleRow + x, _mm256_blendv_ps(_mm256_loadu_ps(visibleRow + x), ids, pass));
+                }
+            }
+#elif defined(SOFTRASTER_SSE)
+            int x0 = (std::max(t.minX, originX) - originX) & ~3;
+            const __m128 stepX = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            const __m128 a0 = _mm_set1_ps(t.A[0]), a1 = _mm_set1_ps(t.A[1]), a2 = _mm_set1_ps(t.A[2]);
+            const __m128 az = _mm_set1_ps(t.zA);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 ids = _mm_castsi128_ps(_mm_set1_epi32((int)id));
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                __m128 e0y = _mm_set1_ps(t.B[0] * py + C[0]);
+                __m128 e1y = _mm_set1_ps(t.B[1] * py + C[1]);
+                __m128 e2y = _mm_set1_ps(t.B[2] * py + C[2]);
+                __m128 zy = _mm_set1_ps(t.zB * py + zC);
+                float * depthRow = depth + y * TileSize;
+                float * visibleRow = (float *)(visible + y * TileSize);
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), stepX);
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0y);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1y);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2y);
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+                    __m128 z = _mm_add_ps(_mm_mul_ps(az, px), zy);
+                    __m128 old = _mm_loadu_ps(depthRow + x);
+                    __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+                    _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+                    __m128 oldIds = _mm_loadu_ps(visibleRow + x);
+                    _mm_storeu_ps(visibleRow + x, _mm_or_ps(_mm_and_ps(pass, ids), _mm_andnot_ps(pass, oldIds)));
+                }
+            }
+#else
+            int x0 = std::max(t.minX, originX) - originX;
+            for (int y = y0; y <= y1; y++) {
+                float py = y + 0.5f;
+                float e0y = t.B[0] * py + C[0], e1y = t.B[1] * py + C[1], e2y = t.B[2] * py + C[2];
+                float zy = t.zB * py + zC;
+                float * depthRow = depth + y * TileSize;
+                unsigned int * visibleRow = visible + y * TileSize;
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f;
+                    if (t.A[0] * px + e0y >= 0.0f && t.A[1] * px + e1y >= 0.0f && t.A[2] * px + e2y >= 0.0f) {
+                        float z = t.zA * px + zy;
+                        if (z < depthRow[x]) {
+                            depthRow[x] = z;
+                            visibleRow[x] = id;
+                        }
+                    }
+                }
+            }
+#endif
+        }
+    }
+
+    // Shade each covered pixel once, from the triangle that won the depth test
+    glm::vec3 clamped = glm::clamp(clear, 0.0f, 1.0f);
+    const unsigned char background[3] = { (unsigned char)(clamped.r * 255.0f + 0.5f), (unsigned char)(clamped.g * 255.0f + 0.5f),
+                                          (unsigned char)(clamped.b * 255.0f + 0.5f) };
+    unsigned int shaded = 0;
+    for (int y = originY; y <= lastY; y++) {
+        const unsigned int * visibleRow = visible + (y - originY) * TileSize;
+        unsigned char * out = &color[(y * width + originX) * 3];
+        float py = y + 0.5f;
+        for (int x = 0; x <= lastX - originX; x++, out += 3) {
+            unsigned int id = visibleRow[x];
+            if (id == NoTriangle) {
+                out[0] = background[0];
+                out[1] = background[1];
+                out[2] = background[2];
+                continue;
+            }
+            const Triangle & t = jobs[id >> TriangleBits].triangles[id & ((1u << TriangleBits) - 1)];
+            float px = originX + x + 0.5f;
+            // Perspective correct barycentrics, each edge function from its first vertex;
+            // edge e weights vertex (e + 2) % 3
+            float w0 = (t.A[1] * (px - t.v[1].x) + t.B[1] * (py - t.v[1].y)) * t.invW[0];
+            float w1 = (t.A[2] * (px - t.v[2].x) + t.B[2] * (py - t.v[2].y)) * t.invW[1];
+            float w2 = (t.A[0] * (px - t.v[0].x) + t.B[0] * (py - t.v[0].y)) * t.invW[2];
+            float sum = w0 + w1 + w2;
+            if (sum > 0.0f) {
+                float scale = 1.0f / sum;
+                w0 *= scale;
+                w1 *= scale;
+                w2 *= scale;
+            }
+            glm::vec3 c;
+            if (t.texture)
+                c = t.texture->sample(w0 * t.uv[0] + w1 * t.uv[1] + w2 * t.uv[2], t.lod);
+            else
+                c = w0 * t.color[0] + w1 * t.color[1] + w2 * t.color[2];
+            c = glm::clamp(c, 0.0f, 1.0f);
+            out[0] = (unsigned char)(c.r * 255.0f + 0.5f);
+            out[1] = (unsigned char)(c.g * 255.0f + 0.5f);
+            out[2] = (unsigned char)(c.b * 255.0f + 0.5f);
+            shaded++;
+        }
+    }
+    tileShaded[tile] = shaded;
+}
+
+void SoftRasterizer::render(ThreadPool & pool) {
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Split the frame into jobs of consecutive triangles. Very large frames get larger
+    // jobs so job indices still fit the visibility buffer ids.
+    drawStart.resize(draws.size() + 1);
+    drawStart[0] = 0;
+    for (size_t d = 0; d < draws.size(); d++)
+        drawStart[d + 1] = drawStart[d] + draws[d].positions->size() / 3;
+    size_t totalTriangles = drawStart.back();
+    size_t perJob = std::max(JobTriangles, (totalTriangles + MaxJobs - 1) / MaxJobs);
+    jobCount = (totalTriangles + perJob - 1) / perJob;
+    if (jobs.size() < jobCount)
+        jobs.resize(jobCount);
+    for (size_t j = 0; j < jobCount; j++) {
+        jobs[j].first = j * perJob;
+        jobs[j].count = std::min(perJob, totalTriangles - jobs[j].first);
+    }
+    pool.parallelFor((int)jobCount, [this](int j) { runGeometry(jobs[j]); });
+
+    stats.draws = (unsigned int)draws.size();
+    stats.triangles = (unsigned int)totalTriangles;
+    for (size_t j = 0; j < jobCount; j++) {
+        stats.rasterized += (unsigned int)jobs[j].triangles.size();
+        stats.binned += (unsigned int)jobs[j].binned.size();
+    }
+    stats.geometryMilliseconds = millisecondsSince(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    pool.parallelFor(tilesX * tilesY, [this](int tile) { rasterizeTile(tile); });
+    for (size_t tile = 0; tile < tileShaded.size(); tile++)
+        stats.shaded += tileShaded[tile];
+    stats.rasterMilliseconds = millisecondsSince(start);
+}
+
+bool SoftRasterizer::savePPM(const char * path) const {
+    FILE * file = fopen(path, "wb");
+    if (!file) {
+        printf("Impossible to write %s\n", path);
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    fwrite(&color[0], 1, color.size(), file);
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,139 @@
+#ifndef SOFTRASTERIZER_HPP
+#define SOFTRASTERIZER_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "threadpool.hpp"
+
+// Mipmapped RGB texture for the software rasterizer, sampled trilinearly with repeat
+// wrapping like the GL textures of loadBMP_custom
+class SoftTexture {
+public:
+    SoftTexture();
+
+    // BGR rows bottom to top, each padded to 4 bytes, as returned by loadBMP_pixels
+    bool create(const unsigned char * bgr, int width, int height);
+
+    // Colour at uv; lod is log2 of the texels covered by one pixel
+    glm::vec3 sample(const glm::vec2 & uv, float lod) const;
+
+    int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (size_t i = 0; i < levels.size(); i++)
+            bytes += levels[i].texels.size();
+        return bytes;
+    }
+
+private:
+    struct Level {
+        int width, height;
+        bool powerOfTwo;
+        std::vector<unsigned char> texels;  // RGBA, 8 bits each
+    };
+    glm::vec3 sampleLevel(const Level & level, const glm::vec2 & uv) const;
+
+    std::vector<Level> levels;
+};
+
+// One mesh instance for SoftRasterizer::addDraw. Shaded like the unlit GL variants:
+// the texture when there is one, otherwise ambient + diffuse, with diffuse scaled by
+// the x component of the world normal when the mesh has normals.
+struct SoftDraw {
+    const std::vector<glm::vec3> * positions;   // non-indexed triangle list, as from loadOBJ
+    const std::vector<glm::vec2> * uvs;         // NULL or one per position
+    const std::vector<glm::vec3> * normals;     // NULL or one per position
+    const SoftTexture * texture;                // NULL shades with the material
+    glm::mat4 M;
+    glm::vec3 ambient, diffuse;
+};
+
+struct SoftRasterStats {
+    unsigned int draws;
+    unsigned int triangles;     // submitted
+    unsigned int rasterized;    // set up after clipping, inside the viewport
+    unsigned int binned;        // triangle references in tile bins
+    unsigned int shaded;        // pixels covered after the depth test
+    double geometryMilliseconds; // transform, clip, set up and bin
+    double rasterMilliseconds;  // depth test and shade the tiles
+};
+
+// Multithreaded tile based software renderer for machines without a GPU.
+// Triangles are transformed, clipped against the near plane and binned into 64x64
+// pixel tiles by thread pool jobs of consecutive triangles. Then every tile is
+// rasterized by its own job: SIMD edge functions (8 pixels with AVX, 4 with SSE)
+// depth test into a tile local visibility buffer holding the nearest triangle of each
+// pixel, and only those pixels are shaded, perspective correct. Jobs keep submission
+// order, so the image does not depend on the number of threads.
+class SoftRasterizer {
+public:
+    SoftRasterizer();
+
+    void resize(int width, int height);
+
+    // Starts a frame; the colour is what pixels without geometry get
+    void beginFrame(const glm::mat4 & VP, const glm::vec3 & clearColor);
+    // The vertex arrays and the texture have to stay alive until render() returns
+    void addDraw(const SoftDraw & draw);
+    void render(ThreadPool & pool);
+
+    // RGB, top row first
+    const std::vector<unsigned char> & getColor() const { return color; }
+    bool savePPM(const char * path) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const SoftRasterStats & getStats() const { return stats; }
+
+private:
+    // Screen space setup of one clipped triangle, counter clockwise. Depth is kept
+    // relative to a vertex and the edge functions are completed per tile, relative to
+    // the tile, so small triangles far from the window origin keep their precision.
+    struct Triangle {
+        glm::vec2 v[3];             // window coordinates
+        float A[3], B[3];           // edge function gradients, edge e from v[e] to v[(e + 1) % 3]
+                                    // is opposite vertex (e + 2) % 3
+        float z0, zA, zB;           // window depth at v[0] and its gradient
+        float invArea;
+        float invW[3];
+        glm::vec2 uv[3];
+        glm::vec3 color[3];         // per vertex shading without a texture
+        float lod;                  // texture level of detail for the whole triangle
+        const SoftTexture * texture;
+        int minX, minY, maxX, maxY;
+    };
+    // Consecutive triangles of the frame, possibly of several draws, transformed and
+    // binned by one pool job
+    struct GeometryJob {
+        size_t first, count;        // in the order of addDraw calls
+        std::vector<Triangle> triangles;
+        std::vector<unsigned int> tileStart;  // tilesX * tilesY + 1 offsets into binned
+        std::vector<unsigned int> binned;     // triangle indices grouped by tile
+    };
+    struct ClipVertex {
+        glm::vec4 clip;
+        glm::vec2 uv;
+        glm::vec3 color;
+    };
+
+    void runGeometry(GeometryJob & job);
+    void transformDraw(GeometryJob & job, const SoftDraw & draw, size_t first, size_t end);
+    void setupTriangle(GeometryJob & job, const SoftDraw & draw, const ClipVertex & v0, const ClipVertex & v1, const ClipVertex & v2);
+    void rasterizeTile(int tile);
+
+    int width, height;
+    int tilesX, tilesY;
+    glm::mat4 viewProjection;
+    glm::vec3 clear;
+    std::vector<SoftDraw> draws;
+    std::vector<size_t> drawStart;  // first triangle of each draw, then the total
+    std::vector<GeometryJob> jobs;
+    size_t jobCount;
+    std::vector<unsigned char> color;
+    std::vector<unsigned int> tileShaded;
+    SoftRasterStats stats;
+};
+
+#endif
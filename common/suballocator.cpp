@@ -0,0 +1,445 @@
+// Include standard headers
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "suballocator.hpp"
+
+const unsigned int RangeAllocator::NoBlock;
+const size_t RangeAllocator::Granularity;
+const unsigned int BufferSuballocator::NoAllocation;
+
+static unsigned int highestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long bit;
+    _BitScanReverse64(&bit, value);
+    return bit;
+#else
+    unsigned int bit = 0;
+    while (value >>= 1)
+        bit++;
+    return bit;
+#endif
+}
+
+static unsigned int lowestBit(uint64_t value) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(value);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    unsigned long bit;
+    _BitScanForward64(&bit, value);
+    return bit;
+#else
+    unsigned int bit = 0;
+    while (!(value & 1)) {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+RangeAllocator::RangeAllocator() {
+    reset(0);
+}
+
+void RangeAllocator::reset(size_t capacity) {
+    blocks.clear();
+    unusedBlocks.clear();
+    for (unsigned int fl = 0; fl < FLCount; fl++) {
+        slBitmap[fl] = 0;
+        for (unsigned int sl = 0; sl < SLCount; sl++)
+            freeHeads[fl][sl] = NoBlock;
+    }
+    flBitmap = 0;
+    total = capacity & ~(Granularity - 1);
+    used = 0;
+    freeBlocks = 0;
+    head = tail = NoBlock;
+    if (total == 0)
+        return;
+    head = tail = newBlock();
+    Block & block = blocks[head];
+    block.offset = 0;
+    block.size = total;
+    block.prevPhys = block.nextPhys = NoBlock;
+    insertFree(head);
+}
+
+// Size class of a block: fl is the power of two in granules, sl one of SLCount equal
+// steps inside it; below SLCount granules every size has a class of its own
+void RangeAllocator::mapping(size_t size, unsigned int & fl, unsigned int & sl) {
+    size_t granules = size / Granularity;
+    if (granules < SLCount) {
+        fl = 0;
+        sl = (unsigned int)granules;
+    } else {
+        unsigned int bit = highestBit(granules);
+        fl = bit - SLBits + 1;
+        sl = (unsigned int)(granules >> (bit - SLBits)) - SLCount;
+    }
+}
+
+unsigned int RangeAllocator::findFree(size_t size) const {
+    // Rounded up to the next class, so that any block of the class found is large enough
+    size_t granules = size / Granularity;
+    if (granules >= SLCount)
+        size += (((size_t)1 << (highestBit(granules) - SLBits)) - 1) * Granularity;
+    unsigned int fl, sl;
+    mapping(size, fl, sl);
+    if (fl >= FLCount)
+        return NoBlock;
+    uint32_t slMap = slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap = fl + 1 < FLCount ? flBitmap & (~(uint64_t)0 << (fl + 1)) : 0;
+        if (!flMap)
+            return NoBlock;
+        fl = lowestBit(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = lowestBit(slMap);
+    return freeHeads[fl][sl];
+}
+
+// Blocks of the class of size itself, some of which may be large enough; for requests that
+// only fit the exact block, like the one of a page made for them
+unsigned int RangeAllocator::findFreeExact(size_t size) const {
+    unsigned int fl, sl;
+    mapping(size, fl, sl);
+    if (fl >= FLCount)
+        return NoBlock;
+    for (unsigned int index = freeHeads[fl][sl]; index != NoBlock; index = blocks[index].nextFree)
+        if (blocks[index].size >= size)
+            return index;
+    return NoBlock;
+}
+
+void RangeAllocator::insertFree(unsigned int index) {
+    Block & block = blocks[index];
+    unsigned int fl, sl;
+    mapping(block.size, fl, sl);
+    block.free = true;
+    block.prevFree = NoBlock;
+    block.nextFree = freeHeads[fl][sl];
+    if (block.nextFree != NoBlock)
+        blocks[block.nextFree].prevFree = index;
+    freeHeads[fl][sl] = index;
+    flBitmap |= (uint64_t)1 << fl;
+    slBitmap[fl] |= 1u << sl;
+    freeBlocks++;
+}
+
+void RangeAllocator::removeFree(unsigned int index) {
+    Block & block = blocks[index];
+    unsigned int fl, sl;
+    mapping(block.size, fl, sl);
+    if (block.prevFree != NoBlock)
+        blocks[block.prevFree].nextFree = block.nextFree;
+    else
+        freeHeads[fl][sl] = block.nextFree;
+    if (block.nextFree != NoBlock)
+        blocks[block.nextFree].prevFree = block.prevFree;
+    if (freeHeads[fl][sl] == NoBlock) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl])
+            flBitmap &= ~((uint64_t)1 << fl);
+    }
+    block.free = false;
+    freeBlocks--;
+}
+
+unsigned int RangeAllocator::newBlock() {
+    if (!unusedBlocks.empty()) {
+        unsigned int index = unusedBlocks.back();
+        unusedBlocks.pop_back();
+        return index;
+    }
+    blocks.push_back(Block());
+    return (unsigned int)(blocks.size() - 1);
+}
+
+// Cuts a block in two; the front keeps the index, so the block at offset 0 never changes
+unsigned int RangeAllocator::split(unsigned int index, size_t frontSize) {
+    unsigned int rest = newBlock();
+    Block & front = blocks[index];
+    Block & back = blocks[rest];
+    back.offset = front.offset + frontSize;
+    back.size = front.size - frontSize;
+    back.prevPhys = index;
+    back.nextPhys = front.nextPhys;
+    back.free = false;
+    if (front.nextPhys != NoBlock)
+        blocks[front.nextPhys].prevPhys = rest;
+    else
+        tail = rest;
+    front.nextPhys = rest;
+    front.size = frontSize;
+    return rest;
+}
+
+// Allocates size bytes at alignment from a free block already off its list; the padding
+// in front and the rest behind go back to the free lists
+unsigned int RangeAllocator::carve(unsigned int index, size_t size, size_t alignment) {
+    size_t padding = alignUp(blocks[index].offset, alignment) - blocks[index].offset;
+    if (padding) {
+        unsigned int aligned = split(index, padding);
+        insertFree(index);
+        index = aligned;
+    }
+    if (blocks[index].size > size)
+        insertFree(split(index, size));
+    blocks[index].free = false;
+    used += size;
+    return index;
+}
+
+unsigned int RangeAllocator::allocate(size_t size, size_t alignment) {
+    size = alignUp(std::max(size, (size_t)1), Granularity);
+    alignment = std::max(alignment, Granularity);
+    unsigned int index = findFree(size + alignment - Granularity);
+    if (index == NoBlock)
+        index = findFreeExact(size + alignment - Granularity);
+    if (index == NoBlock)
+        return NoBlock;
+    removeFree(index);
+    return carve(index, size, alignment);
+}
+
+void RangeAllocator::free(unsigned int index) {
+    used -= blocks[index].size;
+    unsigned int next = blocks[index].nextPhys;
+    if (next != NoBlock && blocks[next].free) {
+        removeFree(next);
+        blocks[index].size += blocks[next].size;
+        blocks[index].nextPhys = blocks[next].nextPhys;
+        if (blocks[next].nextPhys != NoBlock)
+            blocks[blocks[next].nextPhys].prevPhys = index;
+        blocks[next].size = 0;
+        unusedBlocks.push_back(next);
+    }
+    unsigned int previous = blocks[index].prevPhys;
+    if (previous != NoBlock && blocks[previous].free) {
+        removeFree(previous);
+        blocks[previous].size += blocks[index].size;
+        blocks[previous].nextPhys = blocks[index].nextPhys;
+        if (blocks[index].nextPhys != NoBlock)
+            blocks[blocks[index].nextPhys].prevPhys = previous;
+        blocks[index].size = 0;
+        unusedBlocks.push_back(index);
+        index = previous;
+    }
+    if (blocks[index].nextPhys == NoBlock)
+        tail = index;
+    insertFree(index);
+}
+
+size_t RangeAllocator::largestFree() const {
+    if (!flBitmap)
+        return 0;
+    unsigned int fl = highestBit(flBitmap);
+    unsigned int sl = highestBit(slBitmap[fl]);
+    size_t largest = 0;
+    for (unsigned int index = freeHeads[fl][sl]; index != NoBlock; index = blocks[index].nextFree)
+        largest = std::max(largest, blocks[index].size);
+    return largest;
+}
+
+BufferSuballocator::BufferSuballocator(size_t minPageBytes, size_t maxPageBytes) :
+    minPageBytes(minPageBytes), maxPageBytes(std::max(minPageBytes, maxPageBytes)),
+    nextPageBytes(minPageBytes), movedBytes(0),
+    cursorPage(NoAllocation), cursorBlock(RangeAllocator::NoBlock), passMoved(false), compacted(true) {
+}
+
+unsigned int BufferSuballocator::addPage(size_t bytes) {
+    unsigned int page = (unsigned int)pages.size();
+    for (unsigned int i = 0; i < pages.size(); i++)
+        if (!pages[i].live) {
+            page = i;
+            break;
+        }
+    if (page == pages.size())
+        pages.push_back(Page());
+    Page & added = pages[page];
+    added.ranges.reset(alignUp(bytes, RangeAllocator::Granularity));
+    added.owners.clear();
+    added.allocations = 0;
+    added.live = true;
+    return page;
+}
+
+void BufferSuballocator::setOwner(unsigned int page, unsigned int block, unsigned int handle) {
+    std::vector<unsigned int> & owners = pages[page].owners;
+    if (owners.size() <= block)
+        owners.resize(block + 1, NoAllocation);
+    owners[block] = handle;
+}
+
+unsigned int BufferSuballocator::allocate(size_t size, size_t alignment) {
+    unsigned int page = 0, block = RangeAllocator::NoBlock;
+    for (; page < pages.size() && block == RangeAllocator::NoBlock; page++)
+        if (pages[page].live)
+            block = pages[page].ranges.allocate(size, alignment);
+    if (block == RangeAllocator::NoBlock) {
+        size_t bytes = std::max(nextPageBytes, alignUp(size, RangeAllocator::Granularity) + alignment);
+        page = addPage(bytes);
+        nextPageBytes = std::min(nextPageBytes * 2, maxPageBytes);
+        block = pages[page].ranges.allocate(size, alignment);
+        if (block == RangeAllocator::NoBlock)
+            return NoAllocation;
+    } else {
+        page--;
+    }
+
+    unsigned int handle;
+    if (!unusedSlots.empty()) {
+        handle = unusedSlots.back();
+        unusedSlots.pop_back();
+    } else {
+        handle = (unsigned int)slots.size();
+        slots.push_back(Slot());
+    }
+    Slot & slot = slots[handle];
+    slot.page = page;
+    slot.block = block;
+    slot.size = size;
+    slot.alignment = alignment;
+    slot.live = true;
+    setOwner(page, block, handle);
+    pages[page].allocations++;
+    return handle;
+}
+
+void BufferSuballocator::free(unsigned int handle) {
+    Slot & slot = slots[handle];
+    Page & page = pages[slot.page];
+    page.ranges.free(slot.block);
+    page.owners[slot.block] = NoAllocation;
+    page.allocations--;
+    slot.live = false;
+    unusedSlots.push_back(handle);
+    if (compacted) {
+        compacted = false;
+        cursorPage = NoAllocation;
+    }
+}
+
+size_t BufferSuballocator::defragment(size_t maxBytes, std::vector<BufferMove> & moves) {
+    if (compacted)
+        return 0;
+    size_t moved = 0, examined = 0;
+    // One pass goes from the last page backwards, each page from its end: allocations
+    // move into any earlier page, or lower in their own, so live bytes gather at the
+    // front and the last pages drain. A call examines maxBytes of allocations and the
+    // next one resumes where it stopped.
+    if (cursorPage == NoAllocation) {
+        cursorPage = (unsigned int)pages.size() - 1;
+        cursorBlock = RangeAllocator::NoBlock;
+        passMoved = false;
+    }
+    while (examined < maxBytes) {
+        unsigned int p = cursorPage;
+        if (p == NoAllocation) {
+            // Pass over; the next call starts another one if this one moved anything
+            if (!passMoved)
+                compacted = true;
+            break;
+        }
+        RangeAllocator & ranges = pages[p].ranges;
+        unsigned int block = cursorBlock;
+        // The block the last call stopped at may have been merged away since
+        if (!pages[p].live || block >= ranges.blockSlots() || !ranges.size(block))
+            block = ranges.lastBlock();
+        while (block != RangeAllocator::NoBlock && examined < maxBytes) {
+            unsigned int previous = ranges.previousBlock(block);
+            if (!ranges.isFree(block)) {
+                unsigned int handle = pages[p].owners[block];
+                Slot & slot = slots[handle];
+                examined += slot.size;
+                unsigned int toPage = 0, toBlock = RangeAllocator::NoBlock;
+                for (; toPage < p && toBlock == RangeAllocator::NoBlock; toPage++)
+                    if (pages[toPage].live)
+                        toBlock = pages[toPage].ranges.allocate(slot.size, slot.alignment);
+                if (toBlock != RangeAllocator::NoBlock)
+                    toPage--;
+                else {
+                    // Good fit in the same page, kept only if it is lower
+                    toBlock = ranges.allocate(slot.size, slot.alignment);
+                    if (toBlock != RangeAllocator::NoBlock && ranges.offset(toBlock) > ranges.offset(block)) {
+                        ranges.free(toBlock);
+                        toBlock = RangeAllocator::NoBlock;
+                    }
+                }
+                if (toBlock != RangeAllocator::NoBlock) {
+                    BufferMove move;
+                    move.handle = handle;
+                    move.fromPage = p;
+                    move.fromOffset = ranges.offset(block);
+                    move.toPage = toPage;
+                    move.toOffset = pages[toPage].ranges.offset(toBlock);
+                    move.size = slot.size;
+                    moves.push_back(move);
+
+                    // The old block is freed after the new one was taken, so the two
+                    // never overlap and the copy can stay in one buffer
+                    ranges.free(block);
+                    pages[p].owners[block] = NoAllocation;
+                    pages[p].allocations--;
+                    pages[toPage].allocations++;
+                    setOwner(toPage, toBlock, handle);
+                    slot.page = toPage;
+                    slot.block = toBlock;
+                    moved += slot.size;
+                    passMoved = true;
+                }
+            }
+            block = previous;
+        }
+        if (block != RangeAllocator::NoBlock) {
+            cursorBlock = block;
+            break;
+        }
+        if (pages[p].live && pages[p].allocations == 0 && p > 0) {
+            pages[p].live = false;
+            pages[p].ranges.reset(0);
+            pages[p].owners.clear();
+            nextPageBytes = minPageBytes;
+        }
+        cursorPage = p > 0 ? p - 1 : NoAllocation;
+        cursorBlock = RangeAllocator::NoBlock;
+    }
+    movedBytes += moved;
+    return moved;
+}
+
+SuballocatorStats BufferSuballocator::getStats() const {
+    SuballocatorStats stats;
+    stats.pages = 0;
+    stats.allocations = 0;
+    stats.capacity = 0;
+    stats.used = 0;
+    stats.freeBlocks = 0;
+    stats.largestFree = 0;
+    stats.movedBytes = movedBytes;
+    for (size_t i = 0; i < pages.size(); i++) {
+        if (!pages[i].live)
+            continue;
+        stats.pages++;
+        stats.allocations += pages[i].allocations;
+        stats.capacity += pages[i].ranges.capacity();
+        stats.used += pages[i].ranges.usedBytes();
+        stats.freeBlocks += pages[i].ranges.freeBlockCount();
+        stats.largestFree = std::max(stats.largestFree, pages[i].ranges.largestFree());
+    }
+    return stats;
+}
@@ -0,0 +1,149 @@
+#ifndef SUBALLOCATOR_HPP
+#define SUBALLOCATOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Two level segregated fit (TLSF) allocator of byte ranges in one buffer of fixed size.
+// Only keeps the books, the memory itself is elsewhere (a GL buffer). Free blocks are
+// kept in lists by size class, 16 classes per power of two, found through two bitmaps in
+// O(1); freeing merges a block with its free neighbours right away. Offsets and sizes are
+// multiples of Granularity.
+class RangeAllocator {
+public:
+    static const unsigned int NoBlock = 0xffffffffu;
+    static const size_t Granularity = 16;
+
+    RangeAllocator();
+
+    // Forgets every allocation; the whole capacity becomes one free block
+    void reset(size_t capacity);
+
+    // Good fit: a block from the smallest size class that surely holds size at alignment,
+    // a power of two. NoBlock when there is none.
+    unsigned int allocate(size_t size, size_t alignment);
+    void free(unsigned int block);
+
+    size_t offset(unsigned int block) const { return blocks[block].offset; }
+    size_t size(unsigned int block) const { return blocks[block].size; }
+    bool isFree(unsigned int block) const { return blocks[block].free; }
+    // Blocks in address order, free ones included
+    unsigned int firstBlock() const { return head; }
+    unsigned int lastBlock() const { return tail; }
+    unsigned int nextBlock(unsigned int block) const { return blocks[block].nextPhys; }
+    unsigned int previousBlock(unsigned int block) const { return blocks[block].prevPhys; }
+    // Upper bound of the block indices, for arrays indexed by block
+    size_t blockSlots() const { return blocks.size(); }
+
+    size_t capacity() const { return total; }
+    size_t usedBytes() const { return used; }
+    unsigned int freeBlockCount() const { return freeBlocks; }
+    size_t largestFree() const;
+
+private:
+    enum { SLBits = 4, SLCount = 1 << SLBits, FLCount = 48 };
+
+    struct Block {
+        size_t offset, size;
+        unsigned int prevPhys, nextPhys;    // neighbours in address order
+        unsigned int prevFree, nextFree;    // in the list of its size class
+        bool free;
+    };
+
+    static void mapping(size_t size, unsigned int & fl, unsigned int & sl);
+    unsigned int findFree(size_t size) const;
+    unsigned int findFreeExact(size_t size) const;
+    void insertFree(unsigned int block);
+    void removeFree(unsigned int block);
+    unsigned int newBlock();
+    unsigned int split(unsigned int block, size_t frontSize);
+    unsigned int carve(unsigned int block, size_t size, size_t alignment);
+
+    std::vector<Block> blocks;
+    std::vector<unsigned int> unusedBlocks;
+    unsigned int freeHeads[FLCount][SLCount];
+    uint64_t flBitmap;
+    uint32_t slBitmap[FLCount];
+    unsigned int head, tail;
+    size_t total, used;
+    unsigned int freeBlocks;
+};
+
+// One allocation changing place in BufferSuballocator::defragment
+struct BufferMove {
+    unsigned int handle;
+    unsigned int fromPage, toPage;
+    size_t fromOffset, toOffset;
+    size_t size;
+};
+
+struct SuballocatorStats {
+    unsigned int pages;         // live pages
+    unsigned int allocations;
+    size_t capacity;            // bytes in the live pages
+    size_t used;                // in allocations, rounded up to the granularity
+    unsigned int freeBlocks;    // holes, 1 per page when nothing is fragmented
+    size_t largestFree;
+    size_t movedBytes;          // by defragment() so far
+};
+
+// Suballocations from pages of one RangeAllocator each, with handles that stay valid
+// when defragment() moves an allocation to another page or offset. Pages start at
+// minPageBytes and double up to maxPageBytes while the pool grows; larger requests get a
+// page of their own. Pages left empty by compaction are released, so the page count
+// follows the live bytes instead of the history of loads and unloads.
+class BufferSuballocator {
+public:
+    static const unsigned int NoAllocation = 0xffffffffu;
+
+    BufferSuballocator(size_t minPageBytes = 1 << 20, size_t maxPageBytes = 64 << 20);
+
+    unsigned int allocate(size_t size, size_t alignment);
+    void free(unsigned int handle);
+
+    unsigned int getPage(unsigned int handle) const { return slots[handle].page; }
+    size_t getOffset(unsigned int handle) const { return pages[slots[handle].page].ranges.offset(slots[handle].block); }
+    size_t getSize(unsigned int handle) const { return slots[handle].size; }
+
+    // Moves allocations from the end of the last pages into holes further front and appends
+    // each move to moves; the caller copies the bytes. Looks at maxBytes of allocations
+    // per call, so the work can be spread over frames. Returns the bytes moved.
+    size_t defragment(size_t maxBytes, std::vector<BufferMove> & moves);
+    // Nothing was freed since a full pass of defragment() found nothing to move
+    bool isCompacted() const { return compacted; }
+
+    // Pages are never renumbered; released ones stay dead until a new page reuses them
+    size_t pageSlots() const { return pages.size(); }
+    bool isPageLive(unsigned int page) const { return pages[page].live; }
+    size_t pageCapacity(unsigned int page) const { return pages[page].ranges.capacity(); }
+
+    SuballocatorStats getStats() const;
+
+private:
+    struct Page {
+        RangeAllocator ranges;
+        std::vector<unsigned int> owners;   // handle of each allocated block
+        unsigned int allocations;
+        bool live;
+    };
+    struct Slot {
+        unsigned int page, block;
+        size_t size, alignment;
+        bool live;
+    };
+
+    unsigned int addPage(size_t bytes);
+    void setOwner(unsigned int page, unsigned int block, unsigned int handle);
+
+    std::vector<Page> pages;
+    std::vector<Slot> slots;
+    std::vector<unsigned int> unusedSlots;
+    size_t minPageBytes, maxPageBytes, nextPageBytes;
+    size_t movedBytes;
+    unsigned int cursorPage, cursorBlock;   // where defragment() resumes
+    bool passMoved;     // the current pass moved something
+    bool compacted;
+};
+
+#endif
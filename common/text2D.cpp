@@ -1,5 +1,7 @@
 #include <vector>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include <GL/glew.h>
 
@@ -12,71 +14,171 @@ using namespace glm;
 
 #include "text2D.hpp"
 
+// One corner of a glyph quad, position and UV interleaved
+struct TextVertex {
+	float x, y;
+	float u, v;
+};
+
 unsigned int Text2DTextureID;
+unsigned int Text2DVertexArrayID;
 unsigned int Text2DVertexBufferID;
-unsigned int Text2DUVBufferID;
+unsigned int Text2DIndexBufferID;
 unsigned int Text2DShaderID;
 unsigned int Text2DUniformID;
+unsigned int Text2DDistanceFieldID;
+
+// Quads queued since the last flush; cleared but never shrunk, so steady state
+// frames don't allocate
+std::vector<TextVertex> Text2DVertices;
+size_t Text2DBufferGlyphs = 0;
+
+// Signed distance of every texel to the glyph edge, searched within its own 16x16 cell
+// so neighbouring glyphs don't leak in. 0.5 is the edge, spread texels map to 0 and 1.
+static void buildDistanceField(const std::vector<unsigned char> & coverage, int width, int height, std::vector<unsigned char> & field){
+
+	const int cellWidth = width / 16, cellHeight = height / 16;
+	const int spread = std::max(2, std::min(cellWidth, cellHeight) / 8);
+	field.resize(coverage.size());
+	for (int y = 0; y < height; y++){
+		int cellY = y - y % cellHeight;
+		for (int x = 0; x < width; x++){
+			int cellX = x - x % cellWidth;
+			bool inside = coverage[y * width + x] >= 128;
+			float nearest = (float)spread + 0.5f;
+			for (int sy = std::max(cellY, y - spread); sy <= std::min(cellY + cellHeight - 1, y + spread); sy++){
+				for (int sx = std::max(cellX, x - spread); sx <= std::min(cellX + cellWidth - 1, x + spread); sx++){
+					if ((coverage[sy * width + sx] >= 128) != inside){
+						float d = std::sqrt((float)((sx - x) * (sx - x) + (sy - y) * (sy - y)));
+						nearest = std::min(nearest, d);
+					}
+				}
+			}
+			// The edge lies half a texel short of the nearest texel on the other side
+			float distance = (nearest - 0.5f) * (inside ? 1.0f : -1.0f);
+			float value = 0.5f + distance / (2.0f * spread);
+			field[y * width + x] = (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
 
-void initText2D(const char * texturePath){
+}
 
-	// Initialize texture
-	Text2DTextureID = loadDDS(texturePath);
+void initText2D(const char * texturePath, bool distanceField){
+
+	// Initialize texture, either a DDS or a 24 bit BMP atlas of 16x16 glyphs
+	size_t pathLength = strlen(texturePath);
+	if (pathLength > 4 && (strcmp(texturePath + pathLength - 4, ".bmp") == 0 || strcmp(texturePath + pathLength - 4, ".BMP") == 0)){
+		Text2DTextureID = loadBMP_custom(texturePath);
+		// Keep neighbouring glyphs from bleeding in
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}else{
+		Text2DTextureID = loadDDS(texturePath);
+	}
 
-	// Initialize VBO
+	// Replace the coverage atlas by its distance field, single channel
+	if (distanceField && Text2DTextureID){
+		GLint width = 0, height = 0;
+		glBindTexture(GL_TEXTURE_2D, Text2DTextureID);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+		std::vector<unsigned char> coverage(width * height), field;
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_UNSIGNED_BYTE, &coverage[0]);
+		buildDistanceField(coverage, width, height, field);
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, &field[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	// Core profiles need a VAO of our own, the one bound by the caller is left alone.
+	// The interleaved layout and the index buffer are recorded once here.
+	glGenVertexArrays(1, &Text2DVertexArrayID);
 	glGenBuffers(1, &Text2DVertexBufferID);
-	glGenBuffers(1, &Text2DUVBufferID);
+	glGenBuffers(1, &Text2DIndexBufferID);
+	glBindVertexArray(Text2DVertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)0 );
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)(2 * sizeof(float)) );
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Text2DIndexBufferID);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	Text2DBufferGlyphs = 0;
 
 	// Initialize Shader
 	Text2DShaderID = LoadShaders( "TextVertexShader.vertexshader", "TextVertexShader.fragmentshader" );
 
 	// Initialize uniforms' IDs
 	Text2DUniformID = glGetUniformLocation( Text2DShaderID, "myTextureSampler" );
+	Text2DDistanceFieldID = glGetUniformLocation( Text2DShaderID, "distanceField" );
+	glUseProgram(Text2DShaderID);
+	glUniform1i(Text2DUniformID, 0);
+	glUniform1i(Text2DDistanceFieldID, distanceField ? 1 : 0);
+	glUseProgram(0);
 
 }
 
 void printText2D(const char * text, int x, int y, int size){
 
 	unsigned int length = strlen(text);
-
-	// Fill buffers
-	std::vector<glm::vec2> vertices;
-	std::vector<glm::vec2> UVs;
 	for ( unsigned int i=0 ; i<length ; i++ ){
-		
-		glm::vec2 vertex_up_left    = glm::vec2( x+i*size     , y+size );
-		glm::vec2 vertex_up_right   = glm::vec2( x+i*size+size, y+size );
-		glm::vec2 vertex_down_right = glm::vec2( x+i*size+size, y      );
-		glm::vec2 vertex_down_left  = glm::vec2( x+i*size     , y      );
-
-		vertices.push_back(vertex_up_left   );
-		vertices.push_back(vertex_down_left );
-		vertices.push_back(vertex_up_right  );
 
-		vertices.push_back(vertex_down_right);
-		vertices.push_back(vertex_up_right);
-		vertices.push_back(vertex_down_left);
-
-		char character = text[i];
+		unsigned char character = text[i];
 		float uv_x = (character%16)/16.0f;
 		float uv_y = (character/16)/16.0f;
 
-		glm::vec2 uv_up_left    = glm::vec2( uv_x           , uv_y );
-		glm::vec2 uv_up_right   = glm::vec2( uv_x+1.0f/16.0f, uv_y );
-		glm::vec2 uv_down_right = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
-		glm::vec2 uv_down_left  = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
-		UVs.push_back(uv_up_left   );
-		UVs.push_back(uv_down_left );
-		UVs.push_back(uv_up_right  );
-
-		UVs.push_back(uv_down_right);
-		UVs.push_back(uv_up_right);
-		UVs.push_back(uv_down_left);
+		float left = (float)(x+i*size), right = left + size;
+		float bottom = (float)y, top = bottom + size;
+
+		// up left, down left, up right, down right; flushText2D() indexes them as two triangles
+		TextVertex quad[4] = {
+			{ left,  top,    uv_x,            uv_y },
+			{ left,  bottom, uv_x,            uv_y + 1.0f/16.0f },
+			{ right, top,    uv_x+1.0f/16.0f, uv_y },
+			{ right, bottom, uv_x+1.0f/16.0f, uv_y + 1.0f/16.0f },
+		};
+		Text2DVertices.insert(Text2DVertices.end(), quad, quad + 4);
+	}
+
+}
+
+void flushText2D(){
+
+	size_t glyphs = Text2DVertices.size() / 4;
+	if (glyphs == 0)
+		return;
+
+	glBindVertexArray(Text2DVertexArrayID);
+
+	// Grow both buffers to the next power of two; the indices never change after that
+	if (glyphs > Text2DBufferGlyphs){
+		size_t capacity = 64;
+		while (capacity < glyphs)
+			capacity *= 2;
+		std::vector<GLuint> indices(capacity * 6);
+		for (size_t g = 0; g < capacity; g++){
+			static const GLuint corners[6] = { 0, 1, 2, 3, 2, 1 };
+			for (int k = 0; k < 6; k++)
+				indices[g * 6 + k] = (GLuint)(g * 4) + corners[k];
+		}
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+		Text2DBufferGlyphs = capacity;
 	}
+
+	// Orphan last frame's storage, then fill the new one
 	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, Text2DBufferGlyphs * 4 * sizeof(TextVertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, Text2DVertices.size() * sizeof(TextVertex), &Text2DVertices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	// Bind shader
 	glUseProgram(Text2DShaderID);
@@ -84,29 +186,22 @@ void printText2D(const char * text, int x, int y, int size){
 	// Bind texture
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, Text2DTextureID);
-	// Set our "myTextureSampler" sampler to user Texture Unit 0
-	glUniform1i(Text2DUniformID, 0);
-
-	// 1rst attribute buffer : vertices
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
-
-	// 2nd attribute buffer : UVs
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0 );
 
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// Text goes over the scene
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
 
-	// Draw call
-	glDrawArrays(GL_TRIANGLES, 0, vertices.size() );
+	// One draw call for every queued string
+	glDrawElements(GL_TRIANGLES, (GLsizei)(glyphs * 6), GL_UNSIGNED_INT, (void*)0);
 
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
 	glDisable(GL_BLEND);
 
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
+	glBindVertexArray(0);
+	Text2DVertices.clear();
 
 }
 
@@ -114,7 +209,10 @@ void cleanupText2D(){
 
 	// Delete buffers
 	glDeleteBuffers(1, &Text2DVertexBufferID);
-	glDeleteBuffers(1, &Text2DUVBufferID);
+	glDeleteBuffers(1, &Text2DIndexBufferID);
+	glDeleteVertexArrays(1, &Text2DVertexArrayID);
+	Text2DVertices.clear();
+	Text2DBufferGlyphs = 0;
 
 	// Delete texture
 	glDeleteTextures(1, &Text2DTextureID);
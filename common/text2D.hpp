@@ -1,8 +1,13 @@
 #ifndef TEXT2D_HPP
 #define TEXT2D_HPP
 
-void initText2D(const char * texturePath);
+// distanceField converts the atlas to a signed distance field at load time, so glyphs
+// stay sharp at any size
+void initText2D(const char * texturePath, bool distanceField = false);
+// Queues a string; nothing is drawn until flushText2D()
 void printText2D(const char * text, int x, int y, int size);
+// Draws every string queued since the last flush with one upload and one draw call
+void flushText2D();
 void cleanupText2D();
 
-#endif
\ No newline at end of file
+#endif
@@ -1,13 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#include <algorithm>
 
 #include <GL/glew.h>
 
 #include <glfw3.h>
 
 
-GLuint loadBMP_custom(const char * imagepath){
+bool loadBMP_pixels(const char * imagepath, std::vector<unsigned char> & data, unsigned int & width, unsigned int & height){
 
 	printf("Reading image %s\n", imagepath);
 
@@ -15,29 +17,28 @@ GLuint loadBMP_custom(const char * imagepath){
 	unsigned char header[54];
 	unsigned int dataPos;
 	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
 
 	// Open the file
 	FILE * file = fopen(imagepath,"rb");
-	if (!file)							    {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return 0;}
+	if (!file)							    {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return false;}
 
 	// Read the header, i.e. the 54 first bytes
 
 	// If less than 54 bytes are read, problem
 	if ( fread(header, 1, 54, file)!=54 ){ 
 		printf("Not a correct BMP file\n");
-		return 0;
+		fclose(file);
+		return false;
 	}
 	// A BMP files always begins with "BM"
 	if ( header[0]!='B' || header[1]!='M' ){
 		printf("Not a correct BMP file\n");
-		return 0;
+		fclose(file);
+		return false;
 	}
 	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    return 0;}
+	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
+	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
 
 	// Read the information about the image
 	dataPos    = *(int*)&(header[0x0A]);
@@ -49,14 +50,16 @@ GLuint loadBMP_custom(const char * imagepath){
 	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
 	if (dataPos==0)      dataPos=54; // The BMP header is done that way
 
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
 	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
+	data.resize(std::max(imageSize, ((width*3+3)&~3u)*height));
+	fread(&data[0],1,imageSize,file);
 
 	// Everything is in memory now, the file wan be closed
 	fclose (file);
+	return true;
+}
+
+GLuint createTexture(const unsigned char * bgr, unsigned int width, unsigned int height){
 
 	// Create one OpenGL texture
 	GLuint textureID;
@@ -66,10 +69,7 @@ GLuint loadBMP_custom(const char * imagepath){
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
+	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, bgr);
 
 	// Poor filtering, or ...
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -86,6 +86,35 @@ GLuint loadBMP_custom(const char * imagepath){
 	return textureID;
 }
 
+GLuint loadBMP_custom(const char * imagepath){
+
+	unsigned int width, height;
+	// Actual RGB data
+	std::vector<unsigned char> data;
+	if (!loadBMP_pixels(imagepath, data, width, height))
+		return 0;
+	return createTexture(&data[0], width, height);
+}
+
+size_t textureMemoryBytes(GLuint textureID){
+
+	GLint width = 0, height = 0;
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	// Every level halves both sides down to 1x1
+	size_t bytes = 0;
+	while (width > 0 && height > 0){
+		bytes += (size_t)width * height * 4;
+		if (width == 1 && height == 1)
+			break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return bytes;
+}
+
 // Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 // or do it yourself (just like loadBMP_custom and loadDDS)
 //GLuint loadTGA_glfw(const char * imagepath){
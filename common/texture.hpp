@@ -1,9 +1,23 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
+#include <vector>
+
 // Load a .BMP file using our custom loader
 GLuint loadBMP_custom(const char * imagepath);
 
+// Mipmapped texture of BGR pixels as loadBMP_pixels returns them, for pixels that are
+// already in memory
+GLuint createTexture(const unsigned char * bgr, unsigned int width, unsigned int height);
+
+// Pixels of a 24 bit .BMP file without creating a texture, for CPU rendering.
+// BGR, rows bottom to top as glTexImage2D takes them, each padded to 4 bytes.
+bool loadBMP_pixels(const char * imagepath, std::vector<unsigned char> & data, unsigned int & width, unsigned int & height);
+
+// Estimated video memory of a 2D texture and its mipmaps, from the size of level 0.
+// Binds the texture. Counts 4 bytes per texel, drivers pad GL_RGB to that.
+size_t textureMemoryBytes(GLuint textureID);
+
 //// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 //// or do it yourself (just like loadBMP_custom and loadDDS)
 //// Load a .TGA file using GLFW's own loader
@@ -0,0 +1,89 @@
+// Include standard headers
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+    : currentJob(NULL), jobCount(0), nextJob(0), finishedJobs(0), generation(0), quit(false)
+{
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+    // The thread calling parallelFor works too
+    for (unsigned int i = 1; i < numThreads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::runJobs() {
+    // Called with the mutex held, releases it while a job runs
+    std::unique_lock<std::mutex> lock(mutex, std::adopt_lock);
+    while (nextJob < jobCount) {
+        int index = nextJob++;
+        const std::function<void(int)> & job = *currentJob;
+        lock.unlock();
+        job(index);
+        lock.lock();
+        if (++finishedJobs == jobCount)
+            done.notify_all();
+    }
+    lock.release();
+}
+
+void ThreadPool::workerLoop() {
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&]{ return quit || generation != seen; });
+        if (quit)
+            return;
+        seen = generation;
+        lock.release();
+        runJobs();
+        lock = std::unique_lock<std::mutex>(mutex, std::adopt_lock);
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)> & job) {
+    if (count <= 0)
+        return;
+    if (workers.empty() || count == 1) {
+        for (int i = 0; i < count; i++)
+            job(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> caller(callMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    currentJob = &job;
+    jobCount = count;
+    nextJob = 0;
+    finishedJobs = 0;
+    generation++;
+    wake.notify_all();
+
+    lock.release();
+    runJobs();
+    lock = std::unique_lock<std::mutex>(mutex, std::adopt_lock);
+    done.wait(lock, [&]{ return finishedJobs == jobCount; });
+    currentJob = NULL;
+}
+
+ThreadPool & defaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
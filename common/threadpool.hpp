@@ -0,0 +1,44 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Persistent worker threads for per-frame data parallel work.
+// parallelFor blocks until every job index has run; the calling thread helps.
+// Calls from several threads are serialized.
+class ThreadPool {
+public:
+    // numThreads = 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned int numThreads = 0);
+    ~ThreadPool();
+
+    void parallelFor(int count, const std::function<void(int)> & job);
+
+    // Workers plus the calling thread
+    unsigned int size() const { return (unsigned int)workers.size() + 1; }
+
+private:
+    void workerLoop();
+    void runJobs();
+
+    std::vector<std::thread> workers;
+    std::mutex callMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(int)> * currentJob;
+    int jobCount;
+    int nextJob;
+    int finishedJobs;
+    unsigned int generation;
+    bool quit;
+};
+
+// Shared pool sized to the machine, created on first use
+ThreadPool & defaultThreadPool();
+
+#endif
@@ -0,0 +1,163 @@
+// Include standard headers
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define TRANSFORM_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_SSE 1
+#endif
+
+#include "transformbatch.hpp"
+
+void TransformSoA::clear() {
+    tx.clear(); ty.clear(); tz.clear();
+    qx.clear(); qy.clear(); qz.clear(); qw.clear();
+    sx.clear(); sy.clear(); sz.clear();
+}
+
+void TransformSoA::reserve(size_t n) {
+    tx.reserve(n); ty.reserve(n); tz.reserve(n);
+    qx.reserve(n); qy.reserve(n); qz.reserve(n); qw.reserve(n);
+    sx.reserve(n); sy.reserve(n); sz.reserve(n);
+}
+
+void TransformSoA::push_back(const glm::vec3 & t, const glm::quat & r, const glm::vec3 & s) {
+    tx.push_back(0); ty.push_back(0); tz.push_back(0);
+    qx.push_back(0); qy.push_back(0); qz.push_back(0); qw.push_back(1);
+    sx.push_back(1); sy.push_back(1); sz.push_back(1);
+    set(size() - 1, t, r, s);
+}
+
+void TransformSoA::set(size_t i, const glm::vec3 & t, const glm::quat & r, const glm::vec3 & s) {
+    tx[i] = t.x; ty[i] = t.y; tz[i] = t.z;
+    qx[i] = r.x; qy[i] = r.y; qz[i] = r.z; qw[i] = r.w;
+    sx[i] = s.x; sy[i] = s.y; sz[i] = s.z;
+}
+
+// Rotation terms as in glm::mat3_cast, then each column scaled
+static void composeOne(const TransformSoA & t, size_t i, glm::mat4 & out) {
+    float x = t.qx[i], y = t.qy[i], z = t.qz[i], w = t.qw[i];
+    float xx = x * x, yy = y * y, zz = z * z;
+    float xz = x * z, xy = x * y, yz = y * z;
+    float wx = w * x, wy = w * y, wz = w * z;
+    out[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * t.sx[i], 2.0f * (xy + wz) * t.sx[i], 2.0f * (xz - wy) * t.sx[i], 0.0f);
+    out[1] = glm::vec4(2.0f * (xy - wz) * t.sy[i], (1.0f - 2.0f * (xx + zz)) * t.sy[i], 2.0f * (yz + wx) * t.sy[i], 0.0f);
+    out[2] = glm::vec4(2.0f * (xz + wy) * t.sz[i], 2.0f * (yz - wx) * t.sz[i], (1.0f - 2.0f * (xx + yy)) * t.sz[i], 0.0f);
+    out[3] = glm::vec4(t.tx[i], t.ty[i], t.tz[i], 1.0f);
+}
+
+void composeTransformsScalar(const TransformSoA & transforms, size_t first, size_t count, glm::mat4 * out) {
+    for (size_t i = 0; i < count; i++)
+        composeOne(transforms, first + i, out[i]);
+}
+
+void composeTransforms(const TransformSoA & transforms, size_t first, size_t count, glm::mat4 * out) {
+    size_t i = 0;
+
+#if defined(TRANSFORM_SSE)
+    // 4 objects per iteration: every matrix element is computed for all 4 at once, then
+    // each column is transposed back into the 4 output matrices
+    const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+    for (; i + 4 <= count; i += 4) {
+        size_t j = first + i;
+        __m128 x = _mm_loadu_ps(&transforms.qx[j]);
+        __m128 y = _mm_loadu_ps(&transforms.qy[j]);
+        __m128 z = _mm_loadu_ps(&transforms.qz[j]);
+        __m128 w = _mm_loadu_ps(&transforms.qw[j]);
+        __m128 sx = _mm_loadu_ps(&transforms.sx[j]);
+        __m128 sy = _mm_loadu_ps(&transforms.sy[j]);
+        __m128 sz = _mm_loadu_ps(&transforms.sz[j]);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xz = _mm_mul_ps(x, z), xy = _mm_mul_ps(x, y), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        __m128 columns[4][4];
+        columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        columns[0][3] = _mm_setzero_ps();
+        columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        columns[1][3] = _mm_setzero_ps();
+        columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        columns[2][3] = _mm_setzero_ps();
+        columns[3][0] = _mm_loadu_ps(&transforms.tx[j]);
+        columns[3][1] = _mm_loadu_ps(&transforms.ty[j]);
+        columns[3][2] = _mm_loadu_ps(&transforms.tz[j]);
+        columns[3][3] = one;
+
+        for (int c = 0; c < 4; c++) {
+            _MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+            _mm_storeu_ps(&out[i + 0][c][0], columns[c][0]);
+            _mm_storeu_ps(&out[i + 1][c][0], columns[c][1]);
+            _mm_storeu_ps(&out[i + 2][c][0], columns[c][2]);
+            _mm_storeu_ps(&out[i + 3][c][0], columns[c][3]);
+        }
+    }
+#endif
+
+    // Remaining objects (or everything on targets without SIMD)
+    for (; i < count; i++)
+        composeOne(transforms, first + i, out[i]);
+}
+
+void multiplyMatricesScalar(const glm::mat4 & A, const glm::mat4 * B, glm::mat4 * out, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        out[i] = A * B[i];
+}
+
+void multiplyMatrices(const glm::mat4 & A, const glm::mat4 * B, glm::mat4 * out, size_t count) {
+    size_t i = 0;
+
+#if defined(TRANSFORM_AVX)
+    // Two result columns per 8-wide operation: A's columns are repeated in both halves and
+    // each half broadcasts the elements of its own column of B
+    {
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *)&A[0][0]);
+        __m256 a1 = _mm256_broadcast_ps((const __m128 *)&A[1][0]);
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *)&A[2][0]);
+        __m256 a3 = _mm256_broadcast_ps((const __m128 *)&A[3][0]);
+        for (; i < count; i++) {
+            for (int c = 0; c < 4; c += 2) {
+                __m256 b = _mm256_loadu_ps(&B[i][c][0]);
+                __m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(b, b, 0x00));
+                r = _mm256_add_ps(r, _mm256_mul_ps(a1, _mm256_shuffle_ps(b, b, 0x55)));
+                r = _mm256_add_ps(r, _mm256_mul_ps(a2, _mm256_shuffle_ps(b, b, 0xaa)));
+                r = _mm256_add_ps(r, _mm256_mul_ps(a3, _mm256_shuffle_ps(b, b, 0xff)));
+                _mm256_storeu_ps(&out[i][c][0], r);
+            }
+        }
+    }
+#endif
+
+#if defined(TRANSFORM_SSE)
+    {
+        __m128 a0 = _mm_loadu_ps(&A[0][0]);
+        __m128 a1 = _mm_loadu_ps(&A[1][0]);
+        __m128 a2 = _mm_loadu_ps(&A[2][0]);
+        __m128 a3 = _mm_loadu_ps(&A[3][0]);
+        for (; i < count; i++) {
+            for (int c = 0; c < 4; c++) {
+                __m128 b = _mm_loadu_ps(&B[i][c][0]);
+                __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(b, b, 0x00));
+                r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(b, b, 0x55)));
+                r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(b, b, 0xaa)));
+                r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(b, b, 0xff)));
+                _mm_storeu_ps(&out[i][c][0], r);
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+        out[i] = A * B[i];
+}
@@ -0,0 +1,37 @@
+#ifndef TRANSFORMBATCH_HPP
+#define TRANSFORMBATCH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Translation, rotation and scale of many objects, one array per component so the
+// batched composition can load 4 (SSE) objects per component at once.
+struct TransformSoA {
+    std::vector<float> tx, ty, tz;
+    std::vector<float> qx, qy, qz, qw;
+    std::vector<float> sx, sy, sz;
+
+    size_t size() const { return tx.size(); }
+    void clear();
+    void reserve(size_t n);
+    void push_back(const glm::vec3 & t, const glm::quat & r, const glm::vec3 & s);
+    void set(size_t i, const glm::vec3 & t, const glm::quat & r, const glm::vec3 & s);
+    glm::vec3 translation(size_t i) const { return glm::vec3(tx[i], ty[i], tz[i]); }
+    glm::quat rotation(size_t i) const { return glm::quat(qw[i], qx[i], qy[i], qz[i]); }
+    glm::vec3 scale(size_t i) const { return glm::vec3(sx[i], sy[i], sz[i]); }
+};
+
+// out[i] = T * R * S for objects first .. first + count - 1 of transforms.
+// Uses SSE when the compiler enables it, scalar code otherwise.
+void composeTransforms(const TransformSoA & transforms, size_t first, size_t count, glm::mat4 * out);
+// Reference implementation, same arithmetic one object at a time
+void composeTransformsScalar(const TransformSoA & transforms, size_t first, size_t count, glm::mat4 * out);
+
+// out[i] = A * B[i], e.g. the view projection times every model matrix.
+// Adds in the same order as glm's operator*, so results are bit identical to it.
+// Uses AVX or SSE when the compiler enables them, scalar code otherwise.
+void multiplyMatrices(const glm::mat4 & A, const glm::mat4 * B, glm::mat4 * out, size_t count);
+void multiplyMatricesScalar(const glm::mat4 & A, const glm::mat4 * B, glm::mat4 * out, size_t count);
+
+#endif
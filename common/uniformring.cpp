@@ -0,0 +1,127 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "uniformring.hpp"
+
+static const int MaxSections = 8;
+
+UniformRing::UniformRing()
+    : buffer(0), mapped(NULL), sectionSize(0), sections(0), current(0), used(0), alignment(256) {
+    memset(fences, 0, sizeof(fences));
+    memset(&stats, 0, sizeof(stats));
+}
+
+UniformRing::~UniformRing() {
+    // GL objects belong to the context, destroy() must run while it is still current
+}
+
+bool UniformRing::create(size_t size, int count) {
+    destroy();
+    sections = std::min(std::max(count, 1), MaxSections);
+
+    GLint align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    alignment = std::max(align, 16);
+    sectionSize = alignedSize(std::max(size, (size_t)1));
+    size_t total = sectionSize * sections;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    stats.persistent = GLEW_ARB_buffer_storage != 0;
+    if (stats.persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, total, NULL, flags);
+        mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, 0, total, flags);
+        if (!mapped) {
+            printf("Persistent mapping of the uniform ring failed\n");
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            destroy();
+            return false;
+        }
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, total, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    current = sections - 1;
+    return true;
+}
+
+void UniformRing::destroy() {
+    for (int i = 0; i < MaxSections; i++) {
+        if (fences[i])
+            glDeleteSync(fences[i]);
+        fences[i] = 0;
+    }
+    if (buffer) {
+        if (mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = NULL;
+}
+
+void UniformRing::beginFrame() {
+    current = (current + 1) % sections;
+    used = 0;
+    stats.frames++;
+
+    // Normally signaled long ago; anything else is a stall on the GPU
+    if (fences[current]) {
+        GLenum result = glClientWaitSync(fences[current], 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            stats.stalls++;
+            do {
+                result = glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+            stats.stallMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        glDeleteSync(fences[current]);
+        fences[current] = 0;
+    }
+
+    if (!stats.persistent) {
+        // The fence already guarantees the GPU is done with this range
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        mapped = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, current * sectionSize, sectionSize,
+                                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+}
+
+GLintptr UniformRing::allocate(size_t size, void ** out_pointer) {
+    size_t aligned = alignedSize(size);
+    if (!mapped || used + aligned > sectionSize) {
+        stats.overflows++;
+        *out_pointer = NULL;
+        return -1;
+    }
+    size_t offset = current * sectionSize + used;
+    *out_pointer = stats.persistent ? mapped + offset : mapped + used;
+    used += aligned;
+    return (GLintptr)offset;
+}
+
+void UniformRing::flush() {
+    stats.bytesLastFrame = used;
+    // Coherent persistent mappings need no flush
+    if (!stats.persistent && mapped) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        mapped = NULL;
+    }
+}
+
+void UniformRing::endFrame() {
+    fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
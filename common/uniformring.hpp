@@ -0,0 +1,58 @@
+#ifndef UNIFORMRING_HPP
+#define UNIFORMRING_HPP
+
+#include <stddef.h>
+
+struct UniformRingStats {
+    unsigned int frames;
+    unsigned int stalls;          // frames that had to wait for the GPU to release their section
+    double stallMilliseconds;     // total time spent waiting
+    unsigned int overflows;       // allocations that did not fit in the frame's section
+    size_t bytesLastFrame;
+    bool persistent;              // ARB_buffer_storage mapping, otherwise mapped per frame
+};
+
+// Uniform buffer split into one section per frame in flight, written by the CPU
+// through a mapping and bound to uniform blocks with glBindBufferRange.
+// With ARB_buffer_storage the buffer stays mapped (persistent and coherent);
+// without it each section is mapped unsynchronized at the start of its frame.
+// Either way a fence is placed after the frame's draws and waited on before the
+// section is written again, so data the GPU may still read is never overwritten.
+class UniformRing {
+public:
+    UniformRing();
+    ~UniformRing();
+
+    // sectionSize bytes per frame, sections frames in flight
+    bool create(size_t sectionSize, int sections = 3);
+    void destroy();
+
+    // Waits for the GPU to finish with the section used sections frames ago
+    void beginFrame();
+    // Offset of size bytes aligned for glBindBufferRange and their address in out_pointer;
+    // -1 when the frame's section is full
+    GLintptr allocate(size_t size, void ** out_pointer);
+    // Makes this frame's writes visible to GL, call before the draws using them
+    void flush();
+    // Fences the frame's section after its draws were issued
+    void endFrame();
+
+    GLuint getBuffer() const { return buffer; }
+    // Every allocation is a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    size_t getAlignment() const { return alignment; }
+    size_t alignedSize(size_t size) const { return (size + alignment - 1) / alignment * alignment; }
+    const UniformRingStats & getStats() const { return stats; }
+
+private:
+    GLuint buffer;
+    unsigned char * mapped;       // whole buffer when persistent, the current section otherwise
+    size_t sectionSize;
+    int sections;
+    int current;
+    size_t used;
+    size_t alignment;
+    GLsync fences[8];
+    UniformRingStats stats;
+};
+
+#endif
@@ -12,6 +12,17 @@ void indexVBO(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Like indexVBO, but merges vertices within 0.01 of each other with a linear search, O(n^2)
+void indexVBO_slow(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
 
 void indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
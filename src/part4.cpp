@@ -1,7 +1,16 @@
 // Include standard headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <cmath>
+#include <atomic>
+#include <utility>
 
 // Include GLEW
 #include <GL/glew.h>
@@ -16,13 +25,298 @@ GLFWwindow* window;
 using namespace glm;
 
 #include <common/shader.hpp>
+#include <common/programcache.hpp>
+#include <common/shadervariants.hpp>
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/texture.hpp>
+#include <common/frustum.hpp>
+#include <common/bvh.hpp>
+#include <common/threadpool.hpp>
+#include <common/occlusion.hpp>
+#include <common/renderqueue.hpp>
+#include <common/headless.hpp>
+#include <common/rendertarget.hpp>
+#include <common/framestats.hpp>
+#include <common/profiler.hpp>
+#include <common/text2D.hpp>
+#include <common/framepipeline.hpp>
+#include <common/dynamicresolution.hpp>
+#include <common/uniformring.hpp>
+#include <common/samplecounter.hpp>
+#include <common/clusteredlights.hpp>
+#include <common/clusterbuffers.hpp>
+#include <common/scenegraph.hpp>
+#include <common/transformbatch.hpp>
+#include <common/meshbvh.hpp>
+#include <common/picking.hpp>
+#include <common/softrasterizer.hpp>
+#include <common/memoryledger.hpp>
+#include <common/lineararena.hpp>
+#include <common/bufferpool.hpp>
+#include <common/residency.hpp>
+#include <common/bundle.hpp>
 
 std::vector<GLuint> vertex_vector;
 std::vector<GLuint> num_indicator;
 
+// Scenes with at least this many models are culled through the BVH instead of the flat SIMD pass
+const size_t BVHCullThreshold = 4096;
+// The largest models with at most this many triangles are rasterized as occluders
+const int MaxOccluders = 8;
+const size_t MaxOccluderTriangles = 20000;
+// Bytes of vertex pool ranges looked at per frame when compacting after unloads
+const size_t VertexPoolDefragBytes = 1 << 20;
+// --geometry-budget: models drawn in the last ResidencyKeepFrames frames are never evicted,
+// at most ResidencyLoadsPerFrame loads start per frame, and the range of an evicted mesh
+// is freed ResidencyRetireFrames frames later, once no packet in flight can draw it
+const unsigned int ResidencyKeepFrames = 30;
+const unsigned int ResidencyLoadsPerFrame = 4;
+const int ResidencyRetireFrames = 2;
+// Vertices of the bounding box drawn in place of an evicted mesh
+const GLsizei ProxyVertices = 36;
+
+// Features of the TransformVertexShader / ColorFragmentShader variants
+enum SceneFeature{
+    SceneTexture = 1 << 0,  // UVs and a texture
+    SceneNormals = 1 << 1,  // vertex normals
+    SceneLighting = 1 << 2, // clustered point lights, for models with normals when --lights is given
+};
+const char * const SceneFeatureNames[] = { "HAS_TEXTURE", "HAS_NORMALS", "HAS_LIGHTING" };
+
+// Light lists are read from buffer textures on the units after the model texture
+const GLuint LightTextureUnit = 1;
+// View frustum split into 16x9 tiles and 24 depth slices for the light lists
+const ClusterGrid LightGrid = { 16, 9, 24, 0.1f, 100.0f };
+
+// Uniform blocks of TransformVertexShader (std140), written to the uniform ring
+const GLuint FrameConstantsBinding = 0;
+const GLuint ObjectConstantsBinding = 1;
+struct FrameConstants{
+    glm::mat4 VP;
+    glm::mat4 V;
+    glm::vec4 clusterScale;     // tiles per pixel in x and y, depth slice scale and bias
+    glm::ivec4 clusterGrid;     // tiles in x and y, depth slices
+    glm::vec4 sunDirection;     // view space, towards the light
+    glm::vec4 sunColor;
+};
+struct ObjectConstants{
+    glm::mat4 M;
+    glm::mat4 N;            // inverse transpose of M, for normals
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;     // w is the shininess
+};
+
+// Camera snapshot a frame is built from
+struct FrameInput{
+    glm::mat4 view;
+    glm::mat4 projection;
+    double time;            // seconds, drives --animate
+    bool pick;              // find the model under pickX, pickY (window coordinates)
+    double pickX, pickY;
+};
+
+// New transform of a model that moved, applied to its ObjectConstants on the GL thread
+struct ObjectMove{
+    unsigned int object;
+    glm::mat4 M;
+    glm::mat4 N;
+};
+
+// Mesh evicted in frame, its range is freed after ResidencyRetireFrames
+struct EvictedMesh{
+    unsigned int object;
+    int frame;
+};
+
+// Everything the GL thread needs to draw one frame, built by buildFrame
+struct FramePacket{
+    glm::mat4 VP;
+    glm::mat4 V;            // the view VP and the light clusters were built with
+    RenderQueue queue;      // visible models, sorted
+    RenderQueue prepass;    // the same models front to back with the depth only program
+    std::vector<unsigned int> objects; // model of each command's uniformSlot
+    CullStats cull;
+    OcclusionStats occlusion;
+    ClusterData lights;     // point lights of the view, assigned to clusters
+    std::vector<ObjectMove> moved; // models the scene graph moved for this frame
+    double cullMilliseconds, occlusionMilliseconds, queueMilliseconds;
+    bool picked;            // the input asked for a pick, result below
+    PickResult pick;
+    double pickMicroseconds;
+};
+
+// Command line options
+//   part4 [scene.models] [--headless] [--frames N] [--size WxH] [--dump prefix]
+//         [--profile out.csv|out.json] [--no-hud] [--no-worker]
+//         [--dynamic-res] [--target-fps N] [--scale-min S] [--scale-max S] [--scale-smoothing A]
+//         [--depth-prepass] [--prepass-compare] [--front-to-back]
+//         [--shader-cache dir] [--no-shader-cache] [--lights N] [--animate] [--sdf-text]
+//         [--on-demand] [--max-fps N] [--pick X,Y] [--software] [--keep-geometry] [--memory-report]
+//         [--geometry-budget MB] [--bundle file]
+struct Options{
+    const char * scene;
+    bool headless;      // render into an FBO of an EGL context, no window
+    int frames;         // stop after this many frames and print frame times, 0 = run until ESC
+    int width, height;
+    const char * dump;  // write every frame to <dump>NNNN.ppm
+    const char * profile; // per frame phase timings, JSON when the name ends in .json
+    bool hud;           // frame statistics overlay
+    bool sdfText;       // draw the overlay from a distance field atlas
+    bool worker;        // build frames on a worker thread, one frame ahead
+    bool dynamicResolution; // render the scene at a scale that keeps frame time on target
+    DynamicResolutionSettings resolution;
+    bool depthPrepass;  // lay down depth first, then shade with GL_EQUAL
+    bool prepassCompare; // pre-pass on every other frame only, reports shaded samples of both
+    bool frontToBack;   // sort the shading pass by depth instead of state
+    const char * shaderCache; // directory of linked program binaries, NULL compiles every start
+    int lights;         // point lights scattered over the scene, 0 keeps the unlit shading
+    bool animate;       // spin the first model of the scene
+    bool onDemand;      // sleep in glfwWaitEvents and only draw after the view or window changed
+    double maxFps;      // windowed frame rate cap, 0 = none
+    bool pick;          // print the model under window position pickX, pickY on the first frame
+    double pickX, pickY;
+    bool software;      // draw on the CPU with SoftRasterizer, headless runs need no GPU at all
+    bool keepGeometry;  // keep the CPU copies of every mesh after its upload
+    bool memoryReport;  // list the memory of every mesh and texture after loading and after cleanup
+    double geometryBudget; // MB of vertex data on the GPU, least recently drawn meshes are evicted; 0 = no limit
+    const char * bundle;   // scene, meshes and textures from one file written by packbundle instead of scene
+};
+
+bool parseOptions(int argc, char ** argv, Options & options){
+    options.scene = "default.models";
+    options.headless = false;
+    options.frames = 0;
+    options.width = 1024;
+    options.height = 768;
+    options.dump = NULL;
+    options.profile = NULL;
+    options.hud = true;
+    options.sdfText = false;
+    options.worker = true;
+    options.dynamicResolution = false;
+    options.resolution = defaultDynamicResolutionSettings();
+    options.depthPrepass = false;
+    options.prepassCompare = false;
+    options.frontToBack = false;
+    options.shaderCache = "shadercache";
+    options.lights = 0;
+    options.animate = false;
+    options.onDemand = false;
+    options.maxFps = 0.0;
+    options.pick = false;
+    options.software = false;
+    options.keepGeometry = false;
+    options.memoryReport = false;
+    options.geometryBudget = 0.0;
+    options.bundle = NULL;
+    
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--headless") == 0){
+            options.headless = true;
+        }else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc){
+            options.frames = atoi(argv[++i]);
+        }else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc){
+            if (sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2)
+                return false;
+        }else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc){
+            options.dump = argv[++i];
+        }else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc){
+            options.profile = argv[++i];
+        }else if (strcmp(argv[i], "--no-hud") == 0){
+            options.hud = false;
+        }else if (strcmp(argv[i], "--sdf-text") == 0){
+            options.sdfText = true;
+        }else if (strcmp(argv[i], "--no-worker") == 0){
+            options.worker = false;
+        }else if (strcmp(argv[i], "--depth-prepass") == 0){
+            options.depthPrepass = true;
+        }else if (strcmp(argv[i], "--prepass-compare") == 0){
+            options.depthPrepass = true;
+            options.prepassCompare = true;
+        }else if (strcmp(argv[i], "--front-to-back") == 0){
+            options.frontToBack = true;
+        }else if (strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc){
+            options.shaderCache = argv[++i];
+        }else if (strcmp(argv[i], "--no-shader-cache") == 0){
+            options.shaderCache = NULL;
+        }else if (strcmp(argv[i], "--pick") == 0 && i + 1 < argc){
+            if (sscanf(argv[++i], "%lf,%lf", &options.pickX, &options.pickY) != 2)
+                return false;
+            options.pick = true;
+        }else if (strcmp(argv[i], "--software") == 0){
+            options.software = true;
+        }else if (strcmp(argv[i], "--animate") == 0){
+            options.animate = true;
+        }else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc){
+            options.lights = atoi(argv[++i]);
+            if (options.lights < 0)
+                return false;
+        }else if (strcmp(argv[i], "--dynamic-res") == 0){
+            options.dynamicResolution = true;
+        }else if (strcmp(argv[i], "--keep-geometry") == 0){
+            options.keepGeometry = true;
+        }else if (strcmp(argv[i], "--memory-report") == 0){
+            options.memoryReport = true;
+        }else if (strcmp(argv[i], "--geometry-budget") == 0 && i + 1 < argc){
+            options.geometryBudget = atof(argv[++i]);
+            if (options.geometryBudget < 0.0)
+                return false;
+        }else if (strcmp(argv[i], "--bundle") == 0 && i + 1 < argc){
+            options.bundle = argv[++i];
+        }else if (strcmp(argv[i], "--on-demand") == 0){
+            options.onDemand = true;
+        }else if (strcmp(argv[i], "--max-fps") == 0 && i + 1 < argc){
+            options.maxFps = atof(argv[++i]);
+            if (options.maxFps <= 0.0)
+                return false;
+        }else if (strcmp(argv[i], "--target-fps") == 0 && i + 1 < argc){
+            double fps = atof(argv[++i]);
+            if (fps <= 0.0)
+                return false;
+            options.resolution.targetMilliseconds = 1000.0 / fps;
+        }else if (strcmp(argv[i], "--scale-min") == 0 && i + 1 < argc){
+            options.resolution.minScale = (float)atof(argv[++i]);
+        }else if (strcmp(argv[i], "--scale-max") == 0 && i + 1 < argc){
+            options.resolution.maxScale = (float)atof(argv[++i]);
+        }else if (strcmp(argv[i], "--scale-smoothing") == 0 && i + 1 < argc){
+            options.resolution.smoothing = (float)atof(argv[++i]);
+        }else if (argv[i][0] != '-'){
+            options.scene = argv[i];
+        }else{
+            return false;
+        }
+    }
+    // Headless runs always end on their own
+    if (options.headless && options.frames <= 0)
+        options.frames = 100;
+    // Render targets are allocated at the output size, so the scale never exceeds 1
+    if (options.resolution.minScale <= 0.0f || options.resolution.minScale > options.resolution.maxScale ||
+        options.resolution.maxScale > 1.0f || options.resolution.smoothing <= 0.0f || options.resolution.smoothing > 1.0f)
+        return false;
+    return options.width > 0 && options.height > 0;
+}
+
+// count coloured point lights at random places inside box, the same ones every run.
+// Their radius shrinks with the count so every point is lit by a handful of them.
+void makeLights(int count, const AABB & box, std::vector<PointLight> & out_lights){
+    std::mt19937 rng(485);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 size = box.max - box.min;
+    float radius = glm::length(size) * 0.8f / std::cbrt((float)count);
+    out_lights.resize(count);
+    for (int i = 0; i < count; i++){
+        PointLight & light = out_lights[i];
+        light.position = box.min + size * glm::vec3(unit(rng), unit(rng), unit(rng));
+        light.radius = radius * (0.75f + 0.5f * unit(rng));
+        // Saturated hue
+        float h = unit(rng) * 6.0f;
+        glm::vec3 hue = glm::clamp(glm::vec3(std::fabs(h - 3.0f) - 1.0f, 2.0f - std::fabs(h - 2.0f), 2.0f - std::fabs(h - 4.0f)), 0.0f, 1.0f);
+        light.color = (glm::vec3(0.3f) + 0.7f * hue) * 1.5f;
+    }
+}
+
 // defining a struct
 // purpose - to same multiple models and
 // objects and their information in one place with
@@ -34,24 +328,161 @@ struct ModelObjects{
     std::vector<glm::vec2> MU;
     std::vector<glm::vec3> MN;
     Model M;
-    glm::mat4 MM;
     GLuint vid;
+    GLuint tex;
+    unsigned int material; // models with identical material parameters share an id
+    GLuint pid;            // position only VAO for the depth pre-pass
+    int variant;           // scene shader variant matching the vertex data
+    GLuint program;        // and its program
+    unsigned int node;     // scene graph node
+    unsigned int vertices; // GpuBufferPool range: positions, then normals and uvs; none while evicted
+    size_t normalOffset, uvOffset; // into it, 0 when the mesh has none
+    GLuint bid;            // bounding box VAO drawn while the mesh is evicted, with --geometry-budget
+    unsigned int proxy;    // and its range
+    unsigned int meshAsset;    // MemoryLedger entries of the .obj
+    unsigned int textureAsset; // and of the texture, if tex is set
 };
 
-int main( void )
-{
-    
-    
-    
-    /**********************************/
-    /*** APPLICATION INITIALIZATION ***/
-    /**********************************/
-    
+// The models of the scene: from the bundle when --bundle names one, with the chunk of
+// each mesh and texture, otherwise from the .models file
+bool loadScene(const Options & options, SceneBundle & bundle, std::vector<Model> & models,
+               std::vector<int> & mesh_chunks, std::vector<int> & texture_chunks){
+    if (!options.bundle)
+        return loadModels(options.scene, models);
+    if (!bundle.open(options.bundle))
+        return false;
+    if (!bundle.readScene(models, mesh_chunks, texture_chunks)){
+        printf("%s has no valid scene\n", options.bundle);
+        return false;
+    }
+    printf("bundle %s: %u models, %u chunks, %.1f MB mapped\n", options.bundle, (unsigned int)models.size(),
+           bundle.chunkCount(), bundle.getFileSize() / (1024.0 * 1024.0));
+    return true;
+}
+
+// Offsets of the normals and uvs in a mesh's range of the vertex pool, 0 for those it
+// doesn't have, and the size of the range
+size_t vertexLayout(ModelObjects & object, size_t numVertices, bool has_normals, bool has_uvs){
+    size_t bytes = (numVertices * sizeof(glm::vec3) + 15) & ~(size_t)15;
+    object.normalOffset = 0;
+    object.uvOffset = 0;
+    if (has_normals){
+        object.normalOffset = bytes;
+        bytes += (numVertices * sizeof(glm::vec3) + 15) & ~(size_t)15;
+    }
+    if (has_uvs){
+        object.uvOffset = bytes;
+        bytes += numVertices * sizeof(glm::vec2);
+    }
+    return bytes;
+}
+
+// Copies a mesh into a new range of the vertex pool, laid out by vertexLayout
+void uploadVertices(ModelObjects & object, GpuBufferPool & pool, size_t bytes, const std::vector<glm::vec3> & vertices,
+                    const std::vector<glm::vec3> & normals, const std::vector<glm::vec2> & uvs){
+    object.vertices = pool.allocate(bytes, 16, NULL);
+    pool.upload(object.vertices, 0, vertices.size() * sizeof(glm::vec3), &vertices[0]);
+    if (object.normalOffset)
+        pool.upload(object.vertices, object.normalOffset, vertices.size() * sizeof(glm::vec3), &normals[0]);
+    if (object.uvOffset)
+        pool.upload(object.vertices, object.uvOffset, vertices.size() * sizeof(glm::vec2), &uvs[0]);
+}
+
+// The model space bounds as 12 triangles with face normals
+void proxyTriangles(const AABB & bounds, glm::vec3 positions[ProxyVertices], glm::vec3 normals[ProxyVertices]){
+    static const int faces[6][4] = {
+        {0, 2, 6, 4}, {1, 5, 7, 3}, {0, 4, 5, 1}, {2, 3, 7, 6}, {0, 1, 3, 2}, {4, 6, 7, 5}
+    };
+    glm::vec3 corners[8];
+    for (int c = 0; c < 8; c++)
+        corners[c] = glm::vec3(c & 1 ? bounds.max.x : bounds.min.x, c & 2 ? bounds.max.y : bounds.min.y,
+                               c & 4 ? bounds.max.z : bounds.min.z);
+    static const int corner_order[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int f = 0; f < 6; f++){
+        glm::vec3 normal = glm::normalize(glm::cross(corners[faces[f][1]] - corners[faces[f][0]],
+                                                     corners[faces[f][2]] - corners[faces[f][0]]));
+        if (!(normal == normal))
+            normal = glm::vec3(0.0f, 1.0f, 0.0f);
+        for (int v = 0; v < 6; v++){
+            positions[f * 6 + v] = corners[faces[f][corner_order[v]]];
+            normals[f * 6 + v] = normal;
+        }
+    }
+}
+
+// The bounds box in a range of its own, drawn while the mesh is not resident
+void uploadProxy(ModelObjects & object, GpuBufferPool & pool, const AABB & bounds){
+    glm::vec3 positions[ProxyVertices], normals[ProxyVertices];
+    proxyTriangles(bounds, positions, normals);
+    object.proxy = pool.allocate(sizeof(positions) + sizeof(normals), 16, NULL);
+    pool.upload(object.proxy, 0, sizeof(positions), positions);
+    pool.upload(object.proxy, sizeof(positions), sizeof(normals), normals);
+    glGenVertexArrays(1, &object.bid);
+}
+
+// Points the model's vertex arrays at its ranges of the vertex pool, again whenever
+// the pool moves them or the mesh is loaded back
+void setVertexPointers(const ModelObjects & object, const GpuBufferPool & pool){
+    if (object.vertices != BufferSuballocator::NoAllocation){
+        size_t base = pool.getOffset(object.vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, pool.getBuffer(object.vertices));
+        glBindVertexArray(object.vid);
+        
+        // 1rst attribute buffer : vertices
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)base);
+        
+        // 2nd attribute buffer : normals
+        if (object.normalOffset){
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)(base + object.normalOffset));
+        }
+        
+        // 3rd attribute buffer : VtexCoord
+        if (object.uvOffset){
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, (void*)(base + object.uvOffset));
+        }
+        
+        // Positions alone for the depth pre-pass
+        if (object.pid){
+            glBindVertexArray(object.pid);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)base);
+        }
+    }
+    // The placeholder box, its uvs read as 0 in textured variants
+    if (object.bid){
+        size_t base = pool.getOffset(object.proxy);
+        glBindBuffer(GL_ARRAY_BUFFER, pool.getBuffer(object.proxy));
+        glBindVertexArray(object.bid);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)base);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)(base + ProxyVertices * sizeof(glm::vec3)));
+    }
+    glBindVertexArray(0);
+}
+
+// Totals of the loaded assets, and the whole ledger when asked for. Pick BVHs are
+// counted apart: they are built from the geometry, not left over from its upload.
+void printMemory(const MemoryLedger & memory, bool report){
+    printf("memory: %.1f MB CPU (%.1f MB of it pick BVHs), %.1f MB GPU, %.1f MB of CPU geometry released after upload\n",
+           memory.cpuBytes() / (1024.0 * 1024.0), memory.cpuBytes("pick BVH") / (1024.0 * 1024.0),
+           memory.gpuBytes() / (1024.0 * 1024.0), memory.releasedCpuBytes("mesh") / (1024.0 * 1024.0));
+    if (memory.overReleases())
+        printf("memory: %u releases of more than an asset held\n", memory.overReleases());
+    if (report)
+        memory.report(stdout);
+}
+
+// Window with a GL 3.3 core context, made current
+bool openWindow(int width, int height){
     // Initialise GLFW
     if( !glfwInit() )
     {
         fprintf( stderr, "Failed to initialize GLFW\n" );
-        return -1;
+        return false;
     }
     
     glfwWindowHint(GLFW_SAMPLES, 4);
@@ -61,18 +492,243 @@ int main( void )
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     
     // Open a window and create its OpenGL context
-    window = glfwCreateWindow( 1024, 768, "CMPT 485", NULL, NULL);
+    window = glfwCreateWindow( width, height, "CMPT 485", NULL, NULL);
     if( window == NULL ){
         fprintf( stderr, "Failed to open GLFW window.\n" );
         glfwTerminate();
-        return -1;
+        return false;
     }
     glfwMakeContextCurrent(window);
-    
-    // Initialize GLEW
+    return true;
+}
+
+bool initializeGLEW(){
     glewExperimental = true; // Needed for core profile
     if (glewInit() != GLEW_OK) {
         fprintf(stderr, "Failed to initialize GLEW\n");
+        return false;
+    }
+    // glewExperimental leaves a GL_INVALID_ENUM behind on core profiles
+    glGetError();
+    return true;
+}
+
+// --software: the scene drawn by SoftRasterizer on the thread pool, with the same
+// meshes, textures, transforms and unlit shading as the GL path. Headless runs create
+// no GL context at all; a window only shows the finished images.
+int runSoftware(const Options & options){
+    
+    window = NULL;
+    if (!options.headless){
+        if (!openWindow(options.width, options.height) || !initializeGLEW())
+            return -1;
+        glfwPollEvents();
+        glfwSetCursorPos(window, options.width/2, options.height/2);
+        initializeMouseCallbacks(options.width, options.height);
+    }else{
+        initializeView(options.width, options.height);
+    }
+    
+    std::vector<Model> models;
+    SceneBundle bundle;
+    std::vector<int> mesh_chunks, texture_chunks;
+    std::vector<unsigned char> bundle_scratch;
+    if (!loadScene(options, bundle, models, mesh_chunks, texture_chunks)){
+        return -1;
+    }
+    
+    // Geometry as loadOBJ returns it; models sharing a texture file share its mipmaps.
+    // The rasterizer reads every copy each frame, so nothing is released.
+    MemoryLedger memory;
+    LinearArena load_arena;
+    std::vector<ModelObjects> model_objects(models.size());
+    std::vector<int> model_textures(models.size(), -1);
+    std::vector<SoftTexture> textures;
+    std::vector<std::string> texture_files;
+    TransformSoA model_transforms;
+    CullingBounds model_bounds;
+    std::vector<AABB> local_boxes(models.size());
+    std::vector<BoundingSphere> local_spheres(models.size());
+    for (size_t i = 0; i < models.size(); i++){
+        const Model & model = models[i];
+        ModelObjects & object = model_objects[i];
+        object.M = model;
+        bool loaded = options.bundle ? bundle.readMesh(mesh_chunks[i], object.MV, object.MU, object.MN, bundle_scratch) != NULL
+                                     : loadOBJ(model.objFilename.c_str(), object.MV, object.MU, object.MN, &load_arena);
+        if (!loaded){
+            return -1;
+        }
+        object.meshAsset = memory.record("mesh", model.objFilename, (int)i);
+        memory.allocateCPU(object.meshAsset, vectorBytes(object.MV) + vectorBytes(object.MU) + vectorBytes(object.MN));
+        if (object.MU.size() == object.MV.size()){
+            size_t t = std::find(texture_files.begin(), texture_files.end(), model.textureFilename) - texture_files.begin();
+            if (t == texture_files.size()){
+                std::vector<unsigned char> pixels;
+                unsigned int width = 0, height = 0;
+                textures.push_back(SoftTexture());
+                texture_files.push_back(model.textureFilename);
+                if (options.bundle){
+                    const unsigned char * bgr = texture_chunks[i] >= 0 ?
+                        bundle.readTexture(texture_chunks[i], width, height, bundle_scratch) : NULL;
+                    if (bgr)
+                        textures.back().create(bgr, width, height);
+                }else if (loadBMP_pixels(model.textureFilename.c_str(), pixels, width, height)){
+                    textures.back().create(&pixels[0], width, height);
+                }
+                memory.allocateCPU(memory.record("texture", model.textureFilename, MemoryLedger::Shared), textures.back().memoryBytes());
+            }
+            if (textures[t].getWidth() > 0)
+                model_textures[i] = (int)t;
+        }
+        model_transforms.push_back(glm::vec3(model.tx, model.ty, model.tz),
+                                   glm::angleAxis(model.ra, glm::normalize(glm::vec3(model.rx, model.ry, model.rz))),
+                                   glm::vec3(model.sx, model.sy, model.sz));
+        computeBounds(object.MV, local_boxes[i], local_spheres[i]);
+    }
+    load_arena.release();
+    std::vector<glm::mat4> model_matrices(models.size());
+    if (!models.empty())
+        composeTransforms(model_transforms, 0, models.size(), &model_matrices[0]);
+    for (size_t i = 0; i < models.size(); i++)
+        model_bounds.push_back(transformAABB(local_boxes[i], model_matrices[i]), transformSphere(local_spheres[i], model_matrices[i]));
+    const glm::quat spin_base = models.empty() ? glm::quat() : model_transforms.rotation(0);
+    printMemory(memory, options.memoryReport);
+    
+    SoftRasterizer rasterizer;
+    rasterizer.resize(options.width, options.height);
+    ThreadPool & thread_pool = defaultThreadPool();
+    
+    // The window shows each image through a texture blitted to the back buffer
+    GLuint present_texture = 0, present_fbo = 0;
+    if (window){
+        glGenTextures(1, &present_texture);
+        glBindTexture(GL_TEXTURE_2D, present_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, options.width, options.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &present_fbo);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, present_fbo);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, present_texture, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    }
+    
+    std::vector<double> frame_times;
+    std::vector<unsigned int> visible_models;
+    double geometry_ms = 0.0, raster_ms = 0.0;
+    SoftRasterStats last_stats = SoftRasterStats();
+    std::chrono::high_resolution_clock::time_point loop_start = std::chrono::high_resolution_clock::now();
+    for (int frame = 0; ; frame++){
+        std::chrono::high_resolution_clock::time_point frame_start = std::chrono::high_resolution_clock::now();
+        
+        if (options.animate && !models.empty()){
+            double time = options.frames > 0 ? frame / 60.0 : std::chrono::duration<double>(frame_start - loop_start).count();
+            glm::quat spin = glm::angleAxis((float)time, glm::vec3(0.0f, 1.0f, 0.0f));
+            model_transforms.set(0, model_transforms.translation(0), spin_base * spin, model_transforms.scale(0));
+            composeTransforms(model_transforms, 0, 1, &model_matrices[0]);
+            model_bounds.set(0, transformAABB(local_boxes[0], model_matrices[0]), transformSphere(local_spheres[0], model_matrices[0]));
+        }
+        
+        // Same clear colour and frustum culling as the GL path
+        glm::mat4 VP = getProjectionMatrix() * getViewMatrix();
+        cullBounds(extractFrustumPlanes(VP), model_bounds, visible_models);
+        rasterizer.beginFrame(VP, glm::vec3(0.8f));
+        for (size_t v = 0; v < visible_models.size(); v++){
+            int i = visible_models[v];
+            const ModelObjects & object = model_objects[i];
+            SoftDraw draw;
+            draw.positions = &object.MV;
+            draw.uvs = model_textures[i] >= 0 ? &object.MU : NULL;
+            draw.normals = object.MN.size() == object.MV.size() ? &object.MN : NULL;
+            draw.texture = model_textures[i] >= 0 ? &textures[model_textures[i]] : NULL;
+            draw.M = model_matrices[i];
+            draw.ambient = glm::vec3(object.M.ar, object.M.ag, object.M.ab);
+            draw.diffuse = glm::vec3(object.M.dr, object.M.dg, object.M.db);
+            rasterizer.addDraw(draw);
+        }
+        rasterizer.render(thread_pool);
+        last_stats = rasterizer.getStats();
+        geometry_ms += last_stats.geometryMilliseconds;
+        raster_ms += last_stats.rasterMilliseconds;
+        
+        if (window){
+            // Rows go to the texture bottom up, the blit flips them
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glBindTexture(GL_TEXTURE_2D, present_texture);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, options.width, options.height, GL_RGB, GL_UNSIGNED_BYTE, &rasterizer.getColor()[0]);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, present_fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, options.width, options.height, 0, options.height, options.width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glfwSwapBuffers(window);
+        }
+        
+        if (options.frames > 0){
+            frame_times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frame_start).count());
+            if (options.dump){
+                char path[1024];
+                snprintf(path, sizeof(path), "%s%04d.ppm", options.dump, frame);
+                rasterizer.savePPM(path);
+            }
+            if (frame + 1 >= options.frames)
+                break;
+        }
+        
+        if (window){
+            glfwPollEvents();
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE ) == GLFW_PRESS || glfwWindowShouldClose(window) != 0)
+                break;
+        }
+    }
+    
+    if (!frame_times.empty()){
+        printf("scene: %s, %dx%d, %s, software\n", options.scene, options.width, options.height, window ? "window" : "headless");
+        printFrameTimeSummary(summarizeFrameTimes(frame_times));
+        printf("software rasterizer: %u threads, %u draws, %u of %u triangles set up, %u binned, %u pixels shaded; "
+               "geometry %.2f ms, raster %.2f ms per frame\n", thread_pool.size(), last_stats.draws,
+               last_stats.rasterized, last_stats.triangles, last_stats.binned, last_stats.shaded,
+               geometry_ms / frame_times.size(), raster_ms / frame_times.size());
+    }
+    
+    if (window){
+        glDeleteFramebuffers(1, &present_fbo);
+        glDeleteTextures(1, &present_texture);
+        glfwTerminate();
+    }
+    return 0;
+}
+
+int main( int argc, char ** argv )
+{
+    
+    Options options;
+    if (!parseOptions(argc, argv, options)){
+        fprintf( stderr, "Usage: %s [scene.models] [--headless] [--frames N] [--size WxH] [--dump prefix] [--profile out.csv|out.json] [--no-hud] [--no-worker]\n"
+                 "       [--dynamic-res] [--target-fps N] [--scale-min S] [--scale-max S] [--scale-smoothing A]\n"
+                 "       [--depth-prepass] [--prepass-compare] [--front-to-back] [--shader-cache dir] [--no-shader-cache]\n"
+                 "       [--lights N] [--animate] [--sdf-text] [--on-demand] [--max-fps N] [--pick X,Y] [--software]\n"
+                 "       [--keep-geometry] [--memory-report] [--geometry-budget MB]\n"
+                 "       [--bundle file]\n", argv[0] );
+        return -1;
+    }
+    
+    /**********************************/
+    /*** APPLICATION INITIALIZATION ***/
+    /**********************************/
+    
+    if (options.software)
+        return runSoftware(options);
+    
+    if (options.headless){
+        // Offscreen context, nothing is shown
+        window = NULL;
+        if (!createHeadlessContext(3, 3)){
+            return -1;
+        }
+    }else if (!openWindow(options.width, options.height)){
+        return -1;
+    }
+    
+    if (!initializeGLEW()){
         return -1;
     }
     
@@ -81,12 +737,38 @@ int main( void )
     // Hide the mouse and enable unlimited mouvement
 //    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     
-    // Set the mouse at the center of the screen
-    glfwPollEvents();
-    glfwSetCursorPos(window, 1024/2, 768/2);
-    
-    // Initialize mouse callbacks
-    initializeMouseCallbacks();
+    // Offscreen targets: the scene goes into a 4x MSAA target to match the window when
+    // running headless or at a dynamic resolution. With dynamic resolution it is resolved
+    // at the render size into scaled_target and then upscaled to the output, which is
+    // resolve_target when headless (read back for image dumps) or the window.
+    bool offscreen = !window || options.dynamicResolution;
+    RenderTarget msaa_target = RenderTarget();
+    RenderTarget scaled_target = RenderTarget();
+    RenderTarget resolve_target = RenderTarget();
+    if (window){
+        // Set the mouse at the center of the screen
+        glfwPollEvents();
+        glfwSetCursorPos(window, options.width/2, options.height/2);
+        
+        // Initialize mouse callbacks
+        initializeMouseCallbacks(options.width, options.height);
+        
+        // Frame times have to show the load, not the display refresh
+        if (options.dynamicResolution)
+            glfwSwapInterval(0);
+    }else{
+        if (!createRenderTarget(resolve_target, options.width, options.height, 0)){
+            return -1;
+        }
+    }
+    if (offscreen && !createRenderTarget(msaa_target, options.width, options.height, 4)){
+        return -1;
+    }
+    if (options.dynamicResolution && !createRenderTarget(scaled_target, options.width, options.height, 0)){
+        return -1;
+    }
+    const RenderTarget * output_target = window ? NULL : &resolve_target;
+    DynamicResolution dynamic_resolution(options.resolution);
     
     
     /**********************************/
@@ -104,20 +786,37 @@ int main( void )
     
     
     
-    // Create and compile our GLSL program from the shaders
-    GLuint programID = LoadShaders( "TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader" );
-    // Use our shader
-    glUseProgram(programID);
+    // Programs are reloaded from the binaries of an earlier start when possible
+    ProgramCache program_cache;
+    if (options.shaderCache && !program_cache.initialize(options.shaderCache))
+        printf("program binaries not available, compiling shaders\n");
     
-    // Get a handle for our "MVP" uniform
-    GLuint ViewProjectionMatrixID = glGetUniformLocation(programID, "VP");
-    GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
+    // Each model is shaded by the variant of our GLSL program that matches its vertex
+    // data, they are compiled while the models load
+    ShaderVariants scene_variants;
+    if (!scene_variants.initialize("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader",
+                                   SceneFeatureNames, 3, &program_cache)){
+        return -1;
+    }
     
-    // Initialize GLFW control callbacks
-    initializeMouseCallbacks();
+    // Depth only program for the pre-pass
+    GLuint depthProgramID = 0;
+    if (options.depthPrepass){
+        depthProgramID = program_cache.load( "DepthVertexShader.vertexshader", "DepthFragmentShader.fragmentshader" );
+        if (!depthProgramID){
+            return -1;
+        }
+        glUniformBlockBinding(depthProgramID, glGetUniformBlockIndex(depthProgramID, "FrameConstants"), FrameConstantsBinding);
+        glUniformBlockBinding(depthProgramID, glGetUniformBlockIndex(depthProgramID, "ObjectConstants"), ObjectConstantsBinding);
+    }
+    // M comes from the ObjectConstants block, the queue never uploads it
+    GLint ModelMatrixID = -1;
     
-    // Projection and Model matrices are fixed
-    glm::mat4 ProjectionMatrix = getProjectionMatrix();
+    // Initialize GLFW control callbacks
+    if (window)
+        initializeMouseCallbacks(options.width, options.height);
+    else
+        initializeView(options.width, options.height);
     
     /**********************************/
     /**** LOAD MODEL INFORMATION ******/
@@ -126,26 +825,64 @@ int main( void )
     std::vector<Model> models;
     std::vector<ModelObjects> model_objects;
     
-    loadModels("default.models", models);
+    // With --bundle, every mesh and texture is read from one mapped file; uncompressed
+    // chunks are uploaded straight from the mapping
+    SceneBundle bundle;
+    std::vector<int> mesh_chunks, texture_chunks;
+    std::vector<unsigned char> bundle_scratch, texture_scratch;
+    if (!loadScene(options, bundle, models, mesh_chunks, texture_chunks)){
+        return -1;
+    }
     
     //buffer initialization
     GLuint tex_id;
     GLuint vertex_id;
-    GLuint vertex_buffer;
-    GLuint normalsbuffer;
+    std::vector<Model> materials;
+    
+    // CPU and GPU bytes of every mesh and texture
+    MemoryLedger memory;
+    
+    // Vertex data of every model in a few large buffers, compacted a little every frame
+    // once models are unloaded; the model owning each range, by pool handle
+    GpuBufferPool vertex_pool;
+    std::vector<int> vertex_pool_objects;
+    std::vector<unsigned int> moved_ranges;
+    
+    // --geometry-budget: one residency item per model. Meshes past the budget at load
+    // time are only parsed for their bounds and come back from disk on the streaming
+    // thread when they are drawn.
+    ResidencyManager residency((size_t)(options.geometryBudget * 1024.0 * 1024.0));
+    MeshStreamer mesh_streamer;
+    
+    // Every model hangs below one scene root for now; the graph keeps world matrices
+    // and bounds up to date when a node moves
+    SceneGraph scene_graph;
+    const unsigned int scene_root = scene_graph.addNode(SceneGraph::NoParent, glm::mat4(1.0f));
+    std::vector<int> node_objects(1, -1);
+    
+    // Hot per-model state, indexed like model_objects. Kept apart from the geometry
+    // copies in ModelObjects so the per-frame loops walk contiguous arrays
+    TransformSoA model_transforms;         // translation, rotation and scale from the .models file
+    std::vector<AABB> model_bounds;        // model space, computed once at load time
+    std::vector<BoundingSphere> model_spheres;
 
     
-    for (int i = 0; i<models.size(); i++){
+    // The parser's temporaries of every .obj, the chunks are reused from model to model
+    LinearArena load_arena;
+    bool budget_full = false;
+    std::chrono::high_resolution_clock::time_point load_start = std::chrono::high_resolution_clock::now();
+    
+    for (size_t i = 0; i < models.size(); i++){
         Model model = models[i]; //each model
         
-        glm::mat4 I = glm::mat4(1.0f); // Identity Matrix
-        glm::mat4 Ms = glm::scale(I, glm::vec3(model.sx, model.sy, model.sz));
-        glm::mat4 Mr = glm::rotate(I, model.ra,glm::vec3(model.rx, model.ry, model.rz));
-        glm::mat4 Mt = glm::translate(I, glm::vec3(model.tx, model.ty, model.tz));
-        glm::mat4 Mminust = glm::translate(I, glm::vec3(-model.tx, -model.ty, -model.tz));
-        glm::mat4 ModelMatrix = Mt * Mr * Ms;
+        // Composed into model matrices in one batch once every model is loaded
+        model_transforms.push_back(glm::vec3(model.tx, model.ty, model.tz),
+                                   glm::angleAxis(model.ra, glm::normalize(glm::vec3(model.rx, model.ry, model.rz))),
+                                   glm::vec3(model.sx, model.sy, model.sz));
         
-        // Read our .obj file
+        // Read our .obj file. Once a mesh did not fit the budget, only the vertex count,
+        // attributes and bounds of the rest are parsed, without unrolling them. Bundles
+        // have those in their table of contents and read the vertex data of resident meshes.
         std::vector<glm::vec3> vertices;
         std::vector<glm::vec2> uvs;
         std::vector<glm::vec3> normals;
@@ -153,109 +890,602 @@ int main( void )
         std::vector<glm::ivec3> uv_indices;
         std::vector<glm::ivec3> normal_indices;
         
-        bool loadSuccess = loadOBJ(model.objFilename.c_str(), vertices, uvs, normals);
+        MeshBounds mesh_bounds = MeshBounds();
+        bool loadSuccess;
+        if (options.bundle){
+            loadSuccess = bundle.readMeshBounds(mesh_chunks[i], mesh_bounds);
+        }else if (budget_full){
+            loadSuccess = loadOBJ_bounds(model.objFilename.c_str(), mesh_bounds, &load_arena);
+        }else{
+            loadSuccess = loadOBJ(model.objFilename.c_str(), vertices, uvs, normals, &load_arena);
+            AABB box;
+            BoundingSphere sphere;
+            computeBounds(vertices, box, sphere);
+            mesh_bounds.vertices = vertices.size();
+            mesh_bounds.normals = normals.size() == vertices.size();
+            mesh_bounds.uvs = uvs.size() == vertices.size();
+            mesh_bounds.min = box.min;
+            mesh_bounds.max = box.max;
+            mesh_bounds.radius = sphere.radius;
+        }
         if (!loadSuccess) {
             return -1;
         }
         
-        //initialzing a the struct we constructed in the very beginning
-        ModelObjects OG = {vertices, uvs, normals, model, ModelMatrix, vertex_id};
-        model_objects.push_back(OG);
-        //store the size every iteration
-        GLsizei UV_size_vertex = uvs.size();
-
+        //initialzing a the struct we constructed in the very beginning; the geometry
+        //is moved in, not copied
+        ModelObjects OG = ModelObjects();
+        OG.MV = std::move(vertices);
+        OG.MU = std::move(uvs);
+        OG.MN = std::move(normals);
+        OG.M = model;
+        model_bounds.push_back(AABB());
+        model_spheres.push_back(BoundingSphere());
+        model_bounds.back().min = mesh_bounds.min;
+        model_bounds.back().max = mesh_bounds.max;
+        model_spheres.back().center = 0.5f * (mesh_bounds.min + mesh_bounds.max);
+        model_spheres.back().radius = mesh_bounds.radius;
+        OG.node = scene_graph.addNode(scene_root, glm::mat4(1.0f), &model_bounds.back());
+        node_objects.push_back((int)model_objects.size());
+        
+        // Material id for draw sorting
+        for (OG.material = 0; OG.material < materials.size(); OG.material++){
+            const Model & m = materials[OG.material];
+            if (memcmp(&m.ar, &model.ar, 10 * sizeof(float)) == 0)
+                break;
+        }
+        if (OG.material == materials.size())
+            materials.push_back(model);
+        model_objects.push_back(std::move(OG));
+        ModelObjects & object = model_objects.back();
+        object.meshAsset = memory.record("mesh", model.objFilename, (int)i);
         
         // need to keep track of vbo sizes for drawing later
-        GLsizei numVertices = vertices.size(); // should be same as numNormals
+        GLsizei numVertices = mesh_bounds.vertices; // should be same as numNormals
         num_indicator.push_back(numVertices);
         GLsizei numVertexIndices = vertex_indices.size();
         
-        glGenBuffers(1, &normalsbuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, normalsbuffer);
-        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(glm::vec3), &normals[0], GL_STATIC_DRAW);
-        glGenBuffers(1, &vertex_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-        glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+        // Meshes without normals or UVs get a variant that doesn't read them
+        bool has_normals = mesh_bounds.normals;
+        bool has_uvs = mesh_bounds.uvs;
         
         //read .bmp file
         // assistant tutorials for reading bmp files were observed from below
         //
-        tex_id = loadBMP_custom(model.textureFilename.c_str());
-        //bind texture
-        glBindTexture(GL_TEXTURE_2D, tex_id);
-        glGenBuffers(1, &tex_id);
-        glBindBuffer(GL_ARRAY_BUFFER, tex_id);
-        glBufferData(GL_ARRAY_BUFFER, UV_size_vertex * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+        tex_id = 0;
+        if (has_uvs && options.bundle){
+            unsigned int width, height;
+            const unsigned char * bgr = texture_chunks[i] >= 0 ?
+                bundle.readTexture(texture_chunks[i], width, height, texture_scratch) : NULL;
+            if (bgr)
+                tex_id = createTexture(bgr, width, height);
+        }else if (has_uvs){
+            tex_id = loadBMP_custom(model.textureFilename.c_str());
+        }
+        object.tex = tex_id;
+        if (tex_id){
+            //bind texture
+            glBindTexture(GL_TEXTURE_2D, tex_id);
+            object.textureAsset = memory.record("texture", model.textureFilename, (int)i);
+            memory.allocateGPU(object.textureAsset, textureMemoryBytes(tex_id));
+        }
         
-        //fragment shader sampler
-        glUniform1i(glGetUniformLocation(programID, "t_sampler"), 0);
-        GLuint vTexCoord = glGetAttribLocation( programID, "vTexCoord" );
+        // Positions, normals and uvs one after the other in one range of the vertex pool;
+        // with a budget, meshes past it start evicted and keep no geometry
+        size_t vertex_bytes = vertexLayout(object, numVertices, has_normals, tex_id != 0);
+        bool resident = !residency.hasBudget() || residency.getResidentBytes() + vertex_bytes <= residency.getBudget();
+        residency.add(vertex_bytes, resident ? ResidencyManager::Resident : ResidencyManager::Evicted);
+        budget_full = budget_full || !resident;
+        const unsigned char * packed_vertices = NULL;
+        if (resident && options.bundle){
+            packed_vertices = bundle.readMesh(mesh_chunks[i], object.MV, object.MU, object.MN, bundle_scratch);
+            if (!packed_vertices) {
+                return -1;
+            }
+        }else if (!resident){
+            std::vector<glm::vec3>().swap(object.MV);
+            std::vector<glm::vec2>().swap(object.MU);
+            std::vector<glm::vec3>().swap(object.MN);
+        }
+        memory.allocateCPU(object.meshAsset, vectorBytes(object.MV) + vectorBytes(object.MU) + vectorBytes(object.MN));
+        object.vertices = BufferSuballocator::NoAllocation;
+        if (resident && packed_vertices){
+            // Packed in this layout already, uvs last, so without a texture they are left off the end
+            object.vertices = vertex_pool.allocate(vertex_bytes, 16, packed_vertices);
+        }else if (resident){
+            uploadVertices(object, vertex_pool, vertex_bytes, object.MV, object.MN, object.MU);
+        }
+        if (resident){
+            memory.allocateGPU(object.meshAsset, vertex_pool.getSize(object.vertices));
+            if (vertex_pool_objects.size() <= object.vertices)
+                vertex_pool_objects.resize(object.vertices + 1, -1);
+            vertex_pool_objects[object.vertices] = (int)model_objects.size() - 1;
+        }
+        if (residency.hasBudget()){
+            uploadProxy(object, vertex_pool, model_bounds.back());
+            memory.allocateGPU(object.meshAsset, vertex_pool.getSize(object.proxy));
+            if (vertex_pool_objects.size() <= object.proxy)
+                vertex_pool_objects.resize(object.proxy + 1, -1);
+            vertex_pool_objects[object.proxy] = (int)model_objects.size() - 1;
+        }
+        
+        // Start compiling the variant now if it's a new one, it builds while the next models load
+        unsigned int features = (tex_id ? SceneTexture : 0) | (has_normals ? SceneNormals : 0);
+        if (has_normals && options.lights > 0)
+            features |= SceneLighting;
+        model_objects.back().variant = scene_variants.request(features);
+        scene_variants.compile();
         
         glGenVertexArrays(1, &vertex_id);
-        glBindVertexArray(vertex_id);
         vertex_vector.push_back(vertex_id);
+        object.vid = vertex_id;
+        // Positions alone for the depth pre-pass, from the same range
+        if (options.depthPrepass)
+            glGenVertexArrays(1, &object.pid);
+        setVertexPointers(object, vertex_pool);
         
-        /********************************************/
-        /*** ASSOCIATE DATA WITH SHADER VARIABLES ***/
-        /********************************************/
+    }
+    
+    SuballocatorStats pool_stats = vertex_pool.getStats();
+    printf("vertex pool: %u ranges in %u buffers, %.1f of %.1f KB used\n", pool_stats.allocations, pool_stats.pages,
+           pool_stats.used / 1024.0, pool_stats.capacity / 1024.0);
+    
+    // Read by the frame worker to draw each model or its box; set on the GL thread
+    // after the vertex arrays were pointed at the mesh, cleared when it is evicted
+    std::vector<std::atomic<unsigned char> > model_resident(model_objects.size());
+    for (size_t i = 0; i < model_objects.size(); i++)
+        model_resident[i] = residency.getState(i) == ResidencyManager::Resident;
+    std::vector<EvictedMesh> evicted_meshes;
+    std::vector<StreamedMesh> streamed_meshes;
+    std::vector<unsigned int> residency_loads, residency_evictions;
+    unsigned int streaming_loads = 0;
+    if (residency.hasBudget()){
+        ResidencyStats residency_stats = residency.getStats();
+        printf("geometry budget %.1f MB: %u meshes resident (%.1f MB), %u evicted\n", options.geometryBudget,
+               residency_stats.resident, residency_stats.residentBytes / (1024.0 * 1024.0), residency_stats.evicted);
+        mesh_streamer.start(options.bundle ? &bundle : NULL);
+    }
+    ArenaStats arena_stats = load_arena.getStats();
+    printf("loaded %u models in %.2f ms, load arena %.1f KB peak in %u chunks, %u allocations\n", (unsigned int)models.size(),
+           std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count(),
+           arena_stats.peak / 1024.0, (unsigned int)arena_stats.chunks, (unsigned int)arena_stats.allocations);
+    load_arena.release();
+    
+    // Wait for the variants still compiling and set them up like the other programs:
+    // transformations and materials come from uniform blocks in the uniform ring
+    if (!scene_variants.finish()){
+        return -1;
+    }
+    for (int v = 0; v < scene_variants.count(); v++){
+        GLuint program = scene_variants.getProgram(v);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameConstants"), FrameConstantsBinding);
+        glUniformBlockBinding(program, glGetUniformBlockIndex(program, "ObjectConstants"), ObjectConstantsBinding);
+        glUseProgram(program);
+        if (scene_variants.getFeatures(v) & SceneTexture){
+            //fragment shader sampler
+            glUniform1i(glGetUniformLocation(program, "t_sampler"), 0);
+        }
+        if (scene_variants.getFeatures(v) & SceneLighting){
+            glUniform1i(glGetUniformLocation(program, "lightData"), LightTextureUnit);
+            glUniform1i(glGetUniformLocation(program, "clusterData"), LightTextureUnit + 1);
+            glUniform1i(glGetUniformLocation(program, "lightIndices"), LightTextureUnit + 2);
+        }
+    }
+    for (size_t i = 0; i < model_objects.size(); i++)
+        model_objects[i].program = scene_variants.getProgram(model_objects[i].variant);
+    const ShaderVariantStats & variant_stats = scene_variants.getStats();
+    const ProgramCacheStats & cache_stats = program_cache.getStats();
+    printf("shader variants: %u for %u models, %u compiled%s, %u from binaries (%.2f ms)\n",
+           variant_stats.variants, variant_stats.requests, variant_stats.compiled,
+           variant_stats.parallel ? " in parallel" : "", variant_stats.cached, variant_stats.milliseconds);
+    printf("programs: %u from binaries, %u not cached, %u binaries rejected (%.2f ms)\n",
+           cache_stats.hits, cache_stats.misses, cache_stats.rejected, cache_stats.milliseconds);
+    
+    // Triangle BVHs for picking, one model per thread pool job. Like the vertex data,
+    // they exist while the mesh is resident; evicted meshes are picked by the box drawn
+    // in their place.
+    std::chrono::high_resolution_clock::time_point meshes_start = std::chrono::high_resolution_clock::now();
+    std::vector<MeshBVH> model_meshes(model_objects.size());
+    std::vector<MeshBVH> model_boxes(residency.hasBudget() ? model_objects.size() : 0);
+    std::vector<const MeshBVH *> model_mesh_pointers(model_objects.size());
+    defaultThreadPool().parallelFor((int)model_objects.size(), [&](int i){
+        model_meshes[i].build(model_objects[i].MV);
+        if (!model_boxes.empty()){
+            glm::vec3 positions[ProxyVertices], normals[ProxyVertices];
+            proxyTriangles(model_bounds[i], positions, normals);
+            model_boxes[i].build(std::vector<glm::vec3>(positions, positions + ProxyVertices));
+        }
+    });
+    size_t mesh_triangles = 0, mesh_bytes = 0;
+    std::vector<unsigned int> mesh_assets(model_objects.size());
+    for (size_t i = 0; i < model_objects.size(); i++){
+        model_mesh_pointers[i] = &model_meshes[i];
+        mesh_triangles += model_meshes[i].triangleCount();
+        mesh_bytes += model_meshes[i].memoryBytes();
+        mesh_assets[i] = memory.record("pick BVH", model_objects[i].M.objFilename, (int)i);
+        memory.allocateCPU(mesh_assets[i], model_meshes[i].memoryBytes());
+        if (!model_boxes.empty())
+            memory.allocateCPU(mesh_assets[i], model_boxes[i].memoryBytes());
+    }
+    printf("mesh BVHs: %u triangles, %.1f MB (%.2f ms)\n", (unsigned int)mesh_triangles, mesh_bytes / (1024.0 * 1024.0),
+           std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - meshes_start).count());
+    
+    // Model matrices of every model in one batch, then placed in the scene graph
+    std::vector<glm::mat4> model_matrices(model_objects.size());
+    if (!model_objects.empty())
+        composeTransforms(model_transforms, 0, model_objects.size(), &model_matrices[0]);
+    for (size_t i = 0; i < model_objects.size(); i++)
+        scene_graph.setLocal(model_objects[i].node, model_matrices[i]);
+    scene_graph.update();
+    for (size_t i = 0; i < model_objects.size(); i++)
+        model_matrices[i] = scene_graph.getWorld(model_objects[i].node);
+    
+    // Materials are fixed, the constants are copied into the ring each frame
+    std::vector<ObjectConstants> object_constants(model_objects.size());
+    for (size_t i = 0; i < model_objects.size(); i++){
+        const Model & m = model_objects[i].M;
+        object_constants[i].M = model_matrices[i];
+        object_constants[i].N = glm::transpose(glm::inverse(model_matrices[i]));
+        object_constants[i].ambient = glm::vec4(m.ar, m.ag, m.ab, 1.0f);
+        object_constants[i].diffuse = glm::vec4(m.dr, m.dg, m.db, 1.0f);
+        object_constants[i].specular = glm::vec4(m.sr, m.sg, m.sb, m.ss);
+    }
+    
+    // Three frames of constants in flight: the frame block and one block per model
+    UniformRing uniform_ring;
+    if (!uniform_ring.create(uniform_ring.alignedSize(sizeof(FrameConstants)) +
+                             uniform_ring.alignedSize(sizeof(ObjectConstants)) * model_objects.size(), 3)){
+        return -1;
+    }
+    const size_t object_stride = uniform_ring.alignedSize(sizeof(ObjectConstants));
+    
+    // World space bounds, kept up to date by the frame worker when the scene graph moves models
+    CullingBounds world_bounds;
+    std::vector<AABB> world_boxes(model_objects.size());
+    world_bounds.reserve(model_objects.size());
+    for (size_t i = 0; i < model_objects.size(); i++){
+        world_boxes[i] = scene_graph.getWorldBounds(model_objects[i].node);
+        world_bounds.push_back(world_boxes[i], transformSphere(model_spheres[i], model_matrices[i]));
+    }
+    
+    // Spatial index for visibility, picking and proximity queries
+    SceneBVH scene_index;
+    scene_index.build(world_boxes);
+    
+    // Pick the biggest simple models as occluders for the software occlusion pass
+    std::vector<unsigned char> is_occluder(model_objects.size(), 0);
+    std::vector<unsigned int> occluder_candidates;
+    for (size_t i = 0; i < model_objects.size(); i++){
+        // Meshes that start evicted have no positions to rasterize
+        if (!model_objects[i].MV.empty() && model_objects[i].MV.size() / 3 <= MaxOccluderTriangles)
+            occluder_candidates.push_back(i);
+    }
+    std::sort(occluder_candidates.begin(), occluder_candidates.end(), [&](unsigned int a, unsigned int b){
+        return world_bounds.sr[a] > world_bounds.sr[b];
+    });
+    for (size_t i = 0; i < occluder_candidates.size() && i < MaxOccluders; i++){
+        is_occluder[occluder_candidates[i]] = 1;
+    }
+    
+    // The GPU has the geometry now and picking has its own copy in the mesh BVHs. Only
+    // the occluders still rasterize their positions every frame, everything else goes.
+    if (!options.keepGeometry){
+        for (size_t i = 0; i < model_objects.size(); i++){
+            ModelObjects & object = model_objects[i];
+            size_t before = vectorBytes(object.MV) + vectorBytes(object.MU) + vectorBytes(object.MN);
+            std::vector<glm::vec2>().swap(object.MU);
+            std::vector<glm::vec3>().swap(object.MN);
+            if (!is_occluder[i])
+                std::vector<glm::vec3>().swap(object.MV);
+            memory.releaseCPU(object.meshAsset, before - vectorBytes(object.MV));
+        }
+    }
+    printMemory(memory, options.memoryReport);
+    OcclusionCuller occlusion_culler;
+    ThreadPool & thread_pool = defaultThreadPool();
+    const glm::quat spin_base = model_objects.empty() ? glm::quat() : model_transforms.rotation(0);
+    
+    // Point lights spread through the scene bounds, assigned to clusters on the worker
+    // and uploaded once per frame
+    std::vector<PointLight> scene_lights;
+    ClusteredLights light_clusters;
+    ClusterBuffers light_buffers;
+    if (options.lights > 0){
+        AABB scene_box = world_boxes.empty() ? AABB() : world_boxes[0];
+        for (size_t i = 1; i < world_boxes.size(); i++){
+            scene_box.min = glm::min(scene_box.min, world_boxes[i].min);
+            scene_box.max = glm::max(scene_box.max, world_boxes[i].max);
+        }
+        makeLights(options.lights, scene_box, scene_lights);
+        if (!light_buffers.create()){
+            return -1;
+        }
+        light_clusters.setGrid(LightGrid);
+        light_clusters.setMaxReferences(light_buffers.getMaxTexels());
+    }
+    std::vector<unsigned int> visible_models;
+    std::vector<unsigned int> frame_occluders;
+    std::vector<glm::mat4> occluder_matrices;
+    unsigned int last_culled = (unsigned int)-1;
+    unsigned int last_occluded = (unsigned int)-1;
+    unsigned int last_avoided = (unsigned int)-1;
+    
+    // Culling, occlusion and draw sorting for one camera. Runs on the frame worker and
+    // must not touch GL; everything it writes besides the packet is only used here.
+    auto buildFrame = [&](const FrameInput & input, FramePacket & packet){
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
         
+        // Move the animated nodes; only their subtrees are recomputed, and only the models
+        // in them get new bounds in the culling arrays and the BVH
+        packet.moved.clear();
+        if (options.animate && !model_objects.empty()){
+            glm::quat spin = glm::angleAxis((float)input.time, glm::vec3(0.0f, 1.0f, 0.0f));
+            model_transforms.set(0, model_transforms.translation(0), spin_base * spin, model_transforms.scale(0));
+            glm::mat4 local;
+            composeTransforms(model_transforms, 0, 1, &local);
+            scene_graph.setLocal(model_objects[0].node, local);
+        }
+        if (scene_graph.update()){
+            const std::vector<unsigned int> & changed = scene_graph.getChanged();
+            for (size_t c = 0; c < changed.size(); c++){
+                int i = node_objects[changed[c]];
+                if (i < 0)
+                    continue;
+                model_matrices[i] = scene_graph.getWorld(changed[c]);
+                world_boxes[i] = scene_graph.getWorldBounds(changed[c]);
+                world_bounds.set(i, world_boxes[i], transformSphere(model_spheres[i], model_matrices[i]));
+                scene_index.update(i, world_boxes[i]);
+                ObjectMove move = { (unsigned int)i, model_matrices[i], glm::transpose(glm::inverse(model_matrices[i])) };
+                packet.moved.push_back(move);
+            }
+            scene_index.refit();
+        }
         
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-        glVertexAttribPointer(
-                              0,                  // attribute. No particular reason for 0, but must match the layout in the shader.
-                              3,                  // size
-                              GL_FLOAT,           // type
-                              GL_FALSE,           // normalized?
-                              0,                  // stride
-                              (void*)0            // array buffer offset
-                              );
+        // Cursor picks see the models where this frame draws them
+        packet.picked = input.pick;
+        if (input.pick){
+            std::chrono::high_resolution_clock::time_point pick_start = std::chrono::high_resolution_clock::now();
+            // Boxes are drawn for the meshes not resident, their BVHs may be gone
+            for (size_t i = 0; i < model_boxes.size(); i++)
+                model_mesh_pointers[i] = model_resident[i] ? &model_meshes[i] : &model_boxes[i];
+            pickCursor(input.pickX, input.pickY, options.width, options.height, input.view, input.projection,
+                       scene_index, model_mesh_pointers, model_matrices, packet.pick);
+            packet.pickMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - pick_start).count();
+        }
         
-        // 2nd attribute buffer : normals
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, normalsbuffer);
-        glVertexAttribPointer(
-                              1,                                // attribute. No particular reason for 1, but must match the layout in the shader.
-                              3,                                // size
-                              GL_FLOAT,                         // type
-                              GL_FALSE,                         // normalized?
-                              0,                                // stride
-                              (void*)0                          // array buffer offset
-                              );
+        packet.VP = input.projection * input.view;
+        packet.V = input.view;
         
-        // 3rd attribute buffer : VtexCoord
-        glEnableVertexAttribArray(vTexCoord);
-        glBindBuffer(GL_ARRAY_BUFFER, tex_id);
-        glVertexAttribPointer(
-                              2,                                // attribute. No particular reason for 1, but must match the layout in the shader.
-                              2,                                // size
-                              GL_FLOAT,                         // type
-                              GL_FALSE,                         // normalized?
-                              0,                                // stride
-                              (void*)0                          // array buffer offset
-                              );
+        // Skip every model outside the view frustum
+        Frustum frustum = extractFrustumPlanes(packet.VP);
+        if (model_objects.size() >= BVHCullThreshold){
+            scene_index.queryFrustum(frustum, visible_models);
+            packet.cull.tested = model_objects.size();
+            packet.cull.visible = visible_models.size();
+            packet.cull.culled = packet.cull.tested - packet.cull.visible;
+        }else{
+            cullBounds(frustum, world_bounds, visible_models, &packet.cull);
+        }
+        std::chrono::high_resolution_clock::time_point culled = std::chrono::high_resolution_clock::now();
         
-        /**********************************/
-        /*** UNBIND VERTEX-ARRAY OBJECT ***/
-        /**********************************/
+        // Then skip the ones hidden behind the visible occluders, their VP * M in one batch
+        frame_occluders.clear();
+        occluder_matrices.clear();
+        for (size_t v = 0; v < visible_models.size(); v++){
+            if (is_occluder[visible_models[v]]){
+                frame_occluders.push_back(visible_models[v]);
+                occluder_matrices.push_back(model_matrices[visible_models[v]]);
+            }
+        }
+        if (!occluder_matrices.empty())
+            multiplyMatrices(packet.VP, &occluder_matrices[0], &occluder_matrices[0], occluder_matrices.size());
+        occlusion_culler.beginFrame(packet.VP);
+        for (size_t k = 0; k < frame_occluders.size(); k++)
+            occlusion_culler.addOccluderMVP(model_objects[frame_occluders[k]].MV, occluder_matrices[k]);
+        if (occlusion_culler.getStats().occluders > 0 && visible_models.size() > occlusion_culler.getStats().occluders){
+            occlusion_culler.rasterize(thread_pool);
+            occlusion_culler.cullVisible(world_boxes, is_occluder, visible_models);
+        }
+        packet.occlusion = occlusion_culler.getStats();
+        std::chrono::high_resolution_clock::time_point occluded = std::chrono::high_resolution_clock::now();
         
-        glBindVertexArray(0);
+        // Queue the visible models, sorted by program, texture, VAO, material and depth
+        packet.queue.setDepthRange(0.1f, 100.0f);
+        packet.queue.setSortMode(options.frontToBack ? RenderQueue::SortFrontToBack : RenderQueue::SortByState);
+        packet.queue.clear();
+        packet.prepass.setDepthRange(0.1f, 100.0f);
+        packet.prepass.setSortMode(RenderQueue::SortFrontToBack);
+        packet.prepass.clear();
+        packet.objects.assign(visible_models.begin(), visible_models.end());
+        for (size_t v = 0; v < visible_models.size(); v++){
+            int i = visible_models[v];
+            glm::vec3 center(world_bounds.sx[i], world_bounds.sy[i], world_bounds.sz[i]);
+            DrawCommand command;
+            command.program = model_objects[i].program;
+            bool resident = model_resident[i] != 0;
+            command.vao = resident ? model_objects[i].vid : model_objects[i].bid;
+            command.texture = model_objects[i].tex;
+            command.material = model_objects[i].material;
+            command.first = 0;
+            command.count = resident ? num_indicator[i] : ProxyVertices;
+            command.modelMatrix = &model_matrices[i];
+            command.uniformSlot = v;
+            command.viewDepth = -(input.view * glm::vec4(center, 1.0f)).z;
+            packet.queue.push(command);
+            
+            if (options.depthPrepass){
+                command.program = depthProgramID;
+                command.vao = resident ? model_objects[i].pid : model_objects[i].bid;
+                command.texture = 0;
+                command.material = 0;
+                packet.prepass.push(command);
+            }
+        }
+        packet.queue.sort();
+        packet.prepass.sort();
+        std::chrono::high_resolution_clock::time_point queued = std::chrono::high_resolution_clock::now();
         
-    }
+        packet.cullMilliseconds = std::chrono::duration<double, std::milli>(culled - start).count();
+        packet.occlusionMilliseconds = std::chrono::duration<double, std::milli>(occluded - culled).count();
+        packet.queueMilliseconds = std::chrono::duration<double, std::milli>(queued - occluded).count();
+        
+        // Light lists for the clusters of this view
+        if (!scene_lights.empty())
+            light_clusters.assign(scene_lights, input.view, input.projection, packet.lights, &thread_pool);
+    };
+    
+    // Frame N+1 is built on the worker while frame N is submitted
+    FramePipeline<FrameInput, FramePacket> pipeline;
+    FramePacket inline_packet;
+    if (options.worker)
+        pipeline.start(buildFrame);
+    
+    // CPU and GPU time of each phase of the frame
+    FrameProfiler profiler;
+    const int PhaseClear = profiler.addPhase("clear", true);
+    const int PhaseCull = profiler.addPhase("cull", false);
+    const int PhaseOcclusion = profiler.addPhase("occlusion", false);
+    const int PhaseQueue = profiler.addPhase("queue", false);
+    const int PhaseLights = profiler.addPhase("lights", false);
+    const int PhasePrepass = profiler.addPhase("prepass", true);
+    const int PhaseDraw = profiler.addPhase("draw", true);
+    const int PhaseResolve = profiler.addPhase("resolve", true);
+    const int PhaseHud = profiler.addPhase("hud", true);
+    const int PhaseSwap = profiler.addPhase("swap", true);
+    profiler.initialize();
+    profiler.setRecording(options.profile != NULL);
+    
+    // Samples shaded by the main pass, [0] without and [1] with the depth pre-pass
+    SampleCounter shaded_counter;
+    shaded_counter.create();
+    bool shaded_prepass = false;
+    double shaded_samples[2] = { 0.0, 0.0 };
+    unsigned int shaded_frames[2] = { 0, 0 };
+    GLuint64 last_shaded = 0;
+    
+    // Statistics overlay, refreshed a few times per second so it stays readable
+    std::vector<std::string> hud_lines;
+    if (options.hud)
+        initText2D("textures/font.bmp", options.sdfText);
+    
+    // Frame times for --frames runs, measured after the GPU finished the frame
+    std::vector<double> frame_times;
+    if (options.frames > 0)
+        frame_times.reserve(options.frames);
+    
+    std::chrono::high_resolution_clock::time_point last_frame_start;
+    std::chrono::high_resolution_clock::time_point loop_start = std::chrono::high_resolution_clock::now();
     
-    do{
+    // --on-demand: frames still to draw before going idle. The worker builds one frame
+    // ahead, so a change takes two frames to reach the screen.
+    const int redraw_frames = pipeline.isRunning() ? 2 : 1;
+    int pending_frames = redraw_frames;
+    bool resumed = false;   // the frame after an idle wait, its interval is not a frame time
+    int drawn_frames = 0;
+    double idle_seconds = 0.0;
+    for (int frame = 0; ; frame++){
+        std::chrono::high_resolution_clock::time_point frame_start = std::chrono::high_resolution_clock::now();
+        profiler.beginFrame();
+        
+        // Resolution for this frame from the time the last one took
+        int render_width = options.width, render_height = options.height;
+        if (options.dynamicResolution){
+            if (frame > 0 && !resumed)
+                dynamic_resolution.update(std::chrono::duration<double, std::milli>(frame_start - last_frame_start).count());
+            dynamic_resolution.renderSize(options.width, options.height, render_width, render_height);
+        }
+        last_frame_start = frame_start;
+        if (offscreen){
+            glBindFramebuffer(GL_FRAMEBUFFER, msaa_target.fbo);
+            glViewport(0, 0, render_width, render_height);
+            // glClear ignores the viewport, keep it to the part that is used
+            glScissor(0, 0, render_width, render_height);
+            glEnable(GL_SCISSOR_TEST);
+        }
         
         // get updated View matrix from keyboard and mouse input
-        glm::mat4 ProjectionMatrix = getProjectionMatrix();
-        glm::mat4 ViewMatrix = getViewMatrix();
-        glm::mat4 ModelMatrix = glm::mat4(1.0);
-        glm::mat4 VP = ProjectionMatrix * ViewMatrix;
+        FrameInput input;
+        input.view = getViewMatrix();
+        input.projection = getProjectionMatrix();
+        // Fixed steps for --frames runs, so dumps don't depend on the frame rate
+        input.time = options.frames > 0 ? frame / 60.0 :
+                     std::chrono::duration<double>(frame_start - loop_start).count();
+        // --pick on the first frame, right clicks in the window
+        input.pick = frame == 0 && options.pick;
+        if (input.pick){
+            input.pickX = options.pickX;
+            input.pickY = options.pickY;
+        }else if (window){
+            input.pick = consumePick(input.pickX, input.pickY);
+        }
         
-        // Send our transformation to the currently bound shader,
-        // in the "MVP" uniform
-        glUniformMatrix4fv(ViewProjectionMatrixID, 1, GL_FALSE, &VP[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &model_objects[0].MM[0][0]);
+        FramePacket * packet;
+        if (pipeline.isRunning()){
+            // Nothing is in flight on the first frame
+            if (frame == 0)
+                pipeline.submit(input);
+            packet = &pipeline.acquire();
+            // Start on the next frame while this one is drawn; a pick is only made once
+            if (frame == 0)
+                input.pick = false;
+            pipeline.submit(input);
+        }else{
+            buildFrame(input, inline_packet);
+            packet = &inline_packet;
+        }
+        if (packet->picked){
+            const PickResult & pick = packet->pick;
+            if (pick.object >= 0)
+                printf("pick: model %d (%s) triangle %u, barycentrics %.3f %.3f %.3f, at %.3f %.3f %.3f (%.1f us)\n",
+                       pick.object, model_objects[pick.object].M.objFilename.c_str(), pick.triangle,
+                       pick.barycentric.x, pick.barycentric.y, pick.barycentric.z,
+                       pick.position.x, pick.position.y, pick.position.z, packet->pickMicroseconds);
+            else
+                printf("pick: nothing (%.1f us)\n", packet->pickMicroseconds);
+        }
+        profiler.record(PhaseCull, packet->cullMilliseconds);
+        profiler.record(PhaseOcclusion, packet->occlusionMilliseconds);
+        profiler.record(PhaseQueue, packet->queueMilliseconds);
+        if (!scene_lights.empty())
+            profiler.record(PhaseLights, packet->lights.stats.milliseconds);
+        const CullStats & cull_stats = packet->cull;
+        const OcclusionStats & occlusion_stats = packet->occlusion;
+        
+        // Models the worker moved. It builds one packet per submitted input, so no move is skipped
+        for (size_t m = 0; m < packet->moved.size(); m++){
+            object_constants[packet->moved[m].object].M = packet->moved[m].M;
+            object_constants[packet->moved[m].object].N = packet->moved[m].N;
+        }
+        
+        // Write this frame's constants into the ring; the section was fenced three frames ago
+        uniform_ring.beginFrame();
+        void * frame_data;
+        void * object_data;
+        GLintptr frame_offset = uniform_ring.allocate(sizeof(FrameConstants), &frame_data);
+        GLintptr object_offset = uniform_ring.allocate(object_stride * std::max<size_t>(packet->objects.size(), 1), &object_data);
+        if (frame_offset < 0 || object_offset < 0){
+            fprintf(stderr, "Uniform ring overflow\n");
+            break;
+        }
+        FrameConstants * frame_constants = (FrameConstants *)frame_data;
+        frame_constants->VP = packet->VP;
+        frame_constants->V = packet->V;
+        float slice_scale, slice_bias;
+        light_clusters.sliceParameters(slice_scale, slice_bias);
+        frame_constants->clusterScale = glm::vec4((float)LightGrid.tilesX / render_width, (float)LightGrid.tilesY / render_height,
+                                                  slice_scale, slice_bias);
+        frame_constants->clusterGrid = glm::ivec4(LightGrid.tilesX, LightGrid.tilesY, LightGrid.slices, 0);
+        frame_constants->sunDirection = packet->V * glm::vec4(glm::normalize(glm::vec3(0.5f, 1.0f, 0.3f)), 0.0f);
+        frame_constants->sunColor = glm::vec4(0.3f, 0.3f, 0.3f, 1.0f);
+        for (size_t o = 0; o < packet->objects.size(); o++)
+            memcpy((unsigned char *)object_data + o * object_stride, &object_constants[packet->objects[o]], sizeof(ObjectConstants));
+        uniform_ring.flush();
+        glBindBufferRange(GL_UNIFORM_BUFFER, FrameConstantsBinding, uniform_ring.getBuffer(), frame_offset, sizeof(FrameConstants));
+        packet->queue.setObjectUniforms(ObjectConstantsBinding, uniform_ring.getBuffer(), object_offset, object_stride);
+        if (!scene_lights.empty()){
+            light_buffers.upload(packet->lights);
+            light_buffers.bind(LightTextureUnit);
+        }
         
         
         
@@ -264,41 +1494,344 @@ int main( void )
         /**********************************/
         
         // Clear the screen
+        profiler.begin(PhaseClear);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        profiler.end(PhaseClear);
         
-        //iteration through the model buffer
-        for (int i = 0; i < models.size(); i++){
-            // Bind VAO
-            glBindVertexArray(vertex_vector[i]);
-            glBindTexture(GL_TEXTURE_2D, i+1);
-            glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-            
-            // Set our Model transform matrix
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &model_objects[i].MM[0][0]);
-            
-            glDrawArrays(GL_TRIANGLES, 0, num_indicator[i]);
+        // Depth first, front to back, so the main pass only shades visible fragments
+        bool use_prepass = options.depthPrepass && (!options.prepassCompare || frame % 2 == 0);
+        if (use_prepass){
+            profiler.begin(PhasePrepass);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            packet->prepass.setObjectUniforms(ObjectConstantsBinding, uniform_ring.getBuffer(), object_offset, object_stride);
+            packet->prepass.submit(-1);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            profiler.end(PhasePrepass);
+        }
+        
+        // Draw the visible models in state order
+        profiler.begin(PhaseDraw);
+        shaded_counter.begin();
+        packet->queue.submit(ModelMatrixID);
+        shaded_counter.end();
+        uniform_ring.endFrame();
+        profiler.end(PhaseDraw);
+        if (use_prepass){
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        
+        // Compact some of the vertex pool behind the frame's draws; models whose range
+        // moved read from its new place from the next frame on
+        if (!vertex_pool.isCompacted()){
+            moved_ranges.clear();
+            vertex_pool.defragment(VertexPoolDefragBytes, moved_ranges);
+            for (size_t m = 0; m < moved_ranges.size(); m++)
+                setVertexPointers(model_objects[vertex_pool_objects[moved_ranges[m]]], vertex_pool);
+        }
+        
+        // Geometry residency: the models of this frame are the most recently drawn. Meshes
+        // streamed back go into the pool, then the least recently drawn make room for the
+        // visible ones that are still boxes.
+        if (residency.hasBudget()){
+            for (size_t o = 0; o < packet->objects.size(); o++)
+                residency.touch(packet->objects[o], frame);
+            streamed_meshes.clear();
+            streaming_loads -= (unsigned int)mesh_streamer.poll(streamed_meshes);
+            for (size_t m = 0; m < streamed_meshes.size(); m++){
+                StreamedMesh & mesh = streamed_meshes[m];
+                ModelObjects & object = model_objects[mesh.item];
+                // The file must still have the layout it had when the scene was loaded
+                size_t count = mesh.vertices.size();
+                bool loaded = mesh.loaded && count == (size_t)num_indicator[mesh.item] &&
+                              (!object.normalOffset || mesh.normals.size() == count) &&
+                              (!object.uvOffset || mesh.uvs.size() == count);
+                if (loaded && object.vertices == BufferSuballocator::NoAllocation){
+                    size_t bytes = vertexLayout(object, count, object.normalOffset != 0, object.uvOffset != 0);
+                    uploadVertices(object, vertex_pool, bytes, mesh.vertices, mesh.normals, mesh.uvs);
+                    memory.allocateGPU(object.meshAsset, vertex_pool.getSize(object.vertices));
+                    std::swap(model_meshes[mesh.item], mesh.bvh);
+                    memory.allocateCPU(mesh_assets[mesh.item], model_meshes[mesh.item].memoryBytes());
+                    if (vertex_pool_objects.size() <= object.vertices)
+                        vertex_pool_objects.resize(object.vertices + 1, -1);
+                    vertex_pool_objects[object.vertices] = mesh.item;
+                    setVertexPointers(object, vertex_pool);
+                }
+                residency.finishLoad(mesh.item, loaded);
+                model_resident[mesh.item] = loaded;
+            }
             
-            // Unbind VAO
-            glBindVertexArray(0);
+            residency_loads.clear();
+            residency_evictions.clear();
+            residency.update(frame, ResidencyKeepFrames, ResidencyLoadsPerFrame, residency_loads, residency_evictions);
+            for (size_t e = 0; e < residency_evictions.size(); e++){
+                EvictedMesh evicted = { residency_evictions[e], frame };
+                model_resident[evicted.object] = 0;
+                evicted_meshes.push_back(evicted);
+            }
+            for (size_t l = 0; l < residency_loads.size(); l++){
+                unsigned int i = residency_loads[l];
+                if (model_objects[i].vertices != BufferSuballocator::NoAllocation){
+                    // Evicted so recently that its range is still there
+                    residency.finishLoad(i, true);
+                    model_resident[i] = 1;
+                }else{
+                    mesh_streamer.request(i, model_objects[i].M.objFilename, options.bundle ? mesh_chunks[i] : -1);
+                    streaming_loads++;
+                }
+            }
             
+            // Ranges and pick BVHs of meshes still evicted, once no packet in flight draws
+            // or picks them
+            size_t kept = 0;
+            for (size_t e = 0; e < evicted_meshes.size(); e++){
+                EvictedMesh evicted = evicted_meshes[e];
+                if (frame < evicted.frame + ResidencyRetireFrames){
+                    evicted_meshes[kept++] = evicted;
+                    continue;
+                }
+                ModelObjects & object = model_objects[evicted.object];
+                if (residency.getState(evicted.object) == ResidencyManager::Evicted &&
+                    object.vertices != BufferSuballocator::NoAllocation){
+                    memory.releaseGPU(object.meshAsset, vertex_pool.getSize(object.vertices));
+                    vertex_pool.free(object.vertices);
+                    object.vertices = BufferSuballocator::NoAllocation;
+                    memory.releaseCPU(mesh_assets[evicted.object], model_meshes[evicted.object].memoryBytes());
+                    model_meshes[evicted.object] = MeshBVH();
+                }
+            }
+            evicted_meshes.resize(kept);
         }
         
-        // Swap buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // The count read back belongs to the previous frame
+        if (shaded_counter.previous(last_shaded)){
+            shaded_samples[shaded_prepass] += (double)last_shaded;
+            shaded_frames[shaded_prepass]++;
+        }
+        shaded_prepass = use_prepass;
+        const RenderQueueStats & queue_stats = packet->queue.getStats();
         
-    } // Check if the ESC key was pressed or the window was closed
-    while( glfwGetKey(window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
-          glfwWindowShouldClose(window) == 0 );
+        if (cull_stats.culled != last_culled || occlusion_stats.occluded != last_occluded ||
+            queue_stats.bindsAvoided() != last_avoided){
+            char title[200];
+            snprintf(title, sizeof(title), "CMPT 485 - %u drawn, %u culled, %u occluded (%.2f ms), %u binds avoided",
+                     queue_stats.draws, cull_stats.culled, occlusion_stats.occluded,
+                     occlusion_stats.rasterMilliseconds + occlusion_stats.testMilliseconds,
+                     queue_stats.bindsAvoided());
+            if (window)
+                glfwSetWindowTitle(window, title);
+            last_culled = cull_stats.culled;
+            last_occluded = occlusion_stats.occluded;
+            last_avoided = queue_stats.bindsAvoided();
+        }
+        
+        // Bring the scene to the output size, the overlay is drawn at full resolution
+        if (offscreen){
+            ScopedPhase phase(profiler, PhaseResolve);
+            glDisable(GL_SCISSOR_TEST);
+            if (options.dynamicResolution){
+                blitRenderTarget(msaa_target, render_width, render_height, &scaled_target, render_width, render_height);
+                blitRenderTarget(scaled_target, render_width, render_height, output_target, options.width, options.height);
+            }else{
+                resolveRenderTarget(msaa_target, output_target);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, output_target ? output_target->fbo : 0);
+            glViewport(0, 0, options.width, options.height);
+        }
+        
+        if (options.hud){
+            ScopedPhase phase(profiler, PhaseHud);
+            if (frame % 10 == 0){
+                profiler.formatOverlay(hud_lines);
+                const UniformRingStats & ring_stats = uniform_ring.getStats();
+                char ring_line[64];
+                snprintf(ring_line, sizeof(ring_line), "ring %s %uk stalls %u", ring_stats.persistent ? "persistent" : "mapped",
+                         (unsigned int)(ring_stats.bytesLastFrame / 1024), ring_stats.stalls);
+                hud_lines.push_back(ring_line);
+                char shaded_line[64];
+                if (options.prepassCompare && shaded_frames[0] && shaded_frames[1])
+                    snprintf(shaded_line, sizeof(shaded_line), "shaded %.2fM no prepass %.2fM prepass",
+                             shaded_samples[0] / shaded_frames[0] / 1e6, shaded_samples[1] / shaded_frames[1] / 1e6);
+                else
+                    snprintf(shaded_line, sizeof(shaded_line), "shaded %.2fM samples", last_shaded / 1e6);
+                hud_lines.push_back(shaded_line);
+                if (!scene_lights.empty()){
+                    const ClusterStats & light_stats = packet->lights.stats;
+                    char line[64];
+                    snprintf(line, sizeof(line), "lights %u/%u refs %u max %u", light_stats.lights, (unsigned int)scene_lights.size(),
+                             light_stats.references, light_stats.maxPerCluster);
+                    hud_lines.push_back(line);
+                }
+                if (options.dynamicResolution){
+                    char line[64];
+                    snprintf(line, sizeof(line), "scale %.2f %dx%d", dynamic_resolution.getScale(), render_width, render_height);
+                    hud_lines.push_back(line);
+                }
+                if (residency.hasBudget()){
+                    ResidencyStats residency_stats = residency.getStats();
+                    char line[64];
+                    snprintf(line, sizeof(line), "geometry %.1f/%.0f MB %u boxes %u loading",
+                             residency_stats.residentBytes / (1024.0 * 1024.0), options.geometryBudget,
+                             residency_stats.evicted, residency_stats.loading);
+                    hud_lines.push_back(line);
+                }
+            }
+            for (size_t l = 0; l < hud_lines.size(); l++)
+                printText2D(hud_lines[l].c_str(), 8, 580 - 16 * (int)l, 12);
+            flushText2D();
+        }
+        
+        profiler.begin(PhaseSwap);
+        if (window){
+            // Swap buffers
+            glfwSwapBuffers(window);
+        }
+        profiler.end(PhaseSwap);
+        profiler.endFrame();
+        
+        if (options.frames > 0){
+            glFinish();
+            frame_times.push_back(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frame_start).count());
+            if (options.dump){
+                char path[1024];
+                snprintf(path, sizeof(path), "%s%04d.ppm", options.dump, frame);
+                if (window){
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                    glReadBuffer(GL_FRONT);
+                }else{
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve_target.fbo);
+                }
+                saveFramebufferPPM(path, options.width, options.height);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            }
+            if (frame + 1 >= options.frames)
+                break;
+        }
+        
+        drawn_frames++;
+        
+        if (window){
+            glfwPollEvents();
+            if (options.onDemand){
+                // Keep drawing while the view or the scene changes, otherwise sleep until an
+                // event asks for a redraw or closes the window
+                resumed = false;
+                if (pending_frames > 0)
+                    pending_frames--;
+                if (consumeRedraw() || options.animate || streaming_loads)
+                    pending_frames = redraw_frames;
+                if (pending_frames == 0){
+                    std::chrono::high_resolution_clock::time_point idle_start = std::chrono::high_resolution_clock::now();
+                    while (!consumeRedraw() && glfwWindowShouldClose(window) == 0 && glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS)
+                        glfwWaitEvents();
+                    idle_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - idle_start).count();
+                    pending_frames = redraw_frames;
+                    resumed = true;
+                }
+            }
+            if (options.maxFps > 0.0 && !resumed)
+                std::this_thread::sleep_until(frame_start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+                                                  std::chrono::duration<double>(1.0 / options.maxFps)));
+            // Check if the ESC key was pressed or the window was closed
+            if (glfwGetKey(window, GLFW_KEY_ESCAPE ) == GLFW_PRESS || glfwWindowShouldClose(window) != 0)
+                break;
+        }
+    }
     
-    // Cleanup VBO and shader
-    glDeleteBuffers(1, &vertex_buffer);
-    glDeleteBuffers(1, &normalsbuffer);
-    glDeleteProgram(programID);
-    glDeleteVertexArrays(1, &vertex_id);
+    if (!frame_times.empty()){
+        printf("scene: %s, %dx%d, %s\n", options.scene, options.width, options.height, window ? "window" : "headless");
+        printFrameTimeSummary(summarizeFrameTimes(frame_times));
+        if (options.dynamicResolution)
+            printf("dynamic resolution: scale %.2f, average frame %.2f ms, target %.2f ms\n", dynamic_resolution.getScale(),
+                   dynamic_resolution.getAverageMilliseconds(), options.resolution.targetMilliseconds);
+    }
+    
+    if (window && options.onDemand){
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - loop_start).count();
+        printf("on demand: %d frames in %.1f s, idle %.1f s (%.0f%%)\n", drawn_frames, seconds, idle_seconds,
+               seconds > 0.0 ? 100.0 * idle_seconds / seconds : 0.0);
+    }
+    
+    pipeline.stop();
+    mesh_streamer.stop();
+    if (residency.hasBudget()){
+        ResidencyStats residency_stats = residency.getStats();
+        printf("geometry residency: budget %.1f MB, peak %.1f MB, %u loads (%u failed), %u evictions, %u of %u meshes resident at exit\n",
+               options.geometryBudget, residency_stats.peakBytes / (1024.0 * 1024.0), residency_stats.loads,
+               residency_stats.failed, residency_stats.evictions, residency_stats.resident, (unsigned int)model_objects.size());
+    }
+    const UniformRingStats & ring_stats = uniform_ring.getStats();
+    printf("uniform ring: %s, %u frames, %u stalls (%.2f ms), %u overflows\n", ring_stats.persistent ? "persistent" : "mapped per frame",
+           ring_stats.frames, ring_stats.stalls, ring_stats.stallMilliseconds, ring_stats.overflows);
+    uniform_ring.destroy();
+    light_buffers.destroy();
+    if (shaded_frames[0])
+        printf("samples shaded per frame without depth pre-pass: %.0f\n", shaded_samples[0] / shaded_frames[0]);
+    if (shaded_frames[1])
+        printf("samples shaded per frame with depth pre-pass: %.0f\n", shaded_samples[1] / shaded_frames[1]);
+    shaded_counter.destroy();
+    profiler.flush();
+    if (options.profile){
+        size_t length = strlen(options.profile);
+        if (length > 5 && strcmp(options.profile + length - 5, ".json") == 0)
+            profiler.exportJSON(options.profile);
+        else
+            profiler.exportCSV(options.profile);
+        printf("profile of %u frames written to %s\n", profiler.framesRecorded(), options.profile);
+    }
+    profiler.cleanup();
+    if (options.hud)
+        cleanupText2D();
+    
+    // Cleanup the buffers, vertex arrays and textures of every model, then the shaders
+    for (size_t i = 0; i < model_objects.size(); i++){
+        ModelObjects & object = model_objects[i];
+        glDeleteVertexArrays(1, &object.vid);
+        if (object.pid)
+            glDeleteVertexArrays(1, &object.pid);
+        if (object.vertices != BufferSuballocator::NoAllocation){
+            memory.releaseGPU(object.meshAsset, vertex_pool.getSize(object.vertices));
+            vertex_pool.free(object.vertices);
+        }
+        if (object.bid){
+            glDeleteVertexArrays(1, &object.bid);
+            memory.releaseGPU(object.meshAsset, vertex_pool.getSize(object.proxy));
+            vertex_pool.free(object.proxy);
+        }
+        memory.releaseCPU(object.meshAsset, vectorBytes(object.MV) + vectorBytes(object.MU) + vectorBytes(object.MN));
+        if (object.tex){
+            memory.releaseGPU(object.textureAsset, textureMemoryBytes(object.tex));
+            glDeleteTextures(1, &object.tex);
+        }
+        memory.releaseCPU(mesh_assets[i], model_meshes[i].memoryBytes());
+        if (!model_boxes.empty())
+            memory.releaseCPU(mesh_assets[i], model_boxes[i].memoryBytes());
+    }
+    vertex_pool.destroy();
+    scene_variants.destroy();
+    if (depthProgramID)
+        glDeleteProgram(depthProgramID);
+    
+    // Anything left was loaded without being released, or released twice
+    if (memory.cpuBytes() || memory.gpuBytes() || memory.overReleases() || options.memoryReport){
+        printf("memory after cleanup:\n");
+        memory.report(stdout);
+    }
+    
+    if (offscreen)
+        destroyRenderTarget(msaa_target);
+    if (options.dynamicResolution)
+        destroyRenderTarget(scaled_target);
     
-    // Close OpenGL window and terminate GLFW
-    glfwTerminate();
+    if (window){
+        // Close OpenGL window and terminate GLFW
+        glfwTerminate();
+    }else{
+        destroyRenderTarget(resolve_target);
+        destroyHeadlessContext();
+    }
     
     return 0;
 }
@@ -0,0 +1,39 @@
+// Include standard headers
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include <common/bundle.hpp>
+
+// Packs a .models scene, its meshes and its textures into one bundle for part4 --bundle.
+// The file names in the .models file are read relative to --dir, or to the working
+// directory like part4 reads them.
+// Usage: packbundle scene.models out.bundle [--lz4] [--dir directory]
+int main(int argc, char ** argv)
+{
+    const char * modelsPath = NULL;
+    const char * bundlePath = NULL;
+    std::string directory;
+    bool compress = false, valid = true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lz4") == 0)
+            compress = true;
+        else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            directory = argv[++i];
+        else if (argv[i][0] != '-' && !modelsPath)
+            modelsPath = argv[i];
+        else if (argv[i][0] != '-' && !bundlePath)
+            bundlePath = argv[i];
+        else
+            valid = false;
+    }
+    if (!valid || !modelsPath || !bundlePath) {
+        fprintf(stderr, "Usage: %s scene.models out.bundle [--lz4] [--dir directory]\n", argv[0]);
+        return 1;
+    }
+    return packScene(modelsPath, directory, bundlePath, compress) ? 0 : 1;
+}